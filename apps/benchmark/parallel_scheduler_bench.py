@@ -0,0 +1,94 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""Benchmark of the CPU thread pool scheduling policies.
+
+Compares the p50 and p99 latency of a parallel operator launched with the
+static split against the chunked work-stealing launch, while background
+processes spin on some of the cores to emulate stragglers.
+see README.md for the usage of this script.
+"""
+import argparse
+import multiprocessing
+import time
+
+import numpy as np
+
+import tvm
+
+
+def spin():
+    while True:
+        pass
+
+
+def build(n, chunked):
+    A = tvm.placeholder((n, n), name='A')
+    B = tvm.placeholder((n, n), name='B')
+    k = tvm.reduce_axis((0, n), name='k')
+    C = tvm.compute((n, n), lambda i, j: tvm.sum(A[i, k] * B[j, k], axis=k), name='C')
+    s = tvm.create_schedule(C.op)
+    s[C].parallel(C.op.axis[0])
+    with tvm.build_config(chunked_parallel_launch=chunked):
+        return tvm.build(s, [A, B, C], "llvm")
+
+
+def measure(func, n, repeat):
+    ctx = tvm.cpu(0)
+    a = tvm.nd.array(np.random.uniform(size=(n, n)).astype('float32'), ctx)
+    b = tvm.nd.array(np.random.uniform(size=(n, n)).astype('float32'), ctx)
+    c = tvm.nd.array(np.zeros((n, n), dtype='float32'), ctx)
+    # warm up the thread pool
+    for _ in range(10):
+        func(a, b, c)
+    costs = []
+    for _ in range(repeat):
+        tic = time.perf_counter()
+        func(a, b, c)
+        costs.append((time.perf_counter() - tic) * 1000)
+    return np.percentile(costs, 50), np.percentile(costs, 99)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--size", type=int, default=256, help="The size of the square matmul.")
+    parser.add_argument("--repeat", type=int, default=1000)
+    parser.add_argument("--load", type=int, default=1,
+                        help="The number of background processes spinning on the cores.")
+    parser.add_argument("--chunks-per-worker", type=int, default=8,
+                        help="The number of chunks per worker of the work-stealing launch.")
+    args = parser.parse_args()
+
+    static_func = build(args.size, False)
+    chunked_func = build(args.size, True)
+    set_chunking = tvm.get_global_func("runtime.config_threadpool_chunking")
+    set_chunking(args.chunks_per_worker)
+
+    loads = [multiprocessing.Process(target=spin, daemon=True) for _ in range(args.load)]
+    for p in loads:
+        p.start()
+
+    print("--------------------------------------------------")
+    print("%-20s %-12s %-12s" % ("Scheduler", "p50", "p99"))
+    print("--------------------------------------------------")
+    try:
+        for name, func in [("static", static_func), ("work-stealing", chunked_func)]:
+            p50, p99 = measure(func, args.size, args.repeat)
+            print("%-20s %-12s %-12s" % (name, "%.3f ms" % p50, "%.3f ms" % p99))
+        print(tvm.get_global_func("runtime.threadpool_stats")())
+    finally:
+        for p in loads:
+            p.terminate()
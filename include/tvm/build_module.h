@@ -235,6 +235,18 @@ class BuildConfigNode : public Object {
   /*! \brief Whether to disable assert stmt generation. */
   bool disable_assert = false;
 
+  /*!
+   * \brief Whether parallel loops without barriers are launched as chunks that
+   *  idle workers can steal, see TVMBackendParallelLaunchChunked.
+   */
+  bool chunked_parallel_launch = false;
+
+  /*!
+   * \brief The number of LLVM modules the host functions are split into,
+   *  each optimized and emitted to object code on its own thread.
+   */
+  int llvm_codegen_partitions = 1;
+
   void VisitAttrs(AttrVisitor* v) {
     v->Visit("data_alignment", &data_alignment);
     v->Visit("offset_factor", &offset_factor);
@@ -251,6 +263,8 @@ class BuildConfigNode : public Object {
     v->Visit("disable_select_rewriting", &disable_select_rewriting);
     v->Visit("disable_vectorize", &disable_vectorize);
     v->Visit("disable_assert", &disable_assert);
+    v->Visit("chunked_parallel_launch", &chunked_parallel_launch);
+    v->Visit("llvm_codegen_partitions", &llvm_codegen_partitions);
   }
 
   static constexpr const char* _type_key = "BuildConfig";
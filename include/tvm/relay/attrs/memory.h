@@ -38,6 +38,7 @@ struct AllocTensorAttrs : public tvm::AttrsNode<AllocTensorAttrs> {
   Constant const_shape;
   Array<IndexExpr> assert_shape;
   DataType dtype;
+  int64_t offset;
 
   TVM_DECLARE_ATTRS(AllocTensorAttrs, "relay.attrs.AllocTensorAttrs") {
     TVM_ATTR_FIELD(dtype)
@@ -51,6 +52,35 @@ struct AllocTensorAttrs : public tvm::AttrsNode<AllocTensorAttrs> {
       .describe(
          "The shape to cast the return type of the allocation to, "\
          "used to specify the shape obtained via further analysis.");
+    TVM_ATTR_FIELD(offset)
+      .describe(
+         "The byte offset of the tensor in the storage, only supported "\
+         "for tensors of a constant shape.")
+      .set_default(0);
+  }
+};
+
+/*!
+ * \brief Options for allocating storage.
+ */
+struct AllocStorageAttrs : public tvm::AttrsNode<AllocStorageAttrs> {
+  DataType dtype;
+  int device_type;
+  int device_id;
+
+  TVM_DECLARE_ATTRS(AllocStorageAttrs, "relay.attrs.AllocStorageAttrs") {
+    TVM_ATTR_FIELD(dtype)
+      .describe(
+         "The dtype of the tensors to be allocated in the storage.")
+      .set_default(DataType::Float(32, 1));
+    TVM_ATTR_FIELD(device_type)
+      .describe(
+         "The type of the device of the storage, -1 for the default context of the VM.")
+      .set_default(-1);
+    TVM_ATTR_FIELD(device_id)
+      .describe(
+         "The id of the device of the storage.")
+      .set_default(0);
   }
 };
 
@@ -64,6 +64,7 @@
 #include <tvm/relay/module.h>
 #include <tvm/relay/op.h>
 #include <tvm/relay/op_attr_types.h>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -77,6 +78,87 @@ namespace transform {
  */
 class PassContext;
 
+class PassProfiler;
+
+/*!
+ * \brief PassProfilerNode records the runs of the passes under a PassContext,
+ * i.e. their wall time, the number of IR nodes of the module before and after
+ * them, and how much they raise the peak memory of the process.
+ *
+ * The runs nest: a pass run inside another one, e.g. by a Sequential, is a
+ * child of it in the report. Passes may run on several threads at once.
+ */
+class PassProfilerNode : public RelayNode {
+ public:
+  /*! \brief The record of one run of a pass. */
+  struct Event {
+    /*! \brief The name of the pass. */
+    std::string name;
+    /*! \brief The kind of the pass, i.e. module, function or sequential. */
+    std::string kind;
+    /*! \brief The index of the enclosing run on the same thread, -1 for none. */
+    int64_t parent;
+    /*! \brief The index of the thread of the run. */
+    uint32_t tid;
+    /*! \brief The begin and end of the run in nanoseconds. */
+    int64_t begin_ns;
+    int64_t end_ns;
+    /*! \brief The number of IR nodes before and after, -1 if the pass failed. */
+    int64_t nodes_before;
+    int64_t nodes_after;
+    /*! \brief The growth of the peak resident memory of the process in KB. */
+    int64_t peak_rss_kb;
+  };
+
+  void VisitAttrs(tvm::AttrVisitor* v) {}
+
+  /*!
+   * \brief Record the start of a pass.
+   * \param name The name of the pass.
+   * \param kind The kind of the pass.
+   * \param mod The module that the pass runs on.
+   * \return The index of the run, to be passed to ExitPass.
+   */
+  TVM_DLL size_t EnterPass(const std::string& name, const std::string& kind,
+                           const Module& mod);
+  /*!
+   * \brief Record the end of a pass.
+   * \param index The index of the run returned by EnterPass.
+   * \param mod The updated module, or undefined if the pass failed.
+   */
+  TVM_DLL void ExitPass(size_t index, const Module& mod);
+  /*! \brief Get a copy of the recorded runs, in the order they started. */
+  TVM_DLL std::vector<Event> Events() const;
+  /*! \brief Clear the recorded runs. */
+  TVM_DLL void Reset();
+  /*!
+   * \brief A table of the recorded runs, aggregated by their position in the
+   * tree of nested passes, with the number of calls, total and self time, IR
+   * size and memory growth of each.
+   */
+  TVM_DLL std::string Report() const;
+  /*! \brief The recorded runs in the Chrome trace event format. */
+  TVM_DLL std::string ToChromeJSON() const;
+
+  TVM_DLL static PassProfiler make();
+
+  static constexpr const char* _type_key = "relay.PassProfiler";
+  TVM_DECLARE_FINAL_OBJECT_INFO(PassProfilerNode, RelayNode);
+
+ private:
+  /*! \brief Guards the fields below. */
+  mutable std::mutex mutex_;
+  /*! \brief The recorded runs. */
+  std::vector<Event> events_;
+  /*! \brief The runs in progress of each thread, innermost last. */
+  std::unordered_map<uint32_t, std::vector<size_t> > open_;
+};
+
+class PassProfiler : public ObjectRef {
+ public:
+  TVM_DEFINE_MUTABLE_OBJECT_REF_METHODS(PassProfiler, ObjectRef, PassProfilerNode);
+};
+
 /*!
  * \brief PassContextNode contains the information that a pass can rely on,
  * such as analysis results.
@@ -99,6 +181,15 @@ class PassContextNode : public RelayNode {
   /*! \brief The list of disabled passes. */
   tvm::Array<tvm::PrimExpr> disabled_pass;
 
+  /*! \brief The profiler of the passes, undefined to not record them. */
+  PassProfiler profiler;
+
+  /*!
+   * \brief The number of threads that run a thread-safe function pass over
+   * the functions of a module, 1 to run it sequentially.
+   */
+  int function_pass_threads{1};
+
   PassContextNode() = default;
 
   void VisitAttrs(tvm::AttrVisitor* v) {
@@ -106,6 +197,8 @@ class PassContextNode : public RelayNode {
     v->Visit("fallback_device", &fallback_device);
     v->Visit("required_pass", &required_pass);
     v->Visit("disabled_pass", &disabled_pass);
+    v->Visit("profiler", &profiler);
+    v->Visit("function_pass_threads", &function_pass_threads);
   }
 
   static constexpr const char* _type_key = "relay.PassContext";
@@ -341,6 +434,10 @@ Pass CreateModulePass(
  * \param opt_level The optimization level of the function pass.
  * \param name The name of the function pass.
  * \param required The list of the passes that the function pass is dependent on.
+ * \param thread_safe Whether pass_func can run on several functions of a
+ *  module at once, see PassContextNode::function_pass_threads. It must then
+ *  only read the module and the pass context, and not depend on thread-local
+ *  state such as the current target or a Python dispatch context.
  *
  * \return The created function pass.
  */
@@ -348,7 +445,8 @@ TVM_DLL Pass CreateFunctionPass(const runtime::TypedPackedFunc<
                                 Function(Function, Module, PassContext)>& pass_func,
                                 int opt_level,
                                 const std::string& name,
-                                const tvm::Array<tvm::PrimExpr>& required);
+                                const tvm::Array<tvm::PrimExpr>& required,
+                                bool thread_safe = false);
 
 /*! \brief Remove expressions which does not effect the program result.
  *
@@ -131,6 +131,10 @@ typedef int (*FTVMParallelLambda)(
 /*!
  * \brief Backend function for running parallel jobs.
  *
+ *  A job launched from within the task of another job runs its tasks
+ *  serially on the calling thread, so those tasks must not call
+ *  TVMBackendParallelBarrier when there is more than one of them.
+ *
  * \param flambda The parallel function to be launched.
  * \param cdata The closure data.
  * \param num_task Number of tasks to launch, can be 0, means launch
@@ -142,6 +146,26 @@ TVM_DLL int TVMBackendParallelLaunch(FTVMParallelLambda flambda,
                                      void* cdata,
                                      int num_task);
 
+/*!
+ * \brief Backend function for running parallel jobs split into independent chunks.
+ *
+ *  Unlike TVMBackendParallelLaunch, every task id passed to flambda denotes
+ *  a chunk of work that does not synchronize with the others, so flambda
+ *  must not call TVMBackendParallelBarrier. This allows the runtime to run
+ *  more chunks than there are workers and to let idle workers steal the
+ *  chunks assigned to busy ones.
+ *
+ * \param flambda The parallel function to be launched.
+ * \param cdata The closure data.
+ * \param num_chunk Number of chunks to split the job into, can be 0,
+ *           means let the runtime decide based on the number of workers.
+ *
+ * \return 0 when no error is thrown, -1 when failure happens
+ */
+TVM_DLL int TVMBackendParallelLaunchChunked(FTVMParallelLambda flambda,
+                                            void* cdata,
+                                            int num_chunk);
+
 /*!
  * \brief BSP barrrier between parallel threads
  * \param task_id the task id of the function.
@@ -365,6 +365,18 @@ inline Object* TVMArrayHandleToObjectHandle(TVMArrayHandle handle) {
 /*! \brief Magic number for NDArray file */
 constexpr uint64_t kTVMNDArrayMagic = 0xDD5E40F096B4A13F;
 
+/*!
+ * \brief Version of a saved DLTensor whose data starts at a multiple of
+ *  kTVMNDArrayDataAlign in the file, stored in the reserved field.
+ *
+ *  The data byte size is followed by the number of padding bytes and the
+ *  padding, so the data of the file can be mapped into memory in place.
+ */
+constexpr uint64_t kTVMNDArrayAlignedVersion = 1;
+
+/*! \brief Alignment of the data of an aligned DLTensor in the file, the page size. */
+constexpr uint64_t kTVMNDArrayDataAlign = 4096;
+
 inline bool SaveDLTensor(dmlc::Stream* strm,
                          const DLTensor* tensor) {
   uint64_t header = kTVMNDArrayMagic, reserved = 0;
@@ -414,6 +426,56 @@ inline bool SaveDLTensor(dmlc::Stream* strm,
   return true;
 }
 
+/*!
+ * \brief Save a DLTensor with its data aligned to kTVMNDArrayDataAlign.
+ *
+ *  Tensors smaller than the alignment are saved in the plain layout, as
+ *  they gain nothing from being mapped in place.
+ *
+ * \param strm The stream, whose position 0 is the beginning of the file.
+ * \param tensor The tensor.
+ */
+inline bool SaveDLTensorAligned(dmlc::SeekStream* strm,
+                                const DLTensor* tensor) {
+  int64_t num_elems = 1;
+  for (int i = 0; i < tensor->ndim; ++i) {
+    num_elems *= tensor->shape[i];
+  }
+  int64_t data_byte_size = (tensor->dtype.bits / 8) * num_elems;
+  if (!DMLC_IO_NO_ENDIAN_SWAP ||
+      static_cast<uint64_t>(data_byte_size) < kTVMNDArrayDataAlign) {
+    return SaveDLTensor(strm, tensor);
+  }
+  uint64_t header = kTVMNDArrayMagic, reserved = kTVMNDArrayAlignedVersion;
+  strm->Write(header);
+  strm->Write(reserved);
+  DLContext cpu_ctx;
+  cpu_ctx.device_type = kDLCPU;
+  cpu_ctx.device_id = 0;
+  strm->Write(cpu_ctx);
+  strm->Write(tensor->ndim);
+  strm->Write(tensor->dtype);
+  strm->WriteArray(tensor->shape, tensor->ndim);
+  strm->Write(data_byte_size);
+  uint64_t data_pos = strm->Tell() + sizeof(uint64_t);
+  uint64_t padding = (kTVMNDArrayDataAlign - data_pos % kTVMNDArrayDataAlign) % kTVMNDArrayDataAlign;
+  strm->Write(padding);
+  std::vector<uint8_t> zeros(padding, 0);
+  strm->Write(dmlc::BeginPtr(zeros), padding);
+  if (tensor->ctx.device_type == kDLCPU &&
+      tensor->strides == nullptr &&
+      tensor->byte_offset == 0) {
+    strm->Write(tensor->data, data_byte_size);
+  } else {
+    std::vector<uint8_t> bytes(data_byte_size);
+    CHECK_EQ(TVMArrayCopyToBytes(
+        const_cast<DLTensor*>(tensor), dmlc::BeginPtr(bytes), data_byte_size), 0)
+        << TVMGetLastError();
+    strm->Write(dmlc::BeginPtr(bytes), data_byte_size);
+  }
+  return true;
+}
+
 inline void NDArray::Save(dmlc::Stream* strm) const {
   SaveDLTensor(strm, operator->());
 }
@@ -453,6 +515,16 @@ inline bool NDArray::Load(dmlc::Stream* strm) {
       << "Invalid DLTensor file format";
   CHECK(data_byte_size == num_elems * elem_bytes)
       << "Invalid DLTensor file format";
+  if (reserved == kTVMNDArrayAlignedVersion) {
+    uint64_t padding;
+    CHECK(strm->Read(&padding))
+        << "Invalid DLTensor file format";
+    CHECK_LT(padding, kTVMNDArrayDataAlign)
+        << "Invalid DLTensor file format";
+    std::vector<uint8_t> skip(padding);
+    CHECK_EQ(strm->Read(dmlc::BeginPtr(skip), padding), padding)
+        << "Invalid DLTensor file format";
+  }
   CHECK(strm->Read(ret->data, data_byte_size))
       << "Invalid DLTensor file format";
   if (!DMLC_IO_NO_ENDIAN_SWAP) {
@@ -81,6 +81,17 @@ class ThreadGroup {
    */
   int Configure(AffinityMode mode, int nthreads, bool exclude_worker0);
 
+  /*!
+   * \brief configure the workers to run on an explicit set of cores
+   *
+   * \param cores The ids of the cores, worker i is bound to cores[i].
+   * \param exclude_worker0 Whether to use the main thread as a worker.
+   *        If `true`, the main thread is bound to the whole set of cores.
+   *
+   * \return The number of workers to use.
+   */
+  int ConfigureCores(const std::vector<unsigned>& cores, bool exclude_worker0);
+
  private:
   Impl* impl_;
 };
@@ -27,13 +27,19 @@
 #include <tvm/runtime/object.h>
 #include <tvm/runtime/packed_func.h>
 #include <tvm/runtime/registry.h>
+#include <atomic>
+#include <future>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 namespace tvm {
 namespace runtime {
+
+class MappedFile;
+
 namespace vm {
 
 /*! \brief An object representing a closure. */
@@ -91,6 +97,14 @@ enum class Opcode {
   LoadConsti = 14U,
   Fatal = 15U,
   AllocStorage = 16U,
+  DeviceCopy = 17U,
+  // Superinstructions formed by the VM when it loads an executable, which
+  // are never serialized. Each replaces the first instruction of the
+  // sequence it fuses and jumps over the rest of it.
+  IfConst = 18U,
+  IfTag = 19U,
+  AllocStorageConst = 20U,
+  AllocStorageTensor = 21U,
 };
 
 /*! \brief A single virtual machine instruction.
@@ -113,6 +127,8 @@ struct Instruction {
     struct /* AllocTensor Operands */ {
       /*! \brief The storage to allocate from. */
       RegName storage;
+      /*! \brief The byte offset of the tensor in the storage. */
+      Index offset;
       /*! \brief The number of dimensions. */
       uint32_t ndim;
       /*! \brief The shape of tensor. */
@@ -175,6 +191,8 @@ struct Instruction {
     struct /* LoadConst Operands */ {
       /* \brief The index into the constant pool. */
       Index const_index;
+      /* \brief The device type to load the constant to, -1 for the default context. */
+      Index const_device_type;
     };
     struct /* LoadConsti Operands */ {
       /* \brief The index into the constant pool. */
@@ -217,7 +235,55 @@ struct Instruction {
       RegName alignment;
       /*! \brief The hint of the dtype. */
       DLDataType dtype_hint;
+      /*! \brief The device type of the allocation, -1 for the default context. */
+      Index device_type;
+      /*! \brief The device id of the allocation. */
+      Index device_id;
     } alloc_storage;
+    struct /* DeviceCopy Operands */ {
+      /*! \brief The register containing the tensor to copy. */
+      RegName src;
+      /*! \brief The device type to copy the tensor to. */
+      Index device_type;
+      /*! \brief The device id to copy the tensor to. */
+      Index device_id;
+    } device_copy;
+    struct /* IfConst Operands */ {
+      /*! \brief The register containing the test value. */
+      RegName test;
+      /*! \brief The value to compare the test value with. */
+      Index target_val;
+      /*! \brief The program counter offset for the true branch. */
+      Index true_offset;
+      /*! \brief The program counter offset for the false branch. */
+      Index false_offset;
+    } if_const;
+    struct /* IfTag Operands */ {
+      /*! \brief The register containing the ADT. */
+      RegName object;
+      /*! \brief The tag to compare the tag of the ADT with. */
+      Index tag;
+      /*! \brief The program counter offset for the true branch. */
+      Index true_offset;
+      /*! \brief The program counter offset for the false branch. */
+      Index false_offset;
+    } if_tag;
+    struct /* AllocStorageConst and AllocStorageTensor Operands */ {
+      /*! \brief The size of the allocation. */
+      Index allocation_size;
+      /*! \brief The alignment of the allocation. */
+      Index alignment;
+      /*! \brief The hint of the dtype. */
+      DLDataType dtype_hint;
+      /*! \brief The device of the allocation, narrowed to keep the instruction small. */
+      int32_t device_type;
+      int32_t device_id;
+      /*!
+       * \brief The number of instructions fused. AllocStorageTensor also runs
+       *  the AllocTensor following them.
+       */
+      Index num_fused;
+    } alloc_storage_const;
   };
 
   /*!
@@ -244,12 +310,13 @@ struct Instruction {
   /*!
    * \brief Construct an allocate tensor instruction with constant shape.
    * \param storage The storage to allocate out of.
+   * \param offset The byte offset of the tensor in the storage.
    * \param shape The shape of the tensor.
    * \param dtype The dtype of the tensor.
    * \param dst The destination register.
    * \return The allocate tensor instruction.
    */
-  static Instruction AllocTensor(RegName storage,
+  static Instruction AllocTensor(RegName storage, Index offset,
                                  const std::vector<int64_t>& shape, DLDataType dtype, RegName dst);
   /*!
    * \brief Construct an allocate tensor instruction with register.
@@ -331,9 +398,10 @@ struct Instruction {
    * \brief Construct a load constant instruction.
    * \param const_index The index of the constant.
    * \param dst The destination register.
+   * \param device_type The device type to load the constant to, -1 for the default context.
    * \return The load constant instruction.
    */
-  static Instruction LoadConst(Index const_index, RegName dst);
+  static Instruction LoadConst(Index const_index, RegName dst, Index device_type = -1);
   /*!
    * \brief Construct a load_constanti instruction.
    * \param val The interger constant value.
@@ -355,10 +423,22 @@ struct Instruction {
    * \param alignment The allocation's alignment.
    * \param dtype_hint The data type hint for the allocator.
    * \param dst The destination to place the storage.
+   * \param device_type The device type of the storage, -1 for the default context.
+   * \param device_id The device id of the storage.
    * \return The alloc storage instruction.
    */
   static Instruction AllocStorage(RegName size, RegName alignment,
-                                  DLDataType dtype_hint, RegName dst);
+                                  DLDataType dtype_hint, RegName dst,
+                                  Index device_type = -1, Index device_id = 0);
+  /*!
+   * \brief Copy a tensor to another device.
+   * \param src The register containing the tensor.
+   * \param device_type The device type to copy to.
+   * \param device_id The device id to copy to.
+   * \param dst The destination register.
+   * \return The device copy instruction.
+   */
+  static Instruction DeviceCopy(RegName src, Index device_type, Index device_id, RegName dst);
 
   Instruction();
   Instruction(const Instruction& instr);
@@ -383,14 +463,21 @@ struct VMFunction {
   std::vector<Instruction> instructions;
   /*! \brief The size of the frame for this function */
   Index register_file_size;
+  /*!
+   * \brief The device type of each parameter, -1 for the default context.
+   *  Empty when all the parameters are in the default context.
+   */
+  std::vector<Index> params_device_type;
 
   VMFunction(const std::string& name, std::vector<std::string> params,
              const std::vector<Instruction>& instructions,
-             Index register_file_size)
+             Index register_file_size,
+             std::vector<Index> params_device_type = {})
       : name(name),
         params(params),
         instructions(instructions),
-        register_file_size(register_file_size) {}
+        register_file_size(register_file_size),
+        params_device_type(std::move(params_device_type)) {}
 
   VMFunction() {}
 
@@ -414,18 +501,22 @@ struct VMFrame {
   /*! \brief A pointer into the caller function's instructions. */
   const Instruction* code;
 
-  /*! \brief Statically allocated space for objects */
-  std::vector<ObjectRef> register_file;
+  /*! \brief The offset of the registers of the frame in the register stack. */
+  Index register_base;
+  /*! \brief The number of registers of the frame. */
+  Index register_file_size;
 
   /*! \brief Register in caller's frame to put return value */
   RegName caller_return_register;
 
-  VMFrame(Index pc, Index func_index, Index args, const Instruction* code, Index register_file_size)
+  VMFrame(Index pc, Index func_index, Index args, const Instruction* code,
+          Index register_base, Index register_file_size)
       : pc(pc),
         func_index(func_index),
         args(args),
         code(code),
-        register_file(register_file_size),
+        register_base(register_base),
+        register_file_size(register_file_size),
         caller_return_register(0) {}
 };
 
@@ -440,6 +531,14 @@ struct VMFrame {
  *  - Primitive name section, containing the function name of the primitive ops
  *  used by the virtual machine.
  *  - Code section, handling the VM functions and bytecode.
+ *  - Shape function section, the primitive ops computing shapes.
+ *  - Section index, the offset of each section, constant and function,
+ *  ending with its own offset and a magic number.
+ *
+ * A saved executable is loaded lazily: the constants are loaded on first
+ * use, and the bytecode of a function is decoded when it is first invoked.
+ * Until then, `constants` holds an undefined object and `functions` holds
+ * the function without its instructions.
  */
 class Executable : public ModuleNode {
  public:
@@ -463,7 +562,8 @@ class Executable : public ModuleNode {
   TVMByteArray Save();
 
   /*!
-   * \brief Load the saved VM executable.
+   * \brief Load the saved VM executable, keeping a copy of the code to
+   *  load the constants and functions from on first use.
    *
    * \param code The bytecode in string.
    * \param lib The compiled runtime library.
@@ -472,6 +572,37 @@ class Executable : public ModuleNode {
    */
   static runtime::Module Load(const std::string& code, const runtime::Module lib);
 
+  /*!
+   * \brief Load a saved VM executable from a file mapped into memory.
+   *
+   *  The large constants of the constant section are views of the mapping
+   *  instead of copies, so processes loading the same file share its pages.
+   *  The pages of the constants and functions not used are never read.
+   *
+   * \param file_name The name of the file holding the bytecode.
+   * \param lib The compiled runtime library.
+   *
+   * \return exe The constructed executable.
+   */
+  static runtime::Module LoadFromFile(const std::string& file_name, const runtime::Module lib);
+
+  /*!
+   * \brief Get a function, decoding its bytecode on first use.
+   * \param func_index The index of the function.
+   * \return The function with its instructions.
+   */
+  const VMFunction& GetVMFunction(Index func_index) const;
+
+  /*!
+   * \brief Get a constant, loading it on first use.
+   * \param const_index The index of the constant.
+   * \return The constant.
+   */
+  const ObjectRef& GetConstant(Index const_index) const;
+
+  /*! \brief Load the constants and functions not used yet. */
+  void LoadAll() const;
+
   /*!
    * \brief Get the serialized form of the `functions`. This is
    * essentially bytecode serialization.
@@ -552,10 +683,27 @@ class Executable : public ModuleNode {
    * corresponds to the position of the `packed_funcs` list in a `VirtualMachine` object.
    */
   std::unordered_map<std::string, Index> primitive_map;
+  /*! \brief The packed indices of the primitive ops computing shapes, whose
+   *  outputs only depend on the values of their inputs.
+   */
+  std::vector<Index> shape_funcs;
   /*! \brief The virtual machine's function table. */
   std::vector<VMFunction> functions;
 
  private:
+  /*! \brief The sections of a lazily loaded executable. */
+  struct LazySections;
+
+  /*!
+   * \brief Load an executable, lazily when it has a section index.
+   * \param exec The executable, with its library set.
+   * \param data The serialized executable, which outlives exec.
+   * \param size The size of the serialized executable.
+   * \param file The mapped file holding data, null if data is not of a file.
+   */
+  static void LoadSections(Executable* exec, char* data, size_t size,
+                           std::shared_ptr<MappedFile> file);
+
   /*!
    * \brief Save the globals.
    *
@@ -564,11 +712,13 @@ class Executable : public ModuleNode {
   void SaveGlobalSection(dmlc::Stream* strm);
 
   /*!
-   * \brief Save the constant pool.
+   * \brief Save the constant pool, with the data of large constants aligned
+   *  to pages in the serialized executable.
    *
    * \param strm The input stream.
+   * \param offsets The offset of each constant.
    */
-  void SaveConstantSection(dmlc::Stream* strm);
+  void SaveConstantSection(dmlc::SeekStream* strm, std::vector<uint64_t>* offsets);
 
   /*!
    * \brief Save primitive op names.
@@ -581,22 +731,23 @@ class Executable : public ModuleNode {
    * \brief Save the vm functions.
    *
    * \param strm The input stream.
+   * \param offsets The offset of each function.
    */
-  void SaveCodeSection(dmlc::Stream* strm);
+  void SaveCodeSection(dmlc::SeekStream* strm, std::vector<uint64_t>* offsets);
 
   /*!
-   * \brief Load the globals.
+   * \brief Save the packed indices of the shape functions.
    *
    * \param strm The input stream.
    */
-  void LoadGlobalSection(dmlc::Stream* strm);
+  void SaveShapeFuncSection(dmlc::Stream* strm);
 
   /*!
-   * \brief Load the constant pool.
+   * \brief Load the globals.
    *
    * \param strm The input stream.
    */
-  void LoadConstantSection(dmlc::Stream* strm);
+  void LoadGlobalSection(dmlc::Stream* strm);
 
   /*!
    * \brief Load primitive op names.
@@ -606,16 +757,111 @@ class Executable : public ModuleNode {
   void LoadPrimitiveOpNames(dmlc::Stream* strm);
 
   /*!
-   * \brief Load the vm functions.
+   * \brief Load the packed indices of the shape functions.
    *
    * \param strm The input stream.
    */
-  void LoadCodeSection(dmlc::Stream* strm);
+  void LoadShapeFuncSection(dmlc::Stream* strm);
 
   /*! \brief The serialized bytecode. */
   std::string code_;
+  /*! \brief The sections not loaded yet, null when the executable is complete. */
+  std::shared_ptr<LazySections> lazy_;
+};
+
+/*!
+ * \brief An executable loaded for running, shared by the VMs running it.
+ *
+ *  It holds the packed functions of the executable, the code of each
+ *  function with superinstructions formed, and the constants uploaded to
+ *  each context. The code and the constants are formed once, on first use,
+ *  and never change afterwards, so VMs on any thread read them without
+ *  locking. A VM only holds the state of its own runs, so that concurrent
+ *  requests each take a cheap VM and share one copy of the weights and the
+ *  bytecode.
+ */
+class LoadedExecutable {
+ public:
+  /*! \brief The constants of the executable on a context. */
+  class ConstantPool {
+   public:
+    ConstantPool(const Executable* exec, TVMContext ctx);
+
+    /*! \return The constant on the context, uploaded on first use. */
+    const ObjectRef& Get(Index const_index) {
+      if (ready_[const_index].load(std::memory_order_acquire)) {
+        return constants_[const_index];
+      }
+      return Upload(const_index);
+    }
+
+    TVMContext ctx() const {
+      return ctx_;
+    }
+
+   private:
+    const ObjectRef& Upload(Index const_index);
+
+    const Executable* exec_;
+    TVMContext ctx_;
+    std::vector<ObjectRef> constants_;
+    std::unique_ptr<std::atomic<bool>[]> ready_;
+    std::mutex mutex_;
+  };
+
+  /*!
+   * \brief Load an executable.
+   * \param exec The executable, kept alive by the loaded executable.
+   */
+  explicit LoadedExecutable(const Executable* exec);
+
+  const Executable* exec() const {
+    return exec_;
+  }
+
+  /*! \return The packed function of each primitive op. */
+  const std::vector<PackedFunc>& packed_funcs() const {
+    return packed_funcs_;
+  }
+
+  /*!
+   * \brief Get the code of a function, formed on its first call.
+   * \param func_index The function.
+   * \return The instructions, with superinstructions formed unless disabled
+   *  by TVM_VM_SUPERINSTRUCTIONS=0.
+   */
+  const std::vector<Instruction>& GetCode(Index func_index) {
+    if (code_ready_[func_index].load(std::memory_order_acquire)) {
+      return code_[func_index];
+    }
+    return FormCode(func_index);
+  }
+
+  /*! \return The constants on a context, shared by the VMs running on it. */
+  ConstantPool* GetConstantPool(TVMContext ctx);
+
+ private:
+  const std::vector<Instruction>& FormCode(Index func_index);
+
+  /*! \brief The executable, and the reference keeping it alive. */
+  const Executable* exec_;
+  ObjectPtr<Object> exec_ref_;
+  std::vector<PackedFunc> packed_funcs_;
+  bool superinstructions_;
+  std::vector<std::vector<Instruction> > code_;
+  std::unique_ptr<std::atomic<bool>[]> code_ready_;
+  /*! \brief The constant pools, guarded by mutex_ and never removed. */
+  std::vector<std::unique_ptr<ConstantPool> > constant_pools_;
+  std::mutex mutex_;
 };
 
+class KernelScheduler;
+class AsyncDriver;
+class ShapeCache;
+class KernelSpecializer;
+class VMTrace;
+class Storage;
+
 /*!
  * \brief The virtual machine.
  *
@@ -649,13 +895,13 @@ class VirtualMachine : public runtime::ModuleNode {
   virtual PackedFunc GetFunction(const std::string& name,
                                  const ObjectPtr<Object>& sptr_to_self);
 
-  virtual ~VirtualMachine() {}
+  virtual ~VirtualMachine();
 
   const char* type_key() const final {
     return "VirtualMachine";
   }
 
-  VirtualMachine() : frames_(), func_index_(0), code_(nullptr), pc_(0), exec_(nullptr) {}
+  VirtualMachine();
 
   /*!
    * \brief load the executable for the virtual machine.
@@ -663,11 +909,116 @@ class VirtualMachine : public runtime::ModuleNode {
    */
   virtual void LoadExecutable(const Executable* exec);
 
+  /*!
+   * \brief Run an executable loaded by another VM, sharing its code and
+   *  constants.
+   * \param loaded The loaded executable.
+   */
+  void LoadShared(std::shared_ptr<LoadedExecutable> loaded);
+
+  /*!
+   * \brief Create a VM running the executable of this one, on the same
+   *  contexts and with the same settings of the shape cache.
+   *
+   *  The new VM shares the code and the constants of this one, and has its
+   *  own registers, frames and inputs, so that it can run on another thread.
+   *
+   * \return The new VM.
+   */
+  ObjectPtr<VirtualMachine> CreateContext();
+
+  /*!
+   * \brief Invoke a VM function on the thread of the VM, without waiting for it.
+   *
+   *  The invocations run one at a time, in the order they are made. The
+   *  kernels of a run overlap with each other and with the control flow of
+   *  the VM, as set by ConfigureAsync, with two workers by default. These
+   *  default workers only run the asynchronous invocations.
+   *
+   * \param name The function's name.
+   * \param args The arguments to the function.
+   * \return The future of the result.
+   */
+  std::shared_future<ObjectRef> InvokeAsync(const std::string& name,
+                                            const std::vector<ObjectRef>& args);
+
+  /*!
+   * \brief Set the workers running the kernels launched on the host.
+   *
+   *  A kernel on the host runs on a worker once the kernels in flight
+   *  accessing its tensors are done, while the VM carries on until it
+   *  reads a tensor a kernel in flight writes. Once set, the workers run
+   *  the kernels of the synchronous invocations too, which otherwise run
+   *  them in place.
+   *
+   * \param num_workers The number of workers, zero to run the kernels on
+   *  the thread of the VM.
+   * \param worker_cores The cores of each worker, as semicolon separated
+   *  groups of comma separated core ids or ranges. Empty to split the
+   *  cores evenly.
+   */
+  void ConfigureAsync(int num_workers, const std::string& worker_cores);
+
+  /*!
+   * \brief Set how many outputs of each shape function the VM keeps.
+   *
+   *  The outputs of the shape functions, and of the kernels computing the
+   *  sizes of the allocations from shapes, are reused when they are called
+   *  again with the same inputs, as when a model sees the same input shapes.
+   *
+   * \param max_entries The most outputs kept per function, zero to call the
+   *  shape functions every time. It is 64 by default.
+   * \note Resets the statistics of the cache.
+   */
+  void ConfigureShapeCache(int max_entries);
+
+  /*!
+   * \brief Set the hook specializing the kernels for the shapes seen often.
+   *
+   *  Once a kernel has been called threshold times with the same shapes, the
+   *  hook is called with the name of the kernel and a tuple of the shapes of
+   *  its arguments. The function it returns, if any, is called instead for
+   *  these shapes.
+   *
+   * \param hook The hook, null to call the kernels as compiled.
+   * \param threshold The number of calls before the hook is called.
+   */
+  void SetSpecializeHook(PackedFunc hook, int threshold);
+
+  /*! \return The hits and misses of the shape cache and the specialized kernels, in json. */
+  std::string ShapeCacheStats();
+
+  /*!
+   * \brief Start recording a timeline of the runs of the VM.
+   *
+   *  The dispatch of each instruction, the allocation of each storage, the
+   *  run of each kernel and the push and pop of each frame are recorded in
+   *  a ring buffer keeping the latest events. Kernels on a device are
+   *  timed as launched, without synchronizing.
+   *
+   * \param capacity The number of events kept.
+   * \param sample_every Record one run in every sample_every.
+   */
+  void StartTrace(size_t capacity, int sample_every);
+
+  /*! \brief Stop recording the runs, keeping the events recorded. */
+  void StopTrace();
+
+  /*! \return The events recorded, in the Chrome trace event format. */
+  std::string ExportTrace();
+
  protected:
   /*! \brief The virtual machine's packed function table. */
   std::vector<PackedFunc> packed_funcs_;
   /*! \brief The current stack of call frames. */
   std::vector<VMFrame> frames_;
+  /*!
+   * \brief The registers of all the frames, each frame owning a slice of it.
+   *  It only grows, so calls do not allocate once it fits the deepest call.
+   */
+  std::vector<ObjectRef> register_stack_;
+  /*! \brief The registers of the current frame. */
+  ObjectRef* registers_;
   /*! \brief The fuction table index of the current function. */
   Index func_index_;
   /*! \brief The current pointer to the code section. */
@@ -678,10 +1029,20 @@ class VirtualMachine : public runtime::ModuleNode {
   ObjectRef return_register_;
   /*! \brief The executable the VM will operate on. */
   const Executable* exec_;
-  /*! \brief The function name to inputs mapping. */
-  std::unordered_map<std::string, std::vector<ObjectRef>> inputs_;
+  /*! \brief The executable as loaded, shared with the VMs created from this one. */
+  std::shared_ptr<LoadedExecutable> loaded_;
+  /*! \brief The inputs of each function, indexed as the function table. */
+  std::vector<std::vector<ObjectRef>> inputs_;
   /*! \brief The set of TVM contexts the VM is currently executing on. */
   std::vector<TVMContext> ctxs_;
+  /*! \brief The workers running the kernels on the host, null to run them in place. */
+  std::unique_ptr<KernelScheduler> kernel_scheduler_;
+  /*! \brief Held while running, so that one invocation runs at a time. */
+  std::mutex run_mutex_;
+  /*! \brief The timeline of the runs, null if not traced. */
+  std::shared_ptr<VMTrace> trace_;
+  /*! \brief The timeline of the current run, null if it is not recorded. */
+  VMTrace* active_trace_{nullptr};
 
   /*! \brief Push a call frame on to the call stack. */
   void PushFrame(Index arg_count, Index ret_pc, const VMFunction& vm_func);
@@ -704,7 +1065,7 @@ class VirtualMachine : public runtime::ModuleNode {
    * \param reg The register to read from.
    * \return The read object.
    */
-  inline ObjectRef ReadRegister(RegName reg) const;
+  inline const ObjectRef& ReadRegister(RegName reg) const;
 
   /*!
    * \brief Read a VM register and cast it to int32_t
@@ -768,10 +1129,57 @@ class VirtualMachine : public runtime::ModuleNode {
   void InvokeGlobal(const VMFunction& func, const std::vector<ObjectRef>& args);
 
   /*!
-   * \brief The constant pool for runtime. It caches the device dependent
-   * object to avoid rellocation of constants during inference.
+   * \brief Invoke a kernel, reusing the outputs of a shape function or
+   *  calling the kernel specialized for the shapes of the arguments.
+   */
+  void InvokeKernel(Index packed_index, const PackedFunc& func, Index arg_count,
+                    Index output_size, const std::vector<ObjectRef>& args);
+
+  /*! \brief Allocate a storage on a context, recording it in the trace. */
+  Storage MakeStorage(size_t size, size_t alignment, DLDataType dtype_hint,
+                      const TVMContext& ctx);
+
+  /*!
+   * \brief Copy a tensor to another context. The copy runs on the kernel
+   *  workers when one side is on the host, ordered with the kernels using it.
+   */
+  NDArray CopyToDevice(const NDArray& src, const TVMContext& ctx);
+
+  /*!
+   * \brief The index of the context of a device in ctxs_: the first context
+   *  for -1, else the context of the device id, else the first of the type.
+   */
+  Index ContextIndex(Index device_type, Index device_id) const;
+
+  /*!
+   * \brief The constant pool for runtime of each context, shared by the VMs
+   *  on the context. It caches the device dependent object to avoid
+   *  rellocation of constants during inference. Null until the first
+   *  constant is loaded to the context.
    */
-  std::vector<ObjectRef> const_pool_;
+  std::vector<LoadedExecutable::ConstantPool*> const_pools_;
+  /*! \brief Scratch space for the arguments of a call, reused across calls. */
+  std::vector<ObjectRef> call_args_;
+  /*! \brief Scratch space for the arguments of a packed call, reused across calls. */
+  std::vector<TVMValue> packed_values_;
+  std::vector<int> packed_codes_;
+  /*! \brief The most outputs the shape cache keeps per function. */
+  int shape_cache_entries_{64};
+  /*! \brief The outputs of the shape functions, null if not cached. */
+  std::unique_ptr<ShapeCache> shape_cache_;
+  /*! \brief The kernels specialized for the shapes seen often, null if none are. */
+  std::unique_ptr<KernelSpecializer> specializer_;
+  /*! \brief Scratch space for the input and output tensors of a kernel. */
+  std::vector<const DLTensor*> kernel_inputs_;
+  std::vector<const DLTensor*> kernel_outputs_;
+  /*! \brief Whether the workers have been set, guarded by run_mutex_. */
+  bool async_configured_{false};
+  /*! \brief The default workers of the asynchronous invocations, swapped in
+   *  for their runs while the workers are not set, guarded by run_mutex_. */
+  std::unique_ptr<KernelScheduler> async_default_scheduler_;
+  /*! \brief The thread running the asynchronous invocations. */
+  std::unique_ptr<AsyncDriver> async_driver_;
+  std::once_flag async_driver_once_;
 };
 
 }  // namespace vm
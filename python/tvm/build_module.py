@@ -145,7 +145,9 @@ class BuildConfig(Object):
         "instrument_bound_checkers": False,
         "disable_select_rewriting": False,
         "disable_vectorize": False,
-        "disable_assert": False
+        "disable_assert": False,
+        "chunked_parallel_launch": False,
+        "llvm_codegen_partitions": 1
     }
     _dump_ir = DumpIR()
 
@@ -251,6 +253,15 @@ def build_config(**kwargs):
 
     dump_pass_ir: dump ir of each pass into file idx_passname_ir.cc, default=False
 
+    chunked_parallel_launch: bool, default=False
+        Whether parallel loops without a barrier are launched as independent
+        chunks, which idle workers take from busy ones to balance the load.
+
+    llvm_codegen_partitions: int, default=1
+        The number of LLVM modules the host functions are split into. Each
+        is optimized and emitted to object code on its own thread, and
+        export_library links the objects into one library.
+
     Returns
     -------
     config: BuildConfig
@@ -0,0 +1,107 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""Dynamic micro-batching of requests to a graph runtime or a Relay VM."""
+import json
+
+from .._ffi.function import get_global_func
+from .. import ndarray as nd
+
+
+def create(module, input_names=None, max_batch_size=8, timeout_us=1000, func_name="main"):
+    """Create a micro-batching executor.
+
+    Requests submitted concurrently through :any:`BatchingModule.infer` are
+    gathered into batches of up to max_batch_size rows along the first axis
+    and run by a single invocation of the model.
+
+    Parameters
+    ----------
+    module : GraphModule, VirtualMachine or tvm.Module
+        The model. A graph runtime is compiled for a fixed batch, which caps
+        max_batch_size. A VM needs a model with a dynamic batch axis.
+    input_names : list of str, optional
+        The inputs of a graph runtime that each request provides, in order.
+    max_batch_size : int
+        The maximum number of rows in a batch.
+    timeout_us : int
+        The maximum time in microseconds a request waits for the batch to fill up.
+    func_name : str
+        The function invoked on a VM.
+
+    Returns
+    -------
+    batching_module : BatchingModule
+        The executor.
+    """
+    if hasattr(module, "module"):
+        module = module.module
+    elif hasattr(module, "mod"):
+        module = module.mod
+    input_names = input_names or []
+    fcreate = get_global_func("tvm.batching_executor.create")
+    return BatchingModule(fcreate(module, max_batch_size, timeout_us, func_name, *input_names))
+
+
+class BatchingModule(object):
+    """Wrapper of the micro-batching executor module.
+
+    Parameters
+    ----------
+    module : tvm.Module
+        The internal tvm module that holds the actual batching functions.
+
+    Attributes
+    ----------
+    module : tvm.Module
+        The internal tvm module that holds the actual batching functions.
+    """
+    def __init__(self, module):
+        self.module = module
+        self._infer = module["infer"]
+        self._get_stats = module["get_stats"]
+        self._reset_stats = module["reset_stats"]
+
+    def infer(self, *inputs):
+        """Run one request, blocking until its batch finished.
+
+        Parameters
+        ----------
+        inputs : list of NDArray or numpy.ndarray
+            The inputs of the request, sharing the number of rows.
+
+        Returns
+        -------
+        outputs : list of NDArray
+            The rows of the batch outputs belonging to this request.
+        """
+        inputs = [x if isinstance(x, nd.NDArray) else nd.array(x) for x in inputs]
+        ret = self._infer(*inputs)
+        return [ret[i] for i in range(len(ret))]
+
+    def get_stats(self):
+        """Get the request and batch statistics, latencies are in nanoseconds.
+
+        Returns
+        -------
+        stats : dict
+            The statistics.
+        """
+        return json.loads(self._get_stats())
+
+    def reset_stats(self):
+        """Reset the statistics."""
+        self._reset_stats()
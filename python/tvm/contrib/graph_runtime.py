@@ -130,6 +130,7 @@ class GraphModule(object):
         self._get_input = module["get_input"]
         self._get_num_outputs = module["get_num_outputs"]
         self._load_params = module["load_params"]
+        self._load_params_from_file = module["load_params_from_file"]
         self._share_params = module["share_params"]
 
     def set_input(self, key=None, value=None, **params):
@@ -236,6 +237,20 @@ class GraphModule(object):
         """
         self._load_params(bytearray(params_bytes))
 
+    def load_params_from_file(self, file_name):
+        """Load parameters from a parameter dict file mapped into memory.
+
+        The large CPU parameters of a file saved with
+        relay.save_param_dict(params, aligned=True) are used in place
+        from the mapping instead of being copied.
+
+        Parameters
+        ----------
+        file_name : str
+            The name of the file on the machine running the module.
+        """
+        self._load_params_from_file(file_name)
+
     def share_params(self, other, params_bytes):
         """Share parameters from pre-existing GraphRuntime instance.
 
@@ -249,6 +264,22 @@ class GraphModule(object):
         """
         self._share_params(other.module, bytearray(params_bytes))
 
+    def create_context(self):
+        """Create a lightweight execution context of the graph.
+
+        The context shares the loaded parameters and the operator functions
+        with this module and owns its activation storage, so that several
+        contexts can run the graph concurrently on different threads.
+        The other inputs, such as parameters given to set_input, are copied
+        into it. Parameters should be loaded before the contexts are created.
+
+        Returns
+        -------
+        context : GraphModule
+            The execution context.
+        """
+        return GraphModule(self.module["create_context"]())
+
     def __getitem__(self, key):
         """Get internal module function
 
@@ -0,0 +1,101 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""Graph runtime running independent operators concurrently."""
+import json
+
+from .._ffi.base import string_types
+from .._ffi.function import get_global_func
+from . import graph_runtime
+
+
+def create(graph_json_str, libmod, ctx, num_workers=2, worker_cores=None):
+    """Create a runtime executor module running independent operators concurrently.
+
+    Operators whose inputs are ready and whose outputs do not reuse storage
+    still in use are run at the same time by num_workers executor threads.
+    Each executor has a thread pool bound to its own slice of the cores.
+
+    Parameters
+    ----------
+    graph_json_str : str or graph class
+        The graph to be deployed in json format output by graph compiler.
+    libmod : tvm.Module
+        The module of the corresponding function.
+    ctx : TVMContext or list of TVMContext
+        The context to deploy the module.
+    num_workers : int
+        The number of executor threads.
+    worker_cores : list of list of int, optional
+        The cores of each executor. The available cores are split evenly
+        among the executors by default.
+
+    Returns
+    -------
+    graph_module : InterOpModule
+        Runtime graph module.
+    """
+    if not isinstance(graph_json_str, string_types):
+        try:
+            graph_json_str = graph_json_str._tvm_graph_json()
+        except AttributeError:
+            raise ValueError("Type %s is not supported" % type(graph_json_str))
+    ctx, _, device_type_id = graph_runtime.get_device_ctx(libmod, ctx)
+    fcreate = get_global_func("tvm.graph_runtime_interop.create")
+    mod = InterOpModule(fcreate(graph_json_str, libmod, *device_type_id))
+    mod.configure(num_workers, worker_cores)
+    return mod
+
+
+class InterOpModule(graph_runtime.GraphModule):
+    """Wrapper of the inter-operator parallel graph runtime module.
+
+    Parameters
+    ----------
+    module : Module
+        The internal tvm module that holds the actual graph functions.
+    """
+
+    def __init__(self, module):
+        self._configure_interop = module["configure_interop"]
+        self._get_node_stats = module["get_node_stats"]
+        graph_runtime.GraphModule.__init__(self, module)
+
+    def configure(self, num_workers, worker_cores=None):
+        """Set the executor threads.
+
+        Parameters
+        ----------
+        num_workers : int
+            The number of executor threads.
+        worker_cores : list of list of int, optional
+            The cores of each executor.
+        """
+        spec = ""
+        if worker_cores:
+            spec = ";".join(",".join(str(c) for c in cores) for cores in worker_cores)
+        self._configure_interop(num_workers, spec)
+
+    def get_node_stats(self):
+        """Get the executor and the time span of each operator in the last run.
+
+        Returns
+        -------
+        stats : dict
+            The statistics. Times are in nanoseconds since the beginning of the run.
+            overlap is the total time of the operators divided by the time of the run.
+        """
+        return json.loads(self._get_node_stats())
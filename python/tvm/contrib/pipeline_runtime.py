@@ -0,0 +1,147 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+"""Graph runtime streaming frames through a pipeline of stages."""
+import json
+
+from .._ffi.base import string_types
+from .._ffi.function import get_global_func
+from .. import ndarray as nd
+from . import graph_runtime
+
+
+def create(graph_json_str, libmod, ctx, num_stages=2, stage_cores=None, calibrate_runs=0):
+    """Create a pipelined runtime executor module given a graph and module.
+
+    The nodes of the graph are split into num_stages contiguous stages of
+    similar cost. Every stage runs on its own thread with a thread pool bound
+    to its own cores, so consecutive frames overlap in different stages.
+
+    Parameters
+    ----------
+    graph_json_str : str or graph class
+        The graph to be deployed in json format output by graph compiler.
+    libmod : tvm.Module
+        The module of the corresponding function.
+    ctx : TVMContext or list of TVMContext
+        The context to deploy the module.
+    num_stages : int
+        The maximum number of stages.
+    stage_cores : list of list of int, optional
+        The cores of each stage. The available cores are split evenly
+        among the stages by default.
+    calibrate_runs : int
+        When positive, the stages are balanced by the time of each operator
+        measured over this many runs, instead of the bytes it accesses.
+        Calibration runs on the parameters loaded at the time, call
+        :any:`PipelineModule.configure` after load_params to use the real ones.
+
+    Returns
+    -------
+    pipeline_module : PipelineModule
+        Runtime pipeline module.
+    """
+    if not isinstance(graph_json_str, string_types):
+        try:
+            graph_json_str = graph_json_str._tvm_graph_json()
+        except AttributeError:
+            raise ValueError("Type %s is not supported" % type(graph_json_str))
+    ctx, _, device_type_id = graph_runtime.get_device_ctx(libmod, ctx)
+    fcreate = get_global_func("tvm.graph_runtime_pipeline.create")
+    mod = PipelineModule(fcreate(graph_json_str, libmod, *device_type_id))
+    mod.configure(num_stages, stage_cores, calibrate_runs)
+    return mod
+
+
+class PipelineModule(graph_runtime.GraphModule):
+    """Wrapper of the pipelined graph runtime module.
+
+    Frames are pushed from one thread and popped in order from one thread.
+    A thread doing both keeps at most num_stages + 1 frames in flight. Each frame
+    is run on a private set of activations, while the parameters loaded
+    into this module are shared by all frames. Parameters, whether loaded
+    or set as inputs, must be given before the first frame is pushed, the
+    frames do not see later updates and load_params then fails.
+
+    Parameters
+    ----------
+    module : Module
+        The internal tvm module that holds the actual graph functions.
+    """
+
+    def __init__(self, module):
+        self._configure_pipeline = module["configure_pipeline"]
+        self._push = module["push"]
+        self._pop = module["pop"]
+        self._get_pipeline_stats = module["get_pipeline_stats"]
+        self._reset_pipeline_stats = module["reset_pipeline_stats"]
+        graph_runtime.GraphModule.__init__(self, module)
+
+    def configure(self, num_stages, stage_cores=None, calibrate_runs=0):
+        """Split the graph into stages again, only valid before the first frame.
+
+        Parameters
+        ----------
+        num_stages : int
+            The maximum number of stages.
+        stage_cores : list of list of int, optional
+            The cores of each stage.
+        calibrate_runs : int
+            The number of runs measuring the operators, 0 to estimate their cost.
+        """
+        spec = ""
+        if stage_cores:
+            spec = ";".join(",".join(str(c) for c in cores) for cores in stage_cores)
+        self._configure_pipeline(num_stages, spec, calibrate_runs)
+
+    def push(self, **inputs):
+        """Push a frame, blocking while the pipeline is full.
+
+        Parameters
+        ----------
+        inputs : dict of str to NDArray or numpy.ndarray
+            The inputs of the frame.
+        """
+        args = []
+        for name, value in inputs.items():
+            args.append(name)
+            args.append(value if isinstance(value, nd.NDArray) else nd.array(value))
+        self._push(*args)
+
+    def pop(self):
+        """Pop the outputs of the oldest frame, blocking until it finished.
+
+        Returns
+        -------
+        outputs : list of NDArray
+            The outputs of the frame.
+        """
+        ret = self._pop()
+        return [ret[i] for i in range(len(ret))]
+
+    def get_pipeline_stats(self):
+        """Get the node range, cost, cores and occupancy of each stage.
+
+        Returns
+        -------
+        stats : dict
+            The statistics, times are in nanoseconds.
+        """
+        return json.loads(self._get_pipeline_stats())
+
+    def reset_pipeline_stats(self):
+        """Reset the frame counts and occupancy of the stages."""
+        self._reset_pipeline_stats()
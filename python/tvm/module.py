@@ -134,9 +134,18 @@ class Module(ModuleBase):
                     assert module.type_key == "c"
                     object_format = "cc"
                     has_c_module = True
-            path_obj = temp.relpath("lib" + str(index) + "." + object_format)
-            module.save(path_obj)
-            files.append(path_obj)
+            if module.type_key == "llvm" and object_format == "o":
+                # the module may be split into several objects, see llvm_codegen_partitions.
+                num_objects = module.get_function("_get_num_objects")()
+                save_object = module.get_function("_save_object")
+                for part in range(num_objects):
+                    path_obj = temp.relpath("lib%d_%d.o" % (index, part))
+                    save_object(part, path_obj)
+                    files.append(path_obj)
+            else:
+                path_obj = temp.relpath("lib" + str(index) + "." + object_format)
+                module.save(path_obj)
+                files.append(path_obj)
             is_system_lib = (module.type_key == "llvm" and
                              module.get_function("__tvm_is_system_module")())
             llvm_target_triple = (module.type_key == "llvm" and
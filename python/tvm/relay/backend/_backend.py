@@ -61,6 +61,34 @@ def lower(sch, inputs, func_name, source_func):
         f, (_container.Array, tuple, list)) else [f]
 
 
+@register_func("relay.backend.compile_cache_context")
+def compile_cache_context():
+    """Describe the python state the lowered functions depend on,
+    as part of the keys of the on-disk compile cache.
+
+    Returns
+    -------
+    context : str or None
+        The description, None when the functions must not be cached.
+    """
+    # pylint: disable=protected-access
+    import hashlib
+    from ... import autotvm
+    parts = []
+    ctx = autotvm.DispatchContext.current
+    while ctx is not None:
+        parts.append(type(ctx).__name__)
+        if isinstance(ctx, autotvm.task.ApplyHistoryBest):
+            for table in (ctx.best_by_targetkey, ctx.best_by_model):
+                parts.extend(sorted("%s=%s" % (k, v[0].config) for k, v in table.items()))
+            parts.extend(sorted("%s=%s" % kv for kv in ctx._best_user_defined.items()))
+        elif not isinstance(ctx, autotvm.FallbackContext):
+            # the configs of the other contexts depend on the order of the queries.
+            return None
+        ctx = ctx._old_ctx
+    return hashlib.sha1("\n".join(parts).encode("utf-8")).hexdigest()
+
+
 @register_func("relay.backend.build")
 def build(funcs, target, target_host=None):
     """Backend build function.
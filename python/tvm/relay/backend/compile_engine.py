@@ -99,6 +99,29 @@ class CompileEngine(Object):
             msg += "--------------------------\n"
             raise RuntimeError(msg)
 
+    def lower_parallel(self, source_funcs, target=None):
+        """Lower independent source_funcs concurrently.
+
+        The number of threads is read from the environment variable
+        TVM_LOWER_THREADS, by default the number of cores. This only warms
+        the cache, it does not count as a use of the functions.
+
+        Parameters
+        ----------
+        source_funcs : List[Union[tvm.relay.Function, CCacheKey]]
+            The source relay functions.
+
+        target : tvm.Target
+            The target platform.
+
+        Returns
+        -------
+        cached_funcs: List[CachedFunc]
+            The results of lowering, in the order of source_funcs.
+        """
+        keys = [_get_cache_key(func, target) for func in source_funcs]
+        return list(_backend._CompileEngineLowerParallel(self, keys))
+
     def lower_shape_func(self, source_func, target=None):
         key = _get_cache_key(source_func, target)
         return _backend._CompileEngineLowerShapeFunc(self, key)
@@ -126,6 +149,35 @@ class CompileEngine(Object):
         """clear the existing cached functions"""
         _backend._CompileEngineClear(self)
 
+    def set_disk_cache(self, path, max_bytes=1 << 30):
+        """Keep the lowered functions in a directory, shared by processes.
+
+        The cache can also be set with the environment variables
+        TVM_COMPILE_CACHE_DIR and TVM_COMPILE_CACHE_MAX_BYTES.
+
+        Parameters
+        ----------
+        path : str or None
+            The directory, None to disable the disk cache.
+
+        max_bytes : int
+            The budget of the directory, the least recently used
+            functions are removed past it.
+        """
+        _backend._CompileEngineSetDiskCache(self, path or "", max_bytes)
+
+    def disk_cache_stats(self):
+        """Get the statistics of the disk cache.
+
+        Returns
+        -------
+        stats : Dict[str, int]
+            The numbers of hits, misses, writes and evictions,
+            empty when the disk cache is disabled.
+        """
+        stats = _backend._CompileEngineDiskCacheStats(self)
+        return {k: v.value for k, v in stats.items()}
+
     def items(self):
         """List items in the cache.
 
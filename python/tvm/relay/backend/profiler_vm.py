@@ -34,6 +34,8 @@ class VirtualMachineProfiler(vm.VirtualMachine):
         self.mod = _vm._VirtualMachineDebug(m)
         self._init = self.mod["init"]
         self._invoke = self.mod["invoke"]
+        self._invoke_async = self.mod["invoke_async"]
+        self._configure_async = self.mod["configure_async"]
         self._get_stat = self.mod["get_stat"]
         self._set_input = self.mod["set_input"]
         self._reset = self.mod["reset"]
@@ -20,6 +20,8 @@ The Relay Virtual Machine.
 
 Implements a Python interface to compiling and executing on the Relay VM.
 """
+import json
+
 import numpy as np
 
 import tvm
@@ -168,6 +170,33 @@ class Executable(object):
 
         return Executable(_vm.Load_Executable(bytecode, lib))
 
+    @staticmethod
+    def load_exec_from_file(file_name, lib):
+        """Construct an executable from bytecode saved in a file.
+
+        The file is mapped into memory and the large constants refer to the
+        mapping instead of being copied, so the processes loading the same
+        file share its pages.
+
+        Parameters
+        ----------
+        file_name : str
+            The name of the file holding the Relay VM bytecode.
+
+        lib : :py:class:`~tvm.module.Module`
+            The runtime module that contains the generated code.
+
+        Returns
+        -------
+        exec: Executable
+            An executable constructed using the provided artifacts.
+        """
+        if lib is not None and not isinstance(lib, tvm.module.Module):
+            raise TypeError("lib is expected to be the type of tvm.module.Module" +
+                            ", but received {}".format(type(lib)))
+
+        return Executable(_vm.Load_Executable_From_File(file_name, lib))
+
     @property
     def lib(self):
         """Get the library that contains hardware dependent code.
@@ -275,10 +304,18 @@ class VirtualMachine(object):
             raise TypeError("mod is expected to be the type of Executable or " +
                             "tvm.Module, but received {}".format(type(mod)))
         m = mod.module if isinstance(mod, Executable) else mod
-        self.mod = _vm._VirtualMachine(m)
-        self._exec = mod
+        self._bind(_vm._VirtualMachine(m), mod)
+
+    def _bind(self, vm_mod, exe):
+        self.mod = vm_mod
+        self._exec = exe
         self._init = self.mod["init"]
         self._invoke = self.mod["invoke"]
+        self._invoke_async = self.mod["invoke_async"]
+        self._configure_async = self.mod["configure_async"]
+        self._configure_shape_cache = self.mod["configure_shape_cache"]
+        self._set_specialize_hook = self.mod["set_specialize_hook"]
+        self._get_shape_cache_stats = self.mod["get_shape_cache_stats"]
         self._set_input = self.mod["set_input"]
 
     def init(self, ctx):
@@ -286,12 +323,35 @@ class VirtualMachine(object):
 
         Parameters
         ----------
-        ctx : :py:class:`TVMContext`
-            The runtime context to run the code on.
+        ctx : :py:class:`TVMContext` or list of :py:class:`TVMContext`
+            The runtime contexts to run the code on. The first is the default
+            context, the others hold the tensors placed on their devices by a
+            heterogeneous build.
         """
-        args = [ctx.device_type, ctx.device_id]
+        ctxs = ctx if isinstance(ctx, (list, tuple)) else [ctx]
+        args = []
+        for context in ctxs:
+            args += [context.device_type, context.device_id]
         self._init(*args)
 
+    def create_context(self):
+        """Create a VM sharing the executable loaded by this one.
+
+        The code and the constants are shared, and the constants are
+        uploaded to each device once, so that a context per thread can serve
+        the requests of a model without copying its weights. Each context
+        has its own registers, inputs and shape cache, and is initialized
+        on the devices of this VM.
+
+        Returns
+        -------
+        vm : VirtualMachine
+            The new context.
+        """
+        vm = VirtualMachine.__new__(VirtualMachine)
+        vm._bind(self.mod["create_context"](), self._exec)
+        return vm
+
     def set_input(self, func_name, *args, **kwargs):
         """Set the input to a function.
 
@@ -345,6 +405,135 @@ class VirtualMachine(object):
             self.set_input(func_name, *args, **kwargs)
         return self._invoke(func_name)
 
+    def invoke_async(self, func_name, *args, **kwargs):
+        """Invoke a function on the thread of the VM, without waiting for it.
+
+        The invocations run one at a time, in the order they are made.
+
+        Parameters
+        ----------
+        func_name : str
+            The name of the function.
+
+        args : list[NDArray] or list[np.ndarray]
+            The arguments to the function.
+
+        kwargs: dict of str to NDArray or np.ndarray
+            Named arguments to the function.
+
+        Returns
+        -------
+        future : VMFuture
+            The future of the output.
+        """
+        if args or kwargs:
+            self.set_input(func_name, *args, **kwargs)
+        return VMFuture(self._invoke_async(func_name))
+
+    def configure_async(self, num_workers=2, worker_cores=""):
+        """Set the worker threads running the kernels on the CPU.
+
+        A kernel runs once the kernels before it which access the same
+        tensors are done, so that independent kernels and the control flow
+        of the VM overlap. Once set, the workers also run the kernels of
+        :any:`invoke`, which otherwise runs them in place.
+
+        Parameters
+        ----------
+        num_workers : int
+            The number of workers, 0 to run the kernels on the thread of the VM.
+
+        worker_cores : str
+            The cores of each worker, as semicolon separated groups of comma
+            separated core ids or ranges, e.g. "0-3;4-7". Empty to split the
+            cores evenly.
+        """
+        self._configure_async(num_workers, worker_cores)
+
+    def configure_shape_cache(self, max_entries=64):
+        """Set how many outputs of each shape function the VM reuses.
+
+        The outputs of the shape functions, and of the kernels computing the
+        sizes of the allocations, are reused when they are called again with
+        the same inputs. This also resets the statistics of the cache.
+
+        Parameters
+        ----------
+        max_entries : int
+            The most outputs kept per function, 0 to call the shape
+            functions every time.
+        """
+        self._configure_shape_cache(max_entries)
+
+    def set_specialize_hook(self, hook, threshold=16):
+        """Set the hook specializing the kernels for the shapes seen often.
+
+        Parameters
+        ----------
+        hook : function(str, ADT) -> Optional[tvm.Function]
+            Called with the name of a kernel and the shapes of its arguments
+            once it has been called threshold times with them. The function
+            it returns, if any, is called instead for these shapes. None to
+            remove the hook.
+
+        threshold : int
+            The number of calls with the same shapes before the hook is called.
+        """
+        self._set_specialize_hook(hook, threshold)
+
+    def shape_cache_stats(self):
+        """Get the hits and misses of the shape cache.
+
+        Returns
+        -------
+        stats : dict
+            The hits, misses, bypassed calls, evictions and entries of the
+            shape cache, in total and under "functions" for each shape
+            function, with the kernels specialized under "specialized". A
+            part is None when it is not enabled.
+        """
+        return json.loads(self._get_shape_cache_stats())
+
+    def start_trace(self, capacity=1 << 16, sample_every=1):
+        """Start recording a timeline of the runs of the VM.
+
+        The dispatch of the instructions, the allocations of storage, the
+        kernels and the calls of functions are recorded in a ring buffer
+        which keeps the latest events.
+
+        Parameters
+        ----------
+        capacity : int
+            The number of events kept.
+
+        sample_every : int
+            Record one run in every sample_every, to trace under load.
+        """
+        self.mod["start_trace"](capacity, sample_every)
+
+    def stop_trace(self):
+        """Stop recording the runs, keeping the events recorded."""
+        self.mod["stop_trace"]()
+
+    def export_trace(self, file_name=None):
+        """Export the events recorded in the Chrome trace event format.
+
+        Parameters
+        ----------
+        file_name : Optional[str]
+            The file to write the trace to, to be opened in chrome://tracing.
+
+        Returns
+        -------
+        trace : dict
+            The trace.
+        """
+        trace = self.mod["export_trace"]()
+        if file_name is not None:
+            with open(file_name, "w") as f:
+                f.write(trace)
+        return json.loads(trace)
+
     def run(self, *args, **kwargs):
         """Run the main function.
 
@@ -364,6 +553,28 @@ class VirtualMachine(object):
         return self.invoke("main", *args, **kwargs)
 
 
+class VMFuture(object):
+    """The output of an asynchronous invocation of the Relay VM."""
+    def __init__(self, mod):
+        self.mod = mod
+        self._wait = self.mod["wait"]
+        self._done = self.mod["done"]
+
+    def result(self):
+        """Wait for the invocation to finish.
+
+        Returns
+        -------
+        result : Object
+            The output.
+        """
+        return self._wait()
+
+    def done(self):
+        """Whether the invocation has finished."""
+        return bool(self._done())
+
+
 def compile(mod, target=None, target_host=None, params=None):
     """Compile the module to VM executable. A helper function for VMCompiler.
 
@@ -411,6 +622,7 @@ class VMCompiler(object):
         self._codegen = self.mod["codegen"]
         self._get_exec = self.mod["get_executable"]
         self._set_params_func = self.mod["set_params"]
+        self._get_memory_plan_stats = self.mod["get_memory_plan_stats"]
 
     def set_params(self, params):
         """Set constant parameters for the model.
@@ -470,6 +682,17 @@ class VMCompiler(object):
         """
         return Executable(self._get_exec())
 
+    def get_memory_plan_stats(self):
+        """Get the storage of the static allocations before and after they
+        are coalesced in the last lowering.
+
+        Returns
+        -------
+        stats : dict
+            The number and bytes of the storages before and after planning.
+        """
+        return json.loads(self._get_memory_plan_stats())
+
     def _update_target(self, target):
         """Update target."""
         target = target if target else tvm.target.current_target()
@@ -36,7 +36,7 @@ def invoke_tvm_op(func, inputs, outputs):
     """
     return _make.invoke_tvm_op(func, inputs, outputs)
 
-def alloc_tensor(storage, shape, dtype='float32', assert_shape=None):
+def alloc_tensor(storage, shape, dtype='float32', assert_shape=None, offset=0):
     """Allocate a tensor with the provided shape, and dtype.
 
     Parameters
@@ -52,14 +52,18 @@ def alloc_tensor(storage, shape, dtype='float32', assert_shape=None):
 
     assert_shape: Control the static shape when computed by dynamic shape expression.
 
+    offset: int
+        The byte offset of the tensor in the storage, the shape must be constant
+        when it is not 0.
+
     Returns
     -------
     result : tvm.relay.Expr
         The alloc_tensor expression.
     """
-    return _make.alloc_tensor(storage, shape, dtype, assert_shape)
+    return _make.alloc_tensor(storage, shape, dtype, assert_shape, offset)
 
-def alloc_storage(size, alignment, dtype_hint='float32'):
+def alloc_storage(size, alignment, dtype_hint='float32', ctx=None):
     """Allocate a piece of tensor storage.
 
     Parameters
@@ -70,13 +74,17 @@ def alloc_storage(size, alignment, dtype_hint='float32'):
         The alignment of the allocation.
     dtype : str
         The dtype_hint of the allocation.
+    ctx : TVMContext, optional
+        The device of the allocation, the default context of the VM if None.
 
     Returns
     -------
     result : tvm.relay.Expr
         The alloc_storage expression.
     """
-    return _make.alloc_storage(size, alignment, dtype_hint)
+    if ctx is None:
+        return _make.alloc_storage(size, alignment, dtype_hint, -1, 0)
+    return _make.alloc_storage(size, alignment, dtype_hint, ctx.device_type, ctx.device_id)
 
 def shape_func(func, inputs, outputs, dependent=False):
     """Invoke the shape function of the passed function.
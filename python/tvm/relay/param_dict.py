@@ -19,9 +19,10 @@
 import tvm
 
 _save_param_dict = tvm.get_global_func("tvm.relay._save_param_dict")
+_save_param_dict_aligned = tvm.get_global_func("tvm.relay._save_param_dict_aligned")
 _load_param_dict = tvm.get_global_func("tvm.relay._load_param_dict")
 
-def save_param_dict(params):
+def save_param_dict(params, aligned=False):
     """Save parameter dictionary to binary bytes.
 
     The result binary bytes can be loaded by the
@@ -32,6 +33,11 @@ def save_param_dict(params):
     params : dict of str to NDArray
         The parameter dictionary.
 
+    aligned : bool
+        Whether to align the data of large parameters to pages, so that
+        GraphModule.load_params_from_file maps them from the file in
+        place instead of copying them.
+
     Returns
     -------
     param_bytes: bytearray
@@ -54,6 +60,8 @@ def save_param_dict(params):
     for k, v in params.items():
         args.append(k)
         args.append(tvm.nd.array(v))
+    if aligned:
+        return _save_param_dict_aligned(*args)
     return _save_param_dict(*args)
 
 
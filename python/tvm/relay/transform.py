@@ -54,6 +54,52 @@ class PassInfo(RelayNode):
             _transform.PassInfo, opt_level, name, required)
 
 
+@register_relay_node
+class PassProfiler(RelayNode):
+    """Records the wall time, the number of IR nodes before and after, and the
+    growth of the peak memory of the process of each pass run under a
+    PassContext with this profiler.
+
+    Examples
+    --------
+    .. code-block:: python
+
+        profiler = relay.transform.PassProfiler()
+        with relay.build_config(opt_level=3, profiler=profiler):
+            graph, lib, params = relay.build(mod, "llvm")
+        print(profiler.report())
+    """
+
+    def __init__(self):
+        self.__init_handle_by_constructor__(_transform.PassProfiler)
+
+    def report(self):
+        """Get a table of the recorded passes, nested as they ran.
+
+        Returns
+        -------
+        report : str
+            The number of calls, total and self time, IR nodes before the
+            first and after the last call, and peak memory growth in KB of
+            each pass.
+        """
+        return _transform.PassProfilerReport(self)
+
+    def trace_json(self):
+        """Get the recorded passes in the Chrome trace event format.
+
+        Returns
+        -------
+        trace : str
+            The JSON trace, which chrome://tracing can load.
+        """
+        return _transform.PassProfilerTraceJSON(self)
+
+    def reset(self):
+        """Clear the recorded passes."""
+        _transform.PassProfilerReset(self)
+
+
 @register_relay_node
 class PassContext(RelayNode):
     """The basis where a Relay optimization/analysis runs on.
@@ -73,12 +119,21 @@ class PassContext(RelayNode):
 
     disabled_pass : Optional[Union[List[str], Set[str], Tuple[str]]]
         The list of passes that are disabled.
+
+    profiler : Optional[PassProfiler]
+        The profiler that records the passes run under this context.
+
+    function_pass_threads : Optional[int]
+        The number of threads that run a thread-safe function pass over the
+        functions of a module.
     """
     def __init__(self,
                  opt_level=2,
                  fallback_device=_nd.cpu(),
                  required_pass=None,
-                 disabled_pass=None):
+                 disabled_pass=None,
+                 profiler=None,
+                 function_pass_threads=1):
         if isinstance(fallback_device, str):
             fallback_device = _nd.context(fallback_device).device_type
         elif isinstance(fallback_device, TVMContext):
@@ -99,7 +154,8 @@ class PassContext(RelayNode):
 
         self.__init_handle_by_constructor__(_transform.PassContext, opt_level,
                                             fallback_device, required,
-                                            disabled)
+                                            disabled, profiler,
+                                            function_pass_threads)
 
     def __enter__(self):
         _transform.EnterPassContext(self)
@@ -117,7 +173,9 @@ class PassContext(RelayNode):
 def build_config(opt_level=2,
                  fallback_device=_nd.cpu(),
                  required_pass=None,
-                 disabled_pass=None):
+                 disabled_pass=None,
+                 profiler=None,
+                 function_pass_threads=1):
     """Configure the build behavior by setting config variables.
 
     Parameters
@@ -151,13 +209,21 @@ def build_config(opt_level=2,
     disabled_pass: set of str, optional
         Optimization passes to be disabled during optimization.
 
+    profiler: PassProfiler, optional
+        The profiler that records the passes run under this config.
+
+    function_pass_threads: int, optional
+        The number of threads that run a function pass declared thread-safe,
+        such as FuseOps or InferType, over the functions of a module. The
+        result does not depend on it.
+
     Returns
     -------
     pass_context: PassContext
         The pass context for optimizations.
     """
     return PassContext(opt_level, fallback_device, required_pass,
-                       disabled_pass)
+                       disabled_pass, profiler, function_pass_threads)
 
 
 @register_relay_node
@@ -646,6 +712,47 @@ def LambdaLift():
     return _transform.LambdaLift()
 
 
+def ManifestAlloc(target_host, default_device=-1):
+    """
+    Manifest the allocations of the outputs of the primitive calls, with the
+    shape functions invoked for the outputs of a dynamic shape.
+
+    Parameters
+    ----------
+    target_host : tvm.target.Target
+        The target of the shape functions.
+
+    default_device : int
+        The device type of the values not copied to another device, -1 for
+        the default context of the VM.
+
+    Returns
+    -------
+    ret : tvm.relay.Pass
+        The registered pass that manifests the allocations.
+    """
+    return _transform.ManifestAlloc(target_host, default_device)
+
+
+def MemoryPlan(use_offsets=True):
+    """
+    Coalesce the storage of the manifested static allocations by the
+    lifetime of the tensors.
+
+    Parameters
+    ----------
+    use_offsets : bool
+        Whether the tensors of a scope are placed at offsets of one storage,
+        only supported on devices with flat addresses.
+
+    Returns
+    -------
+    ret : tvm.relay.Pass
+        The registered pass that plans the storage.
+    """
+    return _transform.MemoryPlan(use_offsets)
+
+
 def PrintIR(show_meta_data=True):
     """
     Print the IR for a module to help debugging.
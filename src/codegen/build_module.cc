@@ -684,6 +684,8 @@ TVM_STATIC_IR_FUNCTOR(NodePrinter, vtable)
   p->stream << "disable_select_rewriting=" << op->disable_select_rewriting;
   p->stream << "disable_vectorize=" << op->disable_vectorize;
   p->stream << "disable_assert=" << op->disable_assert;
+  p->stream << "chunked_parallel_launch=" << op->chunked_parallel_launch;
+  p->stream << "llvm_codegen_partitions=" << op->llvm_codegen_partitions;
   p->stream << ")";
 });
 
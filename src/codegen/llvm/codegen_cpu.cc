@@ -23,6 +23,7 @@
 #ifdef TVM_LLVM_VERSION
 
 #include <tvm/runtime/c_runtime_api.h>
+#include <tvm/build_module.h>
 #include <tvm/ir_pass.h>
 #include <memory>
 #include <unordered_map>
@@ -116,6 +117,9 @@ void CodeGenCPU::Init(const std::string& module_name,
     f_tvm_parallel_launch_ = llvm::Function::Create(
         ftype_tvm_parallel_launch_,
         llvm::Function::ExternalLinkage, "TVMBackendParallelLaunch", module_.get());
+    f_tvm_parallel_launch_chunked_ = llvm::Function::Create(
+        ftype_tvm_parallel_launch_,
+        llvm::Function::ExternalLinkage, "TVMBackendParallelLaunchChunked", module_.get());
     f_tvm_parallel_barrier_ = llvm::Function::Create(
         ftype_tvm_parallel_barrier_,
         llvm::Function::ExternalLinkage, "TVMBackendParallelBarrier", module_.get());
@@ -390,6 +394,8 @@ void CodeGenCPU::InitGlobalContext(bool dynamic_lookup) {
           ftype_tvm_api_set_last_error_->getPointerTo(), "__TVMAPISetLastError");
       gv_tvm_parallel_launch_ = InitContextPtr(
           ftype_tvm_parallel_launch_->getPointerTo(), "__TVMBackendParallelLaunch");
+      gv_tvm_parallel_launch_chunked_ = InitContextPtr(
+          ftype_tvm_parallel_launch_->getPointerTo(), "__TVMBackendParallelLaunchChunked");
       gv_tvm_parallel_barrier_ = InitContextPtr(
           ftype_tvm_parallel_barrier_->getPointerTo(), "__TVMBackendParallelBarrier");
       // Mark as context functions
@@ -516,10 +522,8 @@ void CodeGenCPU::CreateParallelLaunch(const Stmt& body, int num_task) {
   Array<Var> vfields = ir::UndefinedVars(body, {});
   uint64_t nbytes;
   llvm::Value* cdata = PackClosureData(vfields, &nbytes);
-  BasicBlock* par_launch_end = CheckCallSuccess(
-      builder_->CreateCall(
-          RuntimeTVMParallelLaunch(),
-          {f, builder_->CreatePointerCast(cdata, t_void_p_), ConstInt32(num_task)}));
+  llvm::Value* cdata_ptr = builder_->CreatePointerCast(cdata, t_void_p_);
+  BasicBlock* par_launch_begin = builder_->GetInsertBlock();
   // Setup the closure function.
   BasicBlock *lambda_entry = BasicBlock::Create(*ctx_, "entry", f);
   builder_->SetInsertPoint(lambda_entry);
@@ -550,7 +554,15 @@ void CodeGenCPU::CreateParallelLaunch(const Stmt& body, int num_task) {
   std::swap(function_, f);
   CHECK_NE(par_env.parallel_loop_count, 0)
       << "Cannot find parallel loop within parallel launch";
-  builder_->SetInsertPoint(par_launch_end);
+  // Launch the closure. A lambda without barriers consists of independent
+  // tasks, which can be split into chunks that idle workers steal.
+  builder_->SetInsertPoint(par_launch_begin);
+  bool chunked = par_env.barrier_count == 0 &&
+      BuildConfig::Current()->chunked_parallel_launch;
+  CheckCallSuccess(
+      builder_->CreateCall(
+          chunked ? RuntimeTVMParallelLaunchChunked() : RuntimeTVMParallelLaunch(),
+          {f, cdata_ptr, ConstInt32(num_task)}));
 }
 
 llvm::Value* CodeGenCPU::CreateStaticHandle() {
@@ -761,6 +773,11 @@ llvm::Value* CodeGenCPU::RuntimeTVMParallelLaunch() {
   return GetContextPtr(gv_tvm_parallel_launch_);
 }
 
+llvm::Value* CodeGenCPU::RuntimeTVMParallelLaunchChunked() {
+  if (f_tvm_parallel_launch_chunked_ != nullptr) return f_tvm_parallel_launch_chunked_;
+  return GetContextPtr(gv_tvm_parallel_launch_chunked_);
+}
+
 llvm::Value* CodeGenCPU::RuntimeTVMParallelBarrier() {
   if (f_tvm_parallel_barrier_ != nullptr) return f_tvm_parallel_barrier_;
   return GetContextPtr(gv_tvm_parallel_barrier_);
@@ -892,6 +909,7 @@ void CodeGenCPU::VisitStmt_(const AttrStmtNode* op) {
       builder_->CreateCall(
           RuntimeTVMParallelBarrier(),
           {MakeValue(parallel_env_.task_id),  parallel_env_.penv});
+      ++parallel_env_.barrier_count;
     } else if (op->attr_key == ir::attr::pragma_import_llvm) {
       const StringImmNode* value = op->value.as<StringImmNode>();
       CHECK(value != nullptr);
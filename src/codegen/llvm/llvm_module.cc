@@ -25,8 +25,13 @@
 
 #include <tvm/runtime/packed_func.h>
 #include <tvm/runtime/registry.h>
+#include <tvm/build_module.h>
 #include <tvm/codegen.h>
+#include <tvm/ir_functor_ext.h>
+#include <algorithm>
 #include <mutex>
+#include <thread>
+#include <vector>
 #include "llvm_common.h"
 #include "codegen_llvm.h"
 #include "codegen_blob.h"
@@ -58,8 +63,8 @@ class LLVMModuleNode final : public runtime::ModuleNode {
       const std::string& name,
       const ObjectPtr<Object>& sptr_to_self) final {
     if (name == "__tvm_is_system_module") {
-      bool flag =
-          (mptr_->getFunction("__tvm_module_startup") != nullptr);
+      bool flag = parts_.empty() ?
+          (mptr_->getFunction("__tvm_module_startup") != nullptr) : system_lib_;
       return PackedFunc([flag](TVMArgs args, TVMRetValue *rv) {
           * rv = flag;
         });
@@ -68,7 +73,17 @@ class LLVMModuleNode final : public runtime::ModuleNode {
       return PackedFunc([target_triple](TVMArgs args, TVMRetValue *rv) {
         * rv = target_triple;
       });
+    } else if (name == "_get_num_objects") {
+      size_t num_objects = std::max(parts_.size(), size_t(1));
+      return PackedFunc([num_objects](TVMArgs args, TVMRetValue *rv) {
+        * rv = static_cast<int64_t>(num_objects);
+      });
+    } else if (name == "_save_object") {
+      return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue *rv) {
+        SaveObject(args[0], args[1]);
+      });
     }
+    LinkParts();
     if (ee_ == nullptr) LazyInitJIT();
     std::lock_guard<std::mutex> lock(mutex_);
     const std::string& fname = (name == runtime::symbol::tvm_module_main ?
@@ -82,6 +97,7 @@ class LLVMModuleNode final : public runtime::ModuleNode {
 
   void SaveToFile(const std::string& file_name,
                   const std::string& format) final {
+    LinkParts();
     std::string fmt = runtime::GetFileFormat(file_name, format);
     std::error_code ecode;
     llvm::raw_fd_ostream dest(file_name, ecode, llvm::sys::fs::F_None);
@@ -151,6 +167,7 @@ class LLVMModuleNode final : public runtime::ModuleNode {
   }
 
   std::string GetSource(const std::string& format) final {
+    LinkParts();
     std::string fmt = runtime::GetFileFormat("", format);
     std::string type_str;
     llvm::SmallString<256> str;
@@ -195,32 +212,18 @@ class LLVMModuleNode final : public runtime::ModuleNode {
   void Init(const Array<LoweredFunc>& funcs, std::string target) {
     InitializeLLVM();
     tm_ = GetLLVMTargetMachine(target);
-    bool system_lib = (target.find("-system-lib") != std::string::npos);
+    system_lib_ = (target.find("-system-lib") != std::string::npos);
     CHECK_NE(funcs.size(), 0U);
     ctx_ = std::make_shared<llvm::LLVMContext>();
-    std::unique_ptr<CodeGenLLVM> cg = CodeGenLLVM::Create(tm_.get());
     entry_func_ = funcs[0]->name;
-    cg->Init(funcs[0]->name, tm_.get(), ctx_.get(), system_lib, system_lib);
-    for (LoweredFunc f :  funcs) {
-      cg->AddFunction(f);
-    }
-    cg->AddMainFunction(funcs[0]->name);
-    module_ = cg->Finish();
-
-    module_->addModuleFlag(llvm::Module::Warning, "tvm_target", llvm::MDString::get(*ctx_, target));
-    module_->addModuleFlag(llvm::Module::Override, "Debug Info Version",
-                           llvm::DEBUG_METADATA_VERSION);
-
-    if (tm_->getTargetTriple().isOSDarwin()) {
-      module_->addModuleFlag(llvm::Module::Override, "Dwarf Version", 2);
-    }
-
-    std::string verify_errors_storage;
-    llvm::raw_string_ostream verify_errors(verify_errors_storage);
-    LOG_IF(FATAL, llvm::verifyModule(*module_, &verify_errors))
-        << "LLVM module verification failed with the following errors: \n"
-        << verify_errors.str();
     target_ = target;
+    int num_parts = BuildConfig::Current()->llvm_codegen_partitions;
+    if (num_parts > 1 && funcs.size() > 1) {
+      InitParts(funcs, num_parts);
+      return;
+    }
+    module_ = CodeGenModule(
+        std::vector<LoweredFunc>(funcs.begin(), funcs.end()), tm_.get(), ctx_.get());
     mptr_ = module_.get();
   }
 
@@ -309,6 +312,161 @@ class LLVMModuleNode final : public runtime::ModuleNode {
         return reinterpret_cast<void*>(GetGlobalAddr(name));
       });
   }
+  /*! \brief A partition of the host functions, optimized and emitted on its own. */
+  struct Part {
+    /*! \brief The optimized module as bitcode, linked on first use. */
+    llvm::SmallVector<char, 0> bitcode;
+    /*! \brief The object code. */
+    llvm::SmallVector<char, 0> object;
+  };
+
+  /*!
+   * \brief Generate and optimize the module of some functions.
+   * \param funcs The functions, the entry function is added if among them.
+   * \param tm The target machine.
+   * \param ctx The context of the module.
+   * \return The module.
+   */
+  std::unique_ptr<llvm::Module> CodeGenModule(const std::vector<LoweredFunc>& funcs,
+                                              llvm::TargetMachine* tm,
+                                              llvm::LLVMContext* ctx) const {
+    std::unique_ptr<CodeGenLLVM> cg = CodeGenLLVM::Create(tm);
+    cg->Init(funcs[0]->name, tm, ctx, system_lib_, system_lib_);
+    bool has_entry = false;
+    for (LoweredFunc f :  funcs) {
+      cg->AddFunction(f);
+      has_entry = has_entry || f->name == entry_func_;
+    }
+    if (has_entry) cg->AddMainFunction(entry_func_);
+    std::unique_ptr<llvm::Module> module = cg->Finish();
+
+    module->addModuleFlag(llvm::Module::Warning, "tvm_target", llvm::MDString::get(*ctx, target_));
+    module->addModuleFlag(llvm::Module::Override, "Debug Info Version",
+                          llvm::DEBUG_METADATA_VERSION);
+
+    if (tm->getTargetTriple().isOSDarwin()) {
+      module->addModuleFlag(llvm::Module::Override, "Dwarf Version", 2);
+    }
+
+    std::string verify_errors_storage;
+    llvm::raw_string_ostream verify_errors(verify_errors_storage);
+    LOG_IF(FATAL, llvm::verifyModule(*module, &verify_errors))
+        << "LLVM module verification failed with the following errors: \n"
+        << verify_errors.str();
+    return module;
+  }
+  /*!
+   * \brief Split the functions into partitions of about the same size, then
+   *  generate, optimize and emit each one on its own thread, with its own
+   *  context and target machine.
+   */
+  void InitParts(const Array<LoweredFunc>& funcs, int num_parts) {
+    // assign the largest functions first, each to the smallest partition.
+    std::vector<std::pair<size_t, LoweredFunc>> sized;
+    for (LoweredFunc f : funcs) {
+      size_t size = 0;
+      ir::PostOrderVisit(f->body, [&size](const ObjectRef&) { ++size; });
+      sized.emplace_back(size, f);
+    }
+    using SizedFunc = std::pair<size_t, LoweredFunc>;
+    std::stable_sort(sized.begin(), sized.end(), [](const SizedFunc& a, const SizedFunc& b) {
+      return a.first > b.first;
+    });
+    num_parts = std::min(num_parts, static_cast<int>(funcs.size()));
+    std::vector<std::vector<LoweredFunc>> part_funcs(num_parts);
+    std::vector<size_t> part_sizes(num_parts, 0);
+    for (const auto& kv : sized) {
+      size_t i = std::min_element(part_sizes.begin(), part_sizes.end()) - part_sizes.begin();
+      part_funcs[i].push_back(kv.second);
+      part_sizes[i] += kv.first;
+    }
+
+    parts_.resize(num_parts);
+    std::vector<std::string> errors(num_parts);
+    BuildConfig config = BuildConfig::Current();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_parts; ++i) {
+      threads.emplace_back([&, i]() {
+        try {
+          With<BuildConfig> scope(config);
+          llvm::LLVMContext ctx;
+          std::unique_ptr<llvm::TargetMachine> tm = GetLLVMTargetMachine(target_);
+          std::unique_ptr<llvm::Module> module = CodeGenModule(part_funcs[i], tm.get(), &ctx);
+          {
+            llvm::raw_svector_ostream os(parts_[i].bitcode);
+#if TVM_LLVM_VERSION <= 60
+            llvm::WriteBitcodeToFile(module.get(), os);
+#else
+            llvm::WriteBitcodeToFile(*module, os);
+#endif
+          }
+          llvm::raw_svector_ostream os(parts_[i].object);
+          llvm::legacy::PassManager pass;
+#if TVM_LLVM_VERSION <= 60
+          CHECK(tm->addPassesToEmitFile(
+              pass, os, llvm::TargetMachine::CGFT_ObjectFile) == 0)
+              << "Cannot emit target CGFT_ObjectFile";
+#elif TVM_LLVM_VERSION <= 90
+          CHECK(tm->addPassesToEmitFile(
+              pass, os, nullptr, llvm::TargetMachine::CGFT_ObjectFile) == 0)
+              << "Cannot emit target CGFT_ObjectFile";
+#else
+          CHECK(tm->addPassesToEmitFile(
+              pass, os, nullptr, llvm::CGFT_ObjectFile) == 0)
+              << "Cannot emit target CGFT_ObjectFile";
+#endif
+          pass.run(*module);
+        } catch (const std::exception& e) {
+          errors[i] = e.what();
+        }
+      });
+    }
+    for (auto& t : threads) t.join();
+    for (const std::string& error : errors) {
+      CHECK(error.empty()) << error;
+    }
+  }
+  /*! \brief Link the partitions into one module, for the uses other than object files. */
+  void LinkParts() {
+    std::call_once(link_once_, [this]() {
+      if (parts_.empty()) return;
+      for (const Part& part : parts_) {
+        llvm::SMDiagnostic err;
+        std::unique_ptr<llvm::Module> module = llvm::parseIR(
+            llvm::MemoryBufferRef(llvm::StringRef(part.bitcode.data(), part.bitcode.size()),
+                                  entry_func_),
+            err, *ctx_);
+        CHECK(module != nullptr) << "Fail to load a partition: " << err.getMessage().str();
+        if (module_ == nullptr) {
+          module_ = std::move(module);
+        } else {
+          CHECK(!llvm::Linker::linkModules(*module_, std::move(module)))
+              << "Failed to link the partitions";
+        }
+      }
+      mptr_ = module_.get();
+    });
+  }
+  /*!
+   * \brief Save one of the object files of the module.
+   * \param index The index of the object file, see _get_num_objects.
+   * \param file_name The file name.
+   */
+  void SaveObject(int index, const std::string& file_name) {
+    if (parts_.empty()) {
+      CHECK_EQ(index, 0);
+      SaveToFile(file_name, "o");
+      return;
+    }
+    CHECK(index >= 0 && static_cast<size_t>(index) < parts_.size())
+        << "object index " << index << " out of range";
+    std::error_code ecode;
+    llvm::raw_fd_ostream dest(file_name, ecode, llvm::sys::fs::F_None);
+    CHECK_EQ(ecode.value(), 0) << "Cannot open file: " << file_name
+                               << " " << ecode.message();
+    dest.write(parts_[index].object.data(), parts_[index].object.size());
+    dest.close();
+  }
   // Get global address from execution engine.
   uint64_t GetGlobalAddr(const std::string& name) {
     // first verifies if GV exists.
@@ -329,6 +487,12 @@ class LLVMModuleNode final : public runtime::ModuleNode {
 
   // The target configuration string
   std::string target_;
+  // Whether the symbols are registered to the system library.
+  bool system_lib_{false};
+  // The partitions, empty when the module is generated as a whole.
+  std::vector<Part> parts_;
+  // Links the partitions once.
+  std::once_flag link_once_;
   // Name of entry function.
   std::string entry_func_;
   // JIT lock
@@ -0,0 +1,73 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file parallel_for.h
+ * \brief A loop over indices on a few short-lived threads.
+ */
+#ifndef TVM_COMMON_PARALLEL_FOR_H_
+#define TVM_COMMON_PARALLEL_FOR_H_
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace tvm {
+namespace common {
+/*!
+ * \brief Run f(0), ..., f(n - 1) on up to num_threads threads, including the
+ *  calling one. The thread-local scopes of the caller, e.g. the current
+ *  PassContext, are not entered on the other threads, f has to do it.
+ *
+ *  The error of the lowest index, if any, is rethrown once all the calls
+ *  are done.
+ * \param n The number of indices.
+ * \param num_threads The maximum number of threads.
+ * \param f The body of the loop.
+ */
+inline void ParallelFor(size_t n, int num_threads, const std::function<void(size_t)>& f) {
+  std::atomic<size_t> next{0};
+  std::vector<std::exception_ptr> errors(n);
+  auto work = [&]() {
+    for (size_t i = next++; i < n; i = next++) {
+      try {
+        f(i);
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  size_t num_workers = std::min(n, static_cast<size_t>(std::max(num_threads, 1)));
+  for (size_t i = 1; i < num_workers; ++i) {
+    threads.emplace_back(work);
+  }
+  work();
+  for (auto& t : threads) t.join();
+  for (const auto& error : errors) {
+    if (error) std::rethrow_exception(error);
+  }
+}
+
+}  // namespace common
+}  // namespace tvm
+#endif  // TVM_COMMON_PARALLEL_FOR_H_
@@ -0,0 +1,227 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file relay/backend/compile_cache.cc
+ * \brief A persistent cache of the lowered functions of the compile engine.
+ */
+#include "compile_cache.h"
+
+#include <tvm/node/serialization.h>
+#include <tvm/runtime/c_runtime_api.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <tuple>
+#include <vector>
+#if !defined(_WIN32)
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+namespace tvm {
+namespace relay {
+
+namespace {
+
+const char* kMagic = "tvm-compile-cache";
+const char* kEntrySuffix = ".entry";
+const int64_t kDefaultMaxBytes = int64_t(1) << 30;
+
+// A digest of the key text, which names its entry.
+std::string Digest(const std::string& text) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (char c : text) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ULL;
+  }
+  std::ostringstream os;
+  os << std::hex << std::setw(16) << std::setfill('0') << hash;
+  return os.str();
+}
+
+bool EndsWith(const std::string& s, const std::string& suffix) {
+  return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/*! \brief An entry file, with its last use and size. */
+struct EntryFile {
+  int64_t mtime;
+  std::string path;
+  int64_t size;
+};
+
+#if !defined(_WIN32)
+// Create a directory and its parents.
+bool MakeDirs(const std::string& dir) {
+  for (size_t pos = dir.find('/', 1); ; pos = dir.find('/', pos + 1)) {
+    std::string prefix = dir.substr(0, pos);
+    if (!prefix.empty() && mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) return false;
+    if (pos == std::string::npos) return true;
+  }
+}
+
+std::vector<EntryFile> ListEntries(const std::string& dir) {
+  std::vector<EntryFile> entries;
+  DIR* d = opendir(dir.c_str());
+  if (d == nullptr) return entries;
+  while (struct dirent* ent = readdir(d)) {
+    std::string name = ent->d_name;
+    if (!EndsWith(name, kEntrySuffix)) continue;
+    std::string path = dir + "/" + name;
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0) {
+      entries.push_back({static_cast<int64_t>(st.st_mtime), path, static_cast<int64_t>(st.st_size)});
+    }
+  }
+  closedir(d);
+  return entries;
+}
+#endif
+
+}  // namespace
+
+DiskCompileCache::DiskCompileCache(std::string dir, int64_t max_bytes)
+    : dir_(std::move(dir)), max_bytes_(max_bytes) {
+#if defined(_WIN32)
+  LOG(FATAL) << "the compile cache is not supported on Windows";
+#else
+  CHECK_GT(max_bytes_, 0) << "the compile cache needs a positive budget";
+  CHECK(MakeDirs(dir_)) << "cannot create the compile cache directory " << dir_;
+  int64_t num_bytes = 0;
+  for (const EntryFile& entry : ListEntries(dir_)) num_bytes += entry.size;
+  num_bytes_ = num_bytes;
+#endif
+}
+
+CachedFunc DiskCompileCache::Get(const std::string& key_text, std::string* base_name) {
+  std::string path = dir_ + "/" + Digest(key_text) + kEntrySuffix;
+  std::ifstream fs(path, std::ios::in | std::ios::binary);
+  std::string magic, name;
+  size_t size = 0;
+  if (fs && std::getline(fs, magic) && magic == kMagic && std::getline(fs, name) &&
+      fs >> size && fs.get() == '\n') {
+    std::string text(size, '\0');
+    if (fs.read(&text[0], size) && text == key_text) {
+      std::string json((std::istreambuf_iterator<char>(fs)), std::istreambuf_iterator<char>());
+      try {
+        CachedFunc func = Downcast<CachedFunc>(LoadJSON(json));
+#if !defined(_WIN32)
+        utime(path.c_str(), nullptr);
+#endif
+        *base_name = name;
+        return func;
+      } catch (const dmlc::Error& e) {
+        LOG(WARNING) << "ignoring the corrupt compile cache entry " << path << ": " << e.what();
+      }
+    }
+  }
+  return CachedFunc();
+}
+
+void DiskCompileCache::Put(const std::string& key_text, const std::string& base_name,
+                           const CachedFunc& func) {
+  std::string path = dir_ + "/" + Digest(key_text) + kEntrySuffix;
+  std::string data;
+  try {
+    std::ostringstream os;
+    os << kMagic << "\n" << base_name << "\n" << key_text.size() << "\n" << key_text
+       << SaveJSON(func);
+    data = os.str();
+  } catch (const dmlc::Error& e) {
+    LOG(WARNING) << "cannot serialize " << func->func_name << " to the compile cache: " << e.what();
+    return;
+  }
+#if !defined(_WIN32)
+  static std::atomic<int64_t> num_temps{0};
+  // a process only renames its own files, so the others never see partial ones.
+  std::string temp = path + ".tmp." + std::to_string(getpid()) + "." + std::to_string(num_temps++);
+  bool written;
+  {
+    std::ofstream fs(temp, std::ios::out | std::ios::binary);
+    written = fs.write(data.data(), data.size()).good();
+  }
+  if (!written || std::rename(temp.c_str(), path.c_str()) != 0) {
+    LOG(WARNING) << "cannot write the compile cache entry " << path;
+    std::remove(temp.c_str());
+    return;
+  }
+#endif
+  ++num_writes_;
+  if ((num_bytes_ += static_cast<int64_t>(data.size())) > max_bytes_) Evict();
+}
+
+void DiskCompileCache::Evict() {
+#if !defined(_WIN32)
+  std::lock_guard<std::mutex> lock(evict_mutex_);
+  if (num_bytes_ <= max_bytes_) return;
+  std::vector<EntryFile> entries = ListEntries(dir_);
+  std::sort(entries.begin(), entries.end(), [](const EntryFile& a, const EntryFile& b) {
+    return std::tie(a.mtime, a.path) < std::tie(b.mtime, b.path);
+  });
+  int64_t num_bytes = 0;
+  for (const EntryFile& entry : entries) num_bytes += entry.size;
+  // evict down to three quarters of the budget, so that scans are rare.
+  for (const EntryFile& entry : entries) {
+    if (num_bytes <= max_bytes_ / 4 * 3) break;
+    if (unlink(entry.path.c_str()) == 0) ++num_evictions_;
+    // the entry is gone either way, possibly evicted by another process.
+    num_bytes -= entry.size;
+  }
+  num_bytes_ = num_bytes;
+#endif
+}
+
+Map<std::string, Integer> DiskCompileCache::Stats() const {
+  Map<std::string, Integer> stats;
+  stats.Set("hits", Integer(static_cast<int>(num_hits_)));
+  stats.Set("misses", Integer(static_cast<int>(num_misses_)));
+  stats.Set("writes", Integer(static_cast<int>(num_writes_)));
+  stats.Set("evictions", Integer(static_cast<int>(num_evictions_)));
+  return stats;
+}
+
+std::string DiskCompileCache::KeyText(const CCacheKey& key, bool shape_func,
+                                      const std::string& context) {
+  std::ostringstream os;
+  os << "TVM " << TVM_VERSION << "\n"
+     << (shape_func ? "shape_func" : "func") << "\n"
+     << key->target->str() << "\n"
+     << context << "\n"
+     << AsText(key->source_func, true);
+  return os.str();
+}
+
+std::shared_ptr<DiskCompileCache> DiskCompileCache::FromEnv() {
+  const char* dir = getenv("TVM_COMPILE_CACHE_DIR");
+  if (dir == nullptr || dir[0] == '\0') return nullptr;
+  const char* max_bytes = getenv("TVM_COMPILE_CACHE_MAX_BYTES");
+  return std::make_shared<DiskCompileCache>(
+      dir, max_bytes != nullptr ? std::stoll(max_bytes) : kDefaultMaxBytes);
+}
+
+}  // namespace relay
+}  // namespace tvm
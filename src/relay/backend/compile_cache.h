@@ -0,0 +1,110 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file relay/backend/compile_cache.h
+ * \brief A persistent cache of the lowered functions of the compile engine,
+ *  shared on disk by processes.
+ */
+#ifndef TVM_RELAY_BACKEND_COMPILE_CACHE_H_
+#define TVM_RELAY_BACKEND_COMPILE_CACHE_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "compile_engine.h"
+
+namespace tvm {
+namespace relay {
+
+/*!
+ * \brief An on-disk cache of lowered functions.
+ *
+ *  An entry is a file named by a digest of its key text, which holds the
+ *  printed source function, the target, the build config and the version of
+ *  TVM. The text is stored in the entry and compared on a hit, so a digest
+ *  collision is a miss. Entries are written to a temporary file and renamed,
+ *  so that processes sharing the directory never read a partial entry. Hits
+ *  touch their file, and the least recently used files are removed when the
+ *  directory grows past its budget.
+ */
+class DiskCompileCache {
+ public:
+  /*!
+   * \brief Create a cache in a directory, which is created if missing.
+   * \param dir The directory.
+   * \param max_bytes The budget of the directory.
+   */
+  DiskCompileCache(std::string dir, int64_t max_bytes);
+  /*!
+   * \brief Look up a function.
+   * \param key_text The key text.
+   * \param base_name Set to the name of the function before it was made unique.
+   * \return The function, undefined on a miss.
+   */
+  CachedFunc Get(const std::string& key_text, std::string* base_name);
+  /*!
+   * \brief Count a lookup.
+   * \param hit Whether the function of the lookup was used, which it is
+   *  not when its name is already taken by another function.
+   */
+  void RecordLookup(bool hit) {
+    ++(hit ? num_hits_ : num_misses_);
+  }
+  /*!
+   * \brief Store a function, failures are only logged.
+   * \param key_text The key text.
+   * \param base_name The name of the function before it was made unique.
+   * \param func The function.
+   */
+  void Put(const std::string& key_text, const std::string& base_name, const CachedFunc& func);
+  /*! \return The numbers of hits, misses, writes and evictions. */
+  Map<std::string, Integer> Stats() const;
+  /*!
+   * \brief Get the key text of a function.
+   * \param key The key of the function.
+   * \param shape_func Whether the key is for the shape function.
+   * \param context The build config and python state the lowering depends on.
+   * \return The key text.
+   */
+  static std::string KeyText(const CCacheKey& key, bool shape_func, const std::string& context);
+  /*! \return The cache configured by TVM_COMPILE_CACHE_DIR, or nullptr. */
+  static std::shared_ptr<DiskCompileCache> FromEnv();
+
+ private:
+  /*! \brief Remove the least recently used entries until the directory fits its budget. */
+  void Evict();
+  /*! \brief The directory. */
+  std::string dir_;
+  /*! \brief The budget of the directory, in bytes. */
+  int64_t max_bytes_;
+  /*! \brief The bytes in the directory as of the last scan, plus the bytes written since. */
+  std::atomic<int64_t> num_bytes_{0};
+  /*! \brief Serializes the eviction scans of this process. */
+  std::mutex evict_mutex_;
+  std::atomic<int64_t> num_hits_{0};
+  std::atomic<int64_t> num_misses_{0};
+  std::atomic<int64_t> num_writes_{0};
+  std::atomic<int64_t> num_evictions_{0};
+};
+
+}  // namespace relay
+}  // namespace tvm
+#endif  // TVM_RELAY_BACKEND_COMPILE_CACHE_H_
@@ -22,11 +22,13 @@
  * \brief Internal compialtion engine.
  */
 #include "compile_engine.h"
+#include "compile_cache.h"
 
 #include <tvm/schedule.h>
 #include <tvm/packed_func_ext.h>
 #include <tvm/operation.h>
 #include <tvm/runtime/registry.h>
+#include <tvm/runtime/threading_backend.h>
 #include <tvm/relay/attrs/device_copy.h>
 #include <tvm/relay/analysis.h>
 #include <tvm/relay/expr.h>
@@ -34,6 +36,8 @@
 #include <tvm/relay/op.h>
 #include <tvm/relay/op_attr_types.h>
 #include <topi/tags.h>
+#include <algorithm>
+#include <cstdlib>
 #include <utility>
 #include <limits>
 #include <mutex>
@@ -41,6 +45,7 @@
 #include <vector>
 #include <unordered_map>
 #include "../ir/type_functor.h"
+#include "../../common/parallel_for.h"
 
 namespace tvm {
 namespace relay {
@@ -594,6 +599,14 @@ class CompileEngineImpl : public CompileEngineNode {
     return LowerInternal(key)->cached_func;
   }
 
+  Array<CachedFunc> LowerParallel(const Array<CCacheKey>& keys) final {
+    Array<CachedFunc> ret;
+    for (const CCacheValue& value : LowerBatch(keys, false, LowerThreads(), false)) {
+      ret.push_back(value->cached_func);
+    }
+    return ret;
+  }
+
   // For now, build one module per function.
   PackedFunc JIT(const CCacheKey& key) final {
     CCacheValue value = LowerInternal(key);
@@ -653,8 +666,24 @@ class CompileEngineImpl : public CompileEngineNode {
   }
 
   void Clear() final {
+    std::lock_guard<std::mutex> lock(mutex_);
     cache_.clear();
   }
+  /*!
+   * \brief Set the directory of the disk cache.
+   * \param dir The directory, empty to disable the disk cache.
+   * \param max_bytes The budget of the directory.
+   */
+  void SetDiskCache(const std::string& dir, int64_t max_bytes) {
+    auto disk = dir.empty() ? nullptr : std::make_shared<DiskCompileCache>(dir, max_bytes);
+    std::lock_guard<std::mutex> lock(mutex_);
+    disk_cache_ = disk;
+  }
+  // Statistics of the disk cache.
+  Map<std::string, Integer> DiskCacheStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return disk_cache_ != nullptr ? disk_cache_->Stats() : Map<std::string, Integer>();
+  }
   // List all items in the cache.
   Array<ObjectRef> ListItems() {
     std::lock_guard<std::mutex> lock(mutex_);
@@ -678,100 +707,237 @@ class CompileEngineImpl : public CompileEngineNode {
   }
 
  private:
-  // implement lowered func
-  CCacheValue LowerInternal(const CCacheKey& key)  {
-    std::lock_guard<std::mutex> lock(mutex_);
+  /*! \brief A function lowered by one call of LowerBatch. */
+  struct LowerTask {
+    CCacheKey key;
     CCacheValue value;
-    auto it = cache_.find(key);
-    if (it != cache_.end()) {
-      it->second->use_count += 1;
-      if (it->second->cached_func.defined()) return it->second;
-      value = it->second;
-    } else {
-      value = CCacheValue(make_object<CCacheValueNode>());
-      value->use_count = 0;
-      cache_[key] = value;
+    /*! \brief Fulfilled once value is published or the lowering failed. */
+    std::promise<void> done;
+    Schedule schedule;
+    ObjectPtr<CachedFuncNode> cache_node;
+    /*! \brief Whether the schedule still has to be lowered. */
+    bool need_lower{false};
+    /*! \brief The disk cache of the function, nullptr when it is not cached. */
+    DiskCompileCache* disk{nullptr};
+    /*! \brief The build config and python state the disk cache keys depend on. */
+    const std::string* context{nullptr};
+    std::string key_text;
+    /*! \brief The name of the function, before and after it is made unique. */
+    std::string base_name;
+    std::string name;
+    /*! \brief Whether cache_node was loaded from the disk cache. */
+    bool from_disk{false};
+    std::exception_ptr error;
+  };
+
+  // implement lowered func
+  CCacheValue LowerInternal(const CCacheKey& key) {
+    return LowerBatch({key}, false, 1, true)[0];
+  }
+  // implement lowered shape func
+  CCacheValue LowerShapeFuncInternal(const CCacheKey& key) {
+    return LowerBatch({key}, true, 1, true)[0];
+  }
+  /*!
+   * \brief Lower the keys missing from the cache on up to num_threads threads.
+   *  A key being lowered by another caller is waited for, not lowered twice.
+   * \param keys The keys to lower.
+   * \param shape_func Whether to lower the shape functions of the keys.
+   * \param num_threads The maximum number of threads, including the calling one.
+   * \param count_use Whether the keys found in the cache count as uses of them.
+   * \return The cache values of the keys.
+   */
+  std::vector<CCacheValue> LowerBatch(const Array<CCacheKey>& keys,
+                                      bool shape_func,
+                                      int num_threads,
+                                      bool count_use) {
+    auto* cache = shape_func ? &shape_func_cache_ : &cache_;
+    std::vector<CCacheValue> values;
+    std::vector<LowerTask> tasks;
+    std::vector<std::shared_future<void>> pending;
+    std::shared_ptr<DiskCompileCache> disk;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      disk = disk_cache_;
+      for (const CCacheKey& key : keys) {
+        auto it = cache->find(key);
+        if (it != cache->end()) {
+          if (count_use) it->second->use_count += 1;
+          if (!it->second->cached_func.defined()) pending.push_back(it->second->ready);
+          values.push_back(it->second);
+          continue;
+        }
+        LowerTask task;
+        task.key = key;
+        task.value = CCacheValue(make_object<CCacheValueNode>());
+        task.value->ready = task.done.get_future().share();
+        (*cache)[key] = task.value;
+        values.push_back(task.value);
+        tasks.push_back(std::move(task));
+      }
+    }
+    // The worker threads see the scopes of the caller.
+    BuildConfig build_config = BuildConfig::Current();
+    transform::PassContext pass_ctx = transform::PassContext::Current();
+    std::string context;
+    if (disk != nullptr && !tasks.empty() && DiskCacheContext(build_config, &context)) {
+      for (LowerTask& task : tasks) {
+        if (!shape_func && !NeedLower(task.key->source_func)) continue;
+        task.disk = disk.get();
+        task.context = &context;
+      }
+    }
+    auto run = [&](LowerTask* task, void (*step)(LowerTask*, bool)) {
+      if (task->error) return;
+      try {
+        With<BuildConfig> build_scope(build_config);
+        With<transform::PassContext> pass_scope(pass_ctx);
+        With<Target> target_scope(task->key->target);
+        step(task, shape_func);
+      } catch (...) {
+        task->error = std::current_exception();
+      }
+    };
+    common::ParallelFor(tasks.size(), num_threads, [&](size_t i) {
+      run(&tasks[i], LoadTaskOrSchedule);
+    });
+    {
+      // Named in the order of the keys, so that the names do not depend
+      // on the scheduling of the threads.
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (LowerTask& task : tasks) {
+        if (task.error || !(task.need_lower || task.from_disk)) continue;
+        task.name = GetUniqueName(task.base_name);
+        if (task.from_disk && task.name != task.cache_node->func_name) {
+          // Cached under another name, lower it again under this one.
+          task.from_disk = false;
+          task.cache_node = nullptr;
+        }
+        if (task.disk != nullptr) task.disk->RecordLookup(task.from_disk);
+      }
+    }
+    common::ParallelFor(tasks.size(), num_threads, [&](size_t i) {
+      run(&tasks[i], LowerTaskSchedule);
+    });
+    std::exception_ptr error;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (LowerTask& task : tasks) {
+        if (task.error) {
+          auto it = cache->find(task.key);
+          if (it != cache->end() && it->second.same_as(task.value)) cache->erase(it);
+          task.done.set_exception(task.error);
+          if (!error) error = task.error;
+        } else {
+          task.value->cached_func = CachedFunc(task.cache_node);
+          task.done.set_value();
+        }
+      }
+    }
+    if (error) std::rethrow_exception(error);
+    for (const auto& ready : pending) ready.get();
+    return values;
+  }
+  /*!
+   * \brief Get the part of the disk cache keys common to a batch.
+   * \param build_config The build config of the batch.
+   * \param context The context.
+   * \return Whether the functions of the batch can be cached.
+   */
+  static bool DiskCacheContext(const BuildConfig& build_config, std::string* context) {
+    // Custom lowering passes cannot be part of the keys.
+    if (!build_config->add_lower_pass.empty()) return false;
+    std::ostringstream os;
+    os << build_config;
+    if (const auto* f = runtime::Registry::Get("relay.backend.compile_cache_context")) {
+      TVMRetValue rv = (*f)();
+      if (rv.type_code() == kNull) return false;
+      os << "\n" << rv.operator std::string();
+    }
+    *context = os.str();
+    return true;
+  }
+  /*! \brief Whether a primitive function is lowered, rather than left to external codegen. */
+  static bool NeedLower(const Function& source_func) {
+    if (!source_func->UseDefaultCompiler()) return false;
+    const CallNode* call_node = source_func->body.as<CallNode>();
+    return call_node == nullptr || call_node->attrs.as<DeviceCopyAttrs>() == nullptr;
+  }
+  /*! \brief Load the function of a task from the disk cache, or create its schedule. */
+  static void LoadTaskOrSchedule(LowerTask* task, bool shape_func) {
+    if (task->disk != nullptr) {
+      task->key_text = DiskCompileCache::KeyText(task->key, shape_func, *task->context);
+      CachedFunc func = task->disk->Get(task->key_text, &task->base_name);
+      if (func.defined()) {
+        task->cache_node = make_object<CachedFuncNode>(*(func.operator->()));
+        task->cache_node->target = task->key->target;
+        task->from_disk = true;
+        return;
+      }
+    }
+    CreateTaskSchedule(task, shape_func);
+  }
+  /*! \brief Create the schedule of a task, or its result if it needs no lowering. */
+  static void CreateTaskSchedule(LowerTask* task, bool shape_func) {
+    const Function& source_func = task->key->source_func;
+    if (shape_func) {
+      auto spair = MakeShapeFunc().Create(source_func);
+      task->schedule = spair.first;
+      task->cache_node = make_object<CachedFuncNode>(*(spair.second.operator->()));
+      task->cache_node->target = task->key->target;
+      task->base_name = task->cache_node->func_name;
+      task->need_lower = true;
+      return;
     }
     // No need to lower external functions for now. We will invoke the external
     // codegen tool once and lower all functions together.
-    if (!key->source_func->UseDefaultCompiler()) {
-      auto cache_node = make_object<CachedFuncNode>();
+    if (!source_func->UseDefaultCompiler()) {
+      task->cache_node = make_object<CachedFuncNode>();
       const auto name_node =
-          FunctionGetAttr(key->source_func, attr::kExternalSymbol).as<tvm::ir::StringImmNode>();
+          FunctionGetAttr(source_func, attr::kExternalSymbol).as<tvm::ir::StringImmNode>();
       CHECK(name_node != nullptr) << "External function has not been attached a name yet.";
-      cache_node->func_name = name_node->value;
-      cache_node->target = tvm::target::ext_dev();
-      value->cached_func = CachedFunc(cache_node);
-      return value;
+      task->cache_node->func_name = name_node->value;
+      task->cache_node->target = tvm::target::ext_dev();
+      return;
     }
-    // Enforce use the target.
-    With<Target> target_scope(key->target);
-
-    CHECK(!value->cached_func.defined());
-    auto spair = CreateSchedule(key->source_func, key->target);
-    auto cache_node = make_object<CachedFuncNode>(
-        *(spair.second.operator->()));
-
+    auto spair = ScheduleGetter(task->key->target).Create(source_func);
+    task->schedule = spair.first;
+    task->cache_node = make_object<CachedFuncNode>(*(spair.second.operator->()));
     // Skip lowering for device copy node.
-    const Expr body = (key->source_func)->body;
-    if (const CallNode* call_node = body.as<CallNode>()) {
-      if (call_node->attrs.as<DeviceCopyAttrs>()) {
-        value->cached_func = CachedFunc(cache_node);
-        return value;
-      }
-    }
-
-    cache_node->func_name = GetUniqueName(cache_node->func_name);
+    if (!NeedLower(source_func)) return;
+    task->base_name = task->cache_node->func_name;
+    task->need_lower = true;
+  }
+  /*! \brief Lower the schedule of a task, once it is named. */
+  static void LowerTaskSchedule(LowerTask* task, bool shape_func) {
+    if (task->from_disk) return;
+    if (task->cache_node == nullptr) CreateTaskSchedule(task, shape_func);
+    if (!task->need_lower) return;
+    CachedFuncNode* cache_node = task->cache_node.get();
+    cache_node->func_name = task->name;
     // NOTE: array will copy on write.
     Array<Tensor> all_args = cache_node->inputs;
     for (Tensor arg : cache_node->outputs) {
       all_args.push_back(arg);
     }
-    // lower the function
-    if (const auto* f = runtime::Registry::Get("relay.backend.lower")) {
+    const auto* f = runtime::Registry::Get("relay.backend.lower");
+    if (!shape_func && f != nullptr) {
       cache_node->funcs = (*f)(
-          spair.first, all_args, cache_node->func_name, key->source_func);
+          task->schedule, all_args, cache_node->func_name, task->key->source_func);
     } else {
       tvm::BuildConfig bcfg = BuildConfig::Create();
       std::unordered_map<Tensor, Buffer> binds;
-      cache_node->funcs = tvm::lower(spair.first, all_args, cache_node->func_name, binds, bcfg);
-    }
-    value->cached_func = CachedFunc(cache_node);
-    return value;
-  }
-  // implement lowered shape func
-  CCacheValue LowerShapeFuncInternal(const CCacheKey& key) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    CCacheValue value;
-    auto it = shape_func_cache_.find(key);
-    if (it != shape_func_cache_.end()) {
-      it->second->use_count += 1;
-      if (it->second->cached_func.defined()) return it->second;
-      value = it->second;
-    } else {
-      value = CCacheValue(make_object<CCacheValueNode>());
-      value->use_count = 0;
-      shape_func_cache_[key] = value;
+      cache_node->funcs = tvm::lower(task->schedule, all_args, cache_node->func_name, binds, bcfg);
     }
-    // Enforce use the target.
-    With<Target> target_scope(key->target);
-
-    CHECK(!value->cached_func.defined());
-    auto spair = MakeShapeFunc().Create(key->source_func);
-    auto cache_node = make_object<CachedFuncNode>(
-            *(spair.second.operator->()));
-    cache_node->func_name = GetUniqueName(cache_node->func_name);
-    cache_node->target = key->target;
-
-    Array<Tensor> all_args = cache_node->inputs;
-    for (Tensor arg : cache_node->outputs) {
-      all_args.push_back(arg);
+    if (task->disk != nullptr) {
+      task->disk->Put(task->key_text, task->base_name, CachedFunc(task->cache_node));
     }
-    tvm::BuildConfig bcfg = BuildConfig::Create();
-    std::unordered_map<Tensor, Buffer> binds;
-    cache_node->funcs = tvm::lower(spair.first, all_args, cache_node->func_name, binds, bcfg);
-    value->cached_func = CachedFunc(cache_node);
-    return value;
+  }
+  /*! \brief The number of threads of LowerParallel, from TVM_LOWER_THREADS. */
+  static int LowerThreads() {
+    const char* val = getenv("TVM_LOWER_THREADS");
+    if (val != nullptr) return std::max(std::atoi(val), 1);
+    return runtime::threading::MaxConcurrency();
   }
   /*!
    * \brief Get unique name from name.
@@ -798,6 +964,8 @@ class CompileEngineImpl : public CompileEngineNode {
   }
   /*! \brief compiler cache lock*/
   std::mutex mutex_;
+  /*! \brief The on-disk cache, nullptr when disabled. */
+  std::shared_ptr<DiskCompileCache> disk_cache_{DiskCompileCache::FromEnv()};
   /*! \brief internal name map to get an unique name */
   std::unordered_map<std::string, int> name_map_;
   /*! \brief internal compiler cache */
@@ -834,6 +1002,12 @@ TVM_REGISTER_GLOBAL("relay.backend._CompileEngineLower")
   return self->Lower(key);
 });
 
+TVM_REGISTER_GLOBAL("relay.backend._CompileEngineLowerParallel")
+.set_body_typed(
+    [](CompileEngine self, Array<CCacheKey> keys) {
+  return self->LowerParallel(keys);
+});
+
 TVM_REGISTER_GLOBAL("relay.backend._CompileEngineLowerShapeFunc")
 .set_body_typed(
     [](CompileEngine self, CCacheKey key) {
@@ -851,6 +1025,18 @@ TVM_REGISTER_GLOBAL("relay.backend._CompileEngineJIT")
   return self->JIT(key);
 });
 
+TVM_REGISTER_GLOBAL("relay.backend._CompileEngineSetDiskCache")
+.set_body_typed(
+    [](CompileEngine self, std::string dir, int64_t max_bytes) {
+  static_cast<CompileEngineImpl*>(self.operator->())->SetDiskCache(dir, max_bytes);
+});
+
+TVM_REGISTER_GLOBAL("relay.backend._CompileEngineDiskCacheStats")
+.set_body_typed(
+    [](CompileEngine self) {
+  return static_cast<CompileEngineImpl*>(self.operator->())->DiskCacheStats();
+});
+
 TVM_REGISTER_GLOBAL("relay.backend._CompileEngineListItems")
 .set_body_typed(
     [](CompileEngine self){
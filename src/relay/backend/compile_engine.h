@@ -32,6 +32,7 @@
 #include <tvm/relay/transform.h>
 #include <string>
 #include <functional>
+#include <future>
 
 namespace tvm {
 namespace relay {
@@ -142,6 +143,11 @@ class CCacheValueNode : public Object {
   PackedFunc packed_func;
   /*! \brief usage statistics */
   int use_count{0};
+  /*!
+   * \brief Ready once the function is lowered, for the callers waiting
+   *  on a lowering in progress on another thread.
+   */
+  std::shared_future<void> ready;
 
   void VisitAttrs(tvm::AttrVisitor* v) {
     v->Visit("cached_func", &cached_func);
@@ -177,6 +183,14 @@ class CompileEngineNode : public Object {
    * \return The result.
    */
   virtual CachedFunc Lower(const CCacheKey& key) = 0;
+  /*!
+   * \brief Get the lowered results of independent keys, lowering the
+   *  missing ones concurrently. This only warms the cache, it does not
+   *  count as a use of the functions.
+   * \param keys The keys to the cached functions.
+   * \return The results, in the order of the keys.
+   */
+  virtual Array<CachedFunc> LowerParallel(const Array<CCacheKey>& keys) = 0;
   /*!
    * \brief Just in time compile to get a PackedFunc.
    * \param key The key to the cached function.
@@ -207,6 +207,7 @@ class GraphRuntimeCodegen
       auto node_ptr = GraphInputNode::make_node_ptr(param->name_hint(), GraphAttrs());
       var_map_[param.get()] = AddNode(node_ptr, param);
     }
+    LowerPrimitives(func);
     heads_ = VisitExpr(func->body);
     std::ostringstream os;
     dmlc::JSONWriter writer(&os);
@@ -402,6 +403,57 @@ class GraphRuntimeCodegen
     return AddNode(node, GetRef<Expr>(op));
   }
 
+  /*!
+   * \brief Get the target of a call to a primitive function.
+   * \param op The call.
+   * \return The target.
+   */
+  Target CallTarget(const CallNode* op) {
+    const FunctionNode* func = op->op.as<FunctionNode>();
+    if (func != nullptr && !func->UseDefaultCompiler()) {
+      return tvm::target::ext_dev();
+    }
+    if (targets_.size() == 1) {
+      // homogeneous execution.
+      return (*targets_.begin()).second;
+    }
+    // heterogeneous execution.
+    Expr expr = GetRef<Expr>(op);
+    CHECK_GE(storage_device_map_.count(expr), 0);
+    auto &device_type = storage_device_map_[expr][1];
+    auto call_dev_type = device_type[0]->value;
+    std::string call_dev_name;
+    if (call_dev_type == 0) {
+      call_dev_name = "llvm";
+    } else {
+      call_dev_name = runtime::DeviceName(call_dev_type);
+    }
+    if (targets_.count(call_dev_type) == 0) {
+      LOG(FATAL) << "No target is provided for device "
+                 << call_dev_name;
+    }
+    return targets_[call_dev_type];
+  }
+
+  /*!
+   * \brief Lower all the primitive functions called in func concurrently,
+   *  ahead of the visit, which then finds them in the compile engine cache.
+   * \param func The function to generate code for.
+   */
+  void LowerPrimitives(const Function& func) {
+    Array<CCacheKey> keys;
+    PostOrderVisit(func->body, [&](const Expr& expr) {
+      const CallNode* call = expr.as<CallNode>();
+      if (call == nullptr) return;
+      const FunctionNode* callee = call->op.as<FunctionNode>();
+      if (callee == nullptr || !callee->IsPrimitive()) return;
+      keys.push_back(CCacheKeyNode::make(GetRef<Function>(callee), CallTarget(call)));
+    });
+    if (keys.size() > 1) {
+      compile_engine_->LowerParallel(keys);
+    }
+  }
+
   std::vector<GraphNodeRef> VisitExpr_(const CallNode* op) override {
     Expr expr = GetRef<Expr>(op);
     Function func;
@@ -422,38 +474,15 @@ class GraphRuntimeCodegen
 
     auto pf0 = GetPackedFunc("relay.backend._make_CCacheKey");
     auto pf1 = GetPackedFunc("relay.backend._CompileEngineLower");
-    Target target;
+    Target target = CallTarget(op);
     // Handle external function
     if (!func->UseDefaultCompiler()) {
-      target = tvm::target::ext_dev();
       CCacheKey key = (*pf0)(func, target);
       CachedFunc ext_func = (*pf1)(compile_engine_, key);
       CHECK(ext_func.defined()) << "External function is not defined.";
       return GraphAddCallNode(op, ext_func->func_name, ext_func->func_name);
     }
 
-    CHECK_GE(storage_device_map_.count(expr), 0);
-    auto &device_type = storage_device_map_[expr][1];
-    auto call_dev_type = device_type[0]->value;
-    // Normal Relay Function
-    if (targets_.size() == 1) {
-       // homogeneous execution.
-      const auto& it = targets_.begin();
-      target = (*it).second;
-    } else {
-      // heterogeneous execution.
-      std::string call_dev_name;
-      if (call_dev_type == 0) {
-        call_dev_name = "llvm";
-      } else {
-        call_dev_name = runtime::DeviceName(call_dev_type);
-      }
-      if (targets_.count(call_dev_type) == 0) {
-        LOG(FATAL) << "No target is provided for device "
-                   << call_dev_name;
-      }
-      target = targets_[call_dev_type];
-    }
     CCacheKey key = (*pf0)(func, target);
     CachedFunc lowered_func = (*pf1)(compile_engine_, key);
     if (!lowered_funcs_.count(target->str())) {
@@ -38,37 +38,52 @@ namespace relay {
 
 using namespace runtime;
 
-TVM_REGISTER_GLOBAL("tvm.relay._save_param_dict")
-.set_body([](TVMArgs args, TVMRetValue *rv) {
-    CHECK_EQ(args.size() % 2, 0u);
-    // `args` is in the form "key, value, key, value, ..."
-    size_t num_params = args.size() / 2;
-    std::vector<std::string> names;
-    names.reserve(num_params);
-    std::vector<DLTensor*> arrays;
-    arrays.reserve(num_params);
-    for (size_t i = 0; i < num_params * 2; i += 2) {
-      names.emplace_back(args[i].operator std::string());
-      arrays.emplace_back(args[i + 1].operator DLTensor*());
-    }
-    std::string bytes;
-    dmlc::MemoryStringStream strm(&bytes);
-    dmlc::Stream* fo = &strm;
-    uint64_t header = kTVMNDArrayListMagic, reserved = 0;
-    fo->Write(header);
-    fo->Write(reserved);
-    fo->Write(names);
-    {
-      uint64_t sz = static_cast<uint64_t>(arrays.size());
-      fo->Write(sz);
-      for (size_t i = 0; i < sz; ++i) {
+// Save the parameters in the arguments "key, value, key, value, ...",
+// optionally with their data aligned for mapping the file in place.
+void SaveParamDict(TVMArgs args, TVMRetValue* rv, bool aligned) {
+  CHECK_EQ(args.size() % 2, 0u);
+  // `args` is in the form "key, value, key, value, ..."
+  size_t num_params = args.size() / 2;
+  std::vector<std::string> names;
+  names.reserve(num_params);
+  std::vector<DLTensor*> arrays;
+  arrays.reserve(num_params);
+  for (size_t i = 0; i < num_params * 2; i += 2) {
+    names.emplace_back(args[i].operator std::string());
+    arrays.emplace_back(args[i + 1].operator DLTensor*());
+  }
+  std::string bytes;
+  dmlc::MemoryStringStream strm(&bytes);
+  dmlc::Stream* fo = &strm;
+  uint64_t header = kTVMNDArrayListMagic, reserved = 0;
+  fo->Write(header);
+  fo->Write(reserved);
+  fo->Write(names);
+  {
+    uint64_t sz = static_cast<uint64_t>(arrays.size());
+    fo->Write(sz);
+    for (size_t i = 0; i < sz; ++i) {
+      if (aligned) {
+        tvm::runtime::SaveDLTensorAligned(&strm, arrays[i]);
+      } else {
         tvm::runtime::SaveDLTensor(fo, arrays[i]);
       }
     }
-    TVMByteArray arr;
-    arr.data = bytes.c_str();
-    arr.size = bytes.length();
-    *rv = arr;
+  }
+  TVMByteArray arr;
+  arr.data = bytes.c_str();
+  arr.size = bytes.length();
+  *rv = arr;
+}
+
+TVM_REGISTER_GLOBAL("tvm.relay._save_param_dict")
+.set_body([](TVMArgs args, TVMRetValue *rv) {
+    SaveParamDict(args, rv, false);
+  });
+
+TVM_REGISTER_GLOBAL("tvm.relay._save_param_dict_aligned")
+.set_body([](TVMArgs args, TVMRetValue *rv) {
+    SaveParamDict(args, rv, true);
   });
 
 TVM_REGISTER_GLOBAL("tvm.relay._load_param_dict")
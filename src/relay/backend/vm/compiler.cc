@@ -30,9 +30,11 @@
 #include <tvm/logging.h>
 #include <tvm/relay/transform.h>
 #include <tvm/runtime/vm.h>
+#include <tvm/relay/attrs/device_copy.h>
 #include <tvm/relay/attrs/memory.h>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <string>
 #include <tuple>
 #include <unordered_map>
@@ -52,11 +54,7 @@ Pass LambdaLift();
 Pass InlinePrimitives();
 Pass RemoveUnusedFunctions(Array<tvm::PrimExpr> entry_functions);
 
-Pass ManifestAlloc(Target target_host) {
-  auto f = tvm::runtime::Registry::Get("relay.transform.ManifestAlloc");
-  CHECK(f != nullptr) << "could not load memory allocation pass";
-  return (*f)(target_host);
-}
+Pass ManifestAlloc(Target target_host, int default_device);
 
 }  // namespace transform
 
@@ -226,15 +224,46 @@ std::vector<int64_t> ToAllocTensorShape32(NDArray shape) {
   return raw_shape;
 }
 
+// Whether a type is a few integers, such as a shape, or a tuple of them.
+bool IsShapeLike(const Type& type) {
+  if (const auto* tuple_type = type.as<TupleTypeNode>()) {
+    for (const auto& field : tuple_type->fields) {
+      if (!IsShapeLike(field)) return false;
+    }
+    return true;
+  }
+  const auto* tensor_type = type.as<TensorTypeNode>();
+  if (tensor_type == nullptr || !(tensor_type->dtype.is_int() || tensor_type->dtype.is_uint()) ||
+      tensor_type->shape.size() > 1) {
+    return false;
+  }
+  for (const auto& dim : tensor_type->shape) {
+    const auto* imm = dim.as<IntImmNode>();
+    if (imm == nullptr || imm->value > 16) return false;
+  }
+  return true;
+}
+
+// Whether a primitive function only computes on shapes, so its outputs only
+// depend on the values of a few integers.
+bool IsShapeArithmetic(const Function& func) {
+  for (const auto& param : func->params) {
+    if (!IsShapeLike(param->checked_type())) return false;
+  }
+  return IsShapeLike(func->body->checked_type());
+}
+
 class VMFunctionCompiler : ExprFunctor<void(const Expr& expr)> {
  public:
-  VMFunctionCompiler(VMCompilerContext* context, TargetsMap targets, Target target_host)
+  VMFunctionCompiler(VMCompilerContext* context, TargetsMap targets, Target target_host,
+                     int default_device)
       : last_register_(0),
         registers_num_(0),
         engine_(CompileEngine::Global()),
         context_(context),
         targets_(targets),
-        target_host_(target_host) {}
+        target_host_(target_host),
+        default_device_(default_device) {}
 
   VMFunction Compile(const GlobalVar& var, const Function& func) {
     size_t i = 0;
@@ -261,12 +290,20 @@ class VMFunctionCompiler : ExprFunctor<void(const Expr& expr)> {
       this->VisitExpr(func->body);
     }
     instructions_.push_back(Instruction::Ret(last_register_));
-    return VMFunction(var->name_hint, params_, instructions_, registers_num_);
+    std::vector<Index> params_device_type(params_.size(), default_device_);
+    return VMFunction(var->name_hint, params_, instructions_, registers_num_,
+                      params_device_type);
   }
 
  protected:
   size_t NewRegister() { return registers_num_++; }
 
+  // The device type of the tensors in a register, known for the allocations.
+  Index DeviceOf(RegName reg) const {
+    auto it = register_device_.find(reg);
+    return it == register_device_.end() ? default_device_ : it->second;
+  }
+
   inline void Emit(const Instruction& instr) {
     DLOG(INFO) << "VMCompiler::Emit: instr=" << instr;
     CHECK((int)instr.op < 100) << "Invalid opcode " << (int)instr.op;
@@ -283,6 +320,7 @@ class VMFunctionCompiler : ExprFunctor<void(const Expr& expr)> {
       case Opcode::AllocStorage:
       case Opcode::Move:
       case Opcode::InvokeClosure:
+      case Opcode::DeviceCopy:
         last_register_ = instr.dst;
         break;
       case Opcode::InvokePacked:
@@ -291,6 +329,12 @@ class VMFunctionCompiler : ExprFunctor<void(const Expr& expr)> {
       case Opcode::Goto:
       case Opcode::Fatal:
         break;
+      case Opcode::IfConst:
+      case Opcode::IfTag:
+      case Opcode::AllocStorageConst:
+      case Opcode::AllocStorageTensor:
+        LOG(FATAL) << "superinstructions are only formed by the VM";
+        break;
     }
     instructions_.push_back(instr);
   }
@@ -298,7 +342,7 @@ class VMFunctionCompiler : ExprFunctor<void(const Expr& expr)> {
   void VisitExpr_(const ConstantNode* const_node) {
     size_t konst_idx = context_->constants.size();
     context_->constants.push_back(const_node->data);
-    Emit(Instruction::LoadConst(konst_idx, NewRegister()));
+    Emit(Instruction::LoadConst(konst_idx, NewRegister(), default_device_));
   }
 
   void VisitExpr_(const VarNode* var_node) {
@@ -412,6 +456,7 @@ class VMFunctionCompiler : ExprFunctor<void(const Expr& expr)> {
     } else {
       op_index = context_->seen_funcs[cfunc->funcs[0]];
     }
+    context_->shape_funcs.insert(op_index);
 
     // Prepare input and output registers
     std::vector<Index> argument_registers;
@@ -478,8 +523,16 @@ class VMFunctionCompiler : ExprFunctor<void(const Expr& expr)> {
         const auto& it = targets_.begin();
         target = (*it).second;
       } else {
-        // heterogeneous execution.
-        LOG(FATAL) << "Currently VM compiler doesn't support heterogeneous compilation";
+        // heterogeneous execution, the kernel runs on the device of its outputs.
+        Index device_type = default_device_;
+        if (!output_tuple->fields.empty()) {
+          auto it = register_device_.find(argument_registers[input_tuple->fields.size()]);
+          if (it != register_device_.end() && it->second >= 0) device_type = it->second;
+        }
+        auto it = targets_.find(Integer(static_cast<int>(device_type)));
+        CHECK(it != targets_.end())
+            << "no target for the device type " << device_type;
+        target = (*it).second;
       }
     }
 
@@ -500,6 +553,11 @@ class VMFunctionCompiler : ExprFunctor<void(const Expr& expr)> {
       } else {
         op_index = context_->seen_funcs[cfunc->funcs[0]];
       }
+      // the arithmetic on shapes, such as the sizes of the storages, is cached like
+      // the shape functions.
+      if (IsShapeArithmetic(func)) {
+        context_->shape_funcs.insert(op_index);
+      }
     }
 
     Emit(Instruction::InvokePacked(op_index,
@@ -551,8 +609,12 @@ class VMFunctionCompiler : ExprFunctor<void(const Expr& expr)> {
             }
 
             // Add context field.
-            Emit(Instruction::AllocTensor(storage_register, raw_shape, dtype, NewRegister()));
+            Emit(Instruction::AllocTensor(storage_register, alloc_attrs->offset,
+                                          raw_shape, dtype, NewRegister()));
+            register_device_[last_register_] = DeviceOf(storage_register);
           } else {
+            CHECK_EQ(alloc_attrs->offset, 0)
+                << "a tensor of a dynamic shape must be at the beginning of its storage";
             this->VisitExpr(args[1]);
             auto shape_register = last_register_;
             Emit(Instruction::AllocTensorReg(
@@ -560,6 +622,7 @@ class VMFunctionCompiler : ExprFunctor<void(const Expr& expr)> {
               shape_register,
               dtype,
               NewRegister()));
+            register_device_[last_register_] = DeviceOf(storage_register);
           }
       }).Match("memory.alloc_storage",
         [this](const Array<Expr>& args, const Attrs& attrs, const Array<Type>& type_arg) {
@@ -571,13 +634,26 @@ class VMFunctionCompiler : ExprFunctor<void(const Expr& expr)> {
           this->VisitExpr(args[1]);
           auto alignment_register = last_register_;
 
-          // Get the dtype hint from the attributes.
-          auto alloc_attrs = attrs.as<AllocTensorAttrs>();
+          // Get the dtype hint and the device from the attributes.
+          auto alloc_attrs = attrs.as<AllocStorageAttrs>();
           CHECK(alloc_attrs != nullptr)
-              << "must be the alloc tensor attrs";
+              << "must be the alloc storage attrs";
           auto dtype = alloc_attrs->dtype;
 
-          Emit(Instruction::AllocStorage(size_register, alignment_register, dtype, NewRegister()));
+          Emit(Instruction::AllocStorage(size_register, alignment_register, dtype, NewRegister(),
+                                         alloc_attrs->device_type, alloc_attrs->device_id));
+          register_device_[last_register_] = alloc_attrs->device_type;
+      }).Match("device_copy",
+        [this](const Array<Expr>& args, const Attrs& attrs, const Array<Type>& type_arg) {
+          CHECK_EQ(args.size(), 1);
+          this->VisitExpr(args[0]);
+          auto src_register = last_register_;
+
+          auto copy_attrs = attrs.as<DeviceCopyAttrs>();
+          CHECK(copy_attrs != nullptr)
+              << "must be the device copy attrs";
+          Emit(Instruction::DeviceCopy(src_register, copy_attrs->dst_dev_type, 0, NewRegister()));
+          register_device_[last_register_] = copy_attrs->dst_dev_type;
       }).Match("memory.shape_func",
         [this](const Array<Expr>& args, const Attrs& attrs, const Array<Type>& type_arg) {
           CHECK_EQ(args.size(), 3);
@@ -744,6 +820,10 @@ class VMFunctionCompiler : ExprFunctor<void(const Expr& expr)> {
   TargetsMap targets_;
   /*! \brief Host target. */
   Target target_host_;
+  /*! \brief The device type of the values not placed on another device. */
+  Index default_device_;
+  /*! \brief The device type of the registers holding storages and tensors. */
+  std::unordered_map<RegName, Index> register_device_;
 };
 
 
@@ -764,6 +844,16 @@ PackedFunc VMCompiler::GetFunction(const std::string& name,
     return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
       *rv = runtime::Module(exec_);
     });
+  } else if (name == "get_memory_plan_stats") {
+    return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+      const MemoryPlanStats& stats = this->memory_plan_stats_;
+      std::ostringstream os;
+      os << "{\"num_storage_before\": " << stats.num_storage_before
+         << ", \"num_storage_after\": " << stats.num_storage_after
+         << ", \"bytes_before\": " << stats.bytes_before
+         << ", \"bytes_after\": " << stats.bytes_after << "}";
+      *rv = os.str();
+    });
   } else if (name == "set_params") {
     return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
       Map<std::string, Constant> params = args[0];
@@ -816,8 +906,7 @@ relay::Function VMCompiler::BindParamsByName(
 void VMCompiler::Lower(Module mod,
                        const TargetsMap& targets,
                        const tvm::Target& target_host) {
-  CHECK_EQ(targets.size(), 1)
-    << "Currently VM compiler doesn't support heterogeneous compilation";
+  CHECK_GE(targets.size(), 1U) << "no target to compile for";
   if (params_.size()) {
     BaseFunc base_func = mod->Lookup("main");
     CHECK(base_func->IsInstance<FunctionNode>())
@@ -830,6 +919,14 @@ void VMCompiler::Lower(Module mod,
   exec_ = make_object<Executable>();
   targets_ = targets;
   target_host_ = target_host;
+  // A homogeneous build runs in the default context of the VM, and a
+  // heterogeneous one places the values not annotated on the fallback device.
+  default_device_ = -1;
+  if (targets.size() > 1) {
+    default_device_ = PassContext::Current()->fallback_device;
+    CHECK(targets.count(Integer(default_device_)))
+        << "no target for the fallback device " << default_device_;
+  }
 
   // Run the optimizations necessary to target the VM.
   context_.module = OptimizeModule(mod, targets_);
@@ -844,11 +941,12 @@ void VMCompiler::Lower(Module mod,
   // the global state.
   exec_->functions.resize(context_.module->functions.size());
 
+  LowerPrimitives();
   for (auto named_func : context_.module->functions) {
     auto gvar = named_func.first;
     if (auto* n = named_func.second.as<FunctionNode>()) {
       auto func = GetRef<Function>(n);
-      VMFunctionCompiler func_compiler(&context_, targets_, target_host_);
+      VMFunctionCompiler func_compiler(&context_, targets_, target_host_, default_device_);
       auto vm_func = func_compiler.Compile(gvar, func);
 
       size_t func_index = context_.global_map.at(gvar);
@@ -882,6 +980,7 @@ void VMCompiler::Lower(Module mod,
       exec_->primitive_map.insert({cfunc->funcs[0]->name, primitive_index++});
     }
   }
+  exec_->shape_funcs.assign(context_.shape_funcs.begin(), context_.shape_funcs.end());
 }
 
 Module VMCompiler::OptimizeModule(const Module& mod, const TargetsMap& targets) {
@@ -932,19 +1031,33 @@ Module VMCompiler::OptimizeModule(const Module& mod, const TargetsMap& targets)
 
   pass_seqs.push_back(transform::FoldConstant());
 
+  // Place the operators on their annotated devices, with copies between them.
+  if (targets.size() > 1) {
+    pass_seqs.push_back(transform::RewriteAnnotatedOps(default_device_));
+  }
+
   pass_seqs.push_back(transform::FuseOps());
   pass_seqs.push_back(transform::ToANormalForm());
   pass_seqs.push_back(transform::LambdaLift());
   pass_seqs.push_back(transform::InlinePrimitives());
 
   // Manifest the allocations.
-  pass_seqs.push_back(transform::ManifestAlloc(this->target_host_));
+  pass_seqs.push_back(transform::ManifestAlloc(this->target_host_, default_device_));
   // Compute away possibly introduced constant computation.
   pass_seqs.push_back(transform::FoldConstant());
   // Fuse the shape functions.
   pass_seqs.push_back(transform::FuseOps());
   // Manifest the allocations needed for the shape functions.
-  pass_seqs.push_back(transform::ManifestAlloc(this->target_host_));
+  pass_seqs.push_back(transform::ManifestAlloc(this->target_host_, default_device_));
+  // Coalesce the static allocations by their lifetime, with the tensors at
+  // offsets of one storage on the devices with flat addresses.
+  bool use_offsets = true;
+  for (const auto& kv : targets) {
+    int device_type = kv.first->value;
+    use_offsets &= device_type == kDLCPU || device_type == kDLGPU || device_type == kDLROCM;
+  }
+  memory_plan_stats_ = MemoryPlanStats();
+  pass_seqs.push_back(transform::MemoryPlan(use_offsets, &memory_plan_stats_));
 
   transform::Sequential seq(pass_seqs);
   transform::PassContext pass_ctx = PassContext::Current();
@@ -967,6 +1080,28 @@ void VMCompiler::PopulateGlobalMap() {
   }
 }
 
+void VMCompiler::LowerPrimitives() {
+  // The targets of heterogeneous kernels are only known while compiling them.
+  if (targets_.size() != 1) return;
+  static const Op& invoke_tvm_op = Op::Get("memory.invoke_tvm_op");
+  Target target = (*targets_.begin()).second;
+  Array<CCacheKey> keys;
+  for (auto named_func : context_.module->functions) {
+    PostOrderVisit(named_func.second, [&](const Expr& expr) {
+      const CallNode* call = expr.as<CallNode>();
+      if (call == nullptr || !call->op.same_as(invoke_tvm_op)) return;
+      const FunctionNode* func = call->args[0].as<FunctionNode>();
+      if (func == nullptr) return;
+      keys.push_back(CCacheKeyNode::make(
+          GetRef<Function>(func), func->UseDefaultCompiler() ? target : tvm::target::ext_dev()));
+    });
+  }
+  if (keys.size() > 1) {
+    CompileEngine engine = CompileEngine::Global();
+    engine->LowerParallel(keys);
+  }
+}
+
 void VMCompiler::Codegen() {
   if (!context_.module.defined()) {
     LOG(WARNING) << "Did you forget to call VMCompiler::Lower?";
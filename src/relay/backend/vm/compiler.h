@@ -33,6 +33,7 @@
 #include <tvm/runtime/vm.h>
 #include <iostream>
 #include <memory>
+#include <set>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -60,6 +61,18 @@ using ConstMap = NodeMap<Constant, Index>;
 using ConstTensorShapeMap = NodeMap<TensorType, std::pair<Index, NDArray>>;
 using TargetsMap = Map<tvm::Integer, tvm::Target>;
 
+/*! \brief The storage of the static allocations before and after planning. */
+struct MemoryPlanStats {
+  /*! \brief The number of storages planned. */
+  int64_t num_storage_before{0};
+  /*! \brief The number of storages they are coalesced into. */
+  int64_t num_storage_after{0};
+  /*! \brief The bytes of the storages planned. */
+  int64_t bytes_before{0};
+  /*! \brief The bytes of the storages they are coalesced into. */
+  int64_t bytes_after{0};
+};
+
 struct VMCompilerContext {
   // The module context for the compilation
   Module module;
@@ -77,6 +90,8 @@ struct VMCompilerContext {
   std::vector<CachedFunc> cached_funcs;
   // The functions that have been lowered.
   std::unordered_map<LoweredFunc, size_t, ObjectHash, ObjectEqual> seen_funcs;
+  // The cached functions computing shapes, whose outputs the VM may reuse.
+  std::set<Index> shape_funcs;
 };
 
 
@@ -129,20 +144,49 @@ class VMCompiler : public runtime::ModuleNode {
 
   void PopulateGlobalMap();
 
+  /*!
+   * \brief Lower the primitive functions invoked in the module concurrently,
+   *  ahead of the compilation of the VM functions.
+   */
+  void LowerPrimitives();
+
  protected:
   /*! \brief Target devices. */
   TargetsMap targets_;
   /*! \brief Target host device. */
   tvm::Target target_host_;
+  /*!
+   * \brief The device type of the values not placed on another device, -1
+   *  for the default context of the VM.
+   */
+  int default_device_{-1};
   /*! \brief Global shared meta data */
   VMCompilerContext context_;
   /*! \brief Compiled executable. */
   ObjectPtr<Executable> exec_;
   /*! \brief parameters */
   std::unordered_map<std::string, runtime::NDArray> params_;
+  /*! \brief The statistics of the memory plan of the last lowering. */
+  MemoryPlanStats memory_plan_stats_;
 };
 
 }  // namespace vm
+
+namespace transform {
+
+/*!
+ * \brief Coalesce the storage of the static allocations of the manifested
+ *  program by the lifetime of the tensors.
+ *
+ * \param use_offsets Whether the tensors of a scope are placed at offsets
+ *  of one storage, which needs a device with flat addresses.
+ * \param stats The statistics to accumulate into, may be nullptr.
+ *
+ * \return The pass.
+ */
+Pass MemoryPlan(bool use_offsets, vm::MemoryPlanStats* stats);
+
+}  // namespace transform
 }  // namespace relay
 }  // namespace tvm
 
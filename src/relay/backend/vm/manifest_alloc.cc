@@ -0,0 +1,411 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file tvm/relay/backend/vm/manifest_alloc.cc
+ * \brief Manifest the memory allocations of the primitive calls explicitly.
+ */
+
+#include <tvm/relay/attrs/device_copy.h>
+#include <tvm/relay/attrs/memory.h>
+#include <tvm/relay/attrs/transform.h>
+#include <tvm/relay/expr.h>
+#include <tvm/relay/expr_functor.h>
+#include <tvm/relay/module.h>
+#include <tvm/relay/transform.h>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#include "../compile_engine.h"
+#include "../../pass/let_list.h"
+#include "../../pass/pattern_util.h"
+
+namespace tvm {
+namespace relay {
+namespace vm {
+
+// The integer type of the shapes and sizes computed in Relay.
+static const DataType kComputeType = DataType::Int(64);
+
+inline Expr AllocStorage(Expr size, Expr alignment, DataType dtype_hint, int device_type) {
+  auto attrs = make_object<AllocStorageAttrs>();
+  attrs->dtype = dtype_hint;
+  attrs->device_type = device_type;
+  static const Op& op = Op::Get("memory.alloc_storage");
+  return CallNode::make(op, {size, alignment}, Attrs(attrs), {});
+}
+
+inline Expr AllocTensor(Expr storage, Expr shape, DataType dtype, Array<IndexExpr> assert_shape) {
+  auto attrs = make_object<AllocTensorAttrs>();
+  attrs->dtype = dtype;
+  attrs->assert_shape = assert_shape;
+  static const Op& op = Op::Get("memory.alloc_tensor");
+  return CallNode::make(op, {storage, shape}, Attrs(attrs), {});
+}
+
+inline Expr InvokeTVMOp(Expr func, Expr inputs, Expr outputs) {
+  static const Op& op = Op::Get("memory.invoke_tvm_op");
+  return CallNode::make(op, {func, inputs, outputs}, Attrs());
+}
+
+inline Expr ShapeFunc(Expr func, Expr inputs, Expr outputs, Array<Integer> is_input) {
+  auto attrs = make_object<ShapeFuncAttrs>();
+  attrs->is_input = is_input;
+  static const Op& op = Op::Get("memory.shape_func");
+  return CallNode::make(op, {func, inputs, outputs}, Attrs(attrs), {});
+}
+
+inline Expr ShapeOf(Expr data) {
+  auto attrs = make_object<ShapeOfAttrs>();
+  attrs->dtype = kComputeType;
+  static const Op& op = Op::Get("shape_of");
+  return CallNode::make(op, {data}, Attrs(attrs), {});
+}
+
+inline bool IsPrimitive(const CallNode* call) {
+  const auto* func = call->op.as<FunctionNode>();
+  return func != nullptr && func->IsPrimitive();
+}
+
+// The device_copy of a fused primitive function only copying its argument, or nullptr.
+inline const CallNode* GetDeviceCopy(const Function& func) {
+  static const Op& device_copy = Op::Get("device_copy");
+  const auto* call = func->body.as<CallNode>();
+  if (call == nullptr || !call->op.same_as(device_copy) || func->params.size() != 1 ||
+      !call->args[0].same_as(func->params[0])) {
+    return nullptr;
+  }
+  return call;
+}
+
+// The tensor types of a nested tuple type, in a linear order.
+void FlattenTensorTypes(const Type& type, std::vector<TensorType>* out) {
+  if (const auto* tt = type.as<TensorTypeNode>()) {
+    out->push_back(GetRef<TensorType>(tt));
+  } else if (const auto* tuple_type = type.as<TupleTypeNode>()) {
+    for (const auto& field : tuple_type->fields) {
+      FlattenTensorTypes(field, out);
+    }
+  } else {
+    LOG(FATAL) << "unsupported Relay type: " << type;
+  }
+}
+
+// Pack the linear outputs as a value of the nested tuple type.
+Expr PackTensors(const Type& type, const std::vector<Expr>& outs, size_t* index) {
+  if (type.as<TensorTypeNode>()) {
+    return outs[(*index)++];
+  }
+  const auto* tuple_type = type.as<TupleTypeNode>();
+  CHECK(tuple_type != nullptr) << "unsupported Relay type: " << type;
+  Array<Expr> fields;
+  for (const auto& field : tuple_type->fields) {
+    fields.push_back(PackTensors(field, outs, index));
+  }
+  return TupleNode::make(fields);
+}
+
+/*!
+ * \brief Rewrite the calls to primitive functions into the explicit
+ *  allocation of their outputs and the invocation of the function.
+ *
+ *  The outputs of a call with static shapes are allocated directly. For
+ *  dynamic shapes, the shape function of the primitive is invoked first and
+ *  the storage is computed from its results. The program must be in A-normal
+ *  form, the allocations are inserted in the innermost enclosing scope.
+ *
+ *  The outputs are allocated on the device of the call: the destination of
+ *  a device_copy, which stays a call to the operator for the VM to copy,
+ *  or else the device of the first argument placed on a device, as the
+ *  device_copy operators inserted by RewriteAnnotatedOps move the arguments
+ *  of a call to its device.
+ */
+class DialectRewriter : public ExprMutator {
+ public:
+  DialectRewriter(const Target& target_host, int default_device)
+      : target_host_(target_host), default_device_(default_device) {}
+
+  Expr VisitExpr_(const FunctionNode* func_node) final {
+    if (func_node->IsPrimitive()) {
+      return GetRef<Expr>(func_node);
+    }
+    return FunctionNode::make(func_node->params,
+                              VisitScope(func_node->body),
+                              func_node->ret_type,
+                              func_node->type_params,
+                              func_node->attrs);
+  }
+
+  Expr VisitExpr_(const IfNode* if_node) final {
+    return IfNode::make(VisitExpr(if_node->cond),
+                        VisitScope(if_node->true_branch),
+                        VisitScope(if_node->false_branch));
+  }
+
+  Clause VisitClause(const Clause& clause) final {
+    return ClauseNode::make(clause->lhs, VisitScope(clause->rhs));
+  }
+
+  Expr VisitExpr_(const LetNode* let_node) final {
+    return VisitScope(GetRef<Expr>(let_node));
+  }
+
+  Expr VisitExpr_(const TupleNode* tuple_node) final {
+    LetList& scope = scopes_.back();
+    Array<Expr> new_fields;
+    for (const auto& field : tuple_node->fields) {
+      Expr new_field = VisitExpr(field);
+      if (new_field.as<ConstantNode>()) {
+        new_field = scope.Push(new_field);
+      }
+      new_fields.push_back(new_field);
+    }
+    return TupleNode::make(new_fields);
+  }
+
+  Expr VisitExpr_(const CallNode* call_node) final {
+    if (!IsPrimitive(call_node)) {
+      return ExprMutator::VisitExpr_(call_node);
+    }
+    // Because we are in ANF we do not need to visit the arguments.
+    LetList& scope = scopes_.back();
+    Function func = Downcast<Function>(call_node->op);
+    Array<Expr> new_args;
+    for (const auto& arg : call_node->args) {
+      new_args.push_back(VisitExpr(arg));
+    }
+    if (const auto* copy = GetDeviceCopy(func)) {
+      return CallNode::make(copy->op, new_args, copy->attrs, {});
+    }
+    Expr ins = TupleNode::make(new_args);
+    Type ret_type = call_node->checked_type();
+    std::vector<TensorType> out_types;
+    FlattenTensorTypes(ret_type, &out_types);
+    int device = DeviceOf(GetRef<Expr>(call_node));
+
+    if (IsDynamic(ret_type)) {
+      return DynamicInvoke(&scope, func, ins, new_args, out_types, device);
+    }
+    std::vector<Expr> outs;
+    for (size_t i = 0; i < out_types.size(); ++i) {
+      outs.push_back(MakeStaticAllocation(&scope, out_types[i], device));
+    }
+    Expr output = TupleNode::make(outs);
+    scope.Push(InvokeTVMOp(func, ins, output));
+    if (outs.size() == 1) {
+      return outs[0];
+    }
+    size_t index = 0;
+    return PackTensors(ret_type, outs, &index);
+  }
+
+ private:
+  // Visit an expression that owns the allocations made while visiting it.
+  Expr VisitScope(const Expr& expr) {
+    scopes_.emplace_back();
+    Expr body = expr;
+    while (const auto* let_node = body.as<LetNode>()) {
+      Expr new_value = VisitExpr(let_node->value);
+      int device = DeviceOf(let_node->value);
+      if (device != default_device_) var_device_[let_node->var] = device;
+      scopes_.back().Push(let_node->var, new_value);
+      body = let_node->body;
+    }
+    Expr new_body = VisitExpr(body);
+    Expr ret = scopes_.back().Get(new_body);
+    scopes_.pop_back();
+    return ret;
+  }
+
+  // The device of the tensors of a value, before or after the rewrite.
+  int DeviceOf(const Expr& expr) const {
+    static const Op& alloc_storage = Op::Get("memory.alloc_storage");
+    static const Op& alloc_tensor = Op::Get("memory.alloc_tensor");
+    if (const auto* var = expr.as<VarNode>()) {
+      auto it = var_device_.find(GetRef<Var>(var));
+      return it == var_device_.end() ? default_device_ : it->second;
+    } else if (const auto* tuple = expr.as<TupleNode>()) {
+      return tuple->fields.empty() ? default_device_ : DeviceOf(tuple->fields[0]);
+    } else if (const auto* get = expr.as<TupleGetItemNode>()) {
+      return DeviceOf(get->tuple);
+    }
+    const auto* call = expr.as<CallNode>();
+    if (call == nullptr) return default_device_;
+    if (const auto* attrs = call->attrs.as<DeviceCopyAttrs>()) {
+      return attrs->dst_dev_type;
+    } else if (call->op.same_as(alloc_storage)) {
+      return call->attrs.as<AllocStorageAttrs>()->device_type;
+    } else if (call->op.same_as(alloc_tensor)) {
+      return DeviceOf(call->args[0]);
+    } else if (IsPrimitive(call)) {
+      if (const auto* copy = GetDeviceCopy(Downcast<Function>(call->op))) {
+        return copy->attrs.as<DeviceCopyAttrs>()->dst_dev_type;
+      }
+      for (const auto& arg : call->args) {
+        const auto* var = arg.as<VarNode>();
+        auto it = var ? var_device_.find(GetRef<Var>(var)) : var_device_.end();
+        if (it != var_device_.end()) return it->second;
+      }
+    }
+    return default_device_;
+  }
+
+  Expr ComputeAlignment(const DataType& dtype) const {
+    int64_t align = dtype.bits() / 8 * dtype.lanes();
+    // The minimal alignment of the allocations, kAllocAlignment in device_api.h.
+    if (align < 64) {
+      align = 64;
+    }
+    return MakeConstantScalar(kComputeType, align);
+  }
+
+  Expr ComputeStorageInRelay(const Expr& shape, const TensorType& type) const {
+    auto els = Prod(shape, NullValue<Array<Integer> >(), false, false);
+    auto num = MakeConstantScalar(kComputeType, type->dtype.bits() * type->dtype.lanes());
+    auto add = Add(num, MakeConstantScalar(kComputeType, 7));
+    auto div = MakeConstantScalar(kComputeType, 8);
+    return Multiply(els, Divide(add, div));
+  }
+
+  Expr ComputeStorage(const TensorType& type) const {
+    int64_t size = 1;
+    for (const auto& dim : type->shape) {
+      const auto* imm = dim.as<IntImmNode>();
+      CHECK(imm != nullptr) << "expected a static shape, found " << type;
+      size *= imm->value;
+    }
+    size *= (type->dtype.bits() * type->dtype.lanes() + 7) / 8;
+    return MakeConstantScalar(kComputeType, size);
+  }
+
+  // Allocate a tensor with a statically known shape.
+  Var MakeStaticAllocation(LetList* scope, const TensorType& type, int device) {
+    std::vector<int64_t> int_shape;
+    for (const auto& dim : type->shape) {
+      const auto* imm = dim.as<IntImmNode>();
+      CHECK(imm != nullptr) << "expected a static shape, found " << type;
+      int_shape.push_back(imm->value);
+    }
+    Expr shape = MakeConstantTensor(kComputeType, {static_cast<int64_t>(int_shape.size())},
+                                    int_shape);
+    Expr size = ComputeStorage(type);
+    Expr alignment = ComputeAlignment(type->dtype);
+    Var storage = scope->Push(VarNode::make("storage", Type()),
+                              AllocStorage(size, alignment, type->dtype, device));
+    return scope->Push(VarNode::make("tensor", Type()),
+                       AllocTensor(storage, shape, type->dtype, type->shape));
+  }
+
+  // Allocate the outputs from the results of the shape function, then invoke.
+  Expr DynamicInvoke(LetList* scope, const Function& func, const Expr& ins,
+                     const Array<Expr>& new_args, const std::vector<TensorType>& out_types,
+                     int device) {
+    CompileEngine engine = CompileEngine::Global();
+    CachedFunc cfunc = engine->LowerShapeFunc(CCacheKeyNode::make(func, target_host_));
+    const auto& input_states = cfunc->shape_func_param_states;
+    CHECK_EQ(new_args.size(), input_states.size());
+
+    Array<Expr> shape_func_ins;
+    Array<Integer> is_inputs;
+    for (size_t i = 0; i < new_args.size(); ++i) {
+      Expr arg = new_args[i];
+      int state = input_states[i]->value;
+      if (state == 2) {
+        // Pass the shapes.
+        const auto* var = arg.as<VarNode>();
+        CHECK(var != nullptr) << "expected the arguments in A-normal form";
+        if (const auto* tuple_type = var->type_annotation.as<TupleTypeNode>()) {
+          for (size_t j = 0; j < tuple_type->fields.size(); ++j) {
+            Var in_arg = scope->Push(TupleGetItemNode::make(arg, j));
+            shape_func_ins.push_back(scope->Push(VisitExpr(ShapeOf(in_arg))));
+          }
+        } else {
+          shape_func_ins.push_back(scope->Push(VisitExpr(ShapeOf(arg))));
+        }
+        is_inputs.push_back(0);
+      } else if (state == 1) {
+        // Pass the inputs.
+        shape_func_ins.push_back(scope->Push(VisitExpr(arg)));
+        is_inputs.push_back(1);
+      } else {
+        LOG(FATAL) << "unsupported shape function input state " << state;
+      }
+    }
+
+    std::vector<Expr> out_shapes;
+    for (const auto& out : cfunc->outputs) {
+      auto type = TensorTypeNode::make(out->shape, out->dtype);
+      out_shapes.push_back(MakeStaticAllocation(scope, type, device));
+    }
+    scope->Push(ShapeFunc(func, TupleNode::make(shape_func_ins),
+                          TupleNode::make(out_shapes), is_inputs));
+
+    CHECK_EQ(out_shapes.size(), out_types.size());
+    Array<Expr> outs;
+    for (size_t i = 0; i < out_types.size(); ++i) {
+      const TensorType& type = out_types[i];
+      Var storage = scope->Push(VarNode::make("storage", Type()),
+                                AllocStorage(ComputeStorageInRelay(out_shapes[i], type),
+                                             ComputeAlignment(type->dtype), type->dtype,
+                                             device));
+      outs.push_back(scope->Push(VarNode::make("out", Type()),
+                                 AllocTensor(storage, out_shapes[i], type->dtype, type->shape)));
+    }
+    Expr tuple_outs = TupleNode::make(outs);
+    scope->Push(InvokeTVMOp(func, ins, tuple_outs));
+    return outs.size() == 1 ? outs[0] : tuple_outs;
+  }
+
+  /*! \brief The target of the shape functions. */
+  Target target_host_;
+  /*! \brief The device of the values not placed on another, -1 for the default context. */
+  int default_device_;
+  /*! \brief The device of the variables not on the default device. */
+  std::unordered_map<Var, int, ObjectHash, ObjectEqual> var_device_;
+  /*! \brief The enclosing scopes, a deque keeps references to them valid. */
+  std::deque<LetList> scopes_;
+};
+
+}  // namespace vm
+
+namespace transform {
+
+Pass ManifestAlloc(Target target_host, int default_device) {
+  runtime::TypedPackedFunc<Module(Module, PassContext)> import_func =
+    [](Module m, PassContext pc) {
+      // The storage type is defined in the core prelude.
+      m->ImportFromStd("core.rly");
+      return m;
+  };
+  runtime::TypedPackedFunc<Function(Function, Module, PassContext)> pass_func =
+    [=](Function f, Module m, PassContext pc) {
+      return Downcast<Function>(vm::DialectRewriter(target_host, default_device).VisitExpr(f));
+  };
+  return Sequential({CreateModulePass(import_func, 0, "ImportCore", {}),
+                     CreateFunctionPass(pass_func, 0, "ManifestAllocFunc", {})},
+                    "ManifestAlloc");
+}
+
+TVM_REGISTER_GLOBAL("relay._transform.ManifestAlloc")
+.set_body_typed(ManifestAlloc);
+
+}  // namespace transform
+
+}  // namespace relay
+}  // namespace tvm
@@ -0,0 +1,400 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file tvm/relay/backend/vm/memory_plan.cc
+ * \brief Coalesce the static storage of the manifested allocations.
+ */
+
+#include <tvm/relay/analysis.h>
+#include <tvm/relay/attrs/memory.h>
+#include <tvm/relay/expr.h>
+#include <tvm/relay/expr_functor.h>
+#include <tvm/relay/transform.h>
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "../../pass/pattern_util.h"
+#include "compiler.h"
+
+namespace tvm {
+namespace relay {
+namespace vm {
+
+inline bool IsOp(const Expr& expr, const Op& op) {
+  const auto* call = expr.as<CallNode>();
+  return call != nullptr && call->op.same_as(op);
+}
+
+inline bool GetConstInt(const Expr& expr, int64_t* value) {
+  const auto* konst = expr.as<ConstantNode>();
+  if (konst == nullptr || !konst->is_scalar()) return false;
+  const DLTensor* tensor = konst->data.operator->();
+  if (tensor->dtype.code != kDLInt) return false;
+  if (tensor->dtype.bits == 64) {
+    *value = static_cast<const int64_t*>(tensor->data)[0];
+  } else if (tensor->dtype.bits == 32) {
+    *value = static_cast<const int32_t*>(tensor->data)[0];
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/*!
+ * \brief Plan the storage of the tensors with static shapes.
+ *
+ *  The manifested program allocates one storage for every tensor. Within a
+ *  scope, the lifetime of a storage starts at its allocation and ends at
+ *  the last use of the tensors in it, including the variables aliasing them
+ *  through tuples. Storages with disjoint lifetimes share a block, like the
+ *  storage planning of the graph runtime. The blocks of a scope are then
+ *  laid out in one storage at different offsets, or stay separate storages
+ *  on devices without flat addresses. Only the storages of one device share
+ *  blocks.
+ *
+ *  Storages whose tensors escape the scope, through its result, a call that
+ *  is not a primitive or a copy across devices, or a nested scope, keep their
+ *  own allocation. So do the storages of a dynamic size.
+ */
+class StorageCoalescer : public ExprMutator {
+ public:
+  StorageCoalescer(bool use_offsets, MemoryPlanStats* stats)
+      : use_offsets_(use_offsets), stats_(stats) {}
+
+  Expr VisitExpr_(const LetNode* let_node) final {
+    std::vector<std::pair<Var, Expr> > bindings;
+    Expr body = GetRef<Expr>(let_node);
+    while (const auto* let = body.as<LetNode>()) {
+      bindings.emplace_back(let->var, VisitExpr(let->value));
+      body = let->body;
+    }
+    body = VisitExpr(body);
+    Plan(&bindings, body);
+    for (auto rit = bindings.rbegin(); rit != bindings.rend(); ++rit) {
+      if (rit->second.defined()) {
+        body = LetNode::make(rit->first, rit->second, body);
+      }
+    }
+    return body;
+  }
+
+ private:
+  /*! \brief A storage allocated in the scope. */
+  struct StorageInfo {
+    // the binding allocating the storage.
+    size_t def;
+    // the last binding using the storage.
+    size_t last_use;
+    int64_t size;
+    int64_t alignment;
+    int device_type;
+    int device_id;
+    // whether the size is static and no tensor in it escapes.
+    bool plannable;
+    // the bindings allocating the tensors in the storage.
+    std::vector<size_t> tensors;
+    // the block of the storage.
+    int block{-1};
+  };
+  /*! \brief A block shared by the storages of disjoint lifetimes. */
+  struct Block {
+    int64_t size;
+    int64_t alignment;
+    DataType dtype;
+    // the storage variable holding the block.
+    Var var;
+    // the binding allocating the block.
+    size_t def;
+    int64_t offset{0};
+  };
+
+  using VarSet = std::vector<Var>;
+  using StorageMap = std::unordered_map<Var, StorageInfo, ObjectHash, ObjectEqual>;
+
+  void Plan(std::vector<std::pair<Var, Expr> >* bindings, const Expr& body) {
+    static const Op& alloc_storage = Op::Get("memory.alloc_storage");
+    static const Op& alloc_tensor = Op::Get("memory.alloc_tensor");
+    static const Op& invoke_tvm_op = Op::Get("memory.invoke_tvm_op");
+    static const Op& shape_func = Op::Get("memory.shape_func");
+    static const Op& device_copy = Op::Get("device_copy");
+
+    StorageMap storages;
+    // the storages referenced by each variable holding tensors or tuples of them.
+    std::unordered_map<Var, VarSet, ObjectHash, ObjectEqual> refs;
+
+    auto use = [&](const Expr& expr, size_t index) -> const VarSet* {
+      const auto* var = expr.as<VarNode>();
+      if (var == nullptr) return nullptr;
+      auto it = refs.find(GetRef<Var>(var));
+      if (it == refs.end()) return nullptr;
+      for (const Var& sto : it->second) {
+        StorageInfo& info = storages.at(sto);
+        info.last_use = std::max(info.last_use, index);
+      }
+      return &it->second;
+    };
+    auto escape = [&](const Expr& expr) {
+      for (const Var& var : FreeVars(expr)) {
+        auto it = refs.find(var);
+        if (it == refs.end()) continue;
+        for (const Var& sto : it->second) {
+          storages.at(sto).plannable = false;
+        }
+      }
+    };
+
+    for (size_t i = 0; i < bindings->size(); ++i) {
+      const Var& var = (*bindings)[i].first;
+      const Expr& value = (*bindings)[i].second;
+      const auto* call = value.as<CallNode>();
+      if (IsOp(value, alloc_storage)) {
+        const auto* attrs = call->attrs.as<AllocStorageAttrs>();
+        StorageInfo info;
+        info.def = i;
+        info.last_use = i;
+        info.device_type = attrs->device_type;
+        info.device_id = attrs->device_id;
+        info.plannable = GetConstInt(call->args[0], &info.size) &&
+            GetConstInt(call->args[1], &info.alignment);
+        // a dynamic size is only read by the allocation.
+        use(call->args[0], i);
+        storages.emplace(var, info);
+        refs[var] = {var};
+      } else if (IsOp(value, alloc_tensor)) {
+        const auto* sto = call->args[0].as<VarNode>();
+        auto it = sto ? storages.find(GetRef<Var>(sto)) : storages.end();
+        if (it == storages.end()) {
+          escape(value);
+          continue;
+        }
+        StorageInfo& info = it->second;
+        const auto* attrs = call->attrs.as<AllocTensorAttrs>();
+        if (!call->args[1].as<ConstantNode>() || attrs->offset != 0) {
+          info.plannable = false;
+        }
+        // a dynamic shape is only read by the allocation.
+        use(call->args[1], i);
+        info.tensors.push_back(i);
+        info.last_use = std::max(info.last_use, i);
+        refs[var] = {it->first};
+      } else if (IsOp(value, invoke_tvm_op) || IsOp(value, shape_func)) {
+        // the inputs and outputs are only used during the call.
+        for (size_t k = 1; k < call->args.size(); ++k) {
+          const auto* tuple = call->args[k].as<TupleNode>();
+          if (tuple == nullptr) {
+            escape(call->args[k]);
+            continue;
+          }
+          for (const auto& field : tuple->fields) {
+            if (!use(field, i)) escape(field);
+          }
+        }
+      } else if (IsOp(value, device_copy)) {
+        // the VM returns the source itself when it is already on the target
+        // device, so the result keeps the storages of the source alive.
+        const VarSet* fs = use(call->args[0], i);
+        if (fs) {
+          refs[var] = *fs;
+        } else {
+          escape(call->args[0]);
+        }
+      } else if (const auto* tuple = value.as<TupleNode>()) {
+        VarSet alias;
+        for (const auto& field : tuple->fields) {
+          const VarSet* fs = use(field, i);
+          if (fs) {
+            alias.insert(alias.end(), fs->begin(), fs->end());
+          } else {
+            escape(field);
+          }
+        }
+        if (!alias.empty()) refs[var] = alias;
+      } else if (const auto* get = value.as<TupleGetItemNode>()) {
+        const VarSet* fs = use(get->tuple, i);
+        if (fs) {
+          refs[var] = *fs;
+        } else {
+          escape(get->tuple);
+        }
+      } else if (value.as<VarNode>()) {
+        const VarSet* fs = use(value, i);
+        if (fs) refs[var] = *fs;
+      } else {
+        escape(value);
+      }
+    }
+    escape(body);
+
+    // Coalesce the plannable storages of each device, in the order of allocation.
+    std::map<std::pair<int, int>, std::vector<Var> > devices;
+    for (auto& kv : storages) {
+      if (kv.second.plannable) {
+        devices[{kv.second.device_type, kv.second.device_id}].push_back(kv.first);
+      }
+    }
+    for (auto& kv : devices) {
+      std::vector<Var>& order = kv.second;
+      if (order.size() < 2) continue;
+      std::sort(order.begin(), order.end(), [&](const Var& a, const Var& b) {
+        return storages.at(a).def < storages.at(b).def;
+      });
+      Coalesce(bindings, &storages, order);
+    }
+  }
+
+  // Assign the storages of one device to blocks and rewrite their allocations.
+  void Coalesce(std::vector<std::pair<Var, Expr> >* bindings, StorageMap* storage_map,
+                const std::vector<Var>& order) {
+    StorageMap& storages = *storage_map;
+    std::vector<Block> blocks;
+    // the free blocks by size.
+    std::multimap<int64_t, int> free_blocks;
+    // the storages by the end of their lifetimes.
+    std::multimap<size_t, Var> live;
+    int64_t bytes_before = 0;
+    for (const Var& sto : order) {
+      StorageInfo& info = storages.at(sto);
+      // release the blocks of the storages not used any more.
+      while (!live.empty() && live.begin()->first < info.def) {
+        int block = storages.at(live.begin()->second).block;
+        free_blocks.emplace(blocks[block].size, block);
+        live.erase(live.begin());
+      }
+      info.block = FindBlock(info, &free_blocks, &blocks);
+      if (info.block < 0) {
+        Block block;
+        block.size = info.size;
+        block.alignment = info.alignment;
+        block.dtype = Downcast<Call>((*bindings)[info.def].second)
+            ->attrs.as<AllocStorageAttrs>()->dtype;
+        block.var = sto;
+        block.def = info.def;
+        info.block = static_cast<int>(blocks.size());
+        blocks.push_back(block);
+      }
+      live.emplace(info.last_use, sto);
+      bytes_before += info.size;
+    }
+
+    // Lay out the blocks and rewrite the allocations.
+    int64_t total = 0;
+    int64_t alignment = 1;
+    for (Block& block : blocks) {
+      alignment = std::max(alignment, block.alignment);
+      block.offset = (total + block.alignment - 1) / block.alignment * block.alignment;
+      total = block.offset + block.size;
+    }
+    for (const Var& sto : order) {
+      const StorageInfo& info = storages.at(sto);
+      const Block& block = blocks[info.block];
+      const Block& holder = use_offsets_ ? blocks[0] : block;
+      bool first = use_offsets_ ? info.def == holder.def : sto.same_as(block.var);
+      if (first) {
+        int64_t size = use_offsets_ ? total : block.size;
+        int64_t align = use_offsets_ ? alignment : block.alignment;
+        const auto* call = (*bindings)[info.def].second.as<CallNode>();
+        auto attrs = make_object<AllocStorageAttrs>(*call->attrs.as<AllocStorageAttrs>());
+        attrs->dtype = block.dtype;
+        (*bindings)[info.def].second = CallNode::make(
+            call->op, {MakeConstantScalar(DataType::Int(64), size),
+                       MakeConstantScalar(DataType::Int(64), align)},
+            Attrs(attrs), {});
+      } else {
+        (*bindings)[info.def].second = Expr();
+      }
+      for (size_t t : info.tensors) {
+        const auto* call = (*bindings)[t].second.as<CallNode>();
+        auto attrs = make_object<AllocTensorAttrs>(*call->attrs.as<AllocTensorAttrs>());
+        attrs->offset = use_offsets_ ? block.offset : 0;
+        (*bindings)[t].second = CallNode::make(
+            call->op, {holder.var, call->args[1]}, Attrs(attrs), call->type_args);
+      }
+    }
+    int64_t bytes_after = 0;
+    if (use_offsets_) {
+      bytes_after = total;
+    } else {
+      for (const Block& block : blocks) bytes_after += block.size;
+    }
+    if (stats_ != nullptr) {
+      stats_->num_storage_before += order.size();
+      stats_->num_storage_after += use_offsets_ ? 1 : blocks.size();
+      stats_->bytes_before += bytes_before;
+      stats_->bytes_after += bytes_after;
+    }
+  }
+
+  // Find a free block for the storage, the block grows when it is smaller.
+  static int FindBlock(const StorageInfo& info,
+                       std::multimap<int64_t, int>* free_blocks,
+                       std::vector<Block>* blocks) {
+    // the same factor as the graph memory planner, avoid sharing very different sizes.
+    const int64_t match_range = 16;
+    if (free_blocks->empty()) return -1;
+    auto begin = free_blocks->lower_bound(info.size / match_range);
+    auto mid = free_blocks->lower_bound(info.size);
+    auto end = free_blocks->upper_bound(info.size * match_range);
+    auto it = free_blocks->end();
+    if (mid != end) {
+      // the smallest block not smaller than the storage.
+      it = mid;
+    } else if (mid != begin) {
+      // the largest smaller block, which grows.
+      it = std::prev(mid);
+    } else {
+      return -1;
+    }
+    int block = it->second;
+    free_blocks->erase(it);
+    (*blocks)[block].size = std::max((*blocks)[block].size, info.size);
+    (*blocks)[block].alignment = std::max((*blocks)[block].alignment, info.alignment);
+    return block;
+  }
+
+  /*! \brief Whether the blocks are laid out in one storage. */
+  bool use_offsets_;
+  /*! \brief The statistics of the plan, may be nullptr. */
+  MemoryPlanStats* stats_;
+};
+
+}  // namespace vm
+
+namespace transform {
+
+Pass MemoryPlan(bool use_offsets, vm::MemoryPlanStats* stats) {
+  runtime::TypedPackedFunc<Function(Function, Module, PassContext)> pass_func =
+    [=](Function f, Module m, PassContext pc) {
+      return Downcast<Function>(vm::StorageCoalescer(use_offsets, stats).VisitExpr(f));
+  };
+  return CreateFunctionPass(pass_func, 0, "MemoryPlan", {});
+}
+
+TVM_REGISTER_GLOBAL("relay._transform.MemoryPlan")
+.set_body_typed([](bool use_offsets) {
+  return MemoryPlan(use_offsets, nullptr);
+});
+
+}  // namespace transform
+
+}  // namespace relay
+}  // namespace tvm
@@ -35,6 +35,7 @@
 namespace tvm {
 namespace relay {
 
+TVM_REGISTER_NODE_TYPE(AllocStorageAttrs);
 TVM_REGISTER_NODE_TYPE(AllocTensorAttrs);
 TVM_REGISTER_NODE_TYPE(ShapeFuncAttrs);
 
@@ -42,9 +43,12 @@ TVM_REGISTER_NODE_TYPE(ShapeFuncAttrs);
 // We should consider a better solution, i.e the type relation
 // being able to see the arguments as well?
 TVM_REGISTER_GLOBAL("relay.op.memory._make.alloc_storage")
-    .set_body_typed([](Expr size, Expr alignment, DataType dtype) {
-      auto attrs = make_object<AllocTensorAttrs>();
+    .set_body_typed([](Expr size, Expr alignment, DataType dtype, int device_type,
+                       int device_id) {
+      auto attrs = make_object<AllocStorageAttrs>();
       attrs->dtype = dtype;
+      attrs->device_type = device_type;
+      attrs->device_id = device_id;
       static const Op& op = Op::Get("memory.alloc_storage");
       return CallNode::make(op, {size, alignment}, Attrs(attrs), {});
     });
@@ -89,9 +93,11 @@ RELAY_REGISTER_OP("memory.alloc_storage")
 
 TVM_REGISTER_GLOBAL("relay.op.memory._make.alloc_tensor")
     .set_body_typed(
-        [](Expr storage, tvm::relay::Expr shape, DataType dtype, Array<IndexExpr> assert_shape) {
+        [](Expr storage, tvm::relay::Expr shape, DataType dtype, Array<IndexExpr> assert_shape,
+           int64_t offset) {
           auto attrs = make_object<AllocTensorAttrs>();
           attrs->dtype = dtype;
+          attrs->offset = offset;
           if (assert_shape.defined()) {
             attrs->assert_shape = assert_shape;
           } else {
@@ -134,7 +134,8 @@ Pass CanonicalizeCast() {
     return Downcast<Function>(CanonicalizeCast(f));
   };
   return CreateFunctionPass(pass_func, 3, "CanonicalizeCast",
-                            {ir::StringImmNode::make("InferType")});
+                            {ir::StringImmNode::make("InferType")},
+                            /* thread_safe */ true);
 }
 
 TVM_REGISTER_GLOBAL("relay._transform.CanonicalizeCast")
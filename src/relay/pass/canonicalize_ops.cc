@@ -74,7 +74,8 @@ Pass CanonicalizeOps() {
     return Downcast<Function>(CanonicalizeOps(f));
   };
   return CreateFunctionPass(pass_func, 3, "CanonicalizeOps",
-                            {ir::StringImmNode::make("InferType")});
+                            {ir::StringImmNode::make("InferType")},
+                            /* thread_safe */ true);
 }
 
 TVM_REGISTER_GLOBAL("relay._transform.CanonicalizeOps")
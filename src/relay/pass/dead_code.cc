@@ -144,7 +144,8 @@ Pass DeadCodeElimination(bool inline_once) {
     [=](Function f, Module m, PassContext pc) {
     return Downcast<Function>(DeadCodeElimination(f, inline_once));
   };
-  return CreateFunctionPass(pass_func, 1, "DeadCodeElimination", {});
+  return CreateFunctionPass(pass_func, 1, "DeadCodeElimination", {},
+                            /* thread_safe */ true);
 }
 
 TVM_REGISTER_GLOBAL("relay._transform.DeadCodeElimination")
@@ -92,7 +92,8 @@ Pass EliminateCommonSubexpr(PackedFunc fskip) {
       return Downcast<Function>(EliminateCommonSubexpr(f, fskip));
   };
   return CreateFunctionPass(pass_func, 3, "EliminateCommonSubexpr",
-                            {ir::StringImmNode::make("InferType")});
+                            {ir::StringImmNode::make("InferType")},
+                            /* thread_safe */ true);
 }
 
 TVM_REGISTER_GLOBAL("relay._transform.EliminateCommonSubexpr")
@@ -955,7 +955,8 @@ Pass ForwardFoldScaleAxis() {
           relay::fold_scale_axis::ForwardFoldScaleAxis(f));
   };
   return CreateFunctionPass(pass_func, 3, "ForwardFoldScaleAxis",
-                            {ir::StringImmNode::make("InferType")});
+                            {ir::StringImmNode::make("InferType")},
+                            /* thread_safe */ true);
 }
 
 TVM_REGISTER_GLOBAL("relay._transform.ForwardFoldScaleAxis")
@@ -968,7 +969,8 @@ Pass BackwardFoldScaleAxis() {
           relay::fold_scale_axis::BackwardFoldScaleAxis(f));
     };
   return CreateFunctionPass(pass_func, 3, "BackwardFoldScaleAxis",
-                            {ir::StringImmNode::make("InferType")});
+                            {ir::StringImmNode::make("InferType")},
+                            /* thread_safe */ true);
 }
 
 TVM_REGISTER_GLOBAL("relay._transform.BackwardFoldScaleAxis")
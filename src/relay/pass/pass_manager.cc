@@ -30,6 +30,8 @@
 #include <stack>
 #include <unordered_set>
 
+#include "../../common/parallel_for.h"
+
 namespace tvm {
 namespace relay {
 namespace transform {
@@ -80,6 +82,35 @@ PassContext PassContext::Create() {
   return PassContext(make_object<PassContextNode>());
 }
 
+/*!
+ * \brief Records a run of a pass on the profiler of the pass context, if any.
+ * A pass that throws is recorded without its IR size after it.
+ */
+class PassProfileScope {
+ public:
+  PassProfileScope(const PassContext& pass_ctx, const PassInfo& pass_info,
+                   const char* kind, const Module& mod) {
+    if (!pass_ctx->profiler.defined()) return;
+    profiler_ = pass_ctx->profiler;
+    index_ = profiler_->EnterPass(pass_info->name, kind, mod);
+  }
+
+  ~PassProfileScope() {
+    if (profiler_.defined()) profiler_->ExitPass(index_, Module());
+  }
+
+  /*! \brief Record the end of the run with its updated module. */
+  void Exit(const Module& updated_mod) {
+    if (!profiler_.defined()) return;
+    profiler_->ExitPass(index_, updated_mod);
+    profiler_ = PassProfiler();
+  }
+
+ private:
+  PassProfiler profiler_;
+  size_t index_{0};
+};
+
 class ModulePass;
 
 /*!
@@ -157,10 +188,18 @@ class FunctionPassNode : public PassNode {
    */
   runtime::TypedPackedFunc<Function(Function, Module, PassContext)> pass_func;
 
+  /*!
+   * \brief Whether `pass_func` can run on several functions at once. Nodes that
+   *  functions share stay intact since TypeInferencer only mutates a node it
+   *  holds the sole reference to (`new_e.unique()` in type_infer.cc).
+   */
+  bool thread_safe{false};
+
   FunctionPassNode() = default;
 
   void VisitAttrs(tvm::AttrVisitor* v) {
     v->Visit("pass_info", &pass_info);
+    v->Visit("thread_safe", &thread_safe);
   }
 
   /*!
@@ -295,8 +334,10 @@ Module ModulePassNode::operator()(const Module& mod,
              << " with opt level: "
              << pass_info->opt_level;
   CHECK(mod.defined());
+  PassProfileScope profile(pass_ctx, pass_info, "module", mod);
   Module updated_mod = pass_func(mod, pass_ctx);
   CHECK(updated_mod.defined());
+  profile.Exit(updated_mod);
   return updated_mod;
 }
 
@@ -318,6 +359,7 @@ Module FunctionPassNode::operator()(const Module& mod,
              << pass_info->name
              << " with opt level: "
              << pass_info->opt_level;
+  PassProfileScope profile(pass_ctx, pass_info, "function", mod);
 
   // Execute the pass function and return a new module.
   Module updated_mod = ModuleNode::make(mod->functions, mod->type_definitions, mod->Imports());
@@ -325,17 +367,32 @@ Module FunctionPassNode::operator()(const Module& mod,
   for (const auto& it : updated_mod->functions) {
     // only picks up relay::Function
     if (auto* n = it.second.as<FunctionNode>()) {
-      Function func = GetRef<Function>(n);
-      auto updated_func = SkipFunction(func)
-                          ? func
-                          : pass_func(func, updated_mod, pass_ctx);
-      updates.push_back({it.first, updated_func});
+      updates.push_back({it.first, GetRef<Function>(n)});
     }
   }
+  auto run = [&](size_t i) {
+    const Function& func = updates[i].second;
+    if (!SkipFunction(func)) {
+      updates[i].second = pass_func(func, updated_mod, pass_ctx);
+    }
+  };
+  // The functions only see the module as it was before the pass, and are
+  // updated in the same order either way.
+  int num_threads = thread_safe ? std::min(pass_ctx->function_pass_threads,
+                                           static_cast<int>(updates.size())) : 1;
+  if (num_threads > 1) {
+    common::ParallelFor(updates.size(), num_threads, [&](size_t i) {
+      With<PassContext> scope(pass_ctx);
+      run(i);
+    });
+  } else {
+    for (size_t i = 0; i < updates.size(); ++i) run(i);
+  }
 
   for (const auto& pair : updates) {
     updated_mod->Add(pair.first, pair.second, true);
   }
+  profile.Exit(updated_mod);
   return updated_mod;
 }
 
@@ -412,6 +469,7 @@ Pass GetPass(const std::string& pass_name) {
 // ordering problem needs to be handled in the future.
 Module SequentialNode::operator()(const Module& module,
                                   const PassContext& pass_ctx) const {
+  PassProfileScope profile(pass_ctx, pass_info, "sequential", module);
   Module mod = module;
   for (const Pass& pass : passes) {
     CHECK(pass.defined()) << "Found undefined pass for optimization.";
@@ -425,6 +483,7 @@ Module SequentialNode::operator()(const Module& module,
     }
     mod = pass(mod, pass_ctx);
   }
+  profile.Exit(mod);
   return mod;
 }
 
@@ -441,9 +500,13 @@ Pass CreateFunctionPass(
     const runtime::TypedPackedFunc<Function(Function, Module, PassContext)>& pass_func,
     int opt_level,
     const std::string& name,
-    const tvm::Array<tvm::PrimExpr>& required) {
-  PassInfo pass_info = PassInfoNode::make(opt_level, name, required);
-  return FunctionPassNode::make(pass_func, pass_info);
+    const tvm::Array<tvm::PrimExpr>& required,
+    bool thread_safe) {
+  auto n = make_object<FunctionPassNode>();
+  n->pass_func = pass_func;
+  n->pass_info = PassInfoNode::make(opt_level, name, required);
+  n->thread_safe = thread_safe;
+  return FunctionPass(n);
 }
 
 TVM_REGISTER_NODE_TYPE(PassInfoNode);
@@ -539,10 +602,15 @@ TVM_REGISTER_GLOBAL("relay._transform.PassContext")
   int fallback_device = args[1];
   tvm::Array<tvm::PrimExpr> required = args[2];
   tvm::Array<tvm::PrimExpr> disabled = args[3];
+  PassProfiler profiler = args[4];
+  int function_pass_threads = args[5];
+  CHECK_GT(function_pass_threads, 0);
   pctx->opt_level = opt_level;
   pctx->fallback_device = fallback_device;
   pctx->required_pass = std::move(required);
   pctx->disabled_pass = std::move(disabled);
+  pctx->profiler = std::move(profiler);
+  pctx->function_pass_threads = function_pass_threads;
   *ret = pctx;
 });
 
@@ -565,7 +633,9 @@ TVM_STATIC_IR_FUNCTOR(NodePrinter, vtable)
   for (const auto& it : node->disabled_pass) {
     p->stream << it << " ";
   }
-  p->stream << "]";
+  p->stream << "]\n";
+
+  p->stream << "\tfunction pass threads: " << node->function_pass_threads;
 });
 
 class PassContext::Internal {
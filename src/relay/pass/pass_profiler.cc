@@ -0,0 +1,258 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file src/relay/pass/pass_profiler.cc
+ * \brief The record of the wall time, IR size and memory of the passes.
+ */
+#include <tvm/relay/expr_functor.h>
+#include <tvm/relay/transform.h>
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+namespace tvm {
+namespace relay {
+namespace transform {
+
+namespace {
+
+int64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The peak resident memory of the process in KB, 0 if unknown.
+int64_t PeakRSSKB() {
+#if !defined(_WIN32)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined(__APPLE__)
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+#else
+  return 0;
+#endif
+}
+
+uint32_t ThreadIndex() {
+  static std::atomic<uint32_t> num_threads{0};
+  static thread_local uint32_t index = num_threads.fetch_add(1);
+  return index;
+}
+
+// The number of distinct expressions in the Relay functions of a module.
+int64_t CountNodes(const Module& mod) {
+  int64_t count = 0;
+  for (const auto& it : mod->functions) {
+    if (it.second.as<FunctionNode>() == nullptr) continue;
+    PostOrderVisit(it.second, [&count](const Expr& e) { ++count; });
+  }
+  return count;
+}
+
+std::string Escape(const std::string& s) {
+  std::string out;
+  for (char c : s) {
+    if (c == '"' || c == '\\') out.push_back('\\');
+    out.push_back(c);
+  }
+  return out;
+}
+
+}  // namespace
+
+size_t PassProfilerNode::EnterPass(const std::string& name, const std::string& kind,
+                                   const Module& mod) {
+  Event e;
+  e.name = name;
+  e.kind = kind;
+  e.tid = ThreadIndex();
+  // count outside of the lock, the other threads keep running their passes.
+  e.nodes_before = CountNodes(mod);
+  e.nodes_after = -1;
+  e.peak_rss_kb = PeakRSSKB();
+  e.end_ns = 0;
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<size_t>& open = open_[e.tid];
+  e.parent = open.empty() ? -1 : static_cast<int64_t>(open.back());
+  size_t index = events_.size();
+  open.push_back(index);
+  e.begin_ns = NowNs();
+  events_.push_back(std::move(e));
+  return index;
+}
+
+void PassProfilerNode::ExitPass(size_t index, const Module& mod) {
+  int64_t end_ns = NowNs();
+  int64_t peak_rss_kb = PeakRSSKB();
+  int64_t nodes_after = mod.defined() ? CountNodes(mod) : -1;
+  std::lock_guard<std::mutex> lock(mutex_);
+  // the runs may have been reset meanwhile.
+  if (index >= events_.size()) return;
+  Event& e = events_[index];
+  e.end_ns = end_ns;
+  e.nodes_after = nodes_after;
+  e.peak_rss_kb = peak_rss_kb - e.peak_rss_kb;
+  std::vector<size_t>& open = open_[e.tid];
+  auto it = std::find(open.begin(), open.end(), index);
+  if (it != open.end()) open.erase(it);
+}
+
+std::vector<PassProfilerNode::Event> PassProfilerNode::Events() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return events_;
+}
+
+void PassProfilerNode::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  events_.clear();
+  open_.clear();
+}
+
+std::string PassProfilerNode::Report() const {
+  std::vector<Event> events = Events();
+  // the tree of nested passes, a pass run twice under the same parent is one
+  // node of it.
+  struct TreeNode {
+    std::string name;
+    std::string kind;
+    std::vector<size_t> children;
+    int64_t calls{0};
+    int64_t total_ns{0};
+    int64_t child_ns{0};
+    int64_t nodes_before{-1};
+    int64_t nodes_after{-1};
+    int64_t peak_rss_kb{0};
+  };
+  std::vector<TreeNode> tree(1);
+  std::map<std::pair<size_t, std::string>, size_t> index;
+  std::vector<size_t> tree_of(events.size());
+  int64_t total_ns = 0;
+  for (size_t i = 0; i < events.size(); ++i) {
+    const Event& e = events[i];
+    size_t parent = e.parent >= 0 ? tree_of[e.parent] : 0;
+    auto key = std::make_pair(parent, e.name);
+    auto it = index.find(key);
+    if (it == index.end()) {
+      it = index.emplace(key, tree.size()).first;
+      tree[parent].children.push_back(tree.size());
+      tree.emplace_back();
+      tree.back().name = e.name;
+      tree.back().kind = e.kind;
+    }
+    tree_of[i] = it->second;
+    TreeNode& n = tree[it->second];
+    int64_t dur = e.end_ns >= e.begin_ns ? e.end_ns - e.begin_ns : 0;
+    if (n.calls++ == 0) n.nodes_before = e.nodes_before;
+    n.total_ns += dur;
+    n.nodes_after = e.nodes_after;
+    n.peak_rss_kb = std::max(n.peak_rss_kb, e.peak_rss_kb);
+    if (e.parent >= 0) {
+      tree[parent].child_ns += dur;
+    } else {
+      total_ns += dur;
+    }
+  }
+
+  std::ostringstream os;
+  os << std::fixed << std::setprecision(3);
+  os << std::left << std::setw(40) << "Pass" << std::right << std::setw(8) << "Calls"
+     << std::setw(14) << "Total(ms)" << std::setw(14) << "Self(ms)" << std::setw(9) << "%"
+     << std::setw(12) << "Nodes in" << std::setw(12) << "Nodes out" << std::setw(14)
+     << "Peak RSS(KB)" << "\n";
+  std::vector<std::pair<size_t, int> > stack;
+  for (auto it = tree[0].children.rbegin(); it != tree[0].children.rend(); ++it) {
+    stack.emplace_back(*it, 0);
+  }
+  while (!stack.empty()) {
+    const TreeNode& n = tree[stack.back().first];
+    int depth = stack.back().second;
+    stack.pop_back();
+    std::string label = std::string(2 * depth, ' ') + n.name;
+    if (n.kind == "sequential") label += " (sequential)";
+    os << std::left << std::setw(40) << label << std::right << std::setw(8) << n.calls
+       << std::setw(14) << n.total_ns / 1e6 << std::setw(14)
+       << (n.total_ns - n.child_ns) / 1e6 << std::setw(9)
+       << (total_ns > 0 ? 100.0 * n.total_ns / total_ns : 0.0) << std::setw(12)
+       << n.nodes_before << std::setw(12) << n.nodes_after << std::setw(14) << n.peak_rss_kb
+       << "\n";
+    for (auto it = n.children.rbegin(); it != n.children.rend(); ++it) {
+      stack.emplace_back(*it, depth + 1);
+    }
+  }
+  return os.str();
+}
+
+std::string PassProfilerNode::ToChromeJSON() const {
+  std::vector<Event> events = Events();
+  int64_t origin = events.empty() ? 0 : events[0].begin_ns;
+  std::ostringstream os;
+  os << std::fixed << std::setprecision(3);
+  os << "{\"traceEvents\": [";
+  for (size_t i = 0; i < events.size(); ++i) {
+    const Event& e = events[i];
+    int64_t dur = e.end_ns >= e.begin_ns ? e.end_ns - e.begin_ns : 0;
+    os << (i == 0 ? "" : ",") << "\n{\"pid\": 0, \"tid\": " << e.tid
+       << ", \"ts\": " << (e.begin_ns - origin) / 1e3 << ", \"dur\": " << dur / 1e3
+       << ", \"ph\": \"X\", \"cat\": \"" << e.kind << "\", \"name\": \"" << Escape(e.name)
+       << "\", \"args\": {\"nodes_before\": " << e.nodes_before << ", \"nodes_after\": "
+       << e.nodes_after << ", \"peak_rss_kb\": " << e.peak_rss_kb << "}}";
+  }
+  os << "],\n\"displayTimeUnit\": \"ms\"}";
+  return os.str();
+}
+
+PassProfiler PassProfilerNode::make() {
+  return PassProfiler(make_object<PassProfilerNode>());
+}
+
+TVM_REGISTER_NODE_TYPE(PassProfilerNode);
+
+TVM_REGISTER_GLOBAL("relay._transform.PassProfiler")
+.set_body_typed(PassProfilerNode::make);
+
+TVM_REGISTER_GLOBAL("relay._transform.PassProfilerReport")
+.set_body_typed([](PassProfiler profiler) {
+  return profiler->Report();
+});
+
+TVM_REGISTER_GLOBAL("relay._transform.PassProfilerTraceJSON")
+.set_body_typed([](PassProfiler profiler) {
+  return profiler->ToChromeJSON();
+});
+
+TVM_REGISTER_GLOBAL("relay._transform.PassProfilerReset")
+.set_body_typed([](PassProfiler profiler) {
+  profiler->Reset();
+});
+
+}  // namespace transform
+}  // namespace relay
+}  // namespace tvm
@@ -836,7 +836,7 @@ Pass InferType() {
     [=](Function f, Module m, PassContext pc) {
       return Downcast<Function>(InferType(f, m));
   };
-  return CreateFunctionPass(pass_func, 0, "InferType", {});
+  return CreateFunctionPass(pass_func, 0, "InferType", {}, /* thread_safe */ true);
 }
 
 TVM_REGISTER_GLOBAL("relay._transform.InferType")
@@ -0,0 +1,434 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file batching_executor.cc
+ * \brief Dynamic micro-batching front end of the graph runtime and the VM.
+ *
+ *  Requests submitted from several threads are queued, gathered into one
+ *  batch of up to max_batch_size rows, or whatever arrived before the oldest
+ *  request waited timeout_us, and executed by a single model invocation.
+ *  The rows of the outputs are then scattered back to the callers.
+ */
+#include <dmlc/logging.h>
+#include <tvm/runtime/container.h>
+#include <tvm/runtime/ndarray.h>
+#include <tvm/runtime/packed_func.h>
+#include <tvm/runtime/registry.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace tvm {
+namespace runtime {
+
+/*! \brief Size in bytes of one row, i.e. one item along the first axis. */
+inline size_t RowBytes(const DLTensor* t) {
+  CHECK_GE(t->ndim, 1) << "Batched tensors need a batch axis";
+  size_t size = (t->dtype.bits * t->dtype.lanes + 7) / 8;
+  for (int i = 1; i < t->ndim; ++i) {
+    size *= static_cast<size_t>(t->shape[i]);
+  }
+  return size;
+}
+
+/*!
+ * \brief Copy rows of src into rows of dst.
+ * \param src The source tensor.
+ * \param src_row The first row copied from src.
+ * \param dst The destination tensor.
+ * \param dst_row The first row written in dst.
+ * \param num_rows The number of rows to copy.
+ */
+inline void CopyRows(const DLTensor* src, int64_t src_row,
+                     const DLTensor* dst, int64_t dst_row, int64_t num_rows) {
+  CHECK_EQ(src->ndim, dst->ndim);
+  CHECK_EQ(RowBytes(src), RowBytes(dst)) << "Mismatched row shapes in batch";
+  std::vector<int64_t> shape(src->shape, src->shape + src->ndim);
+  shape[0] = num_rows;
+  DLTensor from = *src;
+  from.shape = shape.data();
+  from.strides = nullptr;
+  from.byte_offset = src->byte_offset + src_row * RowBytes(src);
+  DLTensor to = *dst;
+  to.shape = shape.data();
+  to.strides = nullptr;
+  to.byte_offset = dst->byte_offset + dst_row * RowBytes(dst);
+  NDArray::CopyFromTo(&from, &to);
+}
+
+/*! \brief Copy num_rows rows of src starting at row into a new array. */
+inline NDArray SliceRows(const NDArray& src, int64_t row, int64_t num_rows) {
+  std::vector<int64_t> shape(src->shape, src->shape + src->ndim);
+  shape[0] = num_rows;
+  NDArray ret = NDArray::Empty(shape, src->dtype, src->ctx);
+  CopyRows(src.operator->(), row, ret.operator->(), 0, num_rows);
+  return ret;
+}
+
+/*!
+ * \brief Micro-batching executor wrapping a GraphRuntime or a VirtualMachine.
+ *
+ *  A GraphRuntime is compiled for a fixed batch, so partial batches leave
+ *  the trailing rows of its inputs unused. A VirtualMachine is invoked with
+ *  inputs of exactly the gathered batch size, which needs a model compiled
+ *  with a dynamic batch axis.
+ */
+class BatchingExecutor : public ModuleNode {
+ public:
+  /*! \brief The outputs and latencies of one request. */
+  struct Result {
+    /*! \brief The outputs of the request. */
+    std::vector<NDArray> outputs;
+    /*! \brief Nanoseconds the request waited to be batched. */
+    int64_t queue_ns;
+    /*! \brief Nanoseconds the batch holding the request took to run. */
+    int64_t exec_ns;
+    /*! \brief Number of rows of the batch holding the request. */
+    int64_t batch_size;
+  };
+
+  /*!
+   * \brief Create the executor.
+   * \param model The GraphRuntime or VirtualMachine module.
+   * \param max_batch_size The maximum number of rows in a batch.
+   * \param timeout_us The maximum time in microseconds a request waits for
+   *  the batch to fill up.
+   * \param func_name The function invoked on a VirtualMachine.
+   * \param input_names The inputs of a GraphRuntime that requests provide,
+   *  in order.
+   */
+  BatchingExecutor(Module model,
+                   int64_t max_batch_size,
+                   int64_t timeout_us,
+                   std::string func_name,
+                   std::vector<std::string> input_names)
+      : model_(model),
+        max_batch_size_(max_batch_size),
+        timeout_(std::chrono::microseconds(timeout_us)),
+        func_name_(func_name),
+        input_names_(input_names) {
+    CHECK_GT(max_batch_size, 0);
+    is_vm_ = std::string(model->type_key()) == "VirtualMachine";
+    if (is_vm_) {
+      f_set_input_ = model.GetFunction("set_input");
+      f_invoke_ = model.GetFunction("invoke");
+    } else {
+      CHECK(!input_names_.empty()) << "The batched inputs of the graph are not specified";
+      f_set_input_ = model.GetFunction("set_input");
+      f_get_input_ = model.GetFunction("get_input");
+      f_run_ = model.GetFunction("run");
+      f_get_output_ = model.GetFunction("get_output");
+      f_get_num_outputs_ = model.GetFunction("get_num_outputs");
+      CHECK(f_get_input_ != nullptr && f_run_ != nullptr && f_get_output_ != nullptr)
+          << "Batching only supports GraphRuntime and VirtualMachine, but got "
+          << model->type_key();
+      NDArray input = f_get_input_(input_names_[0]);
+      max_batch_size_ = std::min(max_batch_size_, input->shape[0]);
+    }
+    worker_ = std::thread([this] { this->Loop(); });
+  }
+
+  ~BatchingExecutor() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      exit_now_ = true;
+    }
+    cv_.notify_all();
+    worker_.join();
+  }
+
+  const char* type_key() const final {
+    return "BatchingExecutor";
+  }
+
+  /*!
+   * \brief Submit a request.
+   * \param inputs The inputs, all with the same number of rows along the first axis.
+   * \return The future result of the request.
+   */
+  std::future<Result> Submit(std::vector<NDArray> inputs) {
+    CHECK(!inputs.empty());
+    std::unique_ptr<Request> req(new Request());
+    req->rows = inputs[0]->shape[0];
+    CHECK_LE(req->rows, max_batch_size_)
+        << "Request of " << req->rows << " rows exceeds the maximum batch size "
+        << max_batch_size_;
+    for (const NDArray& input : inputs) {
+      CHECK_EQ(input->shape[0], req->rows) << "Inputs of a request differ in batch size";
+    }
+    req->inputs = std::move(inputs);
+    req->enqueue_time = Clock::now();
+    std::future<Result> ret = req->promise.get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.push_back(std::move(req));
+    }
+    cv_.notify_all();
+    return ret;
+  }
+
+  PackedFunc GetFunction(const std::string& name,
+                         const ObjectPtr<Object>& sptr_to_self) final {
+    if (name == "infer") {
+      return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+          std::vector<NDArray> inputs;
+          for (int i = 0; i < args.size(); ++i) {
+            inputs.push_back(args[i]);
+          }
+          Result res = this->Submit(inputs).get();
+          std::vector<ObjectRef> fields(res.outputs.begin(), res.outputs.end());
+          *rv = ADT::Tuple(fields);
+        });
+    } else if (name == "get_stats") {
+      return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+          *rv = this->StatsJSON();
+        });
+    } else if (name == "reset_stats") {
+      return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+          num_request_ = 0;
+          num_batch_ = 0;
+          queue_ns_ = 0;
+          max_queue_ns_ = 0;
+          exec_ns_ = 0;
+          max_exec_ns_ = 0;
+        });
+    } else {
+      return PackedFunc();
+    }
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  /*! \brief A queued request. */
+  struct Request {
+    std::vector<NDArray> inputs;
+    int64_t rows;
+    Clock::time_point enqueue_time;
+    std::promise<Result> promise;
+  };
+
+  // Gather and run batches until the executor is destroyed.
+  void Loop() {
+    while (true) {
+      std::vector<std::unique_ptr<Request> > batch;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return exit_now_ || !queue_.empty(); });
+        if (exit_now_ && queue_.empty()) return;
+        // wait for the batch to fill up, bounded by the age of the oldest request.
+        Clock::time_point deadline = queue_.front()->enqueue_time + timeout_;
+        cv_.wait_until(lock, deadline, [this] {
+            return exit_now_ || QueuedRows() >= max_batch_size_;
+          });
+        int64_t rows = 0;
+        while (!queue_.empty() && rows + queue_.front()->rows <= max_batch_size_) {
+          rows += queue_.front()->rows;
+          batch.push_back(std::move(queue_.front()));
+          queue_.pop_front();
+        }
+      }
+      RunBatch(&batch);
+    }
+  }
+
+  int64_t QueuedRows() const {
+    int64_t rows = 0;
+    for (const auto& req : queue_) {
+      rows += req->rows;
+    }
+    return rows;
+  }
+
+  void RunBatch(std::vector<std::unique_ptr<Request> >* batch) {
+    Clock::time_point tbegin = Clock::now();
+    std::vector<int64_t> row_offset;
+    int64_t rows = 0;
+    for (const auto& req : *batch) {
+      row_offset.push_back(rows);
+      rows += req->rows;
+    }
+    std::vector<NDArray> outputs;
+    try {
+      outputs = is_vm_ ? RunVM(*batch, rows) : RunGraph(*batch);
+    } catch (const std::exception&) {
+      for (auto& req : *batch) {
+        req->promise.set_exception(std::current_exception());
+      }
+      return;
+    }
+    int64_t exec_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - tbegin).count();
+    for (size_t i = 0; i < batch->size(); ++i) {
+      Request* req = (*batch)[i].get();
+      Result res;
+      for (const NDArray& out : outputs) {
+        res.outputs.push_back(SliceRows(out, row_offset[i], req->rows));
+      }
+      res.queue_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          tbegin - req->enqueue_time).count();
+      res.exec_ns = exec_ns;
+      res.batch_size = rows;
+      RecordRequest(res);
+      req->promise.set_value(std::move(res));
+    }
+    num_batch_.fetch_add(1);
+  }
+
+  // Copy the requests into the fixed size inputs of the graph and run it.
+  std::vector<NDArray> RunGraph(const std::vector<std::unique_ptr<Request> >& batch) {
+    for (size_t k = 0; k < input_names_.size(); ++k) {
+      NDArray input = f_get_input_(input_names_[k]);
+      int64_t row = 0;
+      for (const auto& req : batch) {
+        CHECK_EQ(req->inputs.size(), input_names_.size())
+            << "Expect " << input_names_.size() << " inputs per request";
+        CopyRows(req->inputs[k].operator->(), 0, input.operator->(), row, req->rows);
+        row += req->rows;
+      }
+    }
+    f_run_();
+    std::vector<NDArray> outputs;
+    int num_outputs = f_get_num_outputs_();
+    for (int i = 0; i < num_outputs; ++i) {
+      outputs.push_back(f_get_output_(i));
+    }
+    return outputs;
+  }
+
+  // Concatenate the requests into inputs of exactly rows rows and invoke the VM.
+  std::vector<NDArray> RunVM(const std::vector<std::unique_ptr<Request> >& batch, int64_t rows) {
+    size_t num_inputs = batch[0]->inputs.size();
+    std::vector<TVMValue> values(num_inputs + 1);
+    std::vector<int> tcodes(num_inputs + 1);
+    std::vector<NDArray> inputs;
+    for (size_t k = 0; k < num_inputs; ++k) {
+      const NDArray& first = batch[0]->inputs[k];
+      std::vector<int64_t> shape(first->shape, first->shape + first->ndim);
+      shape[0] = rows;
+      NDArray input = NDArray::Empty(shape, first->dtype, first->ctx);
+      int64_t row = 0;
+      for (const auto& req : batch) {
+        CHECK_EQ(req->inputs.size(), num_inputs) << "Requests differ in number of inputs";
+        CopyRows(req->inputs[k].operator->(), 0, input.operator->(), row, req->rows);
+        row += req->rows;
+      }
+      inputs.push_back(input);
+    }
+    TVMArgsSetter setter(values.data(), tcodes.data());
+    setter(0, func_name_);
+    for (size_t k = 0; k < num_inputs; ++k) {
+      setter(k + 1, inputs[k]);
+    }
+    TVMRetValue rv;
+    f_set_input_.CallPacked(TVMArgs(values.data(), tcodes.data(), num_inputs + 1), &rv);
+    ObjectRef ret = f_invoke_(func_name_);
+    std::vector<NDArray> outputs;
+    if (const auto* adt = ret.as<ADTObj>()) {
+      for (size_t i = 0; i < adt->size; ++i) {
+        outputs.push_back(Downcast<NDArray>((*adt)[i]));
+      }
+    } else {
+      outputs.push_back(Downcast<NDArray>(ret));
+    }
+    return outputs;
+  }
+
+  void RecordRequest(const Result& res) {
+    num_request_.fetch_add(1);
+    queue_ns_.fetch_add(res.queue_ns);
+    exec_ns_.fetch_add(res.exec_ns);
+    max_queue_ns_.store(std::max(max_queue_ns_.load(), res.queue_ns));
+    max_exec_ns_.store(std::max(max_exec_ns_.load(), res.exec_ns));
+  }
+
+  std::string StatsJSON() const {
+    std::ostringstream os;
+    os << "{\"max_batch_size\": " << max_batch_size_
+       << ", \"num_request\": " << num_request_.load()
+       << ", \"num_batch\": " << num_batch_.load()
+       << ", \"queue_ns\": " << queue_ns_.load()
+       << ", \"max_queue_ns\": " << max_queue_ns_.load()
+       << ", \"exec_ns\": " << exec_ns_.load()
+       << ", \"max_exec_ns\": " << max_exec_ns_.load()
+       << "}";
+    return os.str();
+  }
+
+  /*! \brief The wrapped model. */
+  Module model_;
+  /*! \brief Whether the model is a VirtualMachine. */
+  bool is_vm_;
+  /*! \brief The maximum number of rows in a batch. */
+  int64_t max_batch_size_;
+  /*! \brief The maximum time the oldest request waits for a batch to fill up. */
+  Clock::duration timeout_;
+  /*! \brief The function invoked on a VirtualMachine. */
+  std::string func_name_;
+  /*! \brief The batched inputs of a GraphRuntime. */
+  std::vector<std::string> input_names_;
+  // The functions of the model.
+  PackedFunc f_set_input_, f_get_input_, f_run_, f_get_output_, f_get_num_outputs_, f_invoke_;
+  // The queued requests.
+  std::deque<std::unique_ptr<Request> > queue_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool exit_now_{false};
+  // Request statistics, latencies are in nanoseconds.
+  std::atomic<int64_t> num_request_{0};
+  std::atomic<int64_t> num_batch_{0};
+  std::atomic<int64_t> queue_ns_{0};
+  std::atomic<int64_t> max_queue_ns_{0};
+  std::atomic<int64_t> exec_ns_{0};
+  std::atomic<int64_t> max_exec_ns_{0};
+  /*! \brief The thread gathering and running the batches, declared last to start last. */
+  std::thread worker_;
+};
+
+TVM_REGISTER_GLOBAL("tvm.batching_executor.create")
+.set_body([](TVMArgs args, TVMRetValue* rv) {
+    CHECK_GE(args.num_args, 4)
+        << "The expected arguments are model, max_batch_size, timeout_us, func_name "
+        << "and the names of the batched inputs";
+    std::vector<std::string> input_names;
+    for (int i = 4; i < args.num_args; ++i) {
+      input_names.push_back(args[i]);
+    }
+    int64_t max_batch_size = args[1];
+    int64_t timeout_us = args[2];
+    auto exec = make_object<BatchingExecutor>(
+        args[0].operator Module(), max_batch_size, timeout_us, args[3].operator std::string(),
+        input_names);
+    *rv = Module(exec);
+  });
+
+}  // namespace runtime
+}  // namespace tvm
@@ -22,10 +22,17 @@
  */
 #include <dmlc/json.h>
 #include <dmlc/logging.h>
+#include <tvm/runtime/device_api.h>
 #include <tvm/runtime/serializer.h>
 #include <fstream>
 #include <vector>
 #include <unordered_map>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include "file_util.h"
 
 namespace tvm {
@@ -124,6 +131,90 @@ void LoadBinaryFromFile(const std::string& file_name,
   fs.read(&(*data)[0], size);
 }
 
+MappedFile::MappedFile(const std::string& file_name) {
+#if !defined(_WIN32)
+  int fd = open(file_name.c_str(), O_RDONLY);
+  CHECK_GE(fd, 0) << "Cannot open " << file_name;
+  struct stat st;
+  CHECK_EQ(fstat(fd, &st), 0) << "Cannot stat " << file_name;
+  size_ = static_cast<size_t>(st.st_size);
+  if (size_ != 0) {
+    void* ptr = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    CHECK(ptr != MAP_FAILED) << "Cannot map " << file_name;
+    data_ = static_cast<char*>(ptr);
+  }
+  close(fd);
+#else
+  std::ifstream fs(file_name, std::ios::in | std::ios::binary);
+  CHECK(!fs.fail()) << "Cannot open " << file_name;
+  fs.seekg(0, std::ios::end);
+  size_ = static_cast<size_t>(fs.tellg());
+  fs.seekg(0, std::ios::beg);
+  // the aligned tensors are views of the data, so align it as a mapping is.
+  buffer_.resize(size_ + kAllocAlignment);
+  size_t misalign = reinterpret_cast<uintptr_t>(&buffer_[0]) % kAllocAlignment;
+  data_ = &buffer_[0] + (misalign == 0 ? 0 : kAllocAlignment - misalign);
+  fs.read(data_, size_);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#if !defined(_WIN32)
+  if (data_ != nullptr) munmap(data_, size_);
+#endif
+}
+
+NDArray LoadMappedDLTensor(dmlc::SeekStream* strm, const std::shared_ptr<MappedFile>& file) {
+  size_t begin = strm->Tell();
+  uint64_t header, reserved;
+  CHECK(strm->Read(&header) && header == kTVMNDArrayMagic)
+      << "Invalid DLTensor file format";
+  CHECK(strm->Read(&reserved))
+      << "Invalid DLTensor file format";
+  if (reserved != kTVMNDArrayAlignedVersion) {
+    strm->Seek(begin);
+    NDArray ret;
+    ret.Load(strm);
+    return ret;
+  }
+  // Keeps the file mapped and the shape alive for the view.
+  struct MappedTensor {
+    std::shared_ptr<MappedFile> file;
+    std::vector<int64_t> shape;
+    DLManagedTensor managed;
+  };
+  MappedTensor* tensor = new MappedTensor();
+  tensor->file = file;
+  DLTensor& dl_tensor = tensor->managed.dl_tensor;
+  CHECK(strm->Read(&dl_tensor.ctx) && strm->Read(&dl_tensor.ndim) && strm->Read(&dl_tensor.dtype))
+      << "Invalid DLTensor file format";
+  tensor->shape.resize(dl_tensor.ndim);
+  if (dl_tensor.ndim != 0) {
+    CHECK(strm->ReadArray(&tensor->shape[0], dl_tensor.ndim))
+        << "Invalid DLTensor file format";
+  }
+  int64_t data_byte_size;
+  uint64_t padding;
+  CHECK(strm->Read(&data_byte_size) && strm->Read(&padding))
+      << "Invalid DLTensor file format";
+  dl_tensor.shape = tensor->shape.data();
+  dl_tensor.strides = nullptr;
+  // the view covers the bytes its shape and dtype describe.
+  CHECK_EQ(static_cast<size_t>(data_byte_size), GetDataSize(dl_tensor))
+      << "Invalid DLTensor file format";
+  size_t data_pos = strm->Tell() + padding;
+  CHECK_LE(data_pos + data_byte_size, file->size())
+      << "Invalid DLTensor file format";
+  strm->Seek(data_pos + data_byte_size);
+  dl_tensor.data = file->data() + data_pos;
+  dl_tensor.byte_offset = 0;
+  tensor->managed.manager_ctx = tensor;
+  tensor->managed.deleter = [](DLManagedTensor* self) {
+    delete static_cast<MappedTensor*>(self->manager_ctx);
+  };
+  return NDArray::FromDLPack(&tensor->managed);
+}
+
 void SaveBinaryToFile(
     const std::string& file_name,
     const std::string& data) {
@@ -24,6 +24,8 @@
 #ifndef TVM_RUNTIME_FILE_UTIL_H_
 #define TVM_RUNTIME_FILE_UTIL_H_
 
+#include <tvm/runtime/ndarray.h>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include "meta_data.h"
@@ -91,6 +93,51 @@ void LoadMetaDataFromFile(
     const std::string& file_name,
     std::unordered_map<std::string, FunctionInfo>* fmap);
 
+/*!
+ * \brief A file mapped into memory copy-on-write, so that writes to the
+ *  memory stay private to the process.
+ *
+ *  On platforms without mmap, the file is read into memory aligned as a
+ *  mapping would be instead.
+ */
+class MappedFile {
+ public:
+  /*!
+   * \brief Map a file.
+   * \param file_name The name of the file.
+   */
+  explicit MappedFile(const std::string& file_name);
+  ~MappedFile();
+  /*! \return The mapped content. */
+  char* data() const {
+    return data_;
+  }
+  /*! \return The size of the file. */
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  char* data_{nullptr};
+  size_t size_{0};
+  /*! \brief The content of the file when it is not mapped, data_ is
+   *  aligned to kAllocAlignment in it. */
+  std::string buffer_;
+};
+
+/*!
+ * \brief Load a DLTensor saved by SaveDLTensor or SaveDLTensorAligned
+ *  from a mapped file.
+ *
+ *  The data of an aligned tensor is not copied, the returned array is a
+ *  view of the mapping that keeps the file mapped.
+ *
+ * \param strm A stream over the whole mapped file, positioned at the tensor.
+ * \param file The mapped file.
+ * \return The loaded array.
+ */
+NDArray LoadMappedDLTensor(dmlc::SeekStream* strm, const std::shared_ptr<MappedFile>& file);
+
 /*!
  * \brief Remove (unlink) a file.
  * \param file_name The file name.
@@ -25,16 +25,19 @@
 #include <tvm/runtime/packed_func.h>
 #include <tvm/runtime/registry.h>
 #include <tvm/runtime/serializer.h>
+#include <tvm/runtime/threading_backend.h>
 
 #include <algorithm>
 #include <functional>
 #include <memory>
 #include <numeric>
+#include <sstream>
 #include <string>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
+#include "../file_util.h"
 #include "graph_runtime.h"
 
 namespace tvm {
@@ -56,6 +59,13 @@ void GraphRuntime::Run() {
     if (op_execs_[i]) op_execs_[i]();
   }
 }
+
+void GraphRuntime::RunNodes(uint32_t begin, uint32_t end) {
+  CHECK_LE(end, op_execs_.size());
+  for (uint32_t i = begin; i < end; ++i) {
+    if (op_execs_[i]) op_execs_[i]();
+  }
+}
 /*!
  * \brief Initialize the graph executor with graph and context.
  * \param graph_json The execution graph.
@@ -105,6 +115,9 @@ int GraphRuntime::GetInputIndex(const std::string& name) {
 void GraphRuntime::SetInput(int index, DLTensor* data_in) {
   CHECK_LT(static_cast<size_t>(index), input_nodes_.size());
   uint32_t eid = this->entry_id(input_nodes_[index], 0);
+  CHECK(!shares_params_ || param_eids_.count(eid) == 0)
+      << "Cannot overwrite parameter " << nodes_[input_nodes_[index]].name
+      << " of an execution context, which shares it with other contexts";
   data_entry_[eid].CopyFrom(data_in);
 }
 /*!
@@ -217,9 +230,66 @@ void GraphRuntime::LoadParams(dmlc::Stream* strm) {
     NDArray temp;
     temp.Load(strm);
     data_entry_[eid].CopyFrom(temp);
+    param_eids_.insert(eid);
   }
 }
 
+void GraphRuntime::LoadParamsFromFile(const std::string& file_name) {
+  auto file = std::make_shared<MappedFile>(file_name);
+  dmlc::MemoryFixedSizeStream memstrm(file->data(), file->size());
+  dmlc::SeekStream* strm = &memstrm;
+  uint64_t header, reserved;
+  CHECK(strm->Read(&header))
+      << "Invalid parameters file format";
+  CHECK(header == kTVMNDArrayListMagic)
+      << "Invalid parameters file format";
+  CHECK(strm->Read(&reserved))
+      << "Invalid parameters file format";
+  std::vector<std::string> names;
+  CHECK(strm->Read(&names))
+      << "Invalid parameters file format";
+  uint64_t sz;
+  strm->Read(&sz);
+  size_t size = static_cast<size_t>(sz);
+  CHECK(size == names.size())
+      << "Invalid parameters file format";
+  std::unordered_set<uint32_t> mapped_eids;
+  for (size_t i = 0; i < size; ++i) {
+    int in_idx = GetInputIndex(names[i]);
+    CHECK_GE(in_idx, 0) << "Found param for non-existent input: " << names[i];
+    uint32_t eid = this->entry_id(input_nodes_[in_idx], 0);
+    CHECK_LT(eid, data_entry_.size());
+    NDArray temp = LoadMappedDLTensor(strm, file);
+    const DLTensor* from = temp.operator->();
+    const DLTensor* to = data_entry_[eid].operator->();
+    bool is_view = static_cast<const char*>(from->data) >= file->data() &&
+        static_cast<const char*>(from->data) < file->data() + file->size();
+    if (is_view && to->ctx.device_type == kDLCPU && from->ndim == to->ndim &&
+        std::equal(from->shape, from->shape + from->ndim, to->shape) &&
+        from->dtype.code == to->dtype.code && from->dtype.bits == to->dtype.bits &&
+        from->dtype.lanes == to->dtype.lanes) {
+      data_entry_[eid] = temp;
+      data_alignment_[eid] = details::GetDataAlignment(*from);
+      mapped_eids.insert(eid);
+    } else {
+      data_entry_[eid].CopyFrom(temp);
+    }
+    param_eids_.insert(eid);
+  }
+  if (mapped_eids.empty()) return;
+  // Release the storage whose entries are all mapped now.
+  std::vector<bool> released(storage_pool_.size(), true);
+  for (size_t i = 0; i < attrs_.storage_id.size(); ++i) {
+    if (mapped_eids.count(static_cast<uint32_t>(i)) == 0) {
+      released[attrs_.storage_id[i]] = false;
+    }
+  }
+  for (size_t sid = 0; sid < storage_pool_.size(); ++sid) {
+    if (released[sid]) storage_pool_[sid] = NDArray();
+  }
+  this->SetupOpExecs();
+}
+
 void GraphRuntime::ShareParams(const GraphRuntime& other, dmlc::Stream* strm) {
     uint64_t header, reserved;
     CHECK(strm->Read(&header))
@@ -244,11 +314,35 @@ void GraphRuntime::ShareParams(const GraphRuntime& other, dmlc::Stream* strm) {
     CHECK_GT(data_entry_[eid].use_count(), 1);
     const DLTensor* tmp = data_entry_[eid].operator->();
     data_alignment_[eid] = details::GetDataAlignment(*tmp);
+    param_eids_.insert(eid);
   }
   this->SetupOpExecs();
 }
 
-void GraphRuntime::SetupStorage() {
+Module GraphRuntime::CreateContext() const {
+  auto exec = make_object<GraphRuntime>();
+  exec->nodes_ = nodes_;
+  exec->input_nodes_ = input_nodes_;
+  exec->input_map_ = input_map_;
+  exec->node_row_ptr_ = node_row_ptr_;
+  exec->outputs_ = outputs_;
+  exec->attrs_ = attrs_;
+  exec->module_ = module_;
+  exec->ctxs_ = ctxs_;
+  exec->op_funcs_ = op_funcs_;
+  exec->param_eids_ = param_eids_;
+  exec->shares_params_ = true;
+  exec->SetupStorage(this);
+  // the inputs set by SetInput, parameters among them, start out the same.
+  for (uint32_t nid : input_nodes_) {
+    uint32_t eid = entry_id(nid, 0);
+    if (param_eids_.count(eid) == 0) exec->data_entry_[eid].CopyFrom(data_entry_[eid]);
+  }
+  exec->SetupOpExecs();
+  return Module(exec);
+}
+
+void GraphRuntime::SetupStorage(const GraphRuntime* params_owner) {
   // Grab saved optimization plan from graph.
   std::vector<TVMType> vtype;
   for (const std::string& s_type : attrs_.dltype) {
@@ -287,8 +381,24 @@ void GraphRuntime::SetupStorage() {
     pool_entry[sid].device_type = device_type;
   }
 
+  // Pool entries that only back parameters of params_owner need no space,
+  // the entries are views of the owner's parameters instead.
+  std::vector<bool> param_only(pool_entry.size(), params_owner != nullptr);
+  if (params_owner != nullptr) {
+    for (size_t i = 0; i < attrs_.storage_id.size(); ++i) {
+      if (params_owner->param_eids_.count(static_cast<uint32_t>(i)) == 0) {
+        param_only[attrs_.storage_id[i]] = false;
+      }
+    }
+  }
+
   // Allocate the space.
-  for (const auto& pit : pool_entry) {
+  for (size_t sid = 0; sid < pool_entry.size(); ++sid) {
+    const auto& pit = pool_entry[sid];
+    if (param_only[sid]) {
+      storage_pool_.push_back(NDArray());
+      continue;
+    }
     std::vector<int64_t> shape;
     // This for loop is very fast since there are usually only a couple of
     // devices available on the same hardware.
@@ -310,8 +420,12 @@ void GraphRuntime::SetupStorage() {
   for (size_t i = 0; i < data_entry_.size(); ++i) {
     int storage_id = attrs_.storage_id[i];
     CHECK_LT(static_cast<size_t>(storage_id), storage_pool_.size());
-    data_entry_[i] =
-        storage_pool_[storage_id].CreateView(attrs_.shape[i], vtype[i]);
+    if (params_owner != nullptr && params_owner->param_eids_.count(i) != 0) {
+      data_entry_[i] = params_owner->data_entry_[i];
+    } else {
+      data_entry_[i] =
+          storage_pool_[storage_id].CreateView(attrs_.shape[i], vtype[i]);
+    }
     const DLTensor* tmp = data_entry_[i].operator->();
     data_alignment_[i] = details::GetDataAlignment(*tmp);
   }
@@ -319,6 +433,8 @@ void GraphRuntime::SetupStorage() {
 
 void GraphRuntime::SetupOpExecs() {
   op_execs_.resize(this->GetNumOfNodes());
+  // the tensors of the previous operators are released on a second setup.
+  input_dltensors_.clear();
   input_dltensors_.resize(num_node_entries());
   std::unordered_set<uint32_t> input_node_eids;
   for (size_t i = 0; i < input_nodes_.size(); i++) {
@@ -395,8 +511,11 @@ std::pair<std::function<void()>, std::shared_ptr<GraphRuntime::OpArgs> > GraphRu
 
   // Get compiled function from the module that contains both host and device
   // code.
-  tvm::runtime::PackedFunc pf = module_.GetFunction(param.func_name, true);
-  CHECK(pf != nullptr) << "no such function in module: " << param.func_name;
+  tvm::runtime::PackedFunc& pf = op_funcs_[param.func_name];
+  if (pf == nullptr) {
+    pf = module_.GetFunction(param.func_name, true);
+    CHECK(pf != nullptr) << "no such function in module: " << param.func_name;
+  }
 
   auto fexec = [arg_ptr, pf]() {
     TVMRetValue rv;
@@ -461,6 +580,10 @@ PackedFunc GraphRuntime::GetFunction(
     return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
         this->LoadParams(args[0].operator std::string());
       });
+  } else if (name == "load_params_from_file") {
+    return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+        this->LoadParamsFromFile(args[0]);
+      });
   } else if (name == "share_params") {
     return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
         const auto& module = args[0].operator Module();
@@ -469,6 +592,10 @@ PackedFunc GraphRuntime::GetFunction(
         dmlc::MemoryStringStream strm(const_cast<std::string*>(&param_blob));
         this->ShareParams(dynamic_cast<const GraphRuntime&>(*module.operator->()), &strm);
       });
+  } else if (name == "create_context") {
+    return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+        *rv = this->CreateContext();
+      });
   } else {
     return PackedFunc();
   }
@@ -496,6 +623,57 @@ std::vector<TVMContext> GetAllContext(const TVMArgs& args) {
   return ret;
 }
 
+std::vector<std::vector<unsigned> > ParseCoreGroups(const std::string& spec, size_t num_groups) {
+  std::vector<std::vector<unsigned> > cores;
+  if (spec.empty()) {
+    int num_cores = threading::MaxConcurrency();
+    int per_group = std::max(num_cores / static_cast<int>(num_groups), 1);
+    for (size_t i = 0; i < num_groups; ++i) {
+      std::vector<unsigned> group;
+      for (int k = 0; k < per_group; ++k) {
+        group.push_back(static_cast<unsigned>((i * per_group + k) % num_cores));
+      }
+      cores.push_back(group);
+    }
+    return cores;
+  }
+  std::istringstream is(spec);
+  std::string group_spec;
+  while (std::getline(is, group_spec, ';')) {
+    std::vector<unsigned> group;
+    std::istringstream gs(group_spec);
+    std::string item;
+    while (std::getline(gs, item, ',')) {
+      size_t dash = item.find('-');
+      int first = std::stoi(item.substr(0, dash));
+      int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+      CHECK(first >= 0 && first <= last) << "Invalid core range " << item;
+      for (int core = first; core <= last; ++core) {
+        group.push_back(static_cast<unsigned>(core));
+      }
+    }
+    cores.push_back(group);
+  }
+  CHECK_EQ(cores.size(), num_groups)
+      << "The cores of " << cores.size() << " groups are given, but "
+      << num_groups << " groups are needed";
+  return cores;
+}
+
+void BindThreadPool(const std::vector<unsigned>& cores) {
+  if (cores.empty()) return;
+  const PackedFunc* fconfig = Registry::Get("runtime.config_threadpool_cores");
+  if (fconfig == nullptr) return;
+  std::vector<TVMValue> values(cores.size());
+  std::vector<int> tcodes(cores.size());
+  TVMArgsSetter setter(values.data(), tcodes.data());
+  for (size_t i = 0; i < cores.size(); ++i) {
+    setter(i, static_cast<int>(cores[i]));
+  }
+  TVMRetValue rv;
+  fconfig->CallPacked(TVMArgs(values.data(), tcodes.data(), static_cast<int>(cores.size())), &rv);
+}
+
 // 4-argument version is currently reserved to keep support of calling
 // from tvm4j and javascript, since they don't have heterogeneous
 // execution support yet. For heterogenenous execution, at least 5 arguments will
@@ -33,6 +33,7 @@
 
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 #include <string>
@@ -90,6 +91,12 @@ class GraphRuntime : public ModuleNode {
     return "GraphRuntime";
   }
   void Run();
+  /*!
+   * \brief Run the operators of the nodes in [begin, end) in order.
+   * \param begin The first node.
+   * \param end The node after the last one.
+   */
+  void RunNodes(uint32_t begin, uint32_t end);
 
   /*!
    * \brief Initialize the graph executor with graph and context.
@@ -160,6 +167,17 @@ class GraphRuntime : public ModuleNode {
    */
   void LoadParams(const std::string& param_blob);
 
+  /*!
+   * \brief Load parameters from a file mapped into memory.
+   *
+   *  The parameters on CPU saved with their data aligned become views of
+   *  the mapping instead of copies, and the storage which only backed them
+   *  is released. Processes mapping the same file share its pages.
+   *
+   * \param file_name The name of the parameter file.
+   */
+  void LoadParamsFromFile(const std::string& file_name);
+
   /*!
    * \brief Share parameters from pre-existing GraphRuntime instance.
    * \param other A GraphRuntime instance, previously with |LoadParams| called with the
@@ -168,6 +186,20 @@ class GraphRuntime : public ModuleNode {
    */
   void ShareParams(const GraphRuntime& other, dmlc::Stream* strm);
 
+  /*!
+   * \brief Create a lightweight execution context of the loaded graph.
+   *
+   *  The context shares the parameters loaded by |LoadParams| and the
+   *  resolved operator functions with this runtime, and owns its activation
+   *  storage sized by the graph's storage plan. The other inputs, such as
+   *  parameters set by |SetInput|, are copied into it. Different contexts can run
+   *  concurrently on different threads, as long as the parameters of this
+   *  runtime are not updated meanwhile.
+   *
+   * \return The execution context as a GraphRuntime module.
+   */
+  Module CreateContext() const;
+
   /*!
    * \brief Get total number of nodes.
    * \return Total number of nodes.
@@ -366,8 +398,12 @@ class GraphRuntime : public ModuleNode {
       }
       CHECK_EQ(bitmask, 1|2|4|8|16) << "invalid format";
   }
-  /*! \brief Setup the temporal storage */
-  void SetupStorage();
+  /*!
+   * \brief Setup the temporal storage
+   * \param params_owner If not null, the runtime whose parameters are reused
+   *  instead of allocating storage for them.
+   */
+  void SetupStorage(const GraphRuntime* params_owner = nullptr);
   /*! \brief Setup the executors. */
   void SetupOpExecs();
   /*!
@@ -418,9 +454,31 @@ class GraphRuntime : public ModuleNode {
   std::vector<size_t> data_alignment_;
   /*! \brief Operator on each node. */
   std::vector<std::function<void()> > op_execs_;
+  /*! \brief Entries holding parameters, loaded or shared from another runtime. */
+  std::unordered_set<uint32_t> param_eids_;
+  /*! \brief Whether the parameters are shared with the runtime this context was created from. */
+  bool shares_params_{false};
+  /*! \brief The resolved operator functions by name. */
+  std::unordered_map<std::string, PackedFunc> op_funcs_;
 };
 
 std::vector<TVMContext> GetAllContext(const TVMArgs& args);
+
+/*!
+ * \brief Parse groups of cores, or split the available cores evenly.
+ * \param spec Semicolon separated groups of comma separated core ids or
+ *  ranges, e.g. "0-3;4,5", empty to split the cores evenly.
+ * \param num_groups The number of groups.
+ * \return The cores of each group.
+ */
+std::vector<std::vector<unsigned> > ParseCoreGroups(const std::string& spec, size_t num_groups);
+
+/*!
+ * \brief Bind the thread pool of the calling thread to the cores. The thread
+ *  gets a pool of its own even when the others share the process-wide one.
+ * \param cores The cores, empty to leave the thread pool as is.
+ */
+void BindThreadPool(const std::vector<unsigned>& cores);
 }  // namespace runtime
 }  // namespace tvm
 
@@ -0,0 +1,326 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file graph_runtime_interop.cc
+ * \brief Graph runtime running independent operators concurrently.
+ */
+#include <tvm/runtime/ndarray.h>
+#include <tvm/runtime/packed_func.h>
+#include <tvm/runtime/registry.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "graph_runtime.h"
+
+namespace tvm {
+namespace runtime {
+
+/*!
+ * \brief Graph runtime with inter-operator parallelism.
+ *
+ *  The nodes form a dependency graph, in which a node depends on the
+ *  producers of its inputs. Since the storage plan lets entries that are
+ *  never live at the same time share storage, a node writing a storage
+ *  also depends on the earlier readers and writer of that storage. Ready
+ *  nodes are run by a group of executor threads, each with a thread pool
+ *  bound to its own slice of the cores.
+ */
+class GraphRuntimeInterOp : public GraphRuntime {
+ public:
+  ~GraphRuntimeInterOp() {
+    Stop();
+  }
+
+  /*!
+   * \brief Set the executor threads, takes effect on the next run.
+   * \param num_workers The number of executor threads.
+   * \param worker_cores The cores of each executor, in the format of
+   *  ParseCoreGroups. Empty to split the cores evenly.
+   */
+  void ConfigureInterOp(int num_workers, const std::string& worker_cores) {
+    CHECK_GE(num_workers, 1);
+    Stop();
+    worker_cores_ = ParseCoreGroups(worker_cores, num_workers);
+  }
+
+  /*! \brief Run the graph, with independent nodes running concurrently. */
+  void RunInterOp() {
+    if (succ_.empty()) BuildDependency();
+    if (workers_.empty()) Start();
+    int64_t tbegin = NowNanos();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      error_.clear();
+      failed_.store(false, std::memory_order_relaxed);
+      num_remaining_ = static_cast<int>(nodes_.size());
+      for (uint32_t nid = 0; nid < nodes_.size(); ++nid) {
+        num_pending_[nid].store(num_pred_[nid], std::memory_order_relaxed);
+        if (num_pred_[nid] == 0) ready_.push_back(nid);
+      }
+      run_begin_ns_ = tbegin;
+    }
+    cv_.notify_all();
+    std::string error;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      done_cv_.wait(lock, [this] { return num_remaining_ == 0; });
+      error = error_;
+    }
+    last_run_ns_ = NowNanos() - tbegin;
+    ++num_runs_;
+    CHECK(error.empty()) << error;
+  }
+
+  /*!
+   * \return The timing of the nodes in the last run in json, relative to
+   *  its beginning, and the achieved overlap of the operators.
+   */
+  std::string NodeStatsJSON() const {
+    int64_t busy = 0;
+    std::ostringstream os;
+    os << "{\"num_workers\": " << worker_cores_.size()
+       << ", \"num_runs\": " << num_runs_
+       << ", \"nodes\": [";
+    bool first = true;
+    for (uint32_t nid = 0; nid < node_timing_.size(); ++nid) {
+      if (!op_execs_[nid]) continue;
+      const NodeTiming& t = node_timing_[nid];
+      busy += t.end_ns - t.begin_ns;
+      os << (first ? "" : ", ")
+         << "{\"name\": \"" << nodes_[nid].name << "\""
+         << ", \"worker\": " << t.worker
+         << ", \"begin_ns\": " << t.begin_ns
+         << ", \"end_ns\": " << t.end_ns << "}";
+      first = false;
+    }
+    os << "], \"run_ns\": " << last_run_ns_
+       << ", \"busy_ns\": " << busy
+       << ", \"overlap\": " << (last_run_ns_ > 0 ? static_cast<double>(busy) / last_run_ns_ : 0.0)
+       << "}";
+    return os.str();
+  }
+
+  PackedFunc GetFunction(const std::string& name,
+                         const ObjectPtr<Object>& sptr_to_self) final {
+    if (name == "run") {
+      return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+          this->RunInterOp();
+        });
+    } else if (name == "configure_interop") {
+      return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+          this->ConfigureInterOp(args[0], args[1]);
+        });
+    } else if (name == "get_node_stats") {
+      return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+          *rv = this->NodeStatsJSON();
+        });
+    } else {
+      return GraphRuntime::GetFunction(name, sptr_to_self);
+    }
+  }
+
+ private:
+  /*! \brief The timing of a node in the last run. */
+  struct NodeTiming {
+    int worker{-1};
+    int64_t begin_ns{0};
+    int64_t end_ns{0};
+  };
+
+  static int64_t NowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  // Build the edges from data flow and from the reuse of storage.
+  void BuildDependency() {
+    uint32_t num_nodes = static_cast<uint32_t>(nodes_.size());
+    std::vector<std::vector<uint32_t> > pred(num_nodes);
+    // the last node writing each storage and the nodes reading it since.
+    std::unordered_map<int, uint32_t> last_writer;
+    std::unordered_map<int, std::vector<uint32_t> > readers;
+    for (uint32_t nid = 0; nid < num_nodes; ++nid) {
+      const auto& inode = nodes_[nid];
+      for (const auto& e : inode.inputs) {
+        pred[nid].push_back(e.node_id);
+        int sid = attrs_.storage_id[entry_id(e)];
+        auto it = last_writer.find(sid);
+        if (it != last_writer.end()) pred[nid].push_back(it->second);
+        readers[sid].push_back(nid);
+      }
+      uint32_t num_outputs = inode.op_type == "null" ? 1 : inode.param.num_outputs;
+      for (uint32_t index = 0; index < num_outputs; ++index) {
+        int sid = attrs_.storage_id[entry_id(nid, index)];
+        auto it = last_writer.find(sid);
+        if (it != last_writer.end()) pred[nid].push_back(it->second);
+        for (uint32_t reader : readers[sid]) {
+          pred[nid].push_back(reader);
+        }
+        readers[sid].clear();
+        last_writer[sid] = nid;
+      }
+    }
+    succ_.assign(num_nodes, std::vector<uint32_t>());
+    num_pred_.assign(num_nodes, 0);
+    for (uint32_t nid = 0; nid < num_nodes; ++nid) {
+      std::sort(pred[nid].begin(), pred[nid].end());
+      pred[nid].erase(std::unique(pred[nid].begin(), pred[nid].end()), pred[nid].end());
+      for (uint32_t p : pred[nid]) {
+        // a node reading and writing the same storage is not its own predecessor.
+        if (p == nid) continue;
+        succ_[p].push_back(nid);
+        ++num_pred_[nid];
+      }
+    }
+    num_pending_.reset(new std::atomic<int>[num_nodes]);
+    node_timing_.assign(num_nodes, NodeTiming());
+  }
+
+  void Start() {
+    if (worker_cores_.empty()) ConfigureInterOp(2, "");
+    exit_now_ = false;
+    for (size_t i = 0; i < worker_cores_.size(); ++i) {
+      workers_.emplace_back([this, i] { this->RunWorker(static_cast<int>(i)); });
+    }
+  }
+
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      exit_now_ = true;
+    }
+    cv_.notify_all();
+    for (auto& t : workers_) {
+      t.join();
+    }
+    workers_.clear();
+  }
+
+  // The loop of an executor thread.
+  void RunWorker(int worker) {
+    BindThreadPool(worker_cores_[worker]);
+    std::vector<uint32_t> next;
+    while (true) {
+      uint32_t nid;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return exit_now_ || !ready_.empty(); });
+        if (exit_now_) return;
+        nid = ready_.front();
+        ready_.pop_front();
+      }
+      // keep running a ready successor on this thread while there is one.
+      while (true) {
+        RunNode(nid, worker);
+        next.clear();
+        for (uint32_t s : succ_[nid]) {
+          if (num_pending_[s].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            next.push_back(s);
+          }
+        }
+        bool finished;
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          for (size_t i = 1; i < next.size(); ++i) {
+            ready_.push_back(next[i]);
+          }
+          finished = --num_remaining_ == 0;
+        }
+        if (next.size() > 1) cv_.notify_all();
+        if (finished) done_cv_.notify_all();
+        if (next.empty()) break;
+        nid = next[0];
+      }
+    }
+  }
+
+  void RunNode(uint32_t nid, int worker) {
+    if (!op_execs_[nid]) return;
+    NodeTiming& t = node_timing_[nid];
+    t.worker = worker;
+    t.begin_ns = NowNanos() - run_begin_ns_;
+    // nodes after a failure are skipped, but still release their successors.
+    if (!failed_.load(std::memory_order_relaxed)) {
+      try {
+        op_execs_[nid]();
+      } catch (const std::exception& e) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (error_.empty()) error_ = e.what();
+        failed_.store(true, std::memory_order_relaxed);
+      }
+    }
+    t.end_ns = NowNanos() - run_begin_ns_;
+  }
+
+  /*! \brief The successors of each node. */
+  std::vector<std::vector<uint32_t> > succ_;
+  /*! \brief The number of predecessors of each node. */
+  std::vector<int> num_pred_;
+  /*! \brief The number of predecessors of each node not finished in the current run. */
+  std::unique_ptr<std::atomic<int>[]> num_pending_;
+  /*! \brief The cores of each executor thread. */
+  std::vector<std::vector<unsigned> > worker_cores_;
+  /*! \brief The executor threads. */
+  std::vector<std::thread> workers_;
+  // The ready nodes and the state of the current run, guarded by mutex_.
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::condition_variable done_cv_;
+  std::deque<uint32_t> ready_;
+  int num_remaining_{0};
+  std::string error_;
+  std::atomic<bool> failed_{false};
+  bool exit_now_{false};
+  // The timing of the last run.
+  int64_t run_begin_ns_{0};
+  int64_t last_run_ns_{0};
+  int64_t num_runs_{0};
+  std::vector<NodeTiming> node_timing_;
+};
+
+Module GraphRuntimeInterOpCreate(const std::string& sym_json,
+                                 const tvm::runtime::Module& m,
+                                 const std::vector<TVMContext>& ctxs) {
+  auto exec = make_object<GraphRuntimeInterOp>();
+  exec->Init(sym_json, m, ctxs);
+  return Module(exec);
+}
+
+TVM_REGISTER_GLOBAL("tvm.graph_runtime_interop.create")
+.set_body([](TVMArgs args, TVMRetValue* rv) {
+    CHECK_GE(args.num_args, 4)
+        << "The expected number of arguments for graph_runtime_interop.create is "
+           "at least 4, but it has "
+        << args.num_args;
+    *rv = GraphRuntimeInterOpCreate(args[0], args[1], GetAllContext(args));
+  });
+}  // namespace runtime
+}  // namespace tvm
@@ -0,0 +1,440 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file graph_runtime_pipeline.cc
+ * \brief Graph runtime executing a stream of frames in a pipeline of stages.
+ */
+#include <tvm/runtime/container.h>
+#include <tvm/runtime/device_api.h>
+#include <tvm/runtime/ndarray.h>
+#include <tvm/runtime/packed_func.h>
+#include <tvm/runtime/registry.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "graph_runtime.h"
+
+namespace tvm {
+namespace runtime {
+
+/*! \brief A blocking FIFO queue of frame slots, which can be closed. */
+class SlotQueue {
+ public:
+  void Push(int slot) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.push_back(slot);
+    }
+    cv_.notify_one();
+  }
+  /*!
+   * \brief Pop the next slot, blocking while the queue is empty.
+   * \return The slot, or -1 when the queue was closed.
+   */
+  int Pop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return closed_ || !queue_.empty(); });
+    if (queue_.empty()) return -1;
+    int slot = queue_.front();
+    queue_.pop_front();
+    return slot;
+  }
+  void Close() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+    }
+    cv_.notify_all();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<int> queue_;
+  bool closed_{false};
+};
+
+/*!
+ * \brief Graph runtime with pipeline parallelism.
+ *
+ *  The node list is split into contiguous stages of similar estimated cost.
+ *  Every stage runs on its own thread, whose thread pool is bound to a
+ *  disjoint group of cores, so different stages work on different frames
+ *  at the same time. Each frame in flight owns an execution context created
+ *  by |CreateContext|, so the storage reuse of the graph is never violated.
+ *  Frames are pushed by one frontend thread and popped in order by one
+ *  frontend thread, which may be the same as long as it does not push more
+ *  frames than there are slots before popping.
+ */
+class GraphRuntimePipeline : public GraphRuntime {
+ public:
+  ~GraphRuntimePipeline() {
+    Stop();
+  }
+
+  /*!
+   * \brief Split the graph into stages, must be called before the first frame.
+   * \param num_stages The number of stages.
+   * \param stage_cores The cores of each stage, as semicolon separated lists of
+   *  comma separated core ids or ranges, e.g. "0-3;4,5". Empty to split the
+   *  cores evenly among the stages.
+   * \param calibrate_runs When positive, the cost of each operator is measured
+   *  on this many runs instead of estimated from the bytes it accesses.
+   */
+  void ConfigurePipeline(int num_stages, const std::string& stage_cores, int calibrate_runs) {
+    CHECK(contexts_.empty()) << "The pipeline must be configured before the first frame";
+    CHECK_GE(num_stages, 1);
+    std::vector<int64_t> cost = calibrate_runs > 0 ?
+        MeasureNodeCosts(calibrate_runs) : EstimateNodeCosts();
+    std::vector<uint32_t> bounds = Partition(cost, num_stages);
+    size_t num_parts = bounds.size() - 1;
+    // a graph with fewer nodes than stages only fills some of them.
+    CHECK(stage_cores.empty() || num_parts == static_cast<size_t>(num_stages))
+        << "The graph only splits into " << num_parts << " of the " << num_stages
+        << " stages whose cores are given, configure " << num_parts << " stages instead";
+    std::vector<std::vector<unsigned> > cores = ParseCoreGroups(stage_cores, num_parts);
+    stages_.clear();
+    for (size_t i = 0; i + 1 < bounds.size(); ++i) {
+      std::unique_ptr<Stage> stage(new Stage());
+      stage->begin = bounds[i];
+      stage->end = bounds[i + 1];
+      for (uint32_t nid = stage->begin; nid < stage->end; ++nid) {
+        stage->cost += cost[nid];
+      }
+      stage->cores = cores[i];
+      stages_.push_back(std::move(stage));
+    }
+  }
+
+  /*!
+   * \brief Push a frame into the pipeline, blocking while all slots are in flight.
+   * \param args The alternating input names and input arrays of the frame.
+   */
+  void Push(TVMArgs args) {
+    if (contexts_.empty()) Start();
+    CHECK_EQ(args.size() % 2, 0) << "Expect pairs of input name and array";
+    int slot = free_slots_.Pop();
+    GraphRuntime* ctx = Context(slot);
+    errors_[slot].clear();
+    for (int i = 0; i < args.size(); i += 2) {
+      int in_idx = ctx->GetInputIndex(args[i]);
+      CHECK_GE(in_idx, 0);
+      ctx->SetInput(in_idx, args[i + 1]);
+    }
+    num_in_flight_.fetch_add(1);
+    queues_[0]->Push(slot);
+  }
+
+  /*!
+   * \brief Pop the outputs of the oldest frame in flight.
+   * \return The copied outputs.
+   */
+  std::vector<NDArray> Pop() {
+    int slot = queues_.back()->Pop();
+    CHECK_GE(slot, 0);
+    num_in_flight_.fetch_sub(1);
+    std::string error = errors_[slot];
+    std::vector<NDArray> outputs;
+    if (error.empty()) {
+      GraphRuntime* ctx = Context(slot);
+      for (int i = 0; i < ctx->NumOutputs(); ++i) {
+        NDArray out = ctx->GetOutput(i);
+        outputs.push_back(out.CopyTo(out->ctx));
+      }
+    }
+    free_slots_.Push(slot);
+    CHECK(error.empty()) << error;
+    return outputs;
+  }
+
+  /*! \return The stages and their occupancy in json. */
+  std::string PipelineStatsJSON() const {
+    int64_t elapsed = start_time_ns_ < 0 ? 0 : NowNanos() - start_time_ns_;
+    std::ostringstream os;
+    os << "{\"num_stages\": " << stages_.size()
+       << ", \"depth\": " << contexts_.size()
+       << ", \"num_in_flight\": " << num_in_flight_.load()
+       << ", \"elapsed_ns\": " << elapsed
+       << ", \"stages\": [";
+    for (size_t i = 0; i < stages_.size(); ++i) {
+      const Stage& stage = *stages_[i];
+      int64_t busy = stage.busy_ns.load();
+      os << (i == 0 ? "" : ", ")
+         << "{\"begin\": " << stage.begin
+         << ", \"end\": " << stage.end
+         << ", \"cost\": " << stage.cost
+         << ", \"cores\": [";
+      for (size_t k = 0; k < stage.cores.size(); ++k) {
+        os << (k == 0 ? "" : ", ") << stage.cores[k];
+      }
+      os << "], \"num_frame\": " << stage.num_frame.load()
+         << ", \"busy_ns\": " << busy
+         << ", \"occupancy\": " << (elapsed > 0 ? static_cast<double>(busy) / elapsed : 0.0)
+         << "}";
+    }
+    os << "]}";
+    return os.str();
+  }
+
+  PackedFunc GetFunction(const std::string& name,
+                         const ObjectPtr<Object>& sptr_to_self) final {
+    if (name == "configure_pipeline") {
+      return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+          this->ConfigurePipeline(args[0], args[1], args[2]);
+        });
+    } else if (name == "push") {
+      return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+          this->Push(args);
+        });
+    } else if (name == "pop") {
+      return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+          std::vector<NDArray> outputs = this->Pop();
+          *rv = ADT::Tuple(std::vector<ObjectRef>(outputs.begin(), outputs.end()));
+        });
+    } else if (name == "get_pipeline_stats") {
+      return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+          *rv = this->PipelineStatsJSON();
+        });
+    } else if (name == "reset_pipeline_stats") {
+      return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+          for (auto& stage : stages_) {
+            stage->num_frame = 0;
+            stage->busy_ns = 0;
+          }
+          start_time_ns_ = NowNanos();
+        });
+    } else if (name == "set_input" || name == "set_input_zero_copy" ||
+               name == "load_params" || name == "load_params_from_file" ||
+               name == "share_params") {
+      // the frame contexts take the inputs and parameters as they are at the first frame.
+      PackedFunc f = GraphRuntime::GetFunction(name, sptr_to_self);
+      return PackedFunc([this, f, name](TVMArgs args, TVMRetValue* rv) {
+          CHECK(contexts_.empty())
+              << "Cannot " << name << " once the pipeline has run its first frame";
+          f.CallPacked(args, rv);
+        });
+    } else {
+      return GraphRuntime::GetFunction(name, sptr_to_self);
+    }
+  }
+
+ private:
+  /*! \brief A stage of the pipeline. */
+  struct Stage {
+    /*! \brief The first node of the stage. */
+    uint32_t begin{0};
+    /*! \brief The node after the last one of the stage. */
+    uint32_t end{0};
+    /*! \brief The estimated or measured cost of the stage. */
+    int64_t cost{0};
+    /*! \brief The cores of the stage, empty to leave the thread pool as is. */
+    std::vector<unsigned> cores;
+    /*! \brief The number of frames run. */
+    std::atomic<int64_t> num_frame{0};
+    /*! \brief The time spent running frames in nanoseconds. */
+    std::atomic<int64_t> busy_ns{0};
+    /*! \brief The thread running the stage. */
+    std::thread thread;
+  };
+
+  GraphRuntime* Context(int slot) {
+    return static_cast<GraphRuntime*>(contexts_[slot].operator->());
+  }
+
+  static int64_t NowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  // The bytes of the inputs and outputs of each operator.
+  std::vector<int64_t> EstimateNodeCosts() const {
+    std::vector<int64_t> cost(nodes_.size(), 0);
+    auto entry_bytes = [this](uint32_t eid) {
+      DLDataType t = String2TVMType(attrs_.dltype[eid]);
+      int64_t bytes = (t.bits * t.lanes + 7) / 8;
+      for (int64_t sz : attrs_.shape[eid]) {
+        bytes *= sz;
+      }
+      return bytes;
+    };
+    for (uint32_t nid = 0; nid < nodes_.size(); ++nid) {
+      const auto& inode = nodes_[nid];
+      if (inode.op_type == "null" || inode.param.func_name == "__nop") continue;
+      for (const auto& e : inode.inputs) {
+        cost[nid] += entry_bytes(entry_id(e));
+      }
+      for (uint32_t index = 0; index < inode.param.num_outputs; ++index) {
+        cost[nid] += entry_bytes(entry_id(nid, index));
+      }
+    }
+    return cost;
+  }
+
+  // The time of each operator in nanoseconds, averaged over the runs.
+  std::vector<int64_t> MeasureNodeCosts(int runs) {
+    std::vector<int64_t> cost(nodes_.size(), 0);
+    // warmup run
+    GraphRuntime::Run();
+    for (int k = 0; k < runs; ++k) {
+      for (uint32_t nid = 0; nid < op_execs_.size(); ++nid) {
+        if (!op_execs_[nid]) continue;
+        const TVMContext& ctx = data_entry_[entry_id(nid, 0)]->ctx;
+        int64_t tbegin = NowNanos();
+        op_execs_[nid]();
+        TVMSynchronize(ctx.device_type, ctx.device_id, nullptr);
+        cost[nid] += NowNanos() - tbegin;
+      }
+    }
+    for (int64_t& c : cost) {
+      c /= runs;
+    }
+    return cost;
+  }
+
+  // Split the nodes into at most num_stages contiguous ranges minimizing the
+  // largest total cost of a range, return the boundaries of the ranges.
+  static std::vector<uint32_t> Partition(const std::vector<int64_t>& cost, int num_stages) {
+    uint32_t num_nodes = static_cast<uint32_t>(cost.size());
+    // greedily fill stages up to limit, return the boundaries.
+    auto split = [&cost, num_nodes](int64_t limit) {
+      std::vector<uint32_t> bounds{0};
+      int64_t load = 0;
+      for (uint32_t nid = 0; nid < num_nodes; ++nid) {
+        if (load + cost[nid] > limit && load > 0) {
+          bounds.push_back(nid);
+          load = 0;
+        }
+        load += cost[nid];
+      }
+      bounds.push_back(num_nodes);
+      return bounds;
+    };
+    int64_t lo = 0, hi = 0;
+    for (int64_t c : cost) {
+      lo = std::max(lo, c);
+      hi += c;
+    }
+    while (lo < hi) {
+      int64_t mid = lo + (hi - lo) / 2;
+      if (split(mid).size() - 1 <= static_cast<size_t>(num_stages)) {
+        hi = mid;
+      } else {
+        lo = mid + 1;
+      }
+    }
+    return split(lo);
+  }
+
+  // Create the frame slots and start the stage threads.
+  void Start() {
+    if (stages_.empty()) ConfigurePipeline(1, "", 0);
+    // one frame per stage plus the one the frontend is filling.
+    size_t depth = stages_.size() + 1;
+    for (size_t i = 0; i < depth; ++i) {
+      contexts_.push_back(CreateContext());
+      free_slots_.Push(static_cast<int>(i));
+    }
+    errors_.resize(depth);
+    for (size_t i = 0; i <= stages_.size(); ++i) {
+      queues_.emplace_back(new SlotQueue());
+    }
+    start_time_ns_ = NowNanos();
+    for (size_t i = 0; i < stages_.size(); ++i) {
+      stages_[i]->thread = std::thread([this, i] { this->RunStage(i); });
+    }
+  }
+
+  void Stop() {
+    for (auto& q : queues_) {
+      q->Close();
+    }
+    for (auto& stage : stages_) {
+      if (stage->thread.joinable()) stage->thread.join();
+    }
+  }
+
+  // The loop of a stage thread.
+  void RunStage(size_t index) {
+    Stage* stage = stages_[index].get();
+    BindThreadPool(stage->cores);
+    SlotQueue* in = queues_[index].get();
+    SlotQueue* out = queues_[index + 1].get();
+    while (true) {
+      int slot = in->Pop();
+      if (slot < 0) return;
+      // a failed frame passes through the remaining stages untouched.
+      if (errors_[slot].empty()) {
+        int64_t tbegin = NowNanos();
+        try {
+          Context(slot)->RunNodes(stage->begin, stage->end);
+        } catch (const std::exception& e) {
+          errors_[slot] = e.what();
+        }
+        stage->busy_ns.fetch_add(NowNanos() - tbegin);
+        stage->num_frame.fetch_add(1);
+      }
+      out->Push(slot);
+    }
+  }
+
+  /*! \brief The stages of the pipeline. */
+  std::vector<std::unique_ptr<Stage> > stages_;
+  /*! \brief The execution context of each frame slot. */
+  std::vector<Module> contexts_;
+  /*! \brief The error of the frame in each slot, empty on success. */
+  std::vector<std::string> errors_;
+  /*! \brief The slots waiting for a frame. */
+  SlotQueue free_slots_;
+  /*! \brief The input queue of each stage, the last one holds the finished frames. */
+  std::vector<std::unique_ptr<SlotQueue> > queues_;
+  /*! \brief The number of frames pushed but not popped. */
+  std::atomic<int> num_in_flight_{0};
+  /*! \brief The start of the pipeline or the last reset of its statistics. */
+  int64_t start_time_ns_{-1};
+};
+
+Module GraphRuntimePipelineCreate(const std::string& sym_json,
+                                  const tvm::runtime::Module& m,
+                                  const std::vector<TVMContext>& ctxs) {
+  auto exec = make_object<GraphRuntimePipeline>();
+  exec->Init(sym_json, m, ctxs);
+  return Module(exec);
+}
+
+TVM_REGISTER_GLOBAL("tvm.graph_runtime_pipeline.create")
+.set_body([](TVMArgs args, TVMRetValue* rv) {
+    CHECK_GE(args.num_args, 4)
+        << "The expected number of arguments for graph_runtime_pipeline.create is "
+           "at least 4, but it has "
+        << args.num_args;
+    *rv = GraphRuntimePipelineCreate(args[0], args[1], GetAllContext(args));
+  });
+}  // namespace runtime
+}  // namespace tvm
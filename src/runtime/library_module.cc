@@ -108,6 +108,7 @@ void InitContextFunctions(std::function<void*(const char*)> fgetsymbol) {
   TVM_INIT_CONTEXT_FUNC(TVMBackendAllocWorkspace);
   TVM_INIT_CONTEXT_FUNC(TVMBackendFreeWorkspace);
   TVM_INIT_CONTEXT_FUNC(TVMBackendParallelLaunch);
+  TVM_INIT_CONTEXT_FUNC(TVMBackendParallelLaunchChunked);
   TVM_INIT_CONTEXT_FUNC(TVMBackendParallelBarrier);
 
   #undef TVM_INIT_CONTEXT_FUNC
@@ -36,6 +36,7 @@
 #include <mutex>
 #include <atomic>
 #include <algorithm>
+#include <chrono>
 #include <vector>
 #include <string>
 #include <cstring>
@@ -58,6 +59,80 @@ uint32_t GetSpinCount() {
   return atoi(val);
 }
 
+bool GetSharedPoolDefault() {
+  const char* val = getenv("TVM_THREAD_POOL_SHARED");
+  return val != nullptr && atoi(val) != 0;
+}
+
+/*! \brief Whether TVMBackendParallelLaunch dispatches to the process-wide pool. */
+std::atomic<bool> use_shared_pool{GetSharedPoolDefault()};
+
+constexpr int kDefaultChunksPerWorker = 4;
+
+int GetChunksPerWorker() {
+  const char* val = getenv("TVM_THREAD_POOL_CHUNKS_PER_WORKER");
+  if (!val) {
+    return kDefaultChunksPerWorker;
+  }
+  return std::max(atoi(val), 1);
+}
+
+/*! \brief Chunks per worker of a chunked launch that leaves the split to the runtime. */
+std::atomic<int> chunks_per_worker{GetChunksPerWorker()};
+
+/*!
+ * \brief How long idle workers spin before they park.
+ *
+ *  kLatency always spins the full TVM_THREAD_POOL_SPIN_COUNT budget.
+ *  kThroughput and kPower spin for twice the observed gap between launches
+ *  of the pool, and park right away when that would exceed their limit,
+ *  since the spinning would then only burn the cycles before parking.
+ */
+enum SpinProfile : int {
+  kLatency = 0,
+  kThroughput = 1,
+  kPower = 2,
+};
+
+/*! \brief Spin limit of the throughput profile. */
+constexpr int64_t kThroughputSpinLimitNs = 5000000;
+/*! \brief Spin limit of the power profile. */
+constexpr int64_t kPowerSpinLimitNs = 50000;
+
+const char* SpinProfileName(SpinProfile profile) {
+  switch (profile) {
+    case kLatency: return "latency";
+    case kThroughput: return "throughput";
+    case kPower: return "power";
+  }
+  return "unknown";
+}
+
+SpinProfile ParseSpinProfile(const std::string& name) {
+  if (name == "latency") return kLatency;
+  if (name == "throughput") return kThroughput;
+  if (name == "power") return kPower;
+  LOG(FATAL) << "Unknown thread pool spin profile " << name
+             << ", candidates are latency, throughput and power";
+  return kLatency;
+}
+
+SpinProfile GetSpinProfile() {
+  const char* val = getenv("TVM_THREAD_POOL_SPIN_PROFILE");
+  if (!val) {
+    return kLatency;
+  }
+  return ParseSpinProfile(val);
+}
+
+/*! \brief The spin profile of all the pools. */
+std::atomic<int> spin_profile{GetSpinProfile()};
+
+int64_t NowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 }  // namespace
 
 // stride in the page, fit to cache line.
@@ -69,15 +144,22 @@ constexpr int kSyncStride = 64 / sizeof(std::atomic<int>);
 class ParallelLauncher {
  public:
   // Reset the the task request.
+  // When num_chunk is positive, the num_task tasks share the work of
+  // num_chunk independent chunks instead of running one task id each.
   void Init(FTVMParallelLambda flambda,
             void* cdata,
             int num_task,
-            bool need_sync) {
+            bool need_sync,
+            int num_chunk = 0) {
     num_pending_.store(num_task);
     this->cdata = cdata;
     this->flambda = flambda;
-    this->env.num_task = num_task;
+    this->env.num_task = num_chunk > 0 ? num_chunk : num_task;
     has_error_.store(false);
+    chunked_ = num_chunk > 0;
+    if (chunked_) {
+      InitChunks(num_task, num_chunk);
+    }
     // reshape
     if (static_cast<size_t>(num_task) > par_errors_.size()) {
       par_errors_.resize(num_task + 1);
@@ -99,6 +181,21 @@ class ParallelLauncher {
   ~ParallelLauncher() {
     delete[] sync_counter_;
   }
+  // Run the work of task_id, return the status of the lambda.
+  int RunTask(int task_id) {
+    if (!chunked_) {
+      return (*flambda)(task_id, &env, cdata);
+    }
+    int chunk;
+    while ((chunk = NextChunk(task_id)) >= 0) {
+      if ((*flambda)(chunk, &env, cdata) != 0) return -1;
+    }
+    return 0;
+  }
+  // Number of chunk ranges stolen during the last chunked launch.
+  int64_t num_steal() const {
+    return num_steal_.load(std::memory_order_relaxed);
+  }
   // Wait n jobs to finish
   int WaitForJobs() {
     while (num_pending_.load() != 0) {
@@ -138,10 +235,88 @@ class ParallelLauncher {
   // Local env
   TVMParallelGroupEnv env;
   // Whether this thread is worker of the pool.
-  // used to prevent recursive launch.
+  // used to run nested launches inline.
   bool is_worker{false};
+  // Whether this thread is running a task of a launch it started.
+  bool in_parallel_region{false};
+  // Whether this thread was bound to explicit cores, and then launches on
+  // its own pool even when the other threads share one.
+  bool has_own_cores{false};
 
  private:
+  /*!
+   * \brief The range of chunks [begin, end) owned by one task, padded to
+   *  its own cache line. Both ends are packed into one word so that the
+   *  owner popping from the front and thieves splitting off the back
+   *  race through a single compare-and-swap.
+   */
+  struct ChunkRange {
+    std::atomic<uint64_t> range;
+    char pad[kL1CacheBytes - sizeof(std::atomic<uint64_t>)];
+  };
+
+  static uint64_t PackRange(uint32_t begin, uint32_t end) {
+    return (static_cast<uint64_t>(end) << 32) | begin;
+  }
+
+  // Evenly distribute the chunks over the tasks.
+  void InitChunks(int num_task, int num_chunk) {
+    if (static_cast<size_t>(num_task) > num_chunk_ranges_) {
+      chunk_ranges_.reset(new ChunkRange[num_task]);
+      num_chunk_ranges_ = num_task;
+    }
+    for (int i = 0; i < num_task; ++i) {
+      uint32_t begin = static_cast<uint32_t>(static_cast<int64_t>(num_chunk) * i / num_task);
+      uint32_t end = static_cast<uint32_t>(static_cast<int64_t>(num_chunk) * (i + 1) / num_task);
+      chunk_ranges_[i].range.store(PackRange(begin, end), std::memory_order_relaxed);
+    }
+    num_chunk_task_ = num_task;
+    num_steal_.store(0, std::memory_order_relaxed);
+  }
+
+  // Get the next chunk for task_id, stealing from the other tasks
+  // once its own range is exhausted. Return -1 when no work is left.
+  int NextChunk(int task_id) {
+    std::atomic<uint64_t>* own = &chunk_ranges_[task_id].range;
+    uint64_t cur = own->load(std::memory_order_acquire);
+    while (static_cast<uint32_t>(cur) < static_cast<uint32_t>(cur >> 32)) {
+      uint32_t begin = static_cast<uint32_t>(cur);
+      uint32_t end = static_cast<uint32_t>(cur >> 32);
+      if (own->compare_exchange_weak(cur, PackRange(begin + 1, end),
+                                     std::memory_order_acq_rel)) {
+        return static_cast<int>(begin);
+      }
+    }
+    for (int k = 1; k < num_chunk_task_; ++k) {
+      std::atomic<uint64_t>* victim = &chunk_ranges_[(task_id + k) % num_chunk_task_].range;
+      uint64_t v = victim->load(std::memory_order_acquire);
+      while (static_cast<uint32_t>(v) < static_cast<uint32_t>(v >> 32)) {
+        uint32_t begin = static_cast<uint32_t>(v);
+        uint32_t end = static_cast<uint32_t>(v >> 32);
+        // split off the back half, the victim keeps the front.
+        uint32_t mid = begin + (end - begin) / 2;
+        if (victim->compare_exchange_weak(v, PackRange(begin, mid),
+                                          std::memory_order_acq_rel)) {
+          num_steal_.fetch_add(1, std::memory_order_relaxed);
+          // our own range is empty, so nobody else modifies it concurrently.
+          own->store(PackRange(mid + 1, end), std::memory_order_release);
+          return static_cast<int>(mid);
+        }
+      }
+    }
+    return -1;
+  }
+
+  // Whether the current launch is chunked.
+  bool chunked_{false};
+  // The chunk ranges of each task.
+  std::unique_ptr<ChunkRange[]> chunk_ranges_;
+  // Capacity of chunk_ranges_.
+  size_t num_chunk_ranges_{0};
+  // Number of tasks sharing the chunks.
+  int num_chunk_task_{0};
+  // Number of successful steals.
+  std::atomic<int64_t> num_steal_{0};
   // The pending jobs.
   std::atomic<int32_t> num_pending_;
   // Whether error has been countered.
@@ -185,24 +360,53 @@ class SpscTaskQueue {
     }
   }
 
+  /*! \brief The time a worker spent waiting for a task. */
+  struct WaitTime {
+    /*! \brief Nanoseconds spent spinning. */
+    int64_t spin_ns{0};
+    /*! \brief Nanoseconds spent parked on the condition variable. */
+    int64_t park_ns{0};
+    /*! \brief Whether the worker was parked. */
+    bool parked{false};
+  };
+
   /*!
    * \brief Pop a task out of the queue and condition wait if no tasks.
    * \param output The pointer to the task to be dequeued.
    * \param spin_count The number of iterations to spin before sleep.
+   * \param spin_ns The time to spin before sleep, -1 means no time limit.
+   * \param wait The time spent waiting.
    * \return Whether pop is successful (true) or we need to exit now (false).
    */
-  bool Pop(Task* output, uint32_t spin_count) {
+  bool Pop(Task* output, uint32_t spin_count, int64_t spin_ns, WaitTime* wait) {
     // Busy wait a bit when the queue is empty.
     // If a new task comes to the queue quickly, this wait avoid the worker from sleeping.
     // The default spin count is set by following the typical omp convention
-    for (uint32_t i = 0; i < spin_count && pending_.load() == 0; ++i) {
-      tvm::runtime::threading::Yield();
+    int64_t tbegin = NowNanos();
+    int64_t tnow = tbegin;
+    if (spin_ns < 0) {
+      // the clock is only read in the loop when the spin is timed.
+      for (uint32_t i = 0; i < spin_count && pending_.load() == 0; ++i) {
+        tvm::runtime::threading::Yield();
+      }
+      tnow = NowNanos();
+    } else {
+      int64_t deadline = tbegin + spin_ns;
+      for (uint32_t i = 0; i < spin_count && pending_.load() == 0 && tnow < deadline; ++i) {
+        tvm::runtime::threading::Yield();
+        tnow = NowNanos();
+      }
     }
+    wait->spin_ns = tnow - tbegin;
+    wait->park_ns = 0;
+    wait->parked = false;
     if (pending_.fetch_sub(1) == 0) {
       std::unique_lock<std::mutex> lock(mutex_);
       cv_.wait(lock, [this] {
           return pending_.load() >= 0 || exit_now_.load();
         });
+      wait->park_ns = NowNanos() - tnow;
+      wait->parked = true;
     }
     if (exit_now_.load(std::memory_order_relaxed)) {
       return false;
@@ -274,10 +478,132 @@ class SpscTaskQueue {
   std::condition_variable cv_;
 };
 
+/*! \brief Launch counters of a thread pool, all durations are in nanoseconds. */
+struct ThreadPoolStats {
+  /*! \brief Number of parallel launches served. */
+  std::atomic<int64_t> num_launch{0};
+  /*! \brief Accumulated time from launch request to completion. */
+  std::atomic<int64_t> launch_ns{0};
+  /*! \brief The slowest launch observed. */
+  std::atomic<int64_t> max_launch_ns{0};
+  /*! \brief Accumulated time spent waiting for admission to the pool. */
+  std::atomic<int64_t> queue_wait_ns{0};
+  /*! \brief The longest admission wait observed. */
+  std::atomic<int64_t> max_queue_wait_ns{0};
+  /*! \brief Number of chunked launches served. */
+  std::atomic<int64_t> num_chunked_launch{0};
+  /*! \brief Number of chunk ranges stolen by idle workers. */
+  std::atomic<int64_t> num_steal{0};
+  /*! \brief Number of launches nested in a parallel region, which run inline. */
+  std::atomic<int64_t> num_nested_launch{0};
+  /*! \brief Accumulated time idle workers spent spinning. */
+  std::atomic<int64_t> spin_ns{0};
+  /*! \brief Accumulated time idle workers spent parked. */
+  std::atomic<int64_t> park_ns{0};
+  /*! \brief Number of times a worker was parked. */
+  std::atomic<int64_t> num_park{0};
+
+  void Record(int64_t wait_ns, int64_t total_ns) {
+    num_launch.fetch_add(1, std::memory_order_relaxed);
+    launch_ns.fetch_add(total_ns, std::memory_order_relaxed);
+    queue_wait_ns.fetch_add(wait_ns, std::memory_order_relaxed);
+    UpdateMax(&max_launch_ns, total_ns);
+    UpdateMax(&max_queue_wait_ns, wait_ns);
+  }
+
+  void Reset() {
+    num_launch.store(0);
+    launch_ns.store(0);
+    max_launch_ns.store(0);
+    queue_wait_ns.store(0);
+    max_queue_wait_ns.store(0);
+    num_chunked_launch.store(0);
+    num_steal.store(0);
+    num_nested_launch.store(0);
+    spin_ns.store(0);
+    park_ns.store(0);
+    num_park.store(0);
+  }
+
+  void RecordWait(const SpscTaskQueue::WaitTime& wait) {
+    spin_ns.fetch_add(wait.spin_ns, std::memory_order_relaxed);
+    if (wait.parked) {
+      park_ns.fetch_add(wait.park_ns, std::memory_order_relaxed);
+      num_park.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  std::string ToJSON(bool shared, const std::vector<unsigned>& cores,
+                     int64_t launch_gap_ns, int64_t spin_budget_ns) const {
+    std::ostringstream os;
+    os << "{\"shared\": " << (shared ? "true" : "false") << ", \"cores\": [";
+    for (size_t i = 0; i < cores.size(); ++i) {
+      os << (i == 0 ? "" : ", ") << cores[i];
+    }
+    os << "]"
+       << ", \"spin_profile\": \""
+       << SpinProfileName(static_cast<SpinProfile>(spin_profile.load())) << "\""
+       << ", \"launch_gap_ns\": " << launch_gap_ns
+       << ", \"spin_budget_ns\": " << spin_budget_ns
+       << ", \"num_launch\": " << num_launch.load()
+       << ", \"launch_ns\": " << launch_ns.load()
+       << ", \"max_launch_ns\": " << max_launch_ns.load()
+       << ", \"queue_wait_ns\": " << queue_wait_ns.load()
+       << ", \"max_queue_wait_ns\": " << max_queue_wait_ns.load()
+       << ", \"num_chunked_launch\": " << num_chunked_launch.load()
+       << ", \"num_steal\": " << num_steal.load()
+       << ", \"num_nested_launch\": " << num_nested_launch.load()
+       << ", \"spin_ns\": " << spin_ns.load()
+       << ", \"park_ns\": " << park_ns.load()
+       << ", \"num_park\": " << num_park.load()
+       << "}";
+    return os.str();
+  }
+
+ private:
+  static void UpdateMax(std::atomic<int64_t>* target, int64_t value) {
+    int64_t cur = target->load(std::memory_order_relaxed);
+    while (value > cur &&
+           !target->compare_exchange_weak(cur, value, std::memory_order_relaxed)) {
+    }
+  }
+};
+
+/*!
+ * \brief FIFO admission gate of a pool shared by several frontend threads.
+ *
+ *  Only one launch owns the workers at a time, which keeps the task queues
+ *  single-producer. Callers are admitted in arrival order so that a busy
+ *  frontend thread cannot starve the others.
+ */
+class AdmissionQueue {
+ public:
+  void Enter() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t ticket = next_ticket_++;
+    cv_.wait(lock, [this, ticket] { return now_serving_ == ticket; });
+  }
+
+  void Exit() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++now_serving_;
+    }
+    cv_.notify_all();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  uint64_t next_ticket_{0};
+  uint64_t now_serving_{0};
+};
+
 // The thread pool
 class ThreadPool {
  public:
-  ThreadPool(): num_workers_(tvm::runtime::threading::MaxConcurrency()) {
+  explicit ThreadPool(bool shared = false)
+      : num_workers_(tvm::runtime::threading::MaxConcurrency()), shared_(shared) {
     for (int i = 0; i < num_workers_; ++i) {
       // The SpscTaskQueue only hosts ONE item at a time
       queues_.emplace_back(std::unique_ptr<SpscTaskQueue>(new SpscTaskQueue()));
@@ -298,13 +624,28 @@ class ThreadPool {
     }
     threads_.reset();
   }
+  /*!
+   * \brief Launch a parallel job.
+   * \param num_chunk When non-zero, the job consists of independent chunks
+   *  that the workers take from each other when they run out of work.
+   *  -1 lets the pool decide the number of chunks.
+   */
   int Launch(FTVMParallelLambda flambda,
              void* cdata,
              int num_task,
-             int need_sync) {
+             int need_sync,
+             int num_chunk = 0) {
     ParallelLauncher* launcher = ParallelLauncher::ThreadLocal();
-    CHECK(!launcher->is_worker)
-        << "Cannot launch parallel job inside worker, consider fuse then parallel";
+    if (launcher->is_worker || launcher->in_parallel_region) {
+      // All the workers may be busy with the enclosing job, so a nested
+      // launch runs on the calling thread instead of waiting on them.
+      stats_.num_nested_launch.fetch_add(1, std::memory_order_relaxed);
+      return LaunchInline(flambda, cdata, num_task, num_chunk);
+    }
+    auto tbegin = std::chrono::steady_clock::now();
+    UpdateLaunchGap(NowNanos());
+    Admission admission(this);
+    auto tadmit = std::chrono::steady_clock::now();
     if (num_task == 0) {
       num_task = num_workers_used_;
     }
@@ -313,7 +654,10 @@ class ThreadPool {
           << "Request parallel sync task larger than number of threads used "
           << " workers=" << num_workers_used_ << " request=" << num_task;
     }
-    launcher->Init(flambda, cdata, num_task, need_sync != 0);
+    if (num_chunk == -1) {
+      num_chunk = num_task * chunks_per_worker.load(std::memory_order_relaxed);
+    }
+    launcher->Init(flambda, cdata, num_task, need_sync != 0, num_chunk);
     SpscTaskQueue::Task tsk;
     tsk.launcher = launcher;
     // if worker0 is taken by the master, queues_[0] is abandoned
@@ -323,14 +667,24 @@ class ThreadPool {
     }
     // use the master thread to run task 0
     if (exclude_worker0_) {
-      TVMParallelGroupEnv* penv = &(tsk.launcher->env);
-      if ((*tsk.launcher->flambda)(0, penv, cdata) == 0) {
-        tsk.launcher->SignalJobFinish();
+      launcher->in_parallel_region = true;
+      if (launcher->RunTask(0) == 0) {
+        launcher->SignalJobFinish();
       } else {
-        tsk.launcher->SignalJobError(tsk.task_id);
+        launcher->SignalJobError(0);
       }
+      launcher->in_parallel_region = false;
     }
     int res = launcher->WaitForJobs();
+    auto tend = std::chrono::steady_clock::now();
+    if (num_chunk != 0) {
+      stats_.num_chunked_launch.fetch_add(1, std::memory_order_relaxed);
+      stats_.num_steal.fetch_add(launcher->num_steal(), std::memory_order_relaxed);
+    }
+    stats_.Record(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(tadmit - tbegin).count(),
+        std::chrono::duration_cast<std::chrono::nanoseconds>(tend - tbegin).count());
+    last_launch_end_ns_.store(NowNanos(), std::memory_order_relaxed);
     return res;
   }
 
@@ -338,17 +692,117 @@ class ThreadPool {
     return dmlc::ThreadLocalStore<ThreadPool>::Get();
   }
 
+  /*! \brief The process-wide pool shared by all frontend threads. */
+  static ThreadPool* Shared() {
+    static ThreadPool inst(true);
+    return &inst;
+  }
+
+  /*! \brief The pool that serves launches from the calling thread. */
+  static ThreadPool* Get() {
+    if (use_shared_pool.load(std::memory_order_relaxed) &&
+        !ParallelLauncher::ThreadLocal()->has_own_cores) {
+      return Shared();
+    }
+    return ThreadLocal();
+  }
+
+  ThreadPoolStats* stats() {
+    return &stats_;
+  }
+
+  std::string StatsJSON() {
+    // cores_ changes under the admission of a shared pool.
+    Admission admission(this);
+    return stats_.ToJSON(shared_, cores_, launch_gap_ns_.load(), SpinBudget());
+  }
+
+  /*!
+   * \brief The time idle workers spin before they park under the current
+   *  spin profile, -1 means spinning is only bounded by the spin count.
+   */
+  int64_t SpinBudget() const {
+    SpinProfile profile = static_cast<SpinProfile>(spin_profile.load(std::memory_order_relaxed));
+    if (profile == kLatency) return -1;
+    int64_t limit = profile == kThroughput ? kThroughputSpinLimitNs : kPowerSpinLimitNs;
+    int64_t gap = launch_gap_ns_.load(std::memory_order_relaxed);
+    // no launch observed yet.
+    if (gap < 0) return limit;
+    return 2 * gap <= limit ? 2 * gap : 0;
+  }
+
+  bool shared() const {
+    return shared_;
+  }
+
   void UpdateWorkerConfiguration(threading::ThreadGroup::AffinityMode mode, int nthreads) {
+    Admission admission(this);
     // this will also reset the affinity of the ThreadGroup
     // may use less than the MaxConcurrency number of workers
     num_workers_used_ = threads_->Configure(mode, nthreads,
                                             exclude_worker0_);
+    cores_.clear();
     // if MaxConcurrency restricted the number of workers (e.g., due to
     // hyperthreading), respect the restriction
     num_workers_used_ = std::min(num_workers_, num_workers_used_);
   }
 
+  /*! \brief Restrict the workers to an explicit set of cores. */
+  void UpdateWorkerConfiguration(const std::vector<unsigned>& cores) {
+    Admission admission(this);
+    num_workers_used_ = threads_->ConfigureCores(cores, exclude_worker0_);
+    cores_ = cores;
+  }
+
  private:
+  // Holds the admission of a shared pool for the duration of a scope.
+  class Admission {
+   public:
+    explicit Admission(ThreadPool* pool) : pool_(pool) {
+      if (pool_->shared_) pool_->admission_.Enter();
+    }
+    ~Admission() {
+      if (pool_->shared_) pool_->admission_.Exit();
+    }
+
+   private:
+    ThreadPool* pool_;
+  };
+
+  // Fold the gap between the end of the previous launch and now into the
+  // exponential moving average of the inter-launch gap. The launchers of a
+  // shared pool update it concurrently, so the average is swapped in whole.
+  void UpdateLaunchGap(int64_t now) {
+    int64_t last_end = last_launch_end_ns_.load(std::memory_order_relaxed);
+    if (last_end < 0) return;
+    // launches queued in a shared pool arrive back to back.
+    int64_t gap = std::max<int64_t>(now - last_end, 0);
+    int64_t avg = launch_gap_ns_.load(std::memory_order_relaxed);
+    while (!launch_gap_ns_.compare_exchange_weak(
+        avg, avg < 0 ? gap : avg + (gap - avg) / 8, std::memory_order_relaxed)) {}
+  }
+
+  // Run a launch serially on the calling thread. Whether the tasks of a
+  // job call the barrier is not known up front, so the job runs without a
+  // sync handle and TVMBackendParallelBarrier rejects the call if they do.
+  static int LaunchInline(FTVMParallelLambda flambda,
+                          void* cdata,
+                          int num_task,
+                          int num_chunk) {
+    TVMParallelGroupEnv env;
+    env.sync_handle = nullptr;
+    if (num_chunk != 0) {
+      // a chunked job without an explicit split runs as a single chunk.
+      env.num_task = std::max(num_chunk, 1);
+    } else {
+      env.num_task = std::max(num_task, 1);
+    }
+    for (int i = 0; i < env.num_task; ++i) {
+      if ((*flambda)(i, &env, cdata) != 0) return -1;
+    }
+    return 0;
+  }
+
   // Internal worker function.
   void RunWorker(int worker_id) {
     SpscTaskQueue* queue = queues_[worker_id].get();
@@ -358,11 +812,11 @@ class ThreadPool {
     // the global first use of the ThreadPool.
     // TODO(tulloch): should we make this configurable via standard APIs?
     static size_t spin_count = GetSpinCount();
-    while (queue->Pop(&task, spin_count)) {
+    SpscTaskQueue::WaitTime wait;
+    while (queue->Pop(&task, spin_count, SpinBudget(), &wait)) {
+      stats_.RecordWait(wait);
       CHECK(task.launcher != nullptr);
-      TVMParallelGroupEnv* penv = &(task.launcher->env);
-      void* cdata = task.launcher->cdata;
-      if ((*task.launcher->flambda)(task.task_id, penv, cdata) == 0) {
+      if (task.launcher->RunTask(task.task_id) == 0) {
         task.launcher->SignalJobFinish();
       } else {
         task.launcher->SignalJobError(task.task_id);
@@ -378,6 +832,18 @@ class ThreadPool {
 #else
   bool exclude_worker0_{false};
 #endif
+  // whether the pool is shared by several frontend threads
+  bool shared_;
+  // the cores the workers are restricted to, empty when set by affinity mode
+  std::vector<unsigned> cores_;
+  // serializes launches from different frontend threads of a shared pool
+  AdmissionQueue admission_;
+  // launch counters
+  ThreadPoolStats stats_;
+  // moving average of the gap between launches in nanoseconds, -1 if unknown
+  std::atomic<int64_t> launch_gap_ns_{-1};
+  // end of the last launch in nanoseconds, -1 if there was none
+  std::atomic<int64_t> last_launch_end_ns_{-1};
   std::vector<std::unique_ptr<SpscTaskQueue> > queues_;
   std::unique_ptr<tvm::runtime::threading::ThreadGroup> threads_;
 };
@@ -388,7 +854,47 @@ TVM_REGISTER_GLOBAL("runtime.config_threadpool")
     static_cast<threading::ThreadGroup::AffinityMode>(\
     static_cast<int>(args[0]));
     int nthreads = args[1];
-    ThreadPool::ThreadLocal()->UpdateWorkerConfiguration(mode, nthreads);
+    // the optional third argument switches between the per-thread pools
+    // and the process-wide shared pool.
+    if (args.size() > 2) {
+      use_shared_pool.store(static_cast<int>(args[2]) != 0);
+    }
+    ThreadPool::Get()->UpdateWorkerConfiguration(mode, nthreads);
+});
+
+TVM_REGISTER_GLOBAL("runtime.config_threadpool_cores")
+.set_body([](TVMArgs args, TVMRetValue* rv) {
+    std::vector<unsigned> cores;
+    for (int i = 0; i < args.size(); ++i) {
+      int core_id = args[i];
+      CHECK_GE(core_id, 0);
+      cores.push_back(static_cast<unsigned>(core_id));
+    }
+    // the cores are those of the calling thread, e.g. a pipeline stage, so
+    // it gets a pool of its own rather than rebinding a shared one.
+    ParallelLauncher::ThreadLocal()->has_own_cores = true;
+    ThreadPool::ThreadLocal()->UpdateWorkerConfiguration(cores);
+});
+
+TVM_REGISTER_GLOBAL("runtime.config_threadpool_chunking")
+.set_body_typed([](int num_chunk_per_worker) {
+    CHECK_GE(num_chunk_per_worker, 1);
+    chunks_per_worker.store(num_chunk_per_worker);
+});
+
+TVM_REGISTER_GLOBAL("runtime.config_threadpool_spin")
+.set_body_typed([](std::string profile) {
+    spin_profile.store(ParseSpinProfile(profile));
+});
+
+TVM_REGISTER_GLOBAL("runtime.threadpool_stats")
+.set_body([](TVMArgs args, TVMRetValue* rv) {
+    *rv = ThreadPool::Get()->StatsJSON();
+});
+
+TVM_REGISTER_GLOBAL("runtime.threadpool_reset_stats")
+.set_body([](TVMArgs args, TVMRetValue* rv) {
+    ThreadPool::Get()->stats()->Reset();
 });
 
 
@@ -401,7 +907,7 @@ int TVMBackendParallelLaunch(
     void* cdata,
     int num_task) {
 #if !TVM_THREADPOOL_USE_OPENMP
-  int res = tvm::runtime::ThreadPool::ThreadLocal()->Launch(
+  int res = tvm::runtime::ThreadPool::Get()->Launch(
       flambda, cdata, num_task, 1);
   return res;
 #else
@@ -424,12 +930,44 @@ int TVMBackendParallelLaunch(
 #endif
 }
 
+int TVMBackendParallelLaunchChunked(
+    FTVMParallelLambda flambda,
+    void* cdata,
+    int num_chunk) {
+#if !TVM_THREADPOOL_USE_OPENMP
+  return tvm::runtime::ThreadPool::Get()->Launch(
+      flambda, cdata, 0, 0, num_chunk == 0 ? -1 : num_chunk);
+#else
+  int num_workers = tvm::runtime::threading::MaxConcurrency();
+  if (num_chunk == 0) {
+    num_chunk = num_workers * tvm::runtime::chunks_per_worker.load();
+  }
+  TVMParallelGroupEnv env;
+  env.num_task = num_chunk;
+  env.sync_handle = nullptr;
+  std::atomic<bool> has_error{false};
+  omp_set_num_threads(num_workers);
+  #pragma omp parallel for schedule(dynamic) num_threads(num_workers)
+  for (int i = 0; i < num_chunk; ++i) {
+    if ((*flambda)(i, &env, cdata) != 0) {
+      has_error.store(true);
+    }
+  }
+  return has_error.load() ? -1 : 0;
+#endif
+}
+
 int TVMBackendParallelBarrier(int task_id, TVMParallelGroupEnv* penv) {
 #if TVM_THREADPOOL_USE_OPENMP
   #pragma omp barrier
 #else
   using tvm::runtime::kSyncStride;
   int num_task = penv->num_task;
+  // a single task, e.g. of a nested launch that runs inline, has nobody to wait for.
+  if (num_task == 1) return 0;
+  CHECK(penv->sync_handle != nullptr)
+      << "Cannot synchronize " << num_task << " tasks of a parallel job launched "
+      << "inside worker, consider fuse then parallel";
   std::atomic<int>* sync_counter =
       reinterpret_cast<std::atomic<int>*>(penv->sync_handle);
   int old_counter = sync_counter[task_id * kSyncStride].fetch_add(
@@ -93,6 +93,16 @@ class ThreadGroup::Impl {
     return num_workers_used;
   }
 
+  int ConfigureCores(const std::vector<unsigned>& cores, bool exclude_worker0) {
+    CHECK(!cores.empty()) << "The set of cores is empty";
+    int num_workers_used = std::min(num_workers_, static_cast<int>(cores.size()));
+    const char *val = getenv("TVM_BIND_THREADS");
+    if (val == nullptr || atoi(val) == 1) {
+      SetCoreAffinity(cores, exclude_worker0);
+    }
+    return num_workers_used;
+  }
+
  private:
   // bind worker threads to disjoint cores
   // if worker 0 is offloaded to master, i.e. exclude_worker0 is true,
@@ -155,6 +165,36 @@ class ThreadGroup::Impl {
 #endif
   }
 
+  // bind worker threads to the given cores, the workers beyond the size of
+  // the set are unused and wrap around. The master thread may run on any of them.
+  void SetCoreAffinity(const std::vector<unsigned>& cores, bool exclude_worker0) {
+#if defined(__linux__) || defined(__ANDROID__)
+    for (unsigned i = 0; i < threads_.size(); ++i) {
+      cpu_set_t cpuset;
+      CPU_ZERO(&cpuset);
+      CPU_SET(cores[(i + exclude_worker0) % cores.size()], &cpuset);
+#if defined(__ANDROID__)
+      sched_setaffinity(threads_[i].native_handle(), sizeof(cpu_set_t), &cpuset);
+#else
+      pthread_setaffinity_np(threads_[i].native_handle(),
+          sizeof(cpu_set_t), &cpuset);
+#endif
+    }
+    if (exclude_worker0) {
+      cpu_set_t cpuset;
+      CPU_ZERO(&cpuset);
+      for (unsigned core_id : cores) {
+        CPU_SET(core_id, &cpuset);
+      }
+#if defined(__ANDROID__)
+      sched_setaffinity(pthread_self(), sizeof(cpu_set_t), &cpuset);
+#else
+      pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+#endif
+    }
+#endif
+  }
+
   static void SetFullCpuAffinity() {
 #if defined(__linux__) || defined(__ANDROID__)
     cpu_set_t cpuset;
@@ -229,6 +269,10 @@ int ThreadGroup::Configure(AffinityMode mode, int nthreads, bool exclude_worker0
   return impl_->Configure(mode, nthreads, exclude_worker0);
 }
 
+int ThreadGroup::ConfigureCores(const std::vector<unsigned>& cores, bool exclude_worker0) {
+  return impl_->ConfigureCores(cores, exclude_worker0);
+}
+
 void Yield() {
   std::this_thread::yield();
 }
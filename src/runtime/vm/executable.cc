@@ -29,12 +29,14 @@
 
 #include <algorithm>
 #include <memory>
+#include <mutex>
 #include <iostream>
 #include <iomanip>
 #include <sstream>
 #include <utility>
 #include <vector>
 
+#include "../file_util.h"
 #include "serialize_util.h"
 
 namespace tvm {
@@ -50,6 +52,75 @@ VMInstructionSerializer SerializeInstruction(const Instruction& instr);
 // Helper to deserialize a serialized vm instruction.
 Instruction DeserializeInstruction(const VMInstructionSerializer& instr);
 
+struct Executable::LazySections {
+  /*! \brief Guards the loading, as the VMs sharing the executable load on demand. */
+  std::mutex mutex;
+  /*! \brief The serialized executable. */
+  char* data;
+  size_t size;
+  /*! \brief The mapped file holding data, null if data is not of a file. */
+  std::shared_ptr<MappedFile> file;
+  /*! \brief The offset of each constant. */
+  std::vector<uint64_t> constant_offsets;
+  /*! \brief The offset of the instructions of each function, and their number. */
+  std::vector<uint64_t> code_offsets;
+  std::vector<size_t> num_instructions;
+  std::vector<bool> constant_loaded;
+  std::vector<bool> function_loaded;
+};
+
+const VMFunction& Executable::GetVMFunction(Index func_index) const {
+  CHECK_LT(static_cast<size_t>(func_index), functions.size());
+  if (lazy_ != nullptr) {
+    std::lock_guard<std::mutex> lock(lazy_->mutex);
+    if (!lazy_->function_loaded[func_index]) {
+      dmlc::MemoryFixedSizeStream strm(lazy_->data, lazy_->size);
+      strm.Seek(lazy_->code_offsets[func_index]);
+      // completed in place, the functions of the other indices are left alone.
+      auto& instructions = const_cast<Executable*>(this)->functions[func_index].instructions;
+      instructions.reserve(lazy_->num_instructions[func_index]);
+      for (size_t j = 0; j < lazy_->num_instructions[func_index]; j++) {
+        VMInstructionSerializer instr;
+        STREAM_CHECK(instr.Load(&strm), "code/instruction");
+        instructions.push_back(DeserializeInstruction(instr));
+      }
+      lazy_->function_loaded[func_index] = true;
+    }
+  }
+  return functions[func_index];
+}
+
+const ObjectRef& Executable::GetConstant(Index const_index) const {
+  CHECK_LT(static_cast<size_t>(const_index), constants.size());
+  if (lazy_ != nullptr) {
+    std::lock_guard<std::mutex> lock(lazy_->mutex);
+    if (!lazy_->constant_loaded[const_index]) {
+      dmlc::MemoryFixedSizeStream strm(lazy_->data, lazy_->size);
+      strm.Seek(lazy_->constant_offsets[const_index]);
+      auto& constant = const_cast<Executable*>(this)->constants[const_index];
+      if (lazy_->file != nullptr) {
+        constant = LoadMappedDLTensor(&strm, lazy_->file);
+      } else {
+        runtime::NDArray array;
+        STREAM_CHECK(array.Load(&strm), "constant");
+        constant = array;
+      }
+      lazy_->constant_loaded[const_index] = true;
+    }
+  }
+  return constants[const_index];
+}
+
+void Executable::LoadAll() const {
+  if (lazy_ == nullptr) return;
+  for (size_t i = 0; i < constants.size(); ++i) {
+    GetConstant(i);
+  }
+  for (size_t i = 0; i < functions.size(); ++i) {
+    GetVMFunction(i);
+  }
+}
+
 PackedFunc Executable::GetFunction(const std::string& name,
     const ObjectPtr<Object>& sptr_to_self) {
   if (name == "get_lib") {
@@ -110,6 +181,7 @@ std::string Executable::GetFunctionParameterName(std::string func_name, uint32_t
 }
 
 std::string Executable::GetBytecode() const {
+  LoadAll();
   std::ostringstream oss;
 
   for (size_t i = 0; i < functions.size(); ++i) {
@@ -144,6 +216,7 @@ std::string Executable::GetBytecode() const {
 }
 
 std::string Executable::Stats() const {
+  LoadAll();
   std::ostringstream oss;
   oss << "Relay VM executable statistics:" << std::endl;
 
@@ -196,14 +269,37 @@ std::string Executable::Stats() const {
   return oss.str();
 }
 
+// The TVM version and the layout version of the executables saved by it.
+static std::string FormatVersion() {
+  return std::string(TVM_VERSION) + "/vm" + std::to_string(kTVMVMBytecodeFormatVersion);
+}
+
 void SaveHeader(dmlc::Stream* strm) {
   uint64_t header = kTVMVMBytecodeMagic;
   strm->Write(header);
-  std::string version = TVM_VERSION;
+  std::string version = FormatVersion();
   strm->Write(version);
 }
 
+// Save the offsets of the sections, followed by the offset of the index and
+// its magic number at the end of the executable.
+void SaveSectionIndex(dmlc::SeekStream* strm,
+                      const std::vector<uint64_t>& constant_offsets,
+                      uint64_t primitive_offset,
+                      const std::vector<uint64_t>& function_offsets,
+                      uint64_t shape_func_offset) {
+  uint64_t index_offset = strm->Tell();
+  strm->Write(constant_offsets);
+  strm->Write(primitive_offset);
+  strm->Write(function_offsets);
+  strm->Write(shape_func_offset);
+  strm->Write(index_offset);
+  strm->Write(kTVMVMSectionIndexMagic);
+}
+
 TVMByteArray Executable::Save() {
+  // Load what is left, as code_ may be what it is loaded from.
+  LoadAll();
   // Initialize the stream object.
   code_.clear();
   dmlc::MemoryStringStream strm(&code_);
@@ -215,13 +311,24 @@ TVMByteArray Executable::Save() {
   SaveGlobalSection(&strm);
 
   // Constant section.
-  SaveConstantSection(&strm);
+  std::vector<uint64_t> constant_offsets;
+  SaveConstantSection(&strm, &constant_offsets);
 
   // Primitive names.
+  uint64_t primitive_offset = strm.Tell();
   SavePrimitiveOpNames(&strm);
 
   // Code section.
-  SaveCodeSection(&strm);
+  std::vector<uint64_t> function_offsets;
+  SaveCodeSection(&strm, &function_offsets);
+
+  // Shape functions.
+  uint64_t shape_func_offset = strm.Tell();
+  SaveShapeFuncSection(&strm);
+
+  // Section index, found from the end to load the sections on demand.
+  SaveSectionIndex(&strm, constant_offsets, primitive_offset, function_offsets,
+                   shape_func_offset);
 
   TVMByteArray arr;
   arr.data = code_.c_str();
@@ -245,7 +352,7 @@ void Executable::SaveGlobalSection(dmlc::Stream* strm) {
   strm->Write(glbs);
 }
 
-void Executable::SaveConstantSection(dmlc::Stream* strm) {
+void Executable::SaveConstantSection(dmlc::SeekStream* strm, std::vector<uint64_t>* offsets) {
   std::vector<DLTensor*> arrays;
   for (const auto& obj : this->constants) {
     const auto cell = Downcast<runtime::NDArray>(obj);
@@ -253,7 +360,8 @@ void Executable::SaveConstantSection(dmlc::Stream* strm) {
   }
   strm->Write(static_cast<uint64_t>(this->constants.size()));
   for (const auto& it : arrays) {
-    runtime::SaveDLTensor(strm, it);
+    offsets->push_back(strm->Tell());
+    runtime::SaveDLTensorAligned(strm, it);
   }
 }
 
@@ -269,15 +377,20 @@ void Executable::SavePrimitiveOpNames(dmlc::Stream* strm) {
   strm->Write(primitive_names);
 }
 
+void Executable::SaveShapeFuncSection(dmlc::Stream* strm) {
+  strm->Write(this->shape_funcs);
+}
+
 // Serialize a virtual machine instruction. It creates a list that contains the
 // hash, opcode, and all fields of an instruction.
 //
 // For example, the function signature used to create an `AllocTensor`
 // instruction is:
-//   Instruction AllocTensor(std::vector<Index> shape, DLDataType dtype, RegName dst)
+//   Instruction AllocTensor(RegName storage, Index offset, std::vector<Index> shape,
+//                           DLDataType dtype, RegName dst)
 //
 // The serialized form will be:
-//   `hash 5 dtype.code dtype.bits dtype.lanes ndim dst_register val1 val2 ... valn`
+//   `hash 5 storage offset dtype.code dtype.bits dtype.lanes ndim dst_register val1 ... valn`
 //
 // where hash is the hash of serialized instruction that is computed internally
 // by the `VMInstructionExecutable`. It is used for sanity check before decoding.
@@ -314,8 +427,9 @@ VMInstructionSerializer SerializeInstruction(const Instruction& instr) {
       break;
     }
     case Opcode::AllocTensor: {
-      // Number of fields = 5 + instr.alloc_tensor.ndim
+      // Number of fields = 7 + instr.alloc_tensor.ndim
       fields.push_back(instr.alloc_tensor.storage);
+      fields.push_back(instr.alloc_tensor.offset);
 
       // Save `DLDataType` and the dst register.
       const auto& dtype = instr.alloc_tensor.dtype;
@@ -357,6 +471,16 @@ VMInstructionSerializer SerializeInstruction(const Instruction& instr) {
       fields.push_back(dtype.bits);
       fields.push_back(dtype.lanes);
       fields.push_back(instr.dst);
+      fields.push_back(instr.alloc_storage.device_type);
+      fields.push_back(instr.alloc_storage.device_id);
+      break;
+    }
+    case Opcode::DeviceCopy: {
+      // Number of fields = 4
+      fields.assign({instr.device_copy.src,
+                     instr.device_copy.device_type,
+                     instr.device_copy.device_id,
+                     instr.dst});
       break;
     }
     case Opcode::AllocADT: {
@@ -404,8 +528,8 @@ VMInstructionSerializer SerializeInstruction(const Instruction& instr) {
       break;
     }
     case Opcode::LoadConst: {
-      // Number of fields = 2
-      fields.assign({instr.const_index, instr.dst});
+      // Number of fields = 3
+      fields.assign({instr.const_index, instr.dst, instr.const_device_type});
       break;
     }
     case Opcode::LoadConsti: {
@@ -436,15 +560,17 @@ VMInstructionSerializer SerializeInstruction(const Instruction& instr) {
   return VMInstructionSerializer(static_cast<Index>(instr.op), fields);
 }
 
-void Executable::SaveCodeSection(dmlc::Stream* strm) {
+void Executable::SaveCodeSection(dmlc::SeekStream* strm, std::vector<uint64_t>* offsets) {
   // Save the number of functions.
   strm->Write(static_cast<uint64_t>(this->functions.size()));
   for (const auto& func : this->functions) {
+    offsets->push_back(strm->Tell());
     // Save the function info.
     VMFunctionSerializer func_format(func.name,
                                      func.register_file_size,
                                      func.instructions.size(),
-                                     func.params);
+                                     func.params,
+                                     func.params_device_type);
     func_format.Save(strm);
 
     // Serialize each instruction.
@@ -464,31 +590,100 @@ void LoadHeader(dmlc::Stream* strm) {
   // Check version.
   std::string version;
   STREAM_CHECK(strm->Read(&version), "version");
-  STREAM_CHECK(version == TVM_VERSION, "version");
+  CHECK_EQ(version, FormatVersion())
+      << "The VM executable was saved by another version of TVM or of its format.";
 }
 
 runtime::Module Executable::Load(const std::string& code, const runtime::Module lib) {
   auto exec = make_object<Executable>();
   exec->lib = lib;
   exec->code_ = code;
-  dmlc::MemoryStringStream strm(&exec->code_);
+  LoadSections(exec.get(), &exec->code_[0], exec->code_.size(), nullptr);
+  return runtime::Module(exec);
+}
+
+runtime::Module Executable::LoadFromFile(const std::string& file_name,
+                                         const runtime::Module lib) {
+  auto file = std::make_shared<MappedFile>(file_name);
+  auto exec = make_object<Executable>();
+  exec->lib = lib;
+  LoadSections(exec.get(), file->data(), file->size(), file);
+  return runtime::Module(exec);
+}
+
+void Executable::LoadSections(Executable* exec, char* data, size_t size,
+                              std::shared_ptr<MappedFile> file) {
+  dmlc::MemoryFixedSizeStream memstrm(data, size);
+  dmlc::SeekStream* strm = &memstrm;
 
   // Load header.
-  LoadHeader(&strm);
+  LoadHeader(strm);
 
   // Global section.
-  exec->LoadGlobalSection(&strm);
+  exec->LoadGlobalSection(strm);
+
+  // Section index, ending with its offset and magic number.
+  size_t sections_begin = strm->Tell();
+  uint64_t index_offset = 0;
+  uint64_t magic = 0;
+  bool has_index = false;
+  if (size >= sections_begin + 2 * sizeof(uint64_t)) {
+    strm->Seek(size - 2 * sizeof(uint64_t));
+    has_index = strm->Read(&index_offset) && strm->Read(&magic) &&
+        magic == kTVMVMSectionIndexMagic &&
+        index_offset >= sections_begin && index_offset < size;
+  }
 
-  // Constant section.
-  exec->LoadConstantSection(&strm);
+  // every executable of the current format version has the index.
+  STREAM_CHECK(has_index, "section index");
+
+  auto lazy = std::make_shared<LazySections>();
+  lazy->data = data;
+  lazy->size = size;
+  lazy->file = file;
+  strm->Seek(index_offset);
+  uint64_t primitive_offset;
+  std::vector<uint64_t> function_offsets;
+  uint64_t shape_func_offset;
+  STREAM_CHECK(strm->Read(&lazy->constant_offsets), "section index");
+  STREAM_CHECK(strm->Read(&primitive_offset), "section index");
+  STREAM_CHECK(strm->Read(&function_offsets), "section index");
+  STREAM_CHECK(strm->Read(&shape_func_offset), "section index");
 
   // Primitive names that will be invoked by `InvokePacked` instructions.
-  exec->LoadPrimitiveOpNames(&strm);
-
-  // Code section.
-  exec->LoadCodeSection(&strm);
-
-  return runtime::Module(exec);
+  strm->Seek(primitive_offset);
+  exec->LoadPrimitiveOpNames(strm);
+
+  // The primitives computing shapes.
+  strm->Seek(shape_func_offset);
+  exec->LoadShapeFuncSection(strm);
+
+  // The constants are loaded on first use.
+  exec->constants.resize(lazy->constant_offsets.size());
+  lazy->constant_loaded.assign(lazy->constant_offsets.size(), false);
+
+  // The function headers, with the instructions decoded on first use.
+  size_t num_funcs = function_offsets.size();
+  exec->functions.resize(num_funcs);
+  lazy->code_offsets.resize(num_funcs);
+  lazy->num_instructions.resize(num_funcs);
+  lazy->function_loaded.assign(num_funcs, false);
+  for (size_t i = 0; i < num_funcs; i++) {
+    strm->Seek(function_offsets[i]);
+    VMFunctionSerializer loaded_func;
+    STREAM_CHECK(loaded_func.Load(strm), "code/function");
+    auto it = exec->global_map.find(loaded_func.name);
+    CHECK(it != exec->global_map.end());
+    CHECK_LT(static_cast<size_t>(it->second), num_funcs);
+    exec->functions[it->second] = VMFunction(loaded_func.name,
+                                             loaded_func.params,
+                                             std::vector<Instruction>(),
+                                             loaded_func.register_file_size,
+                                             loaded_func.params_device_type);
+    lazy->code_offsets[it->second] = strm->Tell();
+    lazy->num_instructions[it->second] = loaded_func.num_instructions;
+  }
+  exec->lazy_ = lazy;
 }
 
 void Executable::LoadGlobalSection(dmlc::Stream* strm) {
@@ -499,20 +694,6 @@ void Executable::LoadGlobalSection(dmlc::Stream* strm) {
   }
 }
 
-void Executable::LoadConstantSection(dmlc::Stream* strm) {
-  uint64_t sz;
-  // Load the number of constants.
-  STREAM_CHECK(strm->Read(&sz, sizeof(sz)), "constant");
-
-  size_t size = static_cast<size_t>(sz);
-  // Load each of the constants.
-  for (size_t i = 0; i < size; i++) {
-    runtime::NDArray constant;
-    STREAM_CHECK(constant.Load(strm), "constant");
-    this->constants.push_back(constant);
-  }
-}
-
 void Executable::LoadPrimitiveOpNames(dmlc::Stream* strm) {
   std::vector<std::string> primitive_names;
   STREAM_CHECK(strm->Read(&primitive_names), "primitive name");
@@ -521,6 +702,10 @@ void Executable::LoadPrimitiveOpNames(dmlc::Stream* strm) {
   }
 }
 
+void Executable::LoadShapeFuncSection(dmlc::Stream* strm) {
+  STREAM_CHECK(strm->Read(&this->shape_funcs), "shape function");
+}
+
 // Extract the `cnt` number of fields started at `start` from the list
 // `instr_fields`.
 inline std::vector<Index> ExtractFields(const std::vector<Index>& instr_fields,
@@ -564,23 +749,26 @@ Instruction DeserializeInstruction(const VMInstructionSerializer& instr) {
       return Instruction::InvokePacked(packed_index, arity, output_size, args);
     }
     case Opcode::AllocTensor: {
-      // Number of fields = 6 + instr.alloc_tensor.ndim
-      DCHECK_GE(instr.fields.size(), 6U);
-      DCHECK_EQ(instr.fields.size(), 6U + static_cast<size_t>(instr.fields[4]));
+      // Number of fields = 7 + instr.alloc_tensor.ndim, 6 + ndim before the
+      // offset was added, which must not be misread in release builds either.
+      CHECK_GE(instr.fields.size(), 7U) << "Invalid layout of alloc_tensor";
+      CHECK_EQ(instr.fields.size(), 7U + static_cast<size_t>(instr.fields[5]))
+          << "Invalid layout of alloc_tensor";
 
       RegName storage_reg = instr.fields[0];
+      Index offset = instr.fields[1];
 
       DLDataType dtype;
-      dtype.code = instr.fields[1];
-      dtype.bits = instr.fields[2];
-      dtype.lanes = instr.fields[3];
+      dtype.code = instr.fields[2];
+      dtype.bits = instr.fields[3];
+      dtype.lanes = instr.fields[4];
 
-      Index ndim = instr.fields[4];
-      RegName dst = instr.fields[5];
+      Index ndim = instr.fields[5];
+      RegName dst = instr.fields[6];
 
-      std::vector<Index> shape = ExtractFields(instr.fields, 6, ndim);
+      std::vector<Index> shape = ExtractFields(instr.fields, 7, ndim);
 
-      return Instruction::AllocTensor(storage_reg, shape, dtype, dst);
+      return Instruction::AllocTensor(storage_reg, offset, shape, dtype, dst);
     }
     case Opcode::AllocTensorReg: {
       // Number of fields = 5
@@ -623,7 +811,8 @@ Instruction DeserializeInstruction(const VMInstructionSerializer& instr) {
       return Instruction::AllocClosure(clo_index, num_freevar, free_vars, dst);
     }
     case Opcode::AllocStorage: {
-      DCHECK_GE(instr.fields.size(), 6U);
+      // Number of fields = 8
+      DCHECK_EQ(instr.fields.size(), 8U);
       Index allocation_size = instr.fields[0];
       Index alignment = instr.fields[1];
 
@@ -633,12 +822,22 @@ Instruction DeserializeInstruction(const VMInstructionSerializer& instr) {
       dtype.lanes = instr.fields[4];
 
       RegName dst = instr.fields[5];
+      Index device_type = instr.fields[6];
+      Index device_id = instr.fields[7];
 
       return Instruction::AllocStorage(
         allocation_size,
         alignment,
         dtype,
-        dst);
+        dst,
+        device_type,
+        device_id);
+    }
+    case Opcode::DeviceCopy: {
+      // Number of fields = 4
+      DCHECK_EQ(instr.fields.size(), 4U);
+      return Instruction::DeviceCopy(instr.fields[0], instr.fields[1], instr.fields[2],
+                                     instr.fields[3]);
     }
     case Opcode::If: {
       // Number of fields = 4
@@ -675,9 +874,9 @@ Instruction DeserializeInstruction(const VMInstructionSerializer& instr) {
       return Instruction::InvokeClosure(closure, args, dst);
     }
     case Opcode::LoadConst: {
-      // Number of fields = 2
-      DCHECK_EQ(instr.fields.size(), 2U);
-      return Instruction::LoadConst(instr.fields[0], instr.fields[1]);
+      // Number of fields = 3
+      DCHECK_EQ(instr.fields.size(), 3U);
+      return Instruction::LoadConst(instr.fields[0], instr.fields[1], instr.fields[2]);
     }
     case Opcode::LoadConsti: {
       // Number of fields = 2
@@ -705,39 +904,6 @@ Instruction DeserializeInstruction(const VMInstructionSerializer& instr) {
   }
 }
 
-void Executable::LoadCodeSection(dmlc::Stream* strm) {
-  // Load the number of functions.
-  uint64_t sz;
-  STREAM_CHECK(strm->Read(&sz, sizeof(sz)), "code");
-
-  size_t num_funcs = static_cast<size_t>(sz);
-  this->functions.resize(num_funcs);
-  for (size_t i = 0; i < num_funcs; i++) {
-    // Load the function info.
-    VMFunctionSerializer loaded_func;
-    STREAM_CHECK(loaded_func.Load(strm), "code/function");
-
-    // Load the instructions.
-    std::vector<Instruction> instructions;
-    for (size_t j = 0; j < loaded_func.num_instructions; j++) {
-      VMInstructionSerializer instr;
-      std::vector<Index> instr_fields;
-      STREAM_CHECK(instr.Load(strm), "code/instruction");
-      instructions.push_back(DeserializeInstruction(instr));
-    }
-
-    // Create the VM function.
-    VMFunction vm_func = VMFunction(loaded_func.name,
-                                    loaded_func.params,
-                                    instructions,
-                                    loaded_func.register_file_size);
-    auto it = this->global_map.find(loaded_func.name);
-    CHECK(it != this->global_map.end());
-    CHECK_LE(it->second, this->global_map.size());
-    this->functions[it->second] = vm_func;
-  }
-}
-
 TVM_REGISTER_GLOBAL("relay._vm.GetNumOfGlobals")
 .set_body([](TVMArgs args, TVMRetValue* rv) {
   runtime::Module mod = args[0];
@@ -796,6 +962,13 @@ TVM_REGISTER_GLOBAL("relay._vm.Load_Executable")
   return Executable::Load(code, lib);
 });
 
+TVM_REGISTER_GLOBAL("relay._vm.Load_Executable_From_File")
+.set_body_typed([](
+    std::string file_name,
+    runtime::Module lib) {
+  return Executable::LoadFromFile(file_name, lib);
+});
+
 }  // namespace vm
 }  // namespace runtime
 }  // namespace tvm
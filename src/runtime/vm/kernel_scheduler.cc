@@ -0,0 +1,182 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file tvm/runtime/vm/kernel_scheduler.cc
+ * \brief Run the kernels launched by the VM on worker threads.
+ */
+#include <dmlc/logging.h>
+#include <exception>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "kernel_scheduler.h"
+#include "../graph/graph_runtime.h"
+
+namespace tvm {
+namespace runtime {
+namespace vm {
+
+KernelScheduler::KernelScheduler(const std::vector<std::vector<unsigned> >& worker_cores) {
+  CHECK(!worker_cores.empty()) << "The kernel scheduler needs at least one worker";
+  for (const auto& cores : worker_cores) {
+    workers_.emplace_back([this, cores] { this->RunWorker(cores); });
+  }
+}
+
+KernelScheduler::~KernelScheduler() {
+  Drain();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    exit_now_ = true;
+  }
+  ready_cv_.notify_all();
+  for (auto& t : workers_) {
+    t.join();
+  }
+}
+
+void KernelScheduler::Launch(std::function<void()> kernel,
+                             std::vector<Range> reads,
+                             std::vector<Range> writes) {
+  ReleaseDone();
+  std::unique_ptr<Task> task(new Task());
+  task->kernel = std::move(kernel);
+  task->reads = std::move(reads);
+  task->writes = std::move(writes);
+  Task* t = task.get();
+  auto overlaps = [](const std::vector<Range>& a, const std::vector<Range>& b) {
+    for (const Range& x : a) {
+      for (const Range& y : b) {
+        if (x.Overlaps(y)) return true;
+      }
+    }
+    return false;
+  };
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& prev : in_flight_) {
+    if (overlaps(prev->writes, t->reads) || overlaps(prev->writes, t->writes) ||
+        overlaps(prev->reads, t->writes)) {
+      prev->succ.push_back(t);
+      ++t->num_pending;
+    }
+  }
+  in_flight_.push_back(std::move(task));
+  t->pos = std::prev(in_flight_.end());
+  if (t->num_pending == 0) {
+    ready_.push_back(t);
+    ready_cv_.notify_one();
+  }
+}
+
+void KernelScheduler::WaitWriters(const Range& range) {
+  Wait(range, false);
+}
+
+void KernelScheduler::WaitAccesses(const Range& range) {
+  Wait(range, true);
+}
+
+void KernelScheduler::Wait(const Range& range, bool readers) {
+  auto overlaps = [&range](const std::vector<Range>& ranges) {
+    for (const Range& r : ranges) {
+      if (r.Overlaps(range)) return true;
+    }
+    return false;
+  };
+  std::string error;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [&] {
+      for (const auto& task : in_flight_) {
+        if (overlaps(task->writes) || (readers && overlaps(task->reads))) return false;
+      }
+      return true;
+    });
+    error = error_;
+  }
+  ReleaseDone();
+  CHECK(error.empty()) << error;
+}
+
+void KernelScheduler::WaitAll() {
+  std::string error = Drain();
+  CHECK(error.empty()) << error;
+}
+
+std::string KernelScheduler::Drain() {
+  std::string error;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] { return in_flight_.empty(); });
+    std::swap(error, error_);
+  }
+  ReleaseDone();
+  return error;
+}
+
+void KernelScheduler::ReleaseDone() {
+  std::vector<std::unique_ptr<Task> > done;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (done_.empty()) return;
+    std::swap(done, done_);
+  }
+}
+
+void KernelScheduler::RunWorker(const std::vector<unsigned>& cores) {
+  BindThreadPool(cores);
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    ready_cv_.wait(lock, [this] { return exit_now_ || !ready_.empty(); });
+    if (exit_now_) return;
+    Task* task = ready_.front();
+    ready_.pop_front();
+    // kernels after a failure are skipped, but still release their successors.
+    bool skip = !error_.empty();
+    lock.unlock();
+    std::string error;
+    if (!skip) {
+      try {
+        task->kernel();
+      } catch (const std::exception& e) {
+        error = e.what();
+      }
+    }
+    lock.lock();
+    if (!error.empty() && error_.empty()) error_ = error;
+    bool has_ready = false;
+    for (Task* s : task->succ) {
+      if (--s->num_pending == 0) {
+        ready_.push_back(s);
+        has_ready = true;
+      }
+    }
+    done_.push_back(std::move(*task->pos));
+    in_flight_.erase(task->pos);
+    if (has_ready) ready_cv_.notify_all();
+    done_cv_.notify_all();
+  }
+}
+
+}  // namespace vm
+}  // namespace runtime
+}  // namespace tvm
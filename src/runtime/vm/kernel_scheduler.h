@@ -0,0 +1,153 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file runtime/vm/kernel_scheduler.h
+ * \brief Run the kernels launched by the VM on worker threads.
+ */
+#ifndef TVM_RUNTIME_VM_KERNEL_SCHEDULER_H_
+#define TVM_RUNTIME_VM_KERNEL_SCHEDULER_H_
+
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tvm {
+namespace runtime {
+namespace vm {
+
+/*!
+ * \brief Run kernels on worker threads, in an order respecting their data.
+ *
+ *  A kernel depends on the kernels launched before it which are not done
+ *  and write memory it reads or writes, or read memory it writes. Kernels
+ *  without such dependencies run concurrently, each worker with a thread
+ *  pool bound to its own slice of the cores. The launching thread only
+ *  waits when it reads the memory written by a kernel in flight.
+ */
+class KernelScheduler {
+ public:
+  /*! \brief A range of bytes accessed by a kernel. */
+  struct Range {
+    const char* begin;
+    const char* end;
+
+    bool Overlaps(const Range& other) const {
+      return begin < other.end && other.begin < end;
+    }
+  };
+
+  /*!
+   * \brief Start the workers.
+   * \param worker_cores The cores of each worker, empty to leave the
+   *  thread pool of a worker as is.
+   */
+  explicit KernelScheduler(const std::vector<std::vector<unsigned> >& worker_cores);
+
+  /*! \brief Wait for the kernels in flight and stop the workers. */
+  ~KernelScheduler();
+
+  /*!
+   * \brief Launch a kernel.
+   * \param kernel The kernel, which owns what it accesses. It is destroyed
+   *  on the launching thread, at a later launch or wait.
+   * \param reads The memory read by the kernel.
+   * \param writes The memory written by the kernel.
+   */
+  void Launch(std::function<void()> kernel, std::vector<Range> reads, std::vector<Range> writes);
+
+  /*!
+   * \brief Wait until the kernels writing the range are done.
+   * \param range The range about to be read.
+   * \note Throws the error of a failed kernel, which stays set until Drain.
+   */
+  void WaitWriters(const Range& range);
+
+  /*!
+   * \brief Wait until the kernels reading or writing the range are done.
+   * \param range The range about to be written.
+   * \note Throws the error of a failed kernel, which stays set until Drain.
+   */
+  void WaitAccesses(const Range& range);
+
+  /*!
+   * \brief Wait until all the kernels are done.
+   * \note Throws the error of a failed kernel.
+   */
+  void WaitAll();
+
+  /*!
+   * \brief Wait until all the kernels are done and reset the error.
+   * \return The error of the first failed kernel, empty if none failed.
+   */
+  std::string Drain();
+
+  /*! \return The number of workers. */
+  size_t NumWorkers() const {
+    return workers_.size();
+  }
+
+ private:
+  struct Task {
+    std::function<void()> kernel;
+    std::vector<Range> reads;
+    std::vector<Range> writes;
+    /*! \brief The tasks depending on this one. */
+    std::vector<Task*> succ;
+    /*! \brief The number of tasks not done this one depends on. */
+    int num_pending{0};
+    /*! \brief The position in the list of tasks in flight. */
+    std::list<std::unique_ptr<Task> >::iterator pos;
+  };
+
+  void RunWorker(const std::vector<unsigned>& cores);
+
+  /*! \brief Wait for the kernels writing the range, and reading it if readers is set. */
+  void Wait(const Range& range, bool readers);
+
+  /*! \brief Destroy the kernels done, outside of the lock. */
+  void ReleaseDone();
+
+  /*! \brief The workers. */
+  std::vector<std::thread> workers_;
+  // The tasks and the state of the workers, guarded by mutex_.
+  std::mutex mutex_;
+  std::condition_variable ready_cv_;
+  std::condition_variable done_cv_;
+  /*! \brief The tasks launched and not done, in the order of launch. */
+  std::list<std::unique_ptr<Task> > in_flight_;
+  /*! \brief The tasks ready to run. */
+  std::list<Task*> ready_;
+  /*! \brief The tasks done, to be destroyed by the launching thread. */
+  std::vector<std::unique_ptr<Task> > done_;
+  /*! \brief The error of the first failed kernel, after which kernels are skipped. */
+  std::string error_;
+  bool exit_now_{false};
+};
+
+}  // namespace vm
+}  // namespace runtime
+}  // namespace tvm
+
+#endif  // TVM_RUNTIME_VM_KERNEL_SCHEDULER_H_
@@ -21,8 +21,12 @@
  * \file tvm/runtime/vm/memory_manager.cc
  * \brief Allocate and manage memory for the runtime.
  */
+#include <tvm/runtime/registry.h>
+#include <cstdlib>
+#include <cstring>
 #include <utility>
 #include <memory>
+#include <sstream>
 #include "memory_manager.h"
 #include "naive_allocator.h"
 #include "pooled_allocator.h"
@@ -69,6 +73,11 @@ inline void VerifyDataType(DLDataType dtype) {
   CHECK_EQ(dtype.bits & (dtype.bits - 1), 0);
 }
 
+inline bool SupportsPointerOffset(DLDeviceType device_type) {
+  return device_type == kDLCPU || device_type == kDLCPUPinned ||
+      device_type == kDLGPU || device_type == kDLROCM;
+}
+
 inline size_t GetDataAlignment(const DLTensor& arr) {
   size_t align = (arr.dtype.bits / 8) * arr.dtype.lanes;
   if (align < kAllocAlignment) return kAllocAlignment;
@@ -76,9 +85,12 @@ inline size_t GetDataAlignment(const DLTensor& arr) {
 }
 
 NDArray StorageObj::AllocNDArray(size_t offset, std::vector<int64_t> shape, DLDataType dtype) {
-  // TODO(@jroesch): generalize later to non-overlapping allocations.
-  CHECK_EQ(offset, 0u);
   VerifyDataType(dtype);
+  // The generated kernels expect a zero byte_offset, so the offset is applied to
+  // the data pointer, which is only meaningful for devices with flat addresses.
+  CHECK(offset == 0 || SupportsPointerOffset(this->buffer.ctx.device_type))
+    << "tensors at an offset of a storage are not supported on "
+    << DeviceName(this->buffer.ctx.device_type);
 
   // crtical zone: allocate header, cannot throw
   NDArray::Container* container = new NDArray::Container(nullptr, shape, dtype, this->buffer.ctx);
@@ -87,13 +99,13 @@ NDArray StorageObj::AllocNDArray(size_t offset, std::vector<int64_t> shape, DLDa
   size_t needed_size = GetDataSize(container->dl_tensor);
   this->IncRef();
   container->manager_ctx = reinterpret_cast<void*>(this);
-  container->dl_tensor.data = this->buffer.data;
+  container->dl_tensor.data = static_cast<char*>(this->buffer.data) + offset;
   NDArray ret(GetObjectPtr<Object>(container));
 
   // RAII in effect, now run the check.
-  // TODO(@jroesch): generalize later to non-overlapping allocations.
-  CHECK(needed_size == this->buffer.size)
-    << "size mistmatch required " << needed_size << " found " << this->buffer.size;
+  CHECK(offset + needed_size <= this->buffer.size)
+    << "size mistmatch required " << needed_size << " at offset " << offset
+    << " found " << this->buffer.size;
 
   return ret;
 }
@@ -103,15 +115,45 @@ MemoryManager* MemoryManager::Global() {
   return &memory_manager;
 }
 
+// The kind of allocator to create, "pooled" by default or "naive".
+inline Allocator* CreateAllocator(TVMContext ctx) {
+  const char* kind = getenv("TVM_VM_ALLOCATOR");
+  if (kind != nullptr && strcmp(kind, "naive") == 0) {
+    return new NaiveAllocator(ctx);
+  }
+  CHECK(kind == nullptr || strcmp(kind, "pooled") == 0)
+      << "unknown allocator " << kind << ", expect naive or pooled";
+  return new PooledAllocator(ctx);
+}
+
 Allocator* MemoryManager::GetAllocator(TVMContext ctx) {
+  // Allocators are never removed, so the ones looked up before stay valid.
+  static thread_local std::vector<std::pair<TVMContext, Allocator*> > seen;
+  for (const auto& kv : seen) {
+    if (kv.first.device_type == ctx.device_type && kv.first.device_id == ctx.device_id) {
+      return kv.second;
+    }
+  }
   std::lock_guard<std::mutex> lock(mu_);
   if (allocators_.find(ctx) == allocators_.end()) {
     DLOG(INFO) << "New allocator for " << DeviceName(ctx.device_type) << "("
                << ctx.device_id << ")";
-    std::unique_ptr<Allocator> alloc(new NaiveAllocator(ctx));
+    std::unique_ptr<Allocator> alloc(CreateAllocator(ctx));
     allocators_.emplace(ctx, std::move(alloc));
   }
-  return allocators_.at(ctx).get();
+  Allocator* alloc = allocators_.at(ctx).get();
+  seen.emplace_back(ctx, alloc);
+  return alloc;
+}
+
+void MemoryManager::ForEach(int device_type,
+                            const std::function<void(TVMContext, Allocator*)>& fvisit) {
+  std::lock_guard<std::mutex> lock(mu_);
+  for (const auto& kv : allocators_) {
+    if (device_type == -1 || kv.first.device_type == device_type) {
+      fvisit(kv.first, kv.second.get());
+    }
+  }
 }
 
 NDArray Allocator::Empty(std::vector<int64_t> shape, DLDataType dtype, DLContext ctx) {
@@ -127,6 +169,64 @@ NDArray Allocator::Empty(std::vector<int64_t> shape, DLDataType dtype, DLContext
   return NDArray(GetObjectPtr<Object>(container));
 }
 
+// The statistics of the allocators of a device type, -1 for all.
+TVM_REGISTER_GLOBAL("vm.memory_manager_stats")
+.set_body([](TVMArgs args, TVMRetValue* rv) {
+    int device_type = args.num_args > 0 ? args[0].operator int() : -1;
+    std::ostringstream os;
+    os << "[";
+    bool first = true;
+    MemoryManager::Global()->ForEach(device_type, [&](TVMContext ctx, Allocator* alloc) {
+        AllocatorStats s = alloc->GetStats();
+        os << (first ? "" : ", ")
+           << "{\"device_type\": " << ctx.device_type
+           << ", \"device_id\": " << ctx.device_id
+           << ", \"num_thread_hit\": " << s.num_thread_hit
+           << ", \"num_shared_hit\": " << s.num_shared_hit
+           << ", \"num_miss\": " << s.num_miss
+           << ", \"num_release\": " << s.num_release
+           << ", \"bytes_in_use\": " << s.bytes_in_use
+           << ", \"bytes_cached\": " << s.bytes_cached
+           << ", \"peak_bytes_held\": " << s.peak_bytes_held
+           << "}";
+        first = false;
+      });
+    os << "]";
+    *rv = os.str();
+  });
+
+TVM_REGISTER_GLOBAL("vm.memory_manager_reset_stats")
+.set_body([](TVMArgs args, TVMRetValue* rv) {
+    int device_type = args.num_args > 0 ? args[0].operator int() : -1;
+    MemoryManager::Global()->ForEach(device_type, [](TVMContext ctx, Allocator* alloc) {
+        alloc->ResetStats();
+      });
+  });
+
+TVM_REGISTER_GLOBAL("vm.memory_manager_release")
+.set_body([](TVMArgs args, TVMRetValue* rv) {
+    int device_type = args.num_args > 0 ? args[0].operator int() : -1;
+    int64_t max_cached_bytes = args.num_args > 1 ? args[1].operator int64_t() : 0;
+    CHECK_GE(max_cached_bytes, 0);
+    MemoryManager::Global()->ForEach(device_type, [=](TVMContext ctx, Allocator* alloc) {
+        alloc->Release(static_cast<size_t>(max_cached_bytes));
+      });
+  });
+
+TVM_REGISTER_GLOBAL("vm.memory_manager_set_max_cached_bytes")
+.set_body_typed([](int device_type, int64_t max_cached_bytes) {
+    CHECK_GE(max_cached_bytes, 0);
+    MemoryManager::Global()->ForEach(device_type, [=](TVMContext ctx, Allocator* alloc) {
+        alloc->SetMaxCachedBytes(static_cast<size_t>(max_cached_bytes));
+      });
+  });
+
+TVM_REGISTER_GLOBAL("vm.memory_manager_set_total_max_cached_bytes")
+.set_body_typed([](int64_t max_cached_bytes) {
+    CHECK_GE(max_cached_bytes, 0);
+    PooledAllocator::SetTotalMaxCachedBytes(static_cast<size_t>(max_cached_bytes));
+  });
+
 }  // namespace vm
 }  // namespace runtime
 }  // namespace tvm
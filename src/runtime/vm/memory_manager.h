@@ -30,6 +30,7 @@
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -63,6 +64,24 @@ struct Buffer {
   TVMContext ctx;
 };
 
+/*! \brief The statistics of an allocator. */
+struct AllocatorStats {
+  /*! \brief Allocations served from the cache of the calling thread. */
+  uint64_t num_thread_hit{0};
+  /*! \brief Allocations served from the cache shared by the threads. */
+  uint64_t num_shared_hit{0};
+  /*! \brief Allocations served by the device. */
+  uint64_t num_miss{0};
+  /*! \brief Cached blocks released back to the device. */
+  uint64_t num_release{0};
+  /*! \brief Bytes of the blocks handed out and not freed yet. */
+  size_t bytes_in_use{0};
+  /*! \brief Bytes of the freed blocks kept for reuse. */
+  size_t bytes_cached{0};
+  /*! \brief The peak of bytes_in_use + bytes_cached. */
+  size_t peak_bytes_held{0};
+};
+
 class Allocator {
  public:
   Allocator() {}
@@ -91,6 +110,24 @@ class Allocator {
    *  \return The amount of memory currently allocated.
    */
   virtual size_t UsedMemory() const = 0;
+  /*! \return The statistics of the allocator. */
+  virtual AllocatorStats GetStats() const {
+    AllocatorStats stats;
+    stats.bytes_in_use = UsedMemory();
+    return stats;
+  }
+  /*! \brief Reset the counters and the peak of the statistics. */
+  virtual void ResetStats() {}
+  /*!
+   * \brief Release cached blocks back to the device.
+   * \param max_cached_bytes The bytes allowed to stay cached.
+   */
+  virtual void Release(size_t max_cached_bytes) {}
+  /*!
+   * \brief Set the budget of cached bytes, above which freed blocks are released.
+   * \param max_cached_bytes The budget.
+   */
+  virtual void SetMaxCachedBytes(size_t max_cached_bytes) {}
   virtual ~Allocator() = default;
 };
 
@@ -98,8 +135,23 @@ class MemoryManager {
  public:
   static MemoryManager* Global();
 
+  /*!
+   * \brief Get the allocator of a context, creating it on first use.
+   *
+   *  Allocators live as long as the manager, so each thread remembers the
+   *  allocators it has looked up and only takes the lock on its first
+   *  lookup of a context.
+   */
   Allocator* GetAllocator(TVMContext ctx);
 
+  /*!
+   * \brief Apply a function to the allocators of a device type.
+   * \param device_type The device type, -1 for all.
+   * \param fvisit The function to apply.
+   */
+  void ForEach(int device_type,
+               const std::function<void(TVMContext, Allocator*)>& fvisit);
+
  private:
   MemoryManager() {}
 
@@ -0,0 +1,468 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file tvm/runtime/vm/pooled_allocator.cc
+ * \brief Allocator caching freed blocks per thread and per size class.
+ */
+#include <dmlc/logging.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "pooled_allocator.h"
+
+namespace tvm {
+namespace runtime {
+namespace vm {
+
+// classes of whole pages, before the classes growing geometrically.
+constexpr size_t kNumPageClass = 4;
+// the most bytes a thread keeps in its own cache.
+constexpr size_t kThreadCacheBytes = 32 << 20;
+// the most blocks a thread keeps per class.
+constexpr size_t kThreadCacheBlocks = 8;
+// the default budget of cached bytes, of each allocator and of all of them.
+constexpr size_t kDefaultMaxCachedBytes = size_t(1) << 30;
+// the frees between two trims of the allocators to their total budget.
+constexpr uint64_t kTrimInterval = 256;
+
+inline int Log2Floor(uint64_t x) {
+#if defined(_MSC_VER)
+  int r = 0;
+  while (x >>= 1) ++r;
+  return r;
+#else
+  return 63 - __builtin_clzll(x);
+#endif
+}
+
+// The default budget of cached bytes, of each allocator and of all of them.
+inline size_t DefaultMaxCachedBytes() {
+  const char* val = getenv("TVM_VM_MAX_CACHED_BYTES");
+  if (val != nullptr) return static_cast<size_t>(std::stoull(val));
+  return kDefaultMaxCachedBytes;
+}
+
+class PooledAllocator::Pool {
+ public:
+  Pool(TVMContext ctx, size_t page_size);
+
+  ~Pool();
+
+  size_t NumSizeClass() const {
+    return kNumPageClass + (64 - first_class_log2_) * 4;
+  }
+
+  /*!
+   * \brief Round the request up to its size class.
+   * \param nbytes The requested bytes.
+   * \param size The bytes of the class.
+   * \return The index of the class.
+   */
+  size_t GetSizeClass(size_t nbytes, size_t* size) const {
+    size_t pages = (nbytes + (page_size_ - 1)) / page_size_;
+    if (pages == 0) pages = 1;
+    if (pages <= kNumPageClass) {
+      *size = pages * page_size_;
+      return pages - 1;
+    }
+    uint64_t n = static_cast<uint64_t>(pages) * page_size_;
+    int p = Log2Floor(n - 1);
+    uint64_t base = uint64_t(1) << p;
+    uint64_t step = base >> 2;
+    uint64_t k = (n - base + step - 1) / step;
+    *size = static_cast<size_t>(base + k * step);
+    return kNumPageClass + (p - first_class_log2_) * 4 + (k - 1);
+  }
+
+  // Take a block of a class from the shared free list.
+  bool Pop(size_t cls, Buffer* buf) {
+    std::lock_guard<std::mutex> lock(mu_);
+    std::vector<Buffer>& blocks = free_list_[cls];
+    if (blocks.empty()) return false;
+    *buf = blocks.back();
+    blocks.pop_back();
+    bytes_cached_.fetch_sub(buf->size, std::memory_order_relaxed);
+    num_shared_hit_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Allocate a block from the device.
+  Buffer AllocFromDevice(size_t size, size_t alignment, TVMType type_hint) {
+    Buffer buf;
+    buf.ctx = ctx_;
+    buf.size = size;
+    buf.data = DeviceAPI::Get(ctx_)->AllocDataSpace(ctx_, size, alignment, type_hint);
+    size_t held = used_memory_.fetch_add(size, std::memory_order_relaxed) + size;
+    size_t peak = peak_bytes_held_.load(std::memory_order_relaxed);
+    while (held > peak &&
+           !peak_bytes_held_.compare_exchange_weak(peak, held, std::memory_order_relaxed)) {}
+    num_miss_.fetch_add(1, std::memory_order_relaxed);
+    DLOG(INFO) << "allocate " << size << " B, used memory " << used_memory_ << " B";
+    return buf;
+  }
+
+  // Return blocks to the shared free lists, releasing the excess over the budget.
+  void Push(const Buffer* bufs, size_t num_bufs) {
+    std::lock_guard<std::mutex> lock(mu_);
+    for (size_t i = 0; i < num_bufs; ++i) {
+      size_t size;
+      size_t cls = GetSizeClass(bufs[i].size, &size);
+      CHECK_EQ(size, bufs[i].size) << "the block was not allocated by this allocator";
+      free_list_[cls].push_back(bufs[i]);
+      bytes_cached_.fetch_add(size, std::memory_order_relaxed);
+    }
+    ReleaseLocked(max_cached_bytes_.load(std::memory_order_relaxed));
+  }
+
+  void Release(size_t max_cached_bytes) {
+    std::lock_guard<std::mutex> lock(mu_);
+    ReleaseLocked(max_cached_bytes);
+  }
+
+  bool OverBudget() const {
+    return bytes_cached_.load(std::memory_order_relaxed) >
+        max_cached_bytes_.load(std::memory_order_relaxed);
+  }
+
+  AllocatorStats GetStats() const {
+    AllocatorStats stats;
+    stats.num_thread_hit = num_thread_hit_.load(std::memory_order_relaxed);
+    stats.num_shared_hit = num_shared_hit_.load(std::memory_order_relaxed);
+    stats.num_miss = num_miss_.load(std::memory_order_relaxed);
+    stats.num_release = num_release_.load(std::memory_order_relaxed);
+    stats.bytes_cached = bytes_cached_.load(std::memory_order_relaxed);
+    size_t held = used_memory_.load(std::memory_order_relaxed);
+    stats.bytes_in_use = held > stats.bytes_cached ? held - stats.bytes_cached : 0;
+    stats.peak_bytes_held = peak_bytes_held_.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+  void ResetStats() {
+    num_thread_hit_ = 0;
+    num_shared_hit_ = 0;
+    num_miss_ = 0;
+    num_release_ = 0;
+    peak_bytes_held_ = used_memory_.load(std::memory_order_relaxed);
+  }
+
+  /*! \brief The context of the blocks. */
+  TVMContext ctx_;
+  /*! \brief The bytes held from the device, in use or cached. */
+  std::atomic<size_t> used_memory_{0};
+  /*! \brief The bytes cached by the threads and the shared pool. */
+  std::atomic<size_t> bytes_cached_{0};
+  /*! \brief The budget of bytes_cached_. */
+  std::atomic<size_t> max_cached_bytes_;
+  /*! \brief Allocations served by the thread caches. */
+  std::atomic<uint64_t> num_thread_hit_{0};
+
+ private:
+  // Release the largest shared blocks until at most max_cached_bytes are cached.
+  void ReleaseLocked(size_t max_cached_bytes) {
+    for (size_t cls = free_list_.size();
+         cls != 0 && bytes_cached_.load(std::memory_order_relaxed) > max_cached_bytes;) {
+      --cls;
+      std::vector<Buffer>& blocks = free_list_[cls];
+      while (!blocks.empty() && bytes_cached_.load(std::memory_order_relaxed) > max_cached_bytes) {
+        const Buffer& buf = blocks.back();
+        DeviceAPI::Get(ctx_)->FreeDataSpace(buf.ctx, buf.data);
+        used_memory_.fetch_sub(buf.size, std::memory_order_relaxed);
+        bytes_cached_.fetch_sub(buf.size, std::memory_order_relaxed);
+        num_release_.fetch_add(1, std::memory_order_relaxed);
+        blocks.pop_back();
+      }
+    }
+  }
+
+  /*! \brief The bytes of a page, the smallest class. */
+  size_t page_size_;
+  /*! \brief The log2 of the first geometric class. */
+  int first_class_log2_;
+  /*! \brief The free lists of the classes, guarded by mu_. */
+  std::vector<std::vector<Buffer> > free_list_;
+  std::mutex mu_;
+  std::atomic<uint64_t> num_shared_hit_{0};
+  std::atomic<uint64_t> num_miss_{0};
+  std::atomic<uint64_t> num_release_{0};
+  std::atomic<size_t> peak_bytes_held_{0};
+};
+
+/*! \brief The free blocks cached by a thread for an allocator. */
+class PooledAllocator::ThreadCache {
+ public:
+  explicit ThreadCache(std::shared_ptr<Pool> pool)
+      : pool_(std::move(pool)), free_list_(pool_->NumSizeClass()) {}
+
+  ~ThreadCache() {
+    Flush();
+  }
+
+  Pool* pool() const {
+    return pool_.get();
+  }
+
+  bool Pop(size_t cls, Buffer* buf) {
+    std::vector<Buffer>& blocks = free_list_[cls];
+    if (blocks.empty()) return false;
+    *buf = blocks.back();
+    blocks.pop_back();
+    bytes_ -= buf->size;
+    pool_->bytes_cached_.fetch_sub(buf->size, std::memory_order_relaxed);
+    pool_->num_thread_hit_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Keep a freed block, false if it should go to the shared pool.
+  bool Push(size_t cls, const Buffer& buf) {
+    if (buf.size > kThreadCacheBytes) return false;
+    std::vector<Buffer>& blocks = free_list_[cls];
+    if (blocks.size() >= kThreadCacheBlocks) return false;
+    if (bytes_ + buf.size > kThreadCacheBytes) Flush();
+    blocks.push_back(buf);
+    bytes_ += buf.size;
+    pool_->bytes_cached_.fetch_add(buf.size, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Move all the blocks to the shared pool.
+  void Flush() {
+    if (bytes_ == 0) return;
+    std::vector<Buffer> bufs;
+    for (std::vector<Buffer>& blocks : free_list_) {
+      bufs.insert(bufs.end(), blocks.begin(), blocks.end());
+      blocks.clear();
+    }
+    // the pool counts the blocks again as they arrive.
+    pool_->bytes_cached_.fetch_sub(bytes_, std::memory_order_relaxed);
+    bytes_ = 0;
+    pool_->Push(bufs.data(), bufs.size());
+  }
+
+ private:
+  std::shared_ptr<Pool> pool_;
+  std::vector<std::vector<Buffer> > free_list_;
+  size_t bytes_{0};
+};
+
+// Set once the thread caches of the thread are destroyed, so that blocks
+// freed later in the exit of the thread go straight to the shared pool.
+static thread_local bool thread_caches_destroyed = false;
+
+/*! \brief The caches of a thread, one per allocator it used. */
+struct PooledAllocator::ThreadCacheList {
+  std::vector<std::unique_ptr<ThreadCache> > caches;
+  ~ThreadCacheList() {
+    thread_caches_destroyed = true;
+  }
+
+  // The list of the calling thread, nullptr once the thread is exiting.
+  static ThreadCacheList* Get() {
+    if (thread_caches_destroyed) return nullptr;
+    static thread_local ThreadCacheList list;
+    return &list;
+  }
+};
+
+/*!
+ * \brief The pools of all the allocators, trimmed together to the budget
+ *  of the bytes they cache.
+ */
+class PooledAllocator::PoolRegistry {
+ public:
+  static PoolRegistry* Global() {
+    // never destroyed, as the pools of the thread caches of exiting
+    // threads can outlive the static objects.
+    static PoolRegistry* inst = new PoolRegistry();
+    return inst;
+  }
+
+  void Add(Pool* pool) {
+    std::lock_guard<std::mutex> lock(mu_);
+    pools_.push_back(pool);
+  }
+
+  void Remove(Pool* pool) {
+    std::lock_guard<std::mutex> lock(mu_);
+    pools_.erase(std::remove(pools_.begin(), pools_.end(), pool), pools_.end());
+  }
+
+  size_t CachedBytes() {
+    std::lock_guard<std::mutex> lock(mu_);
+    return CachedBytesLocked();
+  }
+
+  // Count a free, trimming the pools every kTrimInterval of them.
+  void OnFree() {
+    if (num_free_.fetch_add(1, std::memory_order_relaxed) % kTrimInterval == kTrimInterval - 1) {
+      Trim();
+    }
+  }
+
+  // Release the cached blocks of the pools caching the most, until the
+  // total is within the budget.
+  void Trim() {
+    std::lock_guard<std::mutex> lock(mu_);
+    size_t budget = max_cached_bytes_.load(std::memory_order_relaxed);
+    if (CachedBytesLocked() <= budget) return;
+    // only the caches of the calling thread can be flushed from here.
+    ThreadCacheList* list = ThreadCacheList::Get();
+    if (list != nullptr) {
+      for (const auto& cache : list->caches) cache->Flush();
+    }
+    std::vector<Pool*> pools = pools_;
+    std::sort(pools.begin(), pools.end(), [](const Pool* a, const Pool* b) {
+        return a->bytes_cached_.load(std::memory_order_relaxed) >
+            b->bytes_cached_.load(std::memory_order_relaxed);
+      });
+    for (Pool* pool : pools) {
+      size_t total = CachedBytesLocked();
+      if (total <= budget) break;
+      size_t cached = pool->bytes_cached_.load(std::memory_order_relaxed);
+      size_t excess = total - budget;
+      pool->Release(cached > excess ? cached - excess : 0);
+    }
+  }
+
+  /*! \brief The budget of the bytes cached by all the pools. */
+  std::atomic<size_t> max_cached_bytes_{DefaultMaxCachedBytes()};
+
+ private:
+  size_t CachedBytesLocked() const {
+    size_t total = 0;
+    for (const Pool* pool : pools_) {
+      total += pool->bytes_cached_.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  /*! \brief The live pools, guarded by mu_, locked before the mutex of a pool. */
+  std::vector<Pool*> pools_;
+  std::mutex mu_;
+  std::atomic<uint64_t> num_free_{0};
+};
+
+PooledAllocator::Pool::Pool(TVMContext ctx, size_t page_size)
+    : ctx_(ctx), max_cached_bytes_(DefaultMaxCachedBytes()), page_size_(page_size) {
+  CHECK(page_size != 0 && (page_size & (page_size - 1)) == 0)
+      << "page size must be a power of two, found " << page_size;
+  first_class_log2_ = Log2Floor(page_size * kNumPageClass);
+  free_list_.resize(NumSizeClass());
+  PoolRegistry::Global()->Add(this);
+}
+
+PooledAllocator::Pool::~Pool() {
+  PoolRegistry::Global()->Remove(this);
+  Release(0);
+}
+
+PooledAllocator::PooledAllocator(TVMContext ctx, size_t page_size)
+    : Allocator(), pool_(std::make_shared<Pool>(ctx, page_size)) {}
+
+PooledAllocator::~PooledAllocator() {
+  pool_->Release(0);
+}
+
+PooledAllocator::ThreadCache* PooledAllocator::GetThreadCache() {
+  ThreadCacheList* list = ThreadCacheList::Get();
+  if (list == nullptr) return nullptr;
+  for (const auto& cache : list->caches) {
+    if (cache->pool() == pool_.get()) return cache.get();
+  }
+  list->caches.emplace_back(new ThreadCache(pool_));
+  return list->caches.back().get();
+}
+
+Buffer PooledAllocator::Alloc(size_t nbytes, size_t alignment, TVMType type_hint) {
+  size_t size;
+  size_t cls = pool_->GetSizeClass(nbytes, &size);
+  Buffer buf;
+  ThreadCache* cache = GetThreadCache();
+  if (cache != nullptr && cache->Pop(cls, &buf)) return buf;
+  if (pool_->Pop(cls, &buf)) return buf;
+  try {
+    return pool_->AllocFromDevice(size, alignment, type_hint);
+  } catch (const std::exception&) {
+    // out of memory, retry with the cached blocks of other classes released.
+    if (pool_->bytes_cached_.load(std::memory_order_relaxed) == 0) throw;
+    if (cache != nullptr) cache->Flush();
+    pool_->Release(0);
+    return pool_->AllocFromDevice(size, alignment, type_hint);
+  }
+}
+
+void PooledAllocator::Free(const Buffer& buffer) {
+  size_t size;
+  size_t cls = pool_->GetSizeClass(buffer.size, &size);
+  CHECK_EQ(size, buffer.size) << "the block was not allocated by this allocator";
+  ThreadCache* cache = GetThreadCache();
+  if (cache != nullptr && cache->Push(cls, buffer)) {
+    // over the budget, hand the blocks of this thread to the pool to be released.
+    if (pool_->OverBudget()) cache->Flush();
+  } else {
+    pool_->Push(&buffer, 1);
+    DLOG(INFO) << "reclaim buffer " << buffer.size;
+  }
+  PoolRegistry::Global()->OnFree();
+}
+
+size_t PooledAllocator::UsedMemory() const {
+  return pool_->used_memory_.load(std::memory_order_relaxed);
+}
+
+AllocatorStats PooledAllocator::GetStats() const {
+  return pool_->GetStats();
+}
+
+void PooledAllocator::ResetStats() {
+  pool_->ResetStats();
+}
+
+void PooledAllocator::Release(size_t max_cached_bytes) {
+  ThreadCache* cache = GetThreadCache();
+  if (cache != nullptr) cache->Flush();
+  pool_->Release(max_cached_bytes);
+}
+
+void PooledAllocator::SetMaxCachedBytes(size_t max_cached_bytes) {
+  pool_->max_cached_bytes_.store(max_cached_bytes, std::memory_order_relaxed);
+  pool_->Release(max_cached_bytes);
+}
+
+void PooledAllocator::SetTotalMaxCachedBytes(size_t max_cached_bytes) {
+  PoolRegistry::Global()->max_cached_bytes_.store(max_cached_bytes, std::memory_order_relaxed);
+  PoolRegistry::Global()->Trim();
+}
+
+size_t PooledAllocator::TotalMaxCachedBytes() {
+  return PoolRegistry::Global()->max_cached_bytes_.load(std::memory_order_relaxed);
+}
+
+size_t PooledAllocator::TotalCachedBytes() {
+  return PoolRegistry::Global()->CachedBytes();
+}
+
+}  // namespace vm
+}  // namespace runtime
+}  // namespace tvm
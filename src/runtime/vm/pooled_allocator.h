@@ -24,10 +24,7 @@
 #define TVM_RUNTIME_VM_POOLED_ALLOCATOR_H_
 
 #include <tvm/runtime/device_api.h>
-#include <atomic>
-#include <mutex>
-#include <unordered_map>
-#include <vector>
+#include <memory>
 
 #include "memory_manager.h"
 
@@ -35,65 +32,72 @@ namespace tvm {
 namespace runtime {
 namespace vm {
 
+/*!
+ * \brief Allocator caching freed blocks for reuse.
+ *
+ *  Requests round up to a size class: whole pages up to four pages, then
+ *  four classes per power of two. Each thread keeps a small cache of freed
+ *  blocks per class, which serves its allocations without locking. Blocks
+ *  overflowing it go to a pool shared by the threads under a mutex. Once
+ *  the cached bytes exceed the budget, the largest blocks of the shared
+ *  pool are released back to the device.
+ *
+ *  The bytes cached by all the pooled allocators together are kept to a
+ *  process-wide budget as well, by trimming the pools caching the most
+ *  every few hundred frees. A trim flushes the caches of the freeing
+ *  thread, those of other threads stay bounded by their own limit.
+ */
 class PooledAllocator final : public Allocator {
  public:
   static constexpr size_t kDefaultPageSize = 4096;
 
-  explicit PooledAllocator(TVMContext ctx, size_t page_size = kDefaultPageSize)
-      : Allocator(), page_size_(page_size), used_memory_(0), ctx_(ctx) {}
-
-  ~PooledAllocator() { ReleaseAll(); }
-
-  Buffer Alloc(size_t nbytes, size_t alignment, TVMType type_hint) override {
-    std::lock_guard<std::mutex> lock(mu_);
-    size_t size = ((nbytes + page_size_ - 1) / page_size_) * page_size_;
-    auto&& it = memory_pool_.find(size);
-    if (it != memory_pool_.end() && !it->second.empty()) {
-      auto&& pool = it->second;
-      auto ret = pool.back();
-      pool.pop_back();
-      return ret;
-    }
-    Buffer buf;
-    buf.ctx = ctx_;
-    buf.size = size;
-    buf.data = DeviceAPI::Get(ctx_)->AllocDataSpace(ctx_, size, alignment, type_hint);
-    used_memory_.fetch_add(size, std::memory_order_relaxed);
-    DLOG(INFO) << "allocate " << size << " B, used memory " << used_memory_ << " B";
-    return buf;
-  }
-
-  void Free(const Buffer& buffer) override {
-    std::lock_guard<std::mutex> lock(mu_);
-    if (memory_pool_.find(buffer.size) == memory_pool_.end()) {
-      memory_pool_.emplace(buffer.size, std::vector<Buffer>{});
-    }
-    memory_pool_.at(buffer.size).push_back(buffer);
-    DLOG(INFO) << "reclaim buffer " << buffer.size;
-  }
-
-  size_t UsedMemory() const override { return used_memory_.load(std::memory_order_relaxed); }
+  explicit PooledAllocator(TVMContext ctx, size_t page_size = kDefaultPageSize);
 
- private:
-  void ReleaseAll() {
-    std::lock_guard<std::mutex> lock(mu_);
-    for (auto const& it : memory_pool_) {
-      auto const& pool = it.second;
-      for (auto const& buf : pool) {
-        DeviceAPI::Get(buf.ctx)->FreeDataSpace(buf.ctx, buf.data);
-      }
-    }
-    memory_pool_.clear();
-    used_memory_ = 0;
-    DLOG(INFO) << "release all buffers";
-  }
+  ~PooledAllocator();
+
+  Buffer Alloc(size_t nbytes, size_t alignment, TVMType type_hint) override;
+
+  void Free(const Buffer& buffer) override;
+
+  size_t UsedMemory() const override;
+
+  AllocatorStats GetStats() const override;
+
+  void ResetStats() override;
+
+  /*!
+   * \brief Release the blocks of the shared pool. The caches of other
+   *  threads are flushed to the pool when they overflow or their thread exits.
+   */
+  void Release(size_t max_cached_bytes) override;
+
+  void SetMaxCachedBytes(size_t max_cached_bytes) override;
+
+  /*!
+   * \brief Set the budget of the bytes cached by all the pooled allocators,
+   *  and trim them to it.
+   * \param max_cached_bytes The budget, TVM_VM_MAX_CACHED_BYTES or 1GB by default.
+   */
+  static void SetTotalMaxCachedBytes(size_t max_cached_bytes);
+
+  /*! \return The budget of the bytes cached by all the pooled allocators. */
+  static size_t TotalMaxCachedBytes();
+
+  /*! \return The bytes cached by all the pooled allocators. */
+  static size_t TotalCachedBytes();
 
  private:
-  size_t page_size_;
-  std::atomic<size_t> used_memory_;
-  std::unordered_map<size_t, std::vector<Buffer> > memory_pool_;
-  std::mutex mu_;
-  TVMContext ctx_;
+  class Pool;
+  class PoolRegistry;
+  class ThreadCache;
+  struct ThreadCacheList;
+  /*! \brief Get the cache of the calling thread, nullptr once the thread is exiting. */
+  ThreadCache* GetThreadCache();
+  /*!
+   * \brief The shared state, also referenced by the thread caches, which can
+   *  outlive the allocator.
+   */
+  std::shared_ptr<Pool> pool_;
 };
 
 }  // namespace vm
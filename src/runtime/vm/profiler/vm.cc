@@ -34,6 +34,7 @@
 #include <utility>
 #include <vector>
 
+#include "../kernel_scheduler.h"
 #include "vm.h"
 
 namespace tvm {
@@ -109,14 +110,24 @@ void VirtualMachineDebug::InvokePacked(Index packed_index,
                                        Index output_size,
                                        const std::vector<ObjectRef>& args) {
   CHECK(exec_);
-  auto ctx = this->GetParamsContext();
-  // warmup
+  // the kernel may run on any of the contexts, or on a worker of the
+  // kernel scheduler, which the clock has to wait for as well.
+  auto sync = [this]() {
+    if (kernel_scheduler_ != nullptr) kernel_scheduler_->WaitAll();
+    for (const auto& ctx : ctxs_) {
+      TVMSynchronize(ctx.device_type, ctx.device_id, nullptr);
+    }
+  };
+  // warmup, left out of the trace.
+  VMTrace* trace = active_trace_;
+  active_trace_ = nullptr;
   VirtualMachine::InvokePacked(packed_index, func, arg_count, output_size, args);
-  TVMSynchronize(ctx.device_type, ctx.device_id, nullptr);
+  sync();
+  active_trace_ = trace;
 
   auto op_begin = std::chrono::high_resolution_clock::now();
   VirtualMachine::InvokePacked(packed_index, func, arg_count, output_size, args);
-  TVMSynchronize(ctx.device_type, ctx.device_id, nullptr);
+  sync();
   auto op_end = std::chrono::high_resolution_clock::now();
   double op_duration =
       std::chrono::duration_cast<std::chrono::duration<double> >(op_end -
@@ -39,6 +39,20 @@ namespace vm {
 /*! \brief The magic number for the serialized VM bytecode file  */
 constexpr uint64_t kTVMVMBytecodeMagic = 0xD225DE2F4214151D;
 
+/*!
+ * \brief The version of the layout of a serialized VM executable, to bump on
+ *  each change of it. It is saved along with TVM_VERSION, so that a file of
+ *  another layout is rejected rather than misparsed.
+ *
+ *  1: the layout of TVM 0.6, saved with TVM_VERSION alone.
+ *  2: alloc_tensor carries the offset in its storage, the sections end with
+ *     their index, and device_copy carries both devices.
+ */
+constexpr int kTVMVMBytecodeFormatVersion = 2;
+
+/*! \brief The magic number ending the section index of a serialized VM executable */
+constexpr uint64_t kTVMVMSectionIndexMagic = 0xD225DE2F4214151E;
+
 template <typename T>
 static inline size_t VectorHash(size_t key, const std::vector<T>& values) {
   for (const auto& it : values) {
@@ -57,17 +71,21 @@ struct VMFunctionSerializer {
   size_t num_instructions;
   /*! \brief The parameters of the VMFunction. */
   std::vector<std::string> params;
+  /*! \brief The device type of each parameter, empty for the default context. */
+  std::vector<Index> params_device_type;
 
   VMFunctionSerializer() = default;
 
   VMFunctionSerializer(const std::string& name,
                        Index register_file_size,
                        size_t num_instructions,
-                       const std::vector<std::string>& params)
+                       const std::vector<std::string>& params,
+                       const std::vector<Index>& params_device_type)
       : name(name),
         register_file_size(register_file_size),
         num_instructions(num_instructions),
-        params(params) {}
+        params(params),
+        params_device_type(params_device_type) {}
 
   /*!
    * \brief Load the serialized function header.
@@ -83,7 +101,7 @@ struct VMFunctionSerializer {
     register_file_size = std::stoll(func_info[1]);
     // Get the number of instructions.
     num_instructions = static_cast<size_t>(std::stoll(func_info[2]));
-    return strm->Read(&params);
+    return strm->Read(&params) && strm->Read(&params_device_type);
   }
 
   /*!
@@ -97,6 +115,7 @@ struct VMFunctionSerializer {
     func_info.push_back(std::to_string(num_instructions));
     strm->Write(func_info);
     strm->Write(params);
+    strm->Write(params_device_type);
   }
 };
 
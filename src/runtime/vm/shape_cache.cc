@@ -0,0 +1,219 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file tvm/runtime/vm/shape_cache.cc
+ * \brief Reuse the shapes computed by the VM, and the kernels specialized
+ *  for the shapes seen often.
+ */
+#include <dmlc/logging.h>
+#include <tvm/runtime/container.h>
+#include <tvm/runtime/ndarray.h>
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "shape_cache.h"
+
+namespace tvm {
+namespace runtime {
+namespace vm {
+
+/*! \brief The most bytes of input data a shape function is cached by. */
+static const size_t kMaxKeyBytes = 1024;
+
+template <typename T>
+static void AppendBytes(std::string* key, const T& value) {
+  key->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Append the type and shape of a tensor to a key.
+static void AppendShape(std::string* key, const DLTensor& t) {
+  AppendBytes(key, t.dtype);
+  AppendBytes(key, t.ndim);
+  key->append(reinterpret_cast<const char*>(t.shape), t.ndim * sizeof(int64_t));
+}
+
+// Whether a tensor is on the host, with its elements in order.
+static bool IsCompactOnHost(const DLTensor& t) {
+  return t.ctx.device_type == kDLCPU && t.strides == nullptr;
+}
+
+static const char* TensorData(const DLTensor& t) {
+  return static_cast<const char*>(t.data) + t.byte_offset;
+}
+
+ShapeCache::ShapeCache(std::vector<std::string> func_names,
+                       const std::vector<Index>& shape_funcs,
+                       size_t max_entries)
+    : func_names_(std::move(func_names)), funcs_(func_names_.size()), max_entries_(max_entries) {
+  CHECK_GT(max_entries, 0U);
+  for (Index index : shape_funcs) {
+    CHECK_LT(static_cast<size_t>(index), funcs_.size());
+    funcs_[index].is_shape_func = true;
+  }
+}
+
+bool ShapeCache::Lookup(Index packed_index, const std::vector<const DLTensor*>& inputs,
+                        const std::vector<const DLTensor*>& outputs) {
+  FuncCache& cache = funcs_[packed_index];
+  pending_ = -1;
+  key_.clear();
+  size_t data_bytes = 0;
+  for (const DLTensor* t : inputs) {
+    data_bytes += GetDataSize(*t);
+    if (!IsCompactOnHost(*t) || data_bytes > kMaxKeyBytes) {
+      ++cache.bypassed;
+      return false;
+    }
+    AppendShape(&key_, *t);
+    key_.append(TensorData(*t), GetDataSize(*t));
+  }
+  for (const DLTensor* t : outputs) {
+    if (!IsCompactOnHost(*t)) {
+      ++cache.bypassed;
+      return false;
+    }
+  }
+  auto it = cache.entries.find(key_);
+  if (it == cache.entries.end()) {
+    ++cache.misses;
+    pending_ = packed_index;
+    return false;
+  }
+  const std::string& value = it->second;
+  size_t offset = 0;
+  for (const DLTensor* t : outputs) {
+    size_t size = GetDataSize(*t);
+    CHECK_LE(offset + size, value.size()) << "The outputs of " << func_names_[packed_index]
+                                          << " do not match their cached value";
+    std::memcpy(const_cast<char*>(TensorData(*t)), value.data() + offset, size);
+    offset += size;
+  }
+  ++cache.hits;
+  return true;
+}
+
+void ShapeCache::Store(const std::vector<const DLTensor*>& outputs) {
+  if (pending_ < 0) return;
+  FuncCache& cache = funcs_[pending_];
+  pending_ = -1;
+  if (cache.entries.size() >= max_entries_) {
+    cache.evictions += cache.entries.size();
+    cache.entries.clear();
+  }
+  std::string value;
+  for (const DLTensor* t : outputs) {
+    value.append(TensorData(*t), GetDataSize(*t));
+  }
+  cache.entries.emplace(std::move(key_), std::move(value));
+  key_.clear();
+}
+
+std::string ShapeCache::StatsJSON() const {
+  int64_t hits = 0, misses = 0, bypassed = 0, evictions = 0, entries = 0;
+  std::ostringstream funcs;
+  bool first = true;
+  for (size_t i = 0; i < funcs_.size(); ++i) {
+    const FuncCache& cache = funcs_[i];
+    if (!cache.is_shape_func) continue;
+    funcs << (first ? "" : ", ")
+          << "{\"name\": \"" << func_names_[i] << "\""
+          << ", \"hits\": " << cache.hits
+          << ", \"misses\": " << cache.misses
+          << ", \"bypassed\": " << cache.bypassed
+          << ", \"evictions\": " << cache.evictions
+          << ", \"entries\": " << cache.entries.size()
+          << "}";
+    first = false;
+    hits += cache.hits;
+    misses += cache.misses;
+    bypassed += cache.bypassed;
+    evictions += cache.evictions;
+    entries += cache.entries.size();
+  }
+  std::ostringstream os;
+  os << "{\"hits\": " << hits
+     << ", \"misses\": " << misses
+     << ", \"bypassed\": " << bypassed
+     << ", \"evictions\": " << evictions
+     << ", \"entries\": " << entries
+     << ", \"functions\": [" << funcs.str() << "]}";
+  return os.str();
+}
+
+void ShapeCache::Clear() {
+  for (FuncCache& cache : funcs_) {
+    cache.entries.clear();
+    cache.hits = cache.misses = cache.bypassed = cache.evictions = 0;
+  }
+  pending_ = -1;
+}
+
+KernelSpecializer::KernelSpecializer(std::vector<std::string> func_names, PackedFunc hook,
+                                     int threshold)
+    : func_names_(std::move(func_names)), hook_(std::move(hook)), threshold_(threshold) {
+  CHECK(hook_ != nullptr);
+  CHECK_GT(threshold, 0);
+}
+
+const PackedFunc* KernelSpecializer::Get(Index packed_index,
+                                         const std::vector<const DLTensor*>& tensors) {
+  key_.clear();
+  AppendBytes(&key_, packed_index);
+  for (const DLTensor* t : tensors) {
+    AppendShape(&key_, *t);
+  }
+  Entry& entry = entries_[key_];
+  if (entry.kernel != nullptr) {
+    ++num_calls_;
+    return &entry.kernel;
+  }
+  // the hook is called once, when the shapes reach the threshold.
+  if (++entry.count != threshold_) return nullptr;
+  std::vector<ObjectRef> shapes;
+  for (const DLTensor* t : tensors) {
+    NDArray shape = NDArray::Empty({t->ndim}, {kDLInt, 64, 1}, {kDLCPU, 0});
+    std::memcpy(shape->data, t->shape, t->ndim * sizeof(int64_t));
+    shapes.push_back(shape);
+  }
+  ++num_requests_;
+  TVMRetValue rv = hook_(func_names_[packed_index], ADT(0, shapes));
+  if (rv.type_code() == kFuncHandle) {
+    entry.kernel = rv.operator PackedFunc();
+    ++num_specialized_;
+  }
+  return nullptr;
+}
+
+std::string KernelSpecializer::StatsJSON() const {
+  std::ostringstream os;
+  os << "{\"requests\": " << num_requests_
+     << ", \"kernels\": " << num_specialized_
+     << ", \"calls\": " << num_calls_
+     << "}";
+  return os.str();
+}
+
+}  // namespace vm
+}  // namespace runtime
+}  // namespace tvm
@@ -0,0 +1,151 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file runtime/vm/shape_cache.h
+ * \brief Reuse the shapes computed by the VM, and the kernels specialized
+ *  for the shapes seen often.
+ */
+#ifndef TVM_RUNTIME_VM_SHAPE_CACHE_H_
+#define TVM_RUNTIME_VM_SHAPE_CACHE_H_
+
+#include <tvm/runtime/packed_func.h>
+#include <tvm/runtime/vm.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tvm {
+namespace runtime {
+namespace vm {
+
+/*!
+ * \brief Cache of the outputs of the shape functions of a VM, by the values
+ *  of their inputs.
+ *
+ *  Shape functions, and the kernels computing allocation sizes from shapes,
+ *  are pure functions of a few small integer tensors on the host. When a
+ *  model sees the same input shapes again, their outputs are copied from
+ *  the cache instead of being computed. Inputs that are not on the host or
+ *  too large to key on are passed through. A function holding max_entries
+ *  entries drops them before adding another.
+ */
+class ShapeCache {
+ public:
+  /*!
+   * \param func_names The name of each packed function.
+   * \param shape_funcs The packed indices of the shape functions.
+   * \param max_entries The most entries a function keeps.
+   */
+  ShapeCache(std::vector<std::string> func_names, const std::vector<Index>& shape_funcs,
+             size_t max_entries);
+
+  /*! \return Whether the packed function is a shape function. */
+  bool IsShapeFunc(Index packed_index) const {
+    return static_cast<size_t>(packed_index) < funcs_.size() && funcs_[packed_index].is_shape_func;
+  }
+
+  /*!
+   * \brief Look up the outputs of a call, writing them on a hit.
+   *
+   *  On a miss, the call should be made and then given to Store.
+   *
+   * \param packed_index The shape function.
+   * \param inputs The input tensors.
+   * \param outputs The output tensors.
+   * \return Whether the outputs have been written.
+   */
+  bool Lookup(Index packed_index, const std::vector<const DLTensor*>& inputs,
+              const std::vector<const DLTensor*>& outputs);
+
+  /*!
+   * \brief Store the outputs of the call missed by the last lookup.
+   * \param outputs The output tensors, written by the call.
+   */
+  void Store(const std::vector<const DLTensor*>& outputs);
+
+  /*! \return The hits and misses of each function, in json. */
+  std::string StatsJSON() const;
+
+  /*! \brief Drop the entries and reset the statistics. */
+  void Clear();
+
+ private:
+  struct FuncCache {
+    bool is_shape_func{false};
+    std::unordered_map<std::string, std::string> entries;
+    int64_t hits{0};
+    int64_t misses{0};
+    int64_t bypassed{0};
+    int64_t evictions{0};
+  };
+
+  std::vector<std::string> func_names_;
+  std::vector<FuncCache> funcs_;
+  size_t max_entries_;
+  /*! \brief The key of the last lookup, and its function if it missed. */
+  std::string key_;
+  Index pending_{-1};
+};
+
+/*!
+ * \brief Swap in kernels specialized for the shapes seen often.
+ *
+ *  Once a kernel has been called threshold times with the same shapes of
+ *  its arguments, the hook is called with the name of the kernel and a
+ *  tuple of the shapes, as int64 arrays. The function it returns, if any,
+ *  is called instead for these shapes from then on.
+ */
+class KernelSpecializer {
+ public:
+  KernelSpecializer(std::vector<std::string> func_names, PackedFunc hook, int threshold);
+
+  /*!
+   * \brief Get the kernel to call for the shapes of the arguments.
+   * \param packed_index The kernel.
+   * \param tensors The argument tensors.
+   * \return The specialized kernel, null to call the kernel itself.
+   */
+  const PackedFunc* Get(Index packed_index, const std::vector<const DLTensor*>& tensors);
+
+  /*! \return The number of kernels requested, specialized and their calls, in json. */
+  std::string StatsJSON() const;
+
+ private:
+  struct Entry {
+    int64_t count{0};
+    PackedFunc kernel;
+  };
+
+  std::vector<std::string> func_names_;
+  PackedFunc hook_;
+  int threshold_;
+  std::unordered_map<std::string, Entry> entries_;
+  std::string key_;
+  int64_t num_requests_{0};
+  int64_t num_specialized_{0};
+  int64_t num_calls_{0};
+};
+
+}  // namespace vm
+}  // namespace runtime
+}  // namespace tvm
+
+#endif  // TVM_RUNTIME_VM_SHAPE_CACHE_H_
@@ -0,0 +1,170 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file tvm/runtime/vm/trace.cc
+ * \brief A timeline of the instructions, allocations, kernels and calls of
+ *  the VM.
+ */
+#include <dmlc/logging.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "trace.h"
+
+namespace tvm {
+namespace runtime {
+namespace vm {
+
+static const char* OpcodeName(Opcode op) {
+  switch (op) {
+    case Opcode::Move: return "Move";
+    case Opcode::Ret: return "Ret";
+    case Opcode::Invoke: return "Invoke";
+    case Opcode::InvokeClosure: return "InvokeClosure";
+    case Opcode::InvokePacked: return "InvokePacked";
+    case Opcode::AllocTensor: return "AllocTensor";
+    case Opcode::AllocTensorReg: return "AllocTensorReg";
+    case Opcode::AllocADT: return "AllocADT";
+    case Opcode::AllocClosure: return "AllocClosure";
+    case Opcode::GetField: return "GetField";
+    case Opcode::If: return "If";
+    case Opcode::LoadConst: return "LoadConst";
+    case Opcode::Goto: return "Goto";
+    case Opcode::GetTag: return "GetTag";
+    case Opcode::LoadConsti: return "LoadConsti";
+    case Opcode::Fatal: return "Fatal";
+    case Opcode::AllocStorage: return "AllocStorage";
+    case Opcode::DeviceCopy: return "DeviceCopy";
+    case Opcode::IfConst: return "IfConst";
+    case Opcode::IfTag: return "IfTag";
+    case Opcode::AllocStorageConst: return "AllocStorageConst";
+    case Opcode::AllocStorageTensor: return "AllocStorageTensor";
+  }
+  return "Unknown";
+}
+
+// The name at an index, or a placeholder when it is out of range.
+static std::string NameAt(const std::vector<std::string>& names, int64_t index,
+                          const char* kind) {
+  if (index >= 0 && static_cast<size_t>(index) < names.size() && !names[index].empty()) {
+    return names[index];
+  }
+  return kind + std::to_string(index);
+}
+
+VMTrace::VMTrace(size_t capacity, int sample_every) : sample_every_(sample_every) {
+  CHECK_GT(capacity, 0U);
+  CHECK_GT(sample_every, 0);
+  size_t size = 1;
+  while (size < capacity) size <<= 1;
+  events_.resize(size);
+}
+
+uint32_t VMTrace::ThreadIndex() {
+  static std::atomic<uint32_t> num_threads{0};
+  static thread_local uint32_t index = num_threads.fetch_add(1);
+  return index;
+}
+
+std::string VMTrace::ToChromeJSON(const std::vector<std::string>& func_names,
+                                  const std::vector<std::string>& kernel_names) const {
+  uint64_t next = next_.load(std::memory_order_relaxed);
+  uint64_t first = next > events_.size() ? next - events_.size() : 0;
+  std::vector<const Event*> events;
+  for (uint64_t i = first; i < next; ++i) {
+    events.push_back(&events_[i & (events_.size() - 1)]);
+  }
+  int64_t origin = 0;
+  if (!events.empty()) {
+    origin = (*std::min_element(events.begin(), events.end(), [](const Event* a, const Event* b) {
+        return a->begin < b->begin;
+      }))->begin;
+  }
+  // an instruction lasts until the next instruction or frame of its thread.
+  std::vector<int64_t> ends(events.size(), 0);
+  std::unordered_map<uint32_t, size_t> last_instruction;
+  for (size_t i = 0; i < events.size(); ++i) {
+    const Event& e = *events[i];
+    if (e.kind != EventKind::kInstruction && e.kind != EventKind::kPushFrame &&
+        e.kind != EventKind::kPopFrame) {
+      continue;
+    }
+    auto it = last_instruction.find(e.tid);
+    if (it != last_instruction.end()) {
+      ends[it->second] = e.begin;
+      last_instruction.erase(it);
+    }
+    if (e.kind == EventKind::kInstruction) last_instruction[e.tid] = i;
+  }
+
+  std::ostringstream os;
+  os << std::fixed << std::setprecision(3);
+  auto us = [origin](int64_t ns) { return (ns - origin) / 1e3; };
+  os << "{\"traceEvents\": [";
+  for (size_t i = 0; i < events.size(); ++i) {
+    const Event& e = *events[i];
+    int64_t end = e.kind == EventKind::kInstruction ? ends[i] : e.end;
+    os << (i == 0 ? "" : ",") << "\n{\"pid\": 0, \"tid\": " << e.tid
+       << ", \"ts\": " << us(e.begin) << ", ";
+    switch (e.kind) {
+      case EventKind::kInstruction:
+        os << "\"ph\": \"X\", \"cat\": \"dispatch\", \"name\": \""
+           << OpcodeName(static_cast<Opcode>(e.args[0])) << "\", \"args\": {\"func\": \""
+           << NameAt(func_names, e.args[1], "func_") << "\", \"pc\": " << e.args[2] << "}";
+        break;
+      case EventKind::kAllocStorage:
+        os << "\"ph\": \"X\", \"cat\": \"alloc\", \"name\": \"AllocStorage\", \"args\": "
+           << "{\"bytes\": " << e.args[0] << ", \"device_type\": " << e.args[1]
+           << ", \"device_id\": " << e.args[2] << "}";
+        break;
+      case EventKind::kKernel:
+        os << "\"ph\": \"X\", \"cat\": \"kernel\", \"name\": \""
+           << NameAt(kernel_names, e.args[0], "packed_") << "\"";
+        break;
+      case EventKind::kDeviceCopy:
+        os << "\"ph\": \"X\", \"cat\": \"copy\", \"name\": \"DeviceCopy\", \"args\": "
+           << "{\"bytes\": " << e.args[0] << ", \"src_device_type\": " << e.args[1]
+           << ", \"dst_device_type\": " << e.args[2] << "}";
+        break;
+      case EventKind::kPushFrame:
+      case EventKind::kPopFrame:
+        os << "\"ph\": \"" << (e.kind == EventKind::kPushFrame ? "B" : "E")
+           << "\", \"cat\": \"frame\", \"name\": \"" << NameAt(func_names, e.args[0], "func_")
+           << "\"";
+        break;
+    }
+    if (e.kind != EventKind::kPushFrame && e.kind != EventKind::kPopFrame) {
+      os << ", \"dur\": " << (end >= e.begin ? (end - e.begin) / 1e3 : 0.0);
+    }
+    os << "}";
+  }
+  os << "],\n\"displayTimeUnit\": \"ns\", \"otherData\": {\"num_events\": " << next
+     << ", \"num_dropped\": " << first << "}}";
+  return os.str();
+}
+
+}  // namespace vm
+}  // namespace runtime
+}  // namespace tvm
@@ -0,0 +1,140 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file runtime/vm/trace.h
+ * \brief A timeline of the instructions, allocations, kernels and calls of
+ *  the VM.
+ */
+#ifndef TVM_RUNTIME_VM_TRACE_H_
+#define TVM_RUNTIME_VM_TRACE_H_
+
+#include <tvm/runtime/vm.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace tvm {
+namespace runtime {
+namespace vm {
+
+/*!
+ * \brief A ring buffer of the events of the runs of a VM, exported in the
+ *  Chrome trace event format.
+ *
+ *  Recording an event takes a timestamp and a slot of the buffer, which
+ *  holds the latest events once it is full. The runs recorded may be
+ *  sampled, so that tracing can stay on under load.
+ */
+class VMTrace {
+ public:
+  enum class EventKind : uint8_t {
+    /*! \brief The dispatch of an instruction: opcode, function, pc. */
+    kInstruction,
+    /*! \brief The allocation of a storage: bytes, device type, device id. */
+    kAllocStorage,
+    /*! \brief The run of a kernel: packed index. */
+    kKernel,
+    /*! \brief The push of a call frame: function. */
+    kPushFrame,
+    /*! \brief The pop of a call frame: function. */
+    kPopFrame,
+    /*! \brief The copy of a tensor across devices: bytes, source and destination device types. */
+    kDeviceCopy,
+  };
+
+  struct Event {
+    EventKind kind;
+    /*! \brief The thread recording the event. */
+    uint32_t tid;
+    /*! \brief The times of the event, in nanoseconds, with end zero if not known. */
+    int64_t begin;
+    int64_t end;
+    int64_t args[3];
+  };
+
+  /*!
+   * \param capacity The number of events kept, rounded up to a power of two.
+   * \param sample_every Record one run in every sample_every.
+   */
+  VMTrace(size_t capacity, int sample_every);
+
+  /*! \return Whether to record the next run. */
+  bool Sample() {
+    return enabled_.load(std::memory_order_relaxed) && num_runs_++ % sample_every_ == 0;
+  }
+
+  /*! \brief Stop recording the runs, keeping the events recorded. */
+  void Stop() {
+    enabled_.store(false, std::memory_order_relaxed);
+  }
+
+  /*! \return The current time, in nanoseconds. */
+  static int64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  /*! \brief Record an event, from any thread. */
+  void Record(EventKind kind, int64_t begin, int64_t end,
+              int64_t arg0 = 0, int64_t arg1 = 0, int64_t arg2 = 0) {
+    uint64_t index = next_.fetch_add(1, std::memory_order_relaxed);
+    Event& e = events_[index & (events_.size() - 1)];
+    e.kind = kind;
+    e.tid = ThreadIndex();
+    e.begin = begin;
+    e.end = end;
+    e.args[0] = arg0;
+    e.args[1] = arg1;
+    e.args[2] = arg2;
+  }
+
+  /*!
+   * \brief Export the events kept, while no run is being recorded.
+   *
+   *  Instructions, storages, kernels and copies are complete events, nested in the
+   *  calls of the functions. An instruction lasts until the next event of
+   *  the control flow of the VM.
+   *
+   * \param func_names The name of each VM function.
+   * \param kernel_names The name of each packed function.
+   * \return The trace, in json.
+   */
+  std::string ToChromeJSON(const std::vector<std::string>& func_names,
+                           const std::vector<std::string>& kernel_names) const;
+
+ private:
+  /*! \return A small index of the calling thread. */
+  static uint32_t ThreadIndex();
+
+  std::vector<Event> events_;
+  std::atomic<uint64_t> next_{0};
+  /*! \brief The number of runs, counted on the thread of the VM. */
+  uint64_t num_runs_{0};
+  int sample_every_;
+  std::atomic<bool> enabled_{true};
+};
+
+}  // namespace vm
+}  // namespace runtime
+}  // namespace tvm
+
+#endif  // TVM_RUNTIME_VM_TRACE_H_
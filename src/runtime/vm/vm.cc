@@ -31,13 +31,25 @@
 
 #include <algorithm>
 #include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "kernel_scheduler.h"
 #include "memory_manager.h"
 #include "naive_allocator.h"
+#include "shape_cache.h"
+#include "trace.h"
+#include "../graph/graph_runtime.h"
 
 using namespace tvm::runtime;
 
@@ -80,6 +92,7 @@ Instruction::Instruction(const Instruction& instr) {
       return;
     case Opcode::AllocTensor:
       this->alloc_tensor.storage = instr.alloc_tensor.storage;
+      this->alloc_tensor.offset = instr.alloc_tensor.offset;
       this->alloc_tensor.ndim = instr.alloc_tensor.ndim;
       this->alloc_tensor.shape = Duplicate<int64_t>(instr.alloc_tensor.shape,
                                                     instr.alloc_tensor.ndim);
@@ -121,6 +134,7 @@ Instruction::Instruction(const Instruction& instr) {
       return;
     case Opcode::LoadConst:
       this->const_index = instr.const_index;
+      this->const_device_type = instr.const_device_type;
       return;
     case Opcode::LoadConsti:
       this->load_consti = instr.load_consti;
@@ -138,6 +152,19 @@ Instruction::Instruction(const Instruction& instr) {
     case Opcode::AllocStorage:
       this->alloc_storage = instr.alloc_storage;
       return;
+    case Opcode::DeviceCopy:
+      this->device_copy = instr.device_copy;
+      return;
+    case Opcode::IfConst:
+      this->if_const = instr.if_const;
+      return;
+    case Opcode::IfTag:
+      this->if_tag = instr.if_tag;
+      return;
+    case Opcode::AllocStorageConst:
+    case Opcode::AllocStorageTensor:
+      this->alloc_storage_const = instr.alloc_storage_const;
+      return;
     default:
       std::ostringstream out;
       out << "Invalid instruction " << static_cast<int>(instr.op);
@@ -169,7 +196,8 @@ Instruction& Instruction::operator=(const Instruction& instr) {
       this->result = instr.result;
       return *this;
     case Opcode::AllocTensor:
-      this->alloc_tensor.storage = this->alloc_tensor.storage;
+      this->alloc_tensor.storage = instr.alloc_tensor.storage;
+      this->alloc_tensor.offset = instr.alloc_tensor.offset;
       this->alloc_tensor.ndim = instr.alloc_tensor.ndim;
       this->alloc_tensor.shape = Duplicate<int64_t>(instr.alloc_tensor.shape,
                                                     instr.alloc_tensor.ndim);
@@ -216,6 +244,7 @@ Instruction& Instruction::operator=(const Instruction& instr) {
       return *this;
     case Opcode::LoadConst:
       this->const_index = instr.const_index;
+      this->const_device_type = instr.const_device_type;
       return *this;
     case Opcode::GetField:
       this->object = instr.object;
@@ -230,6 +259,19 @@ Instruction& Instruction::operator=(const Instruction& instr) {
     case Opcode::AllocStorage:
       this->alloc_storage = instr.alloc_storage;
       return *this;
+    case Opcode::DeviceCopy:
+      this->device_copy = instr.device_copy;
+      return *this;
+    case Opcode::IfConst:
+      this->if_const = instr.if_const;
+      return *this;
+    case Opcode::IfTag:
+      this->if_tag = instr.if_tag;
+      return *this;
+    case Opcode::AllocStorageConst:
+    case Opcode::AllocStorageTensor:
+      this->alloc_storage_const = instr.alloc_storage_const;
+      return *this;
     default:
       std::ostringstream out;
       out << "Invalid instruction " << static_cast<int>(instr.op);
@@ -249,7 +291,12 @@ Instruction::~Instruction() {
     case Opcode::Goto:
     case Opcode::LoadConsti:
     case Opcode::AllocStorage:
+    case Opcode::DeviceCopy:
     case Opcode::Fatal:
+    case Opcode::IfConst:
+    case Opcode::IfTag:
+    case Opcode::AllocStorageConst:
+    case Opcode::AllocStorageTensor:
       return;
     case Opcode::AllocTensor:
       delete this->alloc_tensor.shape;
@@ -306,12 +353,14 @@ Instruction Instruction::InvokePacked(Index packed_index,
 
 Instruction Instruction::AllocTensor(
   RegName storage,
+  Index offset,
   const std::vector<int64_t>& shape,
   DLDataType dtype, Index dst) {
   Instruction instr;
   instr.op = Opcode::AllocTensor;
   instr.dst = dst;
   instr.alloc_tensor.storage = storage;
+  instr.alloc_tensor.offset = offset;
   instr.alloc_tensor.ndim = shape.size();
   instr.alloc_tensor.shape = new int64_t[shape.size()];
   for (size_t i = 0; i < shape.size(); ++i) {
@@ -337,13 +386,28 @@ Instruction Instruction::AllocTensorReg(
 Instruction Instruction::AllocStorage(RegName size,
                                       Index alignment,
                                       TVMType dtype_hint,
-                                      Index dst) {
+                                      Index dst,
+                                      Index device_type,
+                                      Index device_id) {
   Instruction instr;
   instr.op = Opcode::AllocStorage;
   instr.dst = dst;
   instr.alloc_storage.allocation_size = size;
   instr.alloc_storage.alignment = alignment;
   instr.alloc_storage.dtype_hint = dtype_hint;
+  instr.alloc_storage.device_type = device_type;
+  instr.alloc_storage.device_id = device_id;
+  return instr;
+}
+
+Instruction Instruction::DeviceCopy(RegName src, Index device_type, Index device_id,
+                                    RegName dst) {
+  Instruction instr;
+  instr.op = Opcode::DeviceCopy;
+  instr.dst = dst;
+  instr.device_copy.src = src;
+  instr.device_copy.device_type = device_type;
+  instr.device_copy.device_id = device_id;
   return instr;
 }
 
@@ -437,11 +501,12 @@ Instruction Instruction::InvokeClosure(RegName closure, const std::vector<RegNam
   return instr;
 }
 
-Instruction Instruction::LoadConst(Index const_index, RegName dst) {
+Instruction Instruction::LoadConst(Index const_index, RegName dst, Index device_type) {
   Instruction instr;
   instr.op = Opcode::LoadConst;
   instr.dst = dst;
   instr.const_index = const_index;
+  instr.const_device_type = device_type;
   return instr;
 }
 
@@ -519,7 +584,7 @@ void InstructionPrint(std::ostream& os, const Instruction& instr) {
     }
     case Opcode::AllocTensor: {
       os << "alloc_tensor $" << instr.dst << " $"
-         << instr.alloc_tensor.storage << " ["
+         << instr.alloc_tensor.storage << " " << instr.alloc_tensor.offset << " ["
          << StrJoin<int64_t>(instr.alloc_tensor.shape, 0,
                              instr.alloc_tensor.ndim)
          << "] ";
@@ -563,6 +628,9 @@ void InstructionPrint(std::ostream& os, const Instruction& instr) {
     }
     case Opcode::LoadConst: {
       os << "load_const $" << instr.dst << " Const[" << instr.const_index << "]";
+      if (instr.const_device_type >= 0) {
+        os << " device(" << instr.const_device_type << ")";
+      }
       break;
     }
     case Opcode::LoadConsti: {
@@ -588,6 +656,39 @@ void InstructionPrint(std::ostream& os, const Instruction& instr) {
         instr.alloc_storage.allocation_size << " $" <<
         instr.alloc_storage.alignment << " " <<
         TVMType2String(instr.alloc_storage.dtype_hint);
+      if (instr.alloc_storage.device_type >= 0) {
+        os << " device(" << instr.alloc_storage.device_type << ", "
+           << instr.alloc_storage.device_id << ")";
+      }
+      break;
+    }
+    case Opcode::DeviceCopy: {
+      os << "device_copy $" << instr.dst << " $" << instr.device_copy.src << " device("
+         << instr.device_copy.device_type << ", " << instr.device_copy.device_id << ")";
+      break;
+    }
+    case Opcode::IfConst: {
+      os << "if_const $" << instr.if_const.test << " " << instr.if_const.target_val << " "
+         << instr.if_const.true_offset << " " << instr.if_const.false_offset;
+      break;
+    }
+    case Opcode::IfTag: {
+      os << "if_tag $" << instr.if_tag.object << " " << instr.if_tag.tag << " "
+         << instr.if_tag.true_offset << " " << instr.if_tag.false_offset;
+      break;
+    }
+    case Opcode::AllocStorageConst:
+    case Opcode::AllocStorageTensor: {
+      os << (instr.op == Opcode::AllocStorageConst ? "alloc_storage_const $"
+                                                  : "alloc_storage_tensor $")
+         << instr.dst << " " << instr.alloc_storage_const.allocation_size << " "
+         << instr.alloc_storage_const.alignment << " "
+         << TVMType2String(instr.alloc_storage_const.dtype_hint);
+      if (instr.alloc_storage_const.device_type >= 0) {
+        os << " device(" << instr.alloc_storage_const.device_type << ", "
+           << instr.alloc_storage_const.device_id << ")";
+      }
+      os << " fused(" << instr.alloc_storage_const.num_fused << ")";
       break;
     }
     default:
@@ -616,13 +717,427 @@ std::ostream& operator<<(std::ostream& os, const VMFunction& vm_func) {
 inline ObjectRef CopyTo(ObjectRef src, const DLContext& ctx) {
   if (src->IsInstance<NDArray::ContainerType>()) {
     auto nd_array = Downcast<NDArray>(src);
-    if (nd_array->ctx.device_type != ctx.device_type) {
+    if (nd_array->ctx.device_type != ctx.device_type ||
+        nd_array->ctx.device_id != ctx.device_id) {
       return nd_array.CopyTo(ctx);
     }
   }
   return src;
 }
 
+// The registers read by an instruction.
+static void GetReadRegisters(const Instruction& instr, std::vector<RegName>* regs) {
+  switch (instr.op) {
+    case Opcode::Move:
+      regs->push_back(instr.from);
+      break;
+    case Opcode::Ret:
+      regs->push_back(instr.result);
+      break;
+    case Opcode::Invoke:
+      regs->insert(regs->end(), instr.invoke_args_registers,
+                   instr.invoke_args_registers + instr.num_args);
+      break;
+    case Opcode::InvokeClosure:
+      regs->push_back(instr.closure);
+      regs->insert(regs->end(), instr.closure_args, instr.closure_args + instr.num_closure_args);
+      break;
+    case Opcode::InvokePacked:
+      regs->insert(regs->end(), instr.packed_args, instr.packed_args + instr.arity);
+      break;
+    case Opcode::AllocTensor:
+      regs->push_back(instr.alloc_tensor.storage);
+      break;
+    case Opcode::AllocTensorReg:
+      regs->push_back(instr.alloc_tensor_reg.storage);
+      regs->push_back(instr.alloc_tensor_reg.shape_register);
+      break;
+    case Opcode::AllocADT:
+      regs->insert(regs->end(), instr.datatype_fields, instr.datatype_fields + instr.num_fields);
+      break;
+    case Opcode::AllocClosure:
+      regs->insert(regs->end(), instr.free_vars, instr.free_vars + instr.num_freevar);
+      break;
+    case Opcode::GetField:
+      regs->push_back(instr.object);
+      break;
+    case Opcode::GetTag:
+      regs->push_back(instr.get_tag.object);
+      break;
+    case Opcode::If:
+      regs->push_back(instr.if_op.test);
+      regs->push_back(instr.if_op.target);
+      break;
+    case Opcode::AllocStorage:
+      regs->push_back(instr.alloc_storage.allocation_size);
+      regs->push_back(instr.alloc_storage.alignment);
+      break;
+    case Opcode::DeviceCopy:
+      regs->push_back(instr.device_copy.src);
+      break;
+    case Opcode::IfConst:
+      regs->push_back(instr.if_const.test);
+      break;
+    case Opcode::IfTag:
+      regs->push_back(instr.if_tag.object);
+      break;
+    case Opcode::LoadConst:
+    case Opcode::LoadConsti:
+    case Opcode::Goto:
+    case Opcode::Fatal:
+    case Opcode::AllocStorageConst:
+    case Opcode::AllocStorageTensor:
+      break;
+  }
+}
+
+// Read a scalar integer as LoadScalarInt, false if it is not one on the host.
+static bool GetHostScalarInt(const ObjectRef& obj, int32_t* val) {
+  const auto* array = obj.as<NDArray::Container>();
+  if (array == nullptr || array->dl_tensor.ctx.device_type != kDLCPU) return false;
+  const DLTensor& t = array->dl_tensor;
+  if (t.dtype.code != kDLInt && t.dtype.code != kDLUInt) return false;
+  if (t.dtype.lanes != 1 || GetDataSize(t) > sizeof(int64_t)) return false;
+  const char* data = static_cast<const char*>(t.data) + t.byte_offset;
+  if (t.dtype.bits <= 8) {
+    *val = *reinterpret_cast<const int8_t*>(data);
+  } else if (t.dtype.bits <= 16) {
+    *val = *reinterpret_cast<const int16_t*>(data);
+  } else {
+    *val = *reinterpret_cast<const int32_t*>(data);
+  }
+  return true;
+}
+
+/*!
+ * \brief Form superinstructions for the common sequences of a function.
+ *
+ *  A sequence is fused when the registers it writes for its own use are
+ *  read nowhere else in the function, and no jump lands inside of it. The
+ *  superinstruction replaces the first instruction of the sequence and
+ *  jumps over the rest, which stay in place so that the jump offsets of
+ *  the function are unchanged.
+ */
+static std::vector<Instruction> FuseInstructions(const VMFunction& func,
+                                                 const Executable& exec) {
+  std::vector<Instruction> code = func.instructions;
+  size_t num_instrs = code.size();
+  std::unordered_map<RegName, int> num_reads;
+  std::vector<bool> is_target(num_instrs + 1, false);
+  std::vector<RegName> regs;
+  for (size_t pc = 0; pc < num_instrs; ++pc) {
+    const Instruction& instr = code[pc];
+    regs.clear();
+    GetReadRegisters(instr, &regs);
+    for (RegName r : regs) ++num_reads[r];
+    auto mark = [&](Index offset) {
+      Index target = static_cast<Index>(pc) + offset;
+      if (target >= 0 && target <= static_cast<Index>(num_instrs)) is_target[target] = true;
+    };
+    if (instr.op == Opcode::If) {
+      mark(instr.if_op.true_offset);
+      mark(instr.if_op.false_offset);
+    } else if (instr.op == Opcode::Goto) {
+      mark(instr.pc_offset);
+    }
+  }
+  // whether the register written by instr is only read once, by the sequence.
+  auto read_once = [&](const Instruction& instr) {
+    return num_reads[instr.dst] == 1;
+  };
+  // the value of a constant load at load time.
+  auto const_value = [&](const Instruction& instr, int32_t* val) {
+    if (instr.op == Opcode::LoadConsti) {
+      *val = static_cast<int32_t>(instr.load_consti.val);
+      return true;
+    }
+    return instr.op == Opcode::LoadConst &&
+        static_cast<size_t>(instr.const_index) < exec.constants.size() &&
+        GetHostScalarInt(exec.GetConstant(instr.const_index), val);
+  };
+
+  for (size_t pc = 0; pc < num_instrs; ++pc) {
+    const Instruction& instr = code[pc];
+    // get_tag $g $adt; load_consti $t k; if $g $t => if_tag $adt k
+    if (instr.op == Opcode::GetTag && pc + 2 < num_instrs &&
+        code[pc + 1].op == Opcode::LoadConsti && code[pc + 2].op == Opcode::If &&
+        !is_target[pc + 1] && !is_target[pc + 2]) {
+      const Instruction& load = code[pc + 1];
+      const Instruction& cond = code[pc + 2];
+      if (cond.if_op.test == instr.dst && cond.if_op.target == load.dst &&
+          instr.dst != load.dst && read_once(instr) && read_once(load) &&
+          cond.if_op.true_offset != 0 && cond.if_op.false_offset != 0) {
+        Instruction fused;
+        fused.op = Opcode::IfTag;
+        fused.dst = 0;
+        fused.if_tag.object = instr.get_tag.object;
+        fused.if_tag.tag = load.load_consti.val;
+        fused.if_tag.true_offset = cond.if_op.true_offset + 2;
+        fused.if_tag.false_offset = cond.if_op.false_offset + 2;
+        code[pc] = fused;
+        pc += 2;
+        continue;
+      }
+    }
+    // load_consti $t k; if $c $t => if_const $c k
+    if (instr.op == Opcode::LoadConsti && pc + 1 < num_instrs &&
+        code[pc + 1].op == Opcode::If && !is_target[pc + 1]) {
+      const Instruction& cond = code[pc + 1];
+      if (cond.if_op.target == instr.dst && cond.if_op.test != instr.dst && read_once(instr) &&
+          cond.if_op.true_offset != 0 && cond.if_op.false_offset != 0) {
+        Instruction fused;
+        fused.op = Opcode::IfConst;
+        fused.dst = 0;
+        fused.if_const.test = cond.if_op.test;
+        fused.if_const.target_val = instr.load_consti.val;
+        fused.if_const.true_offset = cond.if_op.true_offset + 1;
+        fused.if_const.false_offset = cond.if_op.false_offset + 1;
+        code[pc] = fused;
+        pc += 1;
+        continue;
+      }
+    }
+    // load_const $s; load_const $a; alloc_storage $d $s $a [; alloc_tensor $x $d]
+    //   => alloc_storage_const $d size alignment, or alloc_storage_tensor.
+    int32_t v0, v1;
+    if (pc + 2 < num_instrs && code[pc + 2].op == Opcode::AllocStorage &&
+        !is_target[pc + 1] && !is_target[pc + 2] &&
+        const_value(instr, &v0) && const_value(code[pc + 1], &v1) &&
+        instr.dst != code[pc + 1].dst && read_once(instr) && read_once(code[pc + 1])) {
+      const Instruction& alloc = code[pc + 2];
+      RegName size_reg = alloc.alloc_storage.allocation_size;
+      RegName align_reg = alloc.alloc_storage.alignment;
+      bool in_order = instr.dst == size_reg && code[pc + 1].dst == align_reg;
+      bool swapped = instr.dst == align_reg && code[pc + 1].dst == size_reg;
+      if (in_order || swapped) {
+        Instruction fused;
+        fused.dst = alloc.dst;
+        fused.alloc_storage_const.allocation_size = in_order ? v0 : v1;
+        fused.alloc_storage_const.alignment = in_order ? v1 : v0;
+        fused.alloc_storage_const.dtype_hint = alloc.alloc_storage.dtype_hint;
+        fused.alloc_storage_const.device_type =
+            static_cast<int32_t>(alloc.alloc_storage.device_type);
+        fused.alloc_storage_const.device_id = static_cast<int32_t>(alloc.alloc_storage.device_id);
+        fused.alloc_storage_const.num_fused = 3;
+        bool with_tensor = pc + 3 < num_instrs && code[pc + 3].op == Opcode::AllocTensor &&
+            code[pc + 3].alloc_tensor.storage == alloc.dst;
+        fused.op = with_tensor ? Opcode::AllocStorageTensor : Opcode::AllocStorageConst;
+        code[pc] = fused;
+        pc += with_tensor ? 3 : 2;
+        continue;
+      }
+    }
+  }
+  return code;
+}
+
+/*!
+ * \brief The thread running the asynchronous invocations of a VM, in the
+ *  order they are made.
+ */
+class AsyncDriver {
+ public:
+  using RunFunc = std::function<ObjectRef(Index, const std::vector<ObjectRef>&)>;
+
+  explicit AsyncDriver(RunFunc run) : run_(run) {
+    thread_ = std::thread([this] { this->Loop(); });
+  }
+
+  /*! \brief Finish the invocations made and stop the thread. */
+  ~AsyncDriver() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      exit_now_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+  }
+
+  std::shared_future<ObjectRef> Submit(Index func_index, std::vector<ObjectRef> args) {
+    Request req;
+    req.func_index = func_index;
+    req.args = std::move(args);
+    std::shared_future<ObjectRef> result = req.promise.get_future().share();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.push_back(std::move(req));
+    }
+    cv_.notify_one();
+    return result;
+  }
+
+ private:
+  struct Request {
+    Index func_index;
+    std::vector<ObjectRef> args;
+    std::promise<ObjectRef> promise;
+  };
+
+  void Loop() {
+    while (true) {
+      Request req;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return exit_now_ || !queue_.empty(); });
+        if (queue_.empty()) return;
+        req = std::move(queue_.front());
+        queue_.pop_front();
+      }
+      try {
+        req.promise.set_value(run_(req.func_index, req.args));
+      } catch (...) {
+        req.promise.set_exception(std::current_exception());
+      }
+    }
+  }
+
+  RunFunc run_;
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Request> queue_;
+  bool exit_now_{false};
+};
+
+/*! \brief The result of an asynchronous invocation, as a module. */
+class VMFutureNode : public ModuleNode {
+ public:
+  VMFutureNode(std::shared_future<ObjectRef> result, ObjectPtr<Object> vm)
+      : result_(result), vm_(vm) {}
+
+  const char* type_key() const final {
+    return "VMFuture";
+  }
+
+  PackedFunc GetFunction(const std::string& name,
+                         const ObjectPtr<Object>& sptr_to_self) final {
+    if (name == "wait") {
+      return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+        *rv = result_.get();
+      });
+    } else if (name == "done") {
+      return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+        *rv = result_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+      });
+    } else {
+      return PackedFunc(nullptr);
+    }
+  }
+
+ private:
+  std::shared_future<ObjectRef> result_;
+  /*! \brief The VM, kept alive until the result is dropped. */
+  ObjectPtr<Object> vm_;
+};
+
+VirtualMachine::VirtualMachine()
+    : frames_(), registers_(nullptr), func_index_(0), code_(nullptr), pc_(0), exec_(nullptr) {}
+
+VirtualMachine::~VirtualMachine() {
+  // finish the asynchronous invocations while the VM is whole.
+  async_driver_.reset();
+}
+
+std::shared_future<ObjectRef> VirtualMachine::InvokeAsync(const std::string& name,
+                                                          const std::vector<ObjectRef>& args) {
+  CHECK(exec_) << "The executable has not been created yet.";
+  auto it = exec_->global_map.find(name);
+  CHECK(it != exec_->global_map.end())
+    << "Cannot find function " << name << " in the executable";
+  CHECK_EQ(args.size(), exec_->functions[it->second].params.size())
+      << "Input has not been set for function " << name;
+  std::call_once(async_driver_once_, [this] {
+    async_driver_.reset(new AsyncDriver([this](Index func_index,
+                                               const std::vector<ObjectRef>& func_args) {
+      std::lock_guard<std::mutex> lock(run_mutex_);
+      if (async_configured_) return Invoke(exec_->functions[func_index], func_args);
+      // the synchronous invocations keep running their kernels in place.
+      if (async_default_scheduler_ == nullptr) {
+        async_default_scheduler_.reset(new KernelScheduler(ParseCoreGroups("", 2)));
+      }
+      std::swap(kernel_scheduler_, async_default_scheduler_);
+      try {
+        ObjectRef ret = Invoke(exec_->functions[func_index], func_args);
+        std::swap(kernel_scheduler_, async_default_scheduler_);
+        return ret;
+      } catch (...) {
+        std::swap(kernel_scheduler_, async_default_scheduler_);
+        throw;
+      }
+    }));
+  });
+  return async_driver_->Submit(it->second, args);
+}
+
+void VirtualMachine::ConfigureAsync(int num_workers, const std::string& worker_cores) {
+  CHECK_GE(num_workers, 0);
+  std::lock_guard<std::mutex> lock(run_mutex_);
+  kernel_scheduler_.reset();
+  async_default_scheduler_.reset();
+  if (num_workers > 0) {
+    kernel_scheduler_.reset(new KernelScheduler(ParseCoreGroups(worker_cores, num_workers)));
+  }
+  async_configured_ = true;
+}
+
+// The name of each packed function of an executable.
+static std::vector<std::string> PrimitiveNames(const Executable& exec) {
+  std::vector<std::string> names(exec.primitive_map.size());
+  for (const auto& it : exec.primitive_map) {
+    names[it.second] = it.first;
+  }
+  return names;
+}
+
+void VirtualMachine::ConfigureShapeCache(int max_entries) {
+  CHECK_GE(max_entries, 0);
+  std::lock_guard<std::mutex> lock(run_mutex_);
+  shape_cache_entries_ = max_entries;
+  shape_cache_.reset();
+  if (exec_ != nullptr && max_entries > 0 && !exec_->shape_funcs.empty()) {
+    shape_cache_.reset(new ShapeCache(PrimitiveNames(*exec_), exec_->shape_funcs, max_entries));
+  }
+}
+
+void VirtualMachine::SetSpecializeHook(PackedFunc hook, int threshold) {
+  CHECK(exec_) << "The executable is not created yet.";
+  std::lock_guard<std::mutex> lock(run_mutex_);
+  specializer_.reset();
+  if (hook != nullptr) {
+    specializer_.reset(new KernelSpecializer(PrimitiveNames(*exec_), hook, threshold));
+  }
+}
+
+std::string VirtualMachine::ShapeCacheStats() {
+  std::lock_guard<std::mutex> lock(run_mutex_);
+  std::ostringstream os;
+  os << "{\"shape_cache\": " << (shape_cache_ ? shape_cache_->StatsJSON() : "null")
+     << ", \"specialized\": " << (specializer_ ? specializer_->StatsJSON() : "null")
+     << "}";
+  return os.str();
+}
+
+void VirtualMachine::StartTrace(size_t capacity, int sample_every) {
+  std::lock_guard<std::mutex> lock(run_mutex_);
+  trace_ = std::make_shared<VMTrace>(capacity, sample_every);
+}
+
+void VirtualMachine::StopTrace() {
+  std::lock_guard<std::mutex> lock(run_mutex_);
+  if (trace_ != nullptr) trace_->Stop();
+}
+
+std::string VirtualMachine::ExportTrace() {
+  CHECK(exec_) << "The executable is not created yet.";
+  std::lock_guard<std::mutex> lock(run_mutex_);
+  CHECK(trace_ != nullptr) << "The VM has not been traced, call start_trace first";
+  std::vector<std::string> func_names;
+  for (const auto& func : exec_->functions) {
+    func_names.push_back(func.name);
+  }
+  return trace_->ToChromeJSON(func_names, PrimitiveNames(*exec_));
+}
+
 PackedFunc VirtualMachine::GetFunction(const std::string& name,
                                        const ObjectPtr<Object>& sptr_to_self) {
   if (name == "invoke") {
@@ -632,15 +1147,58 @@ PackedFunc VirtualMachine::GetFunction(const std::string& name,
       auto git = exec_->global_map.find(func_name);
       CHECK(git != exec_->global_map.end())
         << "Cannot find function " << func_name << " in the executable";
-      auto func = exec_->functions[git->second];
-      if (func.params.empty()) {
-        *rv = Invoke(func, {});
-      } else {
-        auto it = inputs_.find(func_name);
-        CHECK(it != inputs_.end()) << "Input has not been set for function " << func_name;
-        const std::vector<ObjectRef> &func_args = it->second;
-        *rv = Invoke(func, func_args);
-      }
+      const auto& func = exec_->functions[git->second];
+      const std::vector<ObjectRef>& func_args = inputs_[git->second];
+      CHECK_EQ(func_args.size(), func.params.size())
+          << "Input has not been set for function " << func_name;
+      std::lock_guard<std::mutex> lock(run_mutex_);
+      *rv = Invoke(func, func_args);
+    });
+  } else if (name == "invoke_async") {
+    return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+      CHECK(exec_) << "The executable is not created yet.";
+      std::string func_name = args[0];
+      auto git = exec_->global_map.find(func_name);
+      CHECK(git != exec_->global_map.end())
+        << "Cannot find function " << func_name << " in the executable";
+      auto future = make_object<VMFutureNode>(InvokeAsync(func_name, inputs_[git->second]),
+                                              sptr_to_self);
+      *rv = Module(future);
+    });
+  } else if (name == "configure_async") {
+    return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+      this->ConfigureAsync(args[0], args[1]);
+    });
+  } else if (name == "configure_shape_cache") {
+    return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+      this->ConfigureShapeCache(args[0]);
+    });
+  } else if (name == "set_specialize_hook") {
+    return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+      PackedFunc hook = args[0].type_code() == kNull ? PackedFunc() : args[0].operator PackedFunc();
+      this->SetSpecializeHook(hook, args[1]);
+    });
+  } else if (name == "get_shape_cache_stats") {
+    return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+      *rv = this->ShapeCacheStats();
+    });
+  } else if (name == "create_context") {
+    return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+      *rv = Module(this->CreateContext());
+    });
+  } else if (name == "start_trace") {
+    return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+      int64_t capacity = args[0];
+      CHECK_GT(capacity, 0);
+      this->StartTrace(static_cast<size_t>(capacity), args[1]);
+    });
+  } else if (name == "stop_trace") {
+    return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+      this->StopTrace();
+    });
+  } else if (name == "export_trace") {
+    return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
+      *rv = this->ExportTrace();
     });
   } else if (name == "init") {
     return PackedFunc([sptr_to_self, this](TVMArgs args, TVMRetValue* rv) {
@@ -664,17 +1222,16 @@ PackedFunc VirtualMachine::GetFunction(const std::string& name,
       auto func_index = gvit->second;
       const auto& vm_func = exec_->functions[func_index];
       const auto& param_names = vm_func.params;
-      // TODO(icemelon9): For heterogeneous execution, get input device information
-      TVMContext ctx = ctxs_[0];
       CHECK_EQ(args.size() - 1, param_names.size()) <<
           "The number of provided parameters doesn't match the number of arguments";
-      std::vector<ObjectRef> func_args(param_names.size());
+      // overwrite the inputs in place, so that setting them again does not allocate.
+      std::vector<ObjectRef>& func_args = inputs_[func_index];
+      func_args.resize(param_names.size());
       for (int i = 1; i < args.size(); ++i) {
-        ObjectRef obj = CopyTo(args[i], ctx);
-        func_args[i - 1] = obj;
+        Index device_type = vm_func.params_device_type.empty()
+            ? -1 : vm_func.params_device_type[i - 1];
+        func_args[i - 1] = CopyTo(args[i], ctxs_[ContextIndex(device_type, 0)]);
       }
-      inputs_.erase(func_name);
-      inputs_.emplace(func_name, func_args);
     });
   } else {
     LOG(FATAL) << "Unknown packed function: " << name;
@@ -697,18 +1254,34 @@ TVMContext VirtualMachine::GetParamsContext() const {
 }
 
 void VirtualMachine::PushFrame(Index arg_count, Index ret_pc, const VMFunction& vm_func) {
-  auto frame = VMFrame(ret_pc, func_index_, arg_count, code_, vm_func.register_file_size);
-  frames_.push_back(frame);
+  Index base = 0;
+  if (!frames_.empty()) {
+    base = frames_.back().register_base + frames_.back().register_file_size;
+  }
+  size_t top = static_cast<size_t>(base + vm_func.register_file_size);
+  if (register_stack_.size() < top) {
+    register_stack_.resize(std::max(top, register_stack_.size() * 2));
+  }
+  frames_.emplace_back(ret_pc, func_index_, arg_count, code_, base, vm_func.register_file_size);
+  registers_ = register_stack_.data() + base;
 }
 
 Index VirtualMachine::PopFrame() {
   CHECK_GT(frames_.size(), 0);
+  if (active_trace_ != nullptr) {
+    active_trace_->Record(VMTrace::EventKind::kPopFrame, VMTrace::Now(), 0, func_index_);
+  }
   const VMFrame& fr = frames_.back();
   func_index_ = fr.func_index;
   code_ = fr.code;
   pc_ = fr.pc;
+  // release the objects held by the registers of the frame.
+  for (Index i = 0; i < fr.register_file_size; ++i) {
+    registers_[i] = ObjectRef();
+  }
   auto call_stack_size = frames_.size();
   frames_.pop_back();
+  registers_ = frames_.empty() ? nullptr : register_stack_.data() + frames_.back().register_base;
   return call_stack_size;
 }
 
@@ -721,15 +1294,38 @@ void VirtualMachine::InvokeGlobal(const VMFunction& func, const std::vector<Obje
   }
   DLOG(INFO) << "func.params= " << func.params.size();
 
-  code_ = func.instructions.data();
+  // run the code with superinstructions, unless func is not of the executable.
+  const VMFunction* first = exec_->functions.data();
+  std::less<const VMFunction*> less;
+  if (!less(&func, first) && less(&func, first + exec_->functions.size())) {
+    func_index_ = &func - first;
+    code_ = loaded_->GetCode(func_index_).data();
+  } else {
+    func_index_ = -1;
+    code_ = func.instructions.data();
+  }
   pc_ = 0;
+  if (active_trace_ != nullptr) {
+    active_trace_->Record(VMTrace::EventKind::kPushFrame, VMTrace::Now(), 0, func_index_);
+  }
 }
 
 ObjectRef VirtualMachine::Invoke(const VMFunction& func, const std::vector<ObjectRef>& args) {
   DLOG(INFO) << "Executing Function: " << std::endl << func;
 
+  size_t depth = frames_.size();
+  active_trace_ = trace_ != nullptr && trace_->Sample() ? trace_.get() : nullptr;
   InvokeGlobal(func, args);
-  RunLoop();
+  try {
+    RunLoop();
+  } catch (...) {
+    // let the kernels in flight finish, and drop the frames of the failed run.
+    if (kernel_scheduler_ != nullptr) kernel_scheduler_->Drain();
+    while (frames_.size() > depth) PopFrame();
+    active_trace_ = nullptr;
+    throw;
+  }
+  active_trace_ = nullptr;
   // TODO(wweic) ctx could be obtained from the ctxs list.
   auto alloc = MemoryManager::Global()->GetAllocator(ctxs_[0]);
   DLOG(INFO) << "Memory used: " << alloc->UsedMemory() << " B";
@@ -746,9 +1342,18 @@ ObjectRef VirtualMachine::Invoke(const std::string& name, const std::vector<Obje
   return Invoke(exec_->functions[func_index_], args);
 }
 
-void VirtualMachine::InvokePacked(Index packed_index, const PackedFunc& func,
-                                  Index arg_count, Index output_size,
-                                  const std::vector<ObjectRef>& args) {
+// The bytes of a tensor, for ordering the kernels accessing it.
+static KernelScheduler::Range TensorRange(const DLTensor& t) {
+  const char* begin = static_cast<const char*>(t.data) + t.byte_offset;
+  return {begin, begin + GetDataSize(t)};
+}
+
+// Call a packed function with the tensors of the arguments, passing the
+// fields of a tuple as separate arguments.
+static void CallPackedTensors(const PackedFunc& func, Index arg_count,
+                              const std::vector<ObjectRef>& args,
+                              std::vector<TVMValue>* packed_values,
+                              std::vector<int>* packed_codes) {
   size_t arity = 0;
   for (Index i = 0; i < arg_count; i++) {
     if (const auto* obj = args[i].as<ADTObj>()) {
@@ -758,31 +1363,206 @@ void VirtualMachine::InvokePacked(Index packed_index, const PackedFunc& func,
     }
   }
 
-  std::vector<TVMValue> values(arity);
-  std::vector<int> codes(arity);
-  runtime::TVMArgsSetter setter(values.data(), codes.data());
+  if (packed_values->size() < arity) {
+    packed_values->resize(arity);
+    packed_codes->resize(arity);
+  }
+  TVMValue* values = packed_values->data();
+  int* codes = packed_codes->data();
+  runtime::TVMArgsSetter setter(values, codes);
   int idx = 0;
   for (Index i = 0; i < arg_count; i++) {
     if (const auto* dt_cell = args[i].as<ADTObj>()) {
       for (size_t fi = 0; fi < dt_cell->size; ++fi) {
-        auto obj = (*dt_cell)[fi];
-        auto nd_array = Downcast<NDArray>(obj);
-        setter(idx++, nd_array);
+        const ObjectRef& obj = (*dt_cell)[fi];
+        CHECK(obj->IsInstance<NDArray::ContainerType>())
+            << "expect an NDArray field, found " << obj->GetTypeKey();
+        setter(idx++, obj);
       }
     } else {
-      auto nd_array = Downcast<NDArray>(args[i]);
-      setter(idx++, nd_array);
+      CHECK(args[i]->IsInstance<NDArray::ContainerType>())
+          << "expect an NDArray argument, found " << args[i]->GetTypeKey();
+      setter(idx++, args[i]);
     }
   }
 
   TVMRetValue rv;
-  func.CallPacked(TVMArgs(values.data(), codes.data(), arity), &rv);
+  func.CallPacked(TVMArgs(values, codes, static_cast<int>(arity)), &rv);
 }
 
-void VirtualMachine::LoadExecutable(const Executable* exec) {
-  CHECK(exec) << "The executable is not created yet.";
-  exec_ = exec;
+void VirtualMachine::InvokePacked(Index packed_index, const PackedFunc& func,
+                                  Index arg_count, Index output_size,
+                                  const std::vector<ObjectRef>& args) {
+  if (kernel_scheduler_ != nullptr) {
+    std::vector<KernelScheduler::Range> reads, writes;
+    bool on_host = true;
+    for (Index i = 0; i < arg_count && on_host; ++i) {
+      // the outputs are the last output_size arguments.
+      auto* ranges = i < arg_count - output_size ? &reads : &writes;
+      auto add = [&](const ObjectRef& obj) {
+        const auto* array = obj.as<NDArray::Container>();
+        if (array == nullptr || array->dl_tensor.ctx.device_type != kDLCPU) {
+          on_host = false;
+        } else {
+          ranges->push_back(TensorRange(array->dl_tensor));
+        }
+      };
+      if (const auto* adt = args[i].as<ADTObj>()) {
+        for (size_t fi = 0; fi < adt->size; ++fi) add((*adt)[fi]);
+      } else {
+        add(args[i]);
+      }
+    }
+    if (on_host) {
+      std::vector<ObjectRef> kernel_args(args.begin(), args.begin() + arg_count);
+      std::shared_ptr<VMTrace> trace = active_trace_ != nullptr ? trace_ : nullptr;
+      kernel_scheduler_->Launch([func, arg_count, kernel_args, trace, packed_index]() {
+          std::vector<TVMValue> values;
+          std::vector<int> codes;
+          int64_t begin = trace != nullptr ? VMTrace::Now() : 0;
+          CallPackedTensors(func, arg_count, kernel_args, &values, &codes);
+          if (trace != nullptr) {
+            trace->Record(VMTrace::EventKind::kKernel, begin, VMTrace::Now(), packed_index);
+          }
+        }, std::move(reads), std::move(writes));
+      return;
+    }
+    // a kernel on a device runs after the kernels on the host it may depend on.
+    kernel_scheduler_->WaitAll();
+  }
+  if (active_trace_ != nullptr) {
+    int64_t begin = VMTrace::Now();
+    CallPackedTensors(func, arg_count, args, &packed_values_, &packed_codes_);
+    active_trace_->Record(VMTrace::EventKind::kKernel, begin, VMTrace::Now(), packed_index);
+    return;
+  }
+  CallPackedTensors(func, arg_count, args, &packed_values_, &packed_codes_);
+}
 
+Storage VirtualMachine::MakeStorage(size_t size, size_t alignment, DLDataType dtype_hint,
+                                    const TVMContext& ctx) {
+  if (active_trace_ == nullptr) {
+    return make_storage(size, alignment, dtype_hint, ctx);
+  }
+  int64_t begin = VMTrace::Now();
+  Storage storage = make_storage(size, alignment, dtype_hint, ctx);
+  active_trace_->Record(VMTrace::EventKind::kAllocStorage, begin, VMTrace::Now(), size,
+                        ctx.device_type, ctx.device_id);
+  return storage;
+}
+
+NDArray VirtualMachine::CopyToDevice(const NDArray& src, const TVMContext& ctx) {
+  const DLTensor& from = *src.operator->();
+  std::vector<int64_t> shape(from.shape, from.shape + from.ndim);
+  size_t size = GetDataSize(from);
+  Storage storage = MakeStorage(size, kAllocAlignment, from.dtype, ctx);
+  NDArray dst = storage->AllocNDArray(0, shape, from.dtype);
+  std::shared_ptr<VMTrace> trace = active_trace_ != nullptr ? trace_ : nullptr;
+  int64_t src_type = from.ctx.device_type;
+  auto copy = [src, dst, trace, size, src_type]() {
+    int64_t begin = trace != nullptr ? VMTrace::Now() : 0;
+    src.CopyTo(dst);
+    if (trace != nullptr) {
+      trace->Record(VMTrace::EventKind::kDeviceCopy, begin, VMTrace::Now(), size, src_type,
+                    dst->ctx.device_type);
+    }
+  };
+  bool src_host = from.ctx.device_type == kDLCPU;
+  bool dst_host = ctx.device_type == kDLCPU;
+  if (kernel_scheduler_ != nullptr && (src_host || dst_host)) {
+    // the copy overlaps with the kernels, in order with those using the host side.
+    std::vector<KernelScheduler::Range> reads, writes;
+    if (src_host) reads.push_back(TensorRange(from));
+    if (dst_host) writes.push_back(TensorRange(*dst.operator->()));
+    if (!src_host || !dst_host) {
+      // the device side was written or is read by kernels run in place.
+      kernel_scheduler_->WaitAll();
+    }
+    kernel_scheduler_->Launch(copy, std::move(reads), std::move(writes));
+  } else {
+    if (kernel_scheduler_ != nullptr) kernel_scheduler_->WaitAll();
+    copy();
+  }
+  return dst;
+}
+
+// Append the tensors of args[begin, end) to tensors, with the fields of a tuple in order.
+static void FlattenTensors(const std::vector<ObjectRef>& args, Index begin, Index end,
+                           std::vector<const DLTensor*>* tensors) {
+  auto add = [tensors](const ObjectRef& obj) {
+    const auto* array = obj.as<NDArray::Container>();
+    CHECK(array != nullptr) << "expect an NDArray argument, found " << obj->GetTypeKey();
+    tensors->push_back(&array->dl_tensor);
+  };
+  for (Index i = begin; i < end; ++i) {
+    if (const auto* adt = args[i].as<ADTObj>()) {
+      for (size_t fi = 0; fi < adt->size; ++fi) add((*adt)[fi]);
+    } else {
+      add(args[i]);
+    }
+  }
+}
+
+void VirtualMachine::InvokeKernel(Index packed_index, const PackedFunc& func,
+                                  Index arg_count, Index output_size,
+                                  const std::vector<ObjectRef>& args) {
+  kernel_inputs_.clear();
+  kernel_outputs_.clear();
+  FlattenTensors(args, 0, arg_count - output_size, &kernel_inputs_);
+  FlattenTensors(args, arg_count - output_size, arg_count, &kernel_outputs_);
+  if (shape_cache_ != nullptr && shape_cache_->IsShapeFunc(packed_index)) {
+    if (kernel_scheduler_ != nullptr) {
+      // the cache reads the inputs, and writes the outputs, on this thread.
+      for (const DLTensor* t : kernel_inputs_) {
+        kernel_scheduler_->WaitWriters(TensorRange(*t));
+      }
+      for (const DLTensor* t : kernel_outputs_) {
+        kernel_scheduler_->WaitAccesses(TensorRange(*t));
+      }
+    }
+    if (shape_cache_->Lookup(packed_index, kernel_inputs_, kernel_outputs_)) return;
+    InvokePacked(packed_index, func, arg_count, output_size, args);
+    if (kernel_scheduler_ != nullptr) {
+      for (const DLTensor* t : kernel_outputs_) {
+        kernel_scheduler_->WaitWriters(TensorRange(*t));
+      }
+    }
+    shape_cache_->Store(kernel_outputs_);
+    return;
+  }
+  const PackedFunc* kernel = &func;
+  if (specializer_ != nullptr) {
+    kernel_inputs_.insert(kernel_inputs_.end(), kernel_outputs_.begin(), kernel_outputs_.end());
+    if (const PackedFunc* specialized = specializer_->Get(packed_index, kernel_inputs_)) {
+      kernel = specialized;
+    }
+  }
+  InvokePacked(packed_index, *kernel, arg_count, output_size, args);
+}
+
+LoadedExecutable::ConstantPool::ConstantPool(const Executable* exec, TVMContext ctx)
+    : exec_(exec), ctx_(ctx), constants_(exec->constants.size()),
+      ready_(new std::atomic<bool>[exec->constants.size()]) {
+  for (size_t i = 0; i < constants_.size(); ++i) {
+    ready_[i].store(false, std::memory_order_relaxed);
+  }
+}
+
+const ObjectRef& LoadedExecutable::ConstantPool::Upload(Index const_index) {
+  CHECK_LT(static_cast<size_t>(const_index), constants_.size());
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!ready_[const_index].load(std::memory_order_relaxed)) {
+    constants_[const_index] = CopyTo(exec_->GetConstant(const_index), ctx_);
+    ready_[const_index].store(true, std::memory_order_release);
+  }
+  return constants_[const_index];
+}
+
+LoadedExecutable::LoadedExecutable(const Executable* exec)
+    : exec_(exec),
+      exec_ref_(GetObjectPtr<Object>(const_cast<Executable*>(exec))),
+      code_(exec->functions.size()),
+      code_ready_(new std::atomic<bool>[exec->functions.size()]) {
   runtime::Module lib = exec_->lib;
   // Get the list of packed functions.
   CHECK(exec->primitive_map.empty() || lib.operator->())
@@ -798,26 +1578,113 @@ void VirtualMachine::LoadExecutable(const Executable* exec) {
     CHECK(pf != nullptr) << "Cannot find function in module: " << packed_name;
     packed_funcs_[packed_index] = pf;
   }
+
+  // TVM_VM_SUPERINSTRUCTIONS=0 runs the instructions as compiled.
+  const char* fuse = getenv("TVM_VM_SUPERINSTRUCTIONS");
+  superinstructions_ = fuse == nullptr || std::string(fuse) != "0";
+  // the code of a function is formed on its first call.
+  for (size_t i = 0; i < code_.size(); ++i) {
+    code_ready_[i].store(false, std::memory_order_relaxed);
+  }
+}
+
+const std::vector<Instruction>& LoadedExecutable::FormCode(Index func_index) {
+  CHECK_LT(static_cast<size_t>(func_index), code_.size());
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!code_ready_[func_index].load(std::memory_order_relaxed)) {
+    // decoded and fused on the first call, every function has at least a ret.
+    const VMFunction& vm_func = exec_->GetVMFunction(func_index);
+    code_[func_index] = superinstructions_ ? FuseInstructions(vm_func, *exec_)
+                                           : vm_func.instructions;
+    code_ready_[func_index].store(true, std::memory_order_release);
+  }
+  return code_[func_index];
+}
+
+LoadedExecutable::ConstantPool* LoadedExecutable::GetConstantPool(TVMContext ctx) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& pool : constant_pools_) {
+    if (pool->ctx().device_type == ctx.device_type && pool->ctx().device_id == ctx.device_id) {
+      return pool.get();
+    }
+  }
+  constant_pools_.emplace_back(new ConstantPool(exec_, ctx));
+  return constant_pools_.back().get();
+}
+
+void VirtualMachine::LoadExecutable(const Executable* exec) {
+  CHECK(exec) << "The executable is not created yet.";
+  LoadShared(std::make_shared<LoadedExecutable>(exec));
+}
+
+void VirtualMachine::LoadShared(std::shared_ptr<LoadedExecutable> loaded) {
+  CHECK(loaded != nullptr);
+  loaded_ = std::move(loaded);
+  exec_ = loaded_->exec();
+  packed_funcs_ = loaded_->packed_funcs();
+  const_pools_.assign(ctxs_.size(), nullptr);
+  inputs_.assign(exec_->functions.size(), std::vector<ObjectRef>());
+
+  // TVM_VM_SHAPE_CACHE=0 calls the shape functions every time.
+  const char* shape_cache = getenv("TVM_VM_SHAPE_CACHE");
+  if (shape_cache != nullptr && std::string(shape_cache) == "0") {
+    shape_cache_entries_ = 0;
+  }
+  shape_cache_.reset();
+  specializer_.reset();
+  if (shape_cache_entries_ > 0 && !exec_->shape_funcs.empty()) {
+    shape_cache_.reset(new ShapeCache(PrimitiveNames(*exec_), exec_->shape_funcs,
+                                      shape_cache_entries_));
+  }
+}
+
+ObjectPtr<VirtualMachine> VirtualMachine::CreateContext() {
+  CHECK(loaded_ != nullptr) << "The executable is not loaded yet.";
+  auto vm = make_object<VirtualMachine>();
+  vm->shape_cache_entries_ = shape_cache_entries_;
+  vm->LoadShared(loaded_);
+  vm->Init(ctxs_);
+  return vm;
 }
 
 
 void VirtualMachine::Init(const std::vector<TVMContext>& ctxs) {
+  CHECK(!ctxs.empty()) << "The VM needs at least one context.";
   ctxs_ = ctxs;
+  const_pools_.assign(ctxs_.size(), nullptr);
+}
+
+Index VirtualMachine::ContextIndex(Index device_type, Index device_id) const {
+  if (device_type < 0) return 0;
+  Index same_type = -1;
+  for (size_t i = 0; i < ctxs_.size(); ++i) {
+    if (ctxs_[i].device_type != device_type) continue;
+    if (ctxs_[i].device_id == device_id) return static_cast<Index>(i);
+    if (same_type < 0) same_type = static_cast<Index>(i);
+  }
+  CHECK_GE(same_type, 0) << "the VM is not initialized with a context of the device type "
+                         << device_type;
+  return same_type;
 }
 
 inline void VirtualMachine::WriteRegister(Index r, const ObjectRef& val) {
-  frames_.back().register_file[r] = val;
+  registers_[r] = val;
 }
 
-inline ObjectRef VirtualMachine::ReadRegister(Index r) const {
-  return frames_.back().register_file[r];
+inline const ObjectRef& VirtualMachine::ReadRegister(Index r) const {
+  return registers_[r];
 }
 
 inline int32_t VirtualMachine::LoadScalarInt(Index r) const {
   int32_t result;
   const auto& obj = ReadRegister(r);
-  auto nd_array = Downcast<NDArray>(obj);
-  NDArray array = nd_array.CopyTo({kDLCPU, 0});
+  auto array = Downcast<NDArray>(obj);
+  // scalars computed on the host, such as the condition of a loop, are read in place.
+  if (array->ctx.device_type != kDLCPU) {
+    array = array.CopyTo({kDLCPU, 0});
+  } else if (kernel_scheduler_ != nullptr) {
+    kernel_scheduler_->WaitWriters(TensorRange(*array.operator->()));
+  }
 
   if (array->dtype.bits <= 8) {
     result = reinterpret_cast<int8_t*>(array->data)[0];
@@ -829,119 +1696,174 @@ inline int32_t VirtualMachine::LoadScalarInt(Index r) const {
   return result;
 }
 
+// Dispatch with computed goto where the compiler supports labels as values,
+// giving each opcode its own indirect branch to predict.
+#if defined(__GNUC__) && !defined(TVM_VM_SWITCH_DISPATCH)
+#define TVM_VM_THREADED_DISPATCH 1
+#else
+#define TVM_VM_THREADED_DISPATCH 0
+#endif
+
+#if USE_RELAY_DEBUG
+#define VM_TRACE() InstructionPrint(std::cout, code_[pc_])
+#else
+#define VM_TRACE() DLOG(INFO) << "Executing(" << pc_ << "): " << code_[pc_]
+#endif
+
+// Record the dispatch of the instruction at pc_ in the trace of the run.
+#define VM_RECORD()                                                         \
+  do {                                                                      \
+    if (active_trace_ != nullptr) {                                         \
+      active_trace_->Record(VMTrace::EventKind::kInstruction, VMTrace::Now(), \
+                            0, static_cast<int64_t>(code_[pc_].op),         \
+                            func_index_, pc_);                              \
+    }                                                                       \
+  } while (0)
+
+#if TVM_VM_THREADED_DISPATCH
+#define VM_OP(name) op_##name:
+#define VM_NEXT()                                                   \
+  do {                                                              \
+    VM_TRACE();                                                     \
+    VM_RECORD();                                                    \
+    goto *dispatch_table[static_cast<size_t>(code_[pc_].op)];       \
+  } while (0)
+#else
+#define VM_OP(name) case Opcode::name:
+#define VM_NEXT() goto main_loop
+#endif
+
 void VirtualMachine::RunLoop() {
   CHECK(this->exec_);
   CHECK(this->code_);
   pc_ = 0;
   Index frame_start = frames_.size();
+#if TVM_VM_THREADED_DISPATCH
+  // The handler of each opcode, in the order of the values of Opcode.
+  static const void* dispatch_table[] = {
+    &&op_Move, &&op_Ret, &&op_Invoke, &&op_InvokeClosure, &&op_InvokePacked,
+    &&op_AllocTensor, &&op_AllocTensorReg, &&op_AllocADT, &&op_AllocClosure,
+    &&op_GetField, &&op_If, &&op_LoadConst, &&op_Goto, &&op_GetTag, &&op_LoadConsti,
+    &&op_Fatal, &&op_AllocStorage, &&op_DeviceCopy, &&op_IfConst, &&op_IfTag,
+    &&op_AllocStorageConst, &&op_AllocStorageTensor,
+  };
+  static_assert(sizeof(dispatch_table) / sizeof(dispatch_table[0]) ==
+                static_cast<size_t>(Opcode::AllocStorageTensor) + 1,
+                "the dispatch table must cover all the opcodes");
+  VM_NEXT();
+  {
+#else
   while (true) {
   main_loop:
-    auto const& instr = code_[this->pc_];
-    DLOG(INFO) << "Executing(" << pc_ << "): " << instr;
-#if USE_RELAY_DEBUG
-    InstructionPrint(std::cout, instr);
-#endif  // USE_RELAY_DEBUG
-
-    switch (instr.op) {
-      case Opcode::Move: {
-        ObjectRef from_obj;
-        from_obj = ReadRegister(instr.from);
-        WriteRegister(instr.dst, from_obj);
+    VM_TRACE();
+    VM_RECORD();
+    switch (code_[pc_].op) {
+#endif
+      VM_OP(Move) {
+        const Instruction& instr = code_[pc_];
+        WriteRegister(instr.dst, ReadRegister(instr.from));
         pc_++;
-        goto main_loop;
+        VM_NEXT();
       }
-      case Opcode::Fatal: {
+      VM_OP(Fatal) {
         throw std::runtime_error("VM encountered fatal error");
       }
-      case Opcode::LoadConst: {
-        auto constant_obj = exec_->constants[instr.const_index];
+      VM_OP(LoadConst) {
+        const Instruction& instr = code_[pc_];
         // We cache the allocated object in the constant pool. To measure, the
         // first iteration will set the pool up. The other iterations will
         // directly reuse the allocated objects.
-        if (const_pool_.size() <= static_cast<size_t>(instr.const_index)) {
-          const_pool_.resize(instr.const_index + 1);
+        Index ctx_index = ContextIndex(instr.const_device_type, 0);
+        if (const_pools_[ctx_index] == nullptr) {
+          const_pools_[ctx_index] = loaded_->GetConstantPool(ctxs_[ctx_index]);
         }
-
-        if (!const_pool_[instr.const_index].defined()) {
-          // TODO(wweic) ctx could be obtained from the ctxs list.
-          const_pool_[instr.const_index] = CopyTo(constant_obj, ctxs_[0]);
-        }
-        WriteRegister(instr.dst, const_pool_[instr.const_index]);
+        WriteRegister(instr.dst, const_pools_[ctx_index]->Get(instr.const_index));
         pc_++;
-        goto main_loop;
+        VM_NEXT();
       }
-      case Opcode::LoadConsti: {
+      VM_OP(LoadConsti) {
+        const Instruction& instr = code_[pc_];
         auto tensor = NDArray::Empty({1}, {kDLInt, 64, 1}, {kDLCPU, 0});
         reinterpret_cast<int64_t*>(tensor->data)[0] = instr.load_consti.val;
         WriteRegister(instr.dst, tensor);
         pc_++;
-        goto main_loop;
+        VM_NEXT();
       }
-      case Opcode::Invoke: {
-        std::vector<ObjectRef> args;
+      VM_OP(Invoke) {
+        const Instruction& instr = code_[pc_];
+        call_args_.clear();
         for (Index i = 0; i < instr.num_args; ++i) {
-          args.push_back(ReadRegister(instr.invoke_args_registers[i]));
+          call_args_.push_back(ReadRegister(instr.invoke_args_registers[i]));
         }
-        InvokeGlobal(exec_->functions[instr.func_index], args);
-        frames_.back().caller_return_register = instr.dst;
-        goto main_loop;
+        RegName dst = instr.dst;
+        InvokeGlobal(exec_->functions[instr.func_index], call_args_);
+        call_args_.clear();
+        frames_.back().caller_return_register = dst;
+        VM_NEXT();
       }
-      case Opcode::InvokePacked: {
+      VM_OP(InvokePacked) {
+        const Instruction& instr = code_[pc_];
         DLOG(INFO) << "InvokedPacked " << "arity=" << instr.arity;
         const auto& func = packed_funcs_[instr.packed_index];
         const auto& arity = instr.arity;
-        std::vector<ObjectRef> args;
+        call_args_.clear();
         for (Index i = 0; i < arity; ++i) {
           DLOG(INFO) <<
             "arg" << i << " $" << instr.packed_args[i];
-          auto arg = ReadRegister(instr.packed_args[i]);
-          args.push_back(arg);
+          call_args_.push_back(ReadRegister(instr.packed_args[i]));
         }
 
         // We no longer need to write the registers back, we write directly
         // through the registers mutably.
-        InvokePacked(instr.packed_index, func, arity, instr.output_size, args);
+        if (shape_cache_ != nullptr || specializer_ != nullptr) {
+          InvokeKernel(instr.packed_index, func, arity, instr.output_size, call_args_);
+        } else {
+          InvokePacked(instr.packed_index, func, arity, instr.output_size, call_args_);
+        }
+        call_args_.clear();
         pc_++;
-        goto main_loop;
+        VM_NEXT();
       }
-      case Opcode::InvokeClosure: {
-        auto object = ReadRegister(instr.closure);
-        const auto* closure = object.as<ClosureObj>();
+      VM_OP(InvokeClosure) {
+        const Instruction& instr = code_[pc_];
+        const auto* closure = ReadRegister(instr.closure).as<ClosureObj>();
 
-        std::vector<ObjectRef> args;
-        for (auto free_var : closure->free_vars) {
-          args.push_back(free_var);
+        call_args_.clear();
+        for (const auto& free_var : closure->free_vars) {
+          call_args_.push_back(free_var);
         }
         for (Index i = 0; i < instr.num_closure_args; ++i) {
-          args.push_back(ReadRegister(instr.closure_args[i]));
+          call_args_.push_back(ReadRegister(instr.closure_args[i]));
         }
-        InvokeGlobal(exec_->functions[closure->func_index], args);
-        frames_.back().caller_return_register = instr.dst;
-        goto main_loop;
+        RegName dst = instr.dst;
+        InvokeGlobal(exec_->functions[closure->func_index], call_args_);
+        call_args_.clear();
+        frames_.back().caller_return_register = dst;
+        VM_NEXT();
       }
-      case Opcode::GetField: {
-        auto object = ReadRegister(instr.object);
-        const auto& tuple = Downcast<ADT>(object);
-        auto field = tuple[instr.field_index];
-        WriteRegister(instr.dst, field);
+      VM_OP(GetField) {
+        const Instruction& instr = code_[pc_];
+        const auto& tuple = Downcast<ADT>(ReadRegister(instr.object));
+        WriteRegister(instr.dst, tuple[instr.field_index]);
         pc_++;
-        goto main_loop;
+        VM_NEXT();
       }
-      case Opcode::GetTag: {
-        auto object = ReadRegister(instr.get_tag.object);
-        const auto& adt = Downcast<ADT>(object);
+      VM_OP(GetTag) {
+        const Instruction& instr = code_[pc_];
+        const auto& adt = Downcast<ADT>(ReadRegister(instr.get_tag.object));
         auto tag = adt.tag();
         auto tag_tensor = NDArray::Empty({1}, {kDLInt, 32, 1}, {kDLCPU, 0});
         reinterpret_cast<int32_t*>(tag_tensor->data)[0] = tag;
         WriteRegister(instr.dst, tag_tensor);
         pc_++;
-        goto main_loop;
+        VM_NEXT();
       }
-      case Opcode::Goto: {
-        pc_ += instr.pc_offset;
-        goto main_loop;
+      VM_OP(Goto) {
+        pc_ += code_[pc_].pc_offset;
+        VM_NEXT();
       }
-      case Opcode::If: {
+      VM_OP(If) {
+        const Instruction& instr = code_[pc_];
         int32_t test_val = LoadScalarInt(instr.if_op.test);
         int32_t target_val = LoadScalarInt(instr.if_op.target);
 
@@ -953,29 +1875,55 @@ void VirtualMachine::RunLoop() {
           pc_ += instr.if_op.false_offset;
         }
 
-        goto main_loop;
+        VM_NEXT();
       }
-      case Opcode::AllocTensor: {
+      VM_OP(IfConst) {
+        const Instruction& instr = code_[pc_];
+        int32_t test_val = LoadScalarInt(instr.if_const.test);
+        if (test_val == static_cast<int32_t>(instr.if_const.target_val)) {
+          pc_ += instr.if_const.true_offset;
+        } else {
+          pc_ += instr.if_const.false_offset;
+        }
+        VM_NEXT();
+      }
+      VM_OP(IfTag) {
+        const Instruction& instr = code_[pc_];
+        const auto* adt = ReadRegister(instr.if_tag.object).as<ADTObj>();
+        CHECK(adt != nullptr) << "expect an ADT to compare the tag";
+        if (adt->tag == static_cast<int32_t>(instr.if_tag.tag)) {
+          pc_ += instr.if_tag.true_offset;
+        } else {
+          pc_ += instr.if_tag.false_offset;
+        }
+        VM_NEXT();
+      }
+      VM_OP(AllocTensor) {
+        const Instruction& instr = code_[pc_];
         auto shape = std::vector<int64_t>(instr.alloc_tensor.ndim);
 
         for (uint32_t i = 0; i < instr.alloc_tensor.ndim; ++i) {
           shape[i] = instr.alloc_tensor.shape[i];
         }
 
-        auto storage_obj = ReadRegister(instr.alloc_tensor.storage);
-        auto storage = Downcast<Storage>(storage_obj);
-        auto obj = storage->AllocNDArray(0, shape, instr.alloc_tensor.dtype);
+        auto storage = Downcast<Storage>(ReadRegister(instr.alloc_tensor.storage));
+        auto obj = storage->AllocNDArray(instr.alloc_tensor.offset, shape,
+                                         instr.alloc_tensor.dtype);
 
         WriteRegister(instr.dst, obj);
         pc_++;
-        goto main_loop;
+        VM_NEXT();
       }
-      case Opcode::AllocTensorReg: {
+      VM_OP(AllocTensorReg) {
+        const Instruction& instr = code_[pc_];
         DLContext cpu_ctx;
         cpu_ctx.device_type = kDLCPU;
         cpu_ctx.device_id = 0;
         auto shape_tensor_obj = ReadRegister(instr.alloc_tensor_reg.shape_register);
         const auto shape_arr = Downcast<NDArray>(shape_tensor_obj);
+        if (kernel_scheduler_ != nullptr && shape_arr->ctx.device_type == kDLCPU) {
+          kernel_scheduler_->WaitWriters(TensorRange(*shape_arr.operator->()));
+        }
         NDArray shape_tensor = shape_arr.CopyTo(cpu_ctx);
         const DLTensor* dl_tensor = shape_tensor.operator->();
         CHECK_EQ(dl_tensor->dtype.code, 0u);
@@ -991,9 +1939,10 @@ void VirtualMachine::RunLoop() {
 
         WriteRegister(instr.dst, obj);
         pc_++;
-        goto main_loop;
+        VM_NEXT();
       }
-      case Opcode::AllocADT: {
+      VM_OP(AllocADT) {
+        const Instruction& instr = code_[pc_];
         std::vector<ObjectRef> fields;
         for (Index i = 0; i < instr.num_fields; ++i) {
           fields.push_back(ReadRegister(instr.datatype_fields[i]));
@@ -1001,18 +1950,20 @@ void VirtualMachine::RunLoop() {
         ObjectRef obj = ADT(instr.constructor_tag, fields);
         WriteRegister(instr.dst, obj);
         pc_++;
-        goto main_loop;
+        VM_NEXT();
       }
-      case Opcode::AllocClosure: {
+      VM_OP(AllocClosure) {
+        const Instruction& instr = code_[pc_];
         std::vector<ObjectRef> free_vars;
         for (Index i = 0; i < instr.num_freevar; i++) {
           free_vars.push_back(ReadRegister(instr.free_vars[i]));
         }
         WriteRegister(instr.dst, Closure(instr.func_index, free_vars));
         pc_++;
-        goto main_loop;
+        VM_NEXT();
       }
-      case Opcode::AllocStorage: {
+      VM_OP(AllocStorage) {
+        const Instruction& instr = code_[pc_];
         auto size = LoadScalarInt(instr.alloc_storage.allocation_size);
         auto alignment = LoadScalarInt(instr.alloc_storage.alignment);
 
@@ -1021,12 +1972,53 @@ void VirtualMachine::RunLoop() {
           "alignment=" << alignment <<
           "dtype_hint=" << TVMType2String(instr.alloc_storage.dtype_hint);
 
-        auto storage = make_storage(size, alignment, instr.alloc_storage.dtype_hint, ctxs_[0]);
+        const auto& ctx = ctxs_[ContextIndex(instr.alloc_storage.device_type,
+                                             instr.alloc_storage.device_id)];
+        auto storage = MakeStorage(size, alignment, instr.alloc_storage.dtype_hint, ctx);
         WriteRegister(instr.dst, storage);
         pc_++;
-        goto main_loop;
+        VM_NEXT();
       }
-      case Opcode::Ret: {
+      VM_OP(DeviceCopy) {
+        const Instruction& instr = code_[pc_];
+        auto src = Downcast<NDArray>(ReadRegister(instr.device_copy.src));
+        const auto& ctx = ctxs_[ContextIndex(instr.device_copy.device_type,
+                                             instr.device_copy.device_id)];
+        if (src->ctx.device_type == ctx.device_type && src->ctx.device_id == ctx.device_id) {
+          WriteRegister(instr.dst, src);
+        } else {
+          WriteRegister(instr.dst, CopyToDevice(src, ctx));
+        }
+        pc_++;
+        VM_NEXT();
+      }
+      VM_OP(AllocStorageConst) {
+        const Instruction& instr = code_[pc_];
+        const auto& operands = instr.alloc_storage_const;
+        const auto& ctx = ctxs_[ContextIndex(operands.device_type, operands.device_id)];
+        WriteRegister(instr.dst, MakeStorage(operands.allocation_size, operands.alignment,
+                                             operands.dtype_hint, ctx));
+        pc_ += operands.num_fused;
+        VM_NEXT();
+      }
+      VM_OP(AllocStorageTensor) {
+        const Instruction& instr = code_[pc_];
+        const auto& operands = instr.alloc_storage_const;
+        const auto& ctx = ctxs_[ContextIndex(operands.device_type, operands.device_id)];
+        auto storage = MakeStorage(operands.allocation_size, operands.alignment,
+                                   operands.dtype_hint, ctx);
+        WriteRegister(instr.dst, storage);
+        // the alloc_tensor following the fused instructions.
+        const Instruction& alloc = code_[pc_ + operands.num_fused];
+        std::vector<int64_t> shape(alloc.alloc_tensor.shape,
+                                   alloc.alloc_tensor.shape + alloc.alloc_tensor.ndim);
+        WriteRegister(alloc.dst, storage->AllocNDArray(alloc.alloc_tensor.offset, shape,
+                                                       alloc.alloc_tensor.dtype));
+        pc_ += operands.num_fused + 1;
+        VM_NEXT();
+      }
+      VM_OP(Ret) {
+        const Instruction& instr = code_[pc_];
         // If we have hit the point from which we started
         // running, we should return to the caller breaking
         // the dispatch loop.
@@ -1034,17 +2026,28 @@ void VirtualMachine::RunLoop() {
         auto caller_return_register = frames_.back().caller_return_register;
 
         if (PopFrame() == frame_start) {
+          // the result is read by the caller once the kernels are done.
+          if (kernel_scheduler_ != nullptr) kernel_scheduler_->WaitAll();
           return;
           // Otherwise we are just returning from a local call.
         } else {
           WriteRegister(caller_return_register, return_register_);
-          goto main_loop;
+          VM_NEXT();
         }
       }
+#if TVM_VM_THREADED_DISPATCH
+  }
+#else
     }
   }
+#endif
 }
 
+#undef VM_NEXT
+#undef VM_OP
+#undef VM_RECORD
+#undef VM_TRACE
+
 runtime::Module CreateVirtualMachine(const Executable* exec) {
   auto vm = make_object<VirtualMachine>();
   vm->LoadExecutable(exec);
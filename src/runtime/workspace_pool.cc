@@ -21,7 +21,15 @@
  * \file workspace_pool.h
  * \brief Workspace pool utility.
  */
+#include <tvm/runtime/registry.h>
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
 #include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include "workspace_pool.h"
 
 namespace tvm {
@@ -29,113 +37,192 @@ namespace runtime {
 
 // page size.
 constexpr size_t kWorkspacePageSize = 4 << 10;
+// classes of whole pages, before the classes growing geometrically.
+constexpr size_t kNumPageClass = 4;
+// the log2 of the first geometric class, which is above kNumPageClass pages.
+constexpr int kFirstClassLog2 = 14;
+// number of size classes, four per power of two.
+constexpr size_t kNumSizeClass = kNumPageClass + (64 - kFirstClassLog2) * 4;
+
+inline int Log2Floor(uint64_t x) {
+#if defined(_MSC_VER)
+  int r = 0;
+  while (x >>= 1) ++r;
+  return r;
+#else
+  return 63 - __builtin_clzll(x);
+#endif
+}
+
+/*!
+ * \brief Round the request up to its size class.
+ * \param nbytes The requested bytes.
+ * \param size The bytes of the class.
+ * \return The index of the class.
+ */
+inline size_t GetSizeClass(size_t nbytes, size_t* size) {
+  size_t pages = (nbytes + (kWorkspacePageSize - 1)) / kWorkspacePageSize;
+  if (pages == 0) pages = 1;
+  if (pages <= kNumPageClass) {
+    *size = pages * kWorkspacePageSize;
+    return pages - 1;
+  }
+  uint64_t n = static_cast<uint64_t>(pages) * kWorkspacePageSize;
+  int p = Log2Floor(n - 1);
+  uint64_t base = uint64_t(1) << p;
+  uint64_t step = base >> 2;
+  uint64_t k = (n - base + step - 1) / step;
+  *size = static_cast<size_t>(base + k * step);
+  return kNumPageClass + (p - kFirstClassLog2) * 4 + (k - 1);
+}
 
 class WorkspacePool::Pool {
  public:
   // constructor
-  Pool() {
-    // safe guard header on each list.
-    Entry e;
-    e.data = nullptr;
-    e.size = 0;
-    free_list_.push_back(e);
-    allocated_.push_back(e);
-  }
+  Pool() : free_list_(kNumSizeClass) {}
   // allocate from pool
   void* Alloc(TVMContext ctx, DeviceAPI* device, size_t nbytes) {
-    // Allocate align to page.
-    nbytes = (nbytes + (kWorkspacePageSize - 1)) / kWorkspacePageSize * kWorkspacePageSize;
-    if (nbytes == 0) nbytes = kWorkspacePageSize;
-    Entry e;
-    TVMType type;
-    type.code = kDLUInt;
-    type.bits = 8;
-    type.lanes = 1;
-    if (free_list_.size() == 2) {
-      e = free_list_.back();
-      free_list_.pop_back();
-      if (e.size < nbytes) {
-        // resize the page
-        device->FreeDataSpace(ctx, e.data);
-        e.data = device->AllocDataSpace(ctx, nbytes, kTempAllocaAlignment, type);
-        e.size = nbytes;
-      }
-    } else if (free_list_.size() == 1) {
-      e.data = device->AllocDataSpace(ctx, nbytes, kTempAllocaAlignment, type);
-      e.size = nbytes;
+    size_t size;
+    size_t cls = GetSizeClass(nbytes, &size);
+    void* data;
+    if (!free_list_[cls].empty()) {
+      data = free_list_[cls].back();
+      free_list_[cls].pop_back();
+      stats_.bytes_cached -= size;
+      ++stats_.num_hit;
     } else {
-      if (free_list_.back().size >= nbytes) {
-        // find smallest fit
-        auto it = free_list_.end() - 2;
-        for (; it->size >= nbytes; --it) {}
-        e = *(it + 1);
-        free_list_.erase(it + 1);
-      } else {
-        // resize the page
-        e = free_list_.back();
-        free_list_.pop_back();
-        device->FreeDataSpace(ctx, e.data);
-        e.data = device->AllocDataSpace(ctx, nbytes, kTempAllocaAlignment, type);
-        e.size = nbytes;
+      TVMType type;
+      type.code = kDLUInt;
+      type.bits = 8;
+      type.lanes = 1;
+      try {
+        data = device->AllocDataSpace(ctx, size, kTempAllocaAlignment, type);
+      } catch (const std::exception&) {
+        // out of memory, retry with the cached blocks of other classes released.
+        if (stats_.bytes_cached == 0) throw;
+        Trim(ctx, device, 0);
+        data = device->AllocDataSpace(ctx, size, kTempAllocaAlignment, type);
       }
+      ++stats_.num_miss;
     }
-    allocated_.push_back(e);
-    return e.data;
+    allocated_[data] = cls;
+    stats_.bytes_in_use += size;
+    stats_.peak_bytes_held = std::max(stats_.peak_bytes_held,
+                                      stats_.bytes_in_use + stats_.bytes_cached);
+    return data;
   }
   // free resource back to pool
-  void Free(void* data) {
-    Entry e;
-    if (allocated_.back().data == data) {
-      // quick path, last allocated.
-      e = allocated_.back();
-      allocated_.pop_back();
-    } else {
-      int index = static_cast<int>(allocated_.size()) - 2;
-      for (; index > 0 && allocated_[index].data != data; --index) {}
-      CHECK_GT(index, 0) << "trying to free things that has not been allocated";
-      e = allocated_[index];
-      allocated_.erase(allocated_.begin() + index);
+  void Free(TVMContext ctx, DeviceAPI* device, void* data, size_t max_cached_bytes) {
+    auto it = allocated_.find(data);
+    CHECK(it != allocated_.end()) << "trying to free things that has not been allocated";
+    size_t cls = it->second;
+    allocated_.erase(it);
+    size_t size = ClassSize(cls);
+    free_list_[cls].push_back(data);
+    stats_.bytes_in_use -= size;
+    stats_.bytes_cached += size;
+    if (stats_.bytes_cached > max_cached_bytes) {
+      Trim(ctx, device, max_cached_bytes);
     }
-    if (free_list_.back().size < e.size) {
-      free_list_.push_back(e);
-    } else if (free_list_.size() == 2) {
-      free_list_.push_back(free_list_.back());
-      free_list_[1] = e;
-    } else {
-      size_t i = free_list_.size() - 1;
-      free_list_.resize(free_list_.size() + 1);
-      for (; e.size < free_list_[i].size; --i) {
-        free_list_[i + 1] = free_list_[i];
+  }
+  // Release the largest cached blocks until at most max_cached_bytes are cached.
+  void Trim(TVMContext ctx, DeviceAPI* device, size_t max_cached_bytes) {
+    for (size_t cls = kNumSizeClass; cls != 0 && stats_.bytes_cached > max_cached_bytes;) {
+      --cls;
+      size_t size = ClassSize(cls);
+      std::vector<void*>& blocks = free_list_[cls];
+      while (!blocks.empty() && stats_.bytes_cached > max_cached_bytes) {
+        device->FreeDataSpace(ctx, blocks.back());
+        blocks.pop_back();
+        stats_.bytes_cached -= size;
+        ++stats_.num_trim;
       }
-      free_list_[i + 1] = e;
     }
   }
   // Release all resources
   void Release(TVMContext ctx, DeviceAPI* device) {
-    CHECK_EQ(allocated_.size(), 1);
-    for (size_t i = 1; i < free_list_.size(); ++i) {
-      device->FreeDataSpace(ctx, free_list_[i].data);
+    CHECK_EQ(allocated_.size(), 0);
+    Trim(ctx, device, 0);
+  }
+  // The statistics of the pool
+  Stats* stats() {
+    return &stats_;
+  }
+
+ private:
+  // The bytes of a size class, the inverse of GetSizeClass.
+  static size_t ClassSize(size_t cls) {
+    if (cls < kNumPageClass) return (cls + 1) * kWorkspacePageSize;
+    size_t p = (cls - kNumPageClass) / 4 + kFirstClassLog2;
+    size_t k = (cls - kNumPageClass) % 4 + 1;
+    return (size_t(1) << p) + k * (size_t(1) << (p - 2));
+  }
+  /*! \brief The cached blocks of each size class */
+  std::vector<std::vector<void*> > free_list_;
+  /*! \brief The size class of each allocated block */
+  std::unordered_map<void*, size_t> allocated_;
+  /*! \brief The statistics */
+  Stats stats_;
+};
+
+/*!
+ * \brief The live pools, so that the statistics and the trimming of the
+ *  pools owned by different threads are reachable from the global functions.
+ */
+class WorkspacePoolRegistry {
+ public:
+  void Register(WorkspacePool* pool) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pools_.insert(pool);
+  }
+  void Unregister(WorkspacePool* pool) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pools_.erase(pool);
+  }
+  // The high-water mark of the new pools of a device type.
+  size_t MaxCachedBytes(DLDeviceType device_type) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = max_cached_bytes_.find(device_type);
+    if (it != max_cached_bytes_.end()) return it->second;
+    const char* val = getenv("TVM_WORKSPACE_MAX_CACHED_BYTES");
+    if (val != nullptr) return static_cast<size_t>(std::stoull(val));
+    return std::numeric_limits<size_t>::max();
+  }
+  void SetMaxCachedBytes(int device_type, size_t max_cached_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_cached_bytes_[device_type] = max_cached_bytes;
+    for (WorkspacePool* pool : pools_) {
+      if (pool->device_type() == device_type) pool->SetMaxCachedBytes(max_cached_bytes);
     }
-    free_list_.clear();
+  }
+  // Apply f to the pools of a device type, or all pools when device_type is -1.
+  template<typename F>
+  void ForEach(int device_type, F f) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (WorkspacePool* pool : pools_) {
+      if (device_type == -1 || pool->device_type() == device_type) f(pool);
+    }
+  }
+  static WorkspacePoolRegistry* Global() {
+    // leaked on purpose, pools of other threads may exit after static destruction.
+    static WorkspacePoolRegistry* inst = new WorkspacePoolRegistry();
+    return inst;
   }
 
  private:
-  /*! \brief a single entry in the pool */
-  struct Entry {
-    void* data;
-    size_t size;
-  };
-  /*! \brief List of free items, sorted from small to big size */
-  std::vector<Entry> free_list_;
-  /*! \brief List of allocated items */
-  std::vector<Entry> allocated_;
+  std::mutex mutex_;
+  std::unordered_set<WorkspacePool*> pools_;
+  std::unordered_map<int, size_t> max_cached_bytes_;
 };
 
 WorkspacePool::WorkspacePool(DLDeviceType device_type, std::shared_ptr<DeviceAPI> device)
     : device_type_(device_type), device_(device) {
+  max_cached_bytes_ = WorkspacePoolRegistry::Global()->MaxCachedBytes(device_type);
+  WorkspacePoolRegistry::Global()->Register(this);
 }
 
 WorkspacePool::~WorkspacePool() {
+  WorkspacePoolRegistry::Global()->Unregister(this);
   for (size_t i = 0; i < array_.size(); ++i) {
     if (array_[i] != nullptr) {
       TVMContext ctx;
@@ -148,6 +235,7 @@ WorkspacePool::~WorkspacePool() {
 }
 
 void* WorkspacePool::AllocWorkspace(TVMContext ctx, size_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
   if (static_cast<size_t>(ctx.device_id) >= array_.size()) {
     array_.resize(ctx.device_id + 1, nullptr);
   }
@@ -158,10 +246,110 @@ void* WorkspacePool::AllocWorkspace(TVMContext ctx, size_t size) {
 }
 
 void WorkspacePool::FreeWorkspace(TVMContext ctx, void* ptr) {
+  std::lock_guard<std::mutex> lock(mutex_);
   CHECK(static_cast<size_t>(ctx.device_id) < array_.size() &&
         array_[ctx.device_id] != nullptr);
-  array_[ctx.device_id]->Free(ptr);
+  array_[ctx.device_id]->Free(ctx, device_.get(), ptr, max_cached_bytes_);
+}
+
+void WorkspacePool::SetMaxCachedBytes(size_t max_cached_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  max_cached_bytes_ = max_cached_bytes;
+}
+
+void WorkspacePool::Trim(size_t max_cached_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < array_.size(); ++i) {
+    if (array_[i] != nullptr) {
+      TVMContext ctx;
+      ctx.device_type = device_type_;
+      ctx.device_id = static_cast<int>(i);
+      array_[i]->Trim(ctx, device_.get(), max_cached_bytes);
+    }
+  }
 }
 
+WorkspacePool::Stats WorkspacePool::GetStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stats ret;
+  for (Pool* pool : array_) {
+    if (pool == nullptr) continue;
+    const Stats& s = *pool->stats();
+    ret.num_hit += s.num_hit;
+    ret.num_miss += s.num_miss;
+    ret.num_trim += s.num_trim;
+    ret.bytes_in_use += s.bytes_in_use;
+    ret.bytes_cached += s.bytes_cached;
+    ret.peak_bytes_held += s.peak_bytes_held;
+  }
+  return ret;
+}
+
+void WorkspacePool::ResetStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (Pool* pool : array_) {
+    if (pool == nullptr) continue;
+    Stats* s = pool->stats();
+    s->num_hit = 0;
+    s->num_miss = 0;
+    s->num_trim = 0;
+    s->peak_bytes_held = s->bytes_in_use + s->bytes_cached;
+  }
+}
+
+// The statistics summed over the pools of a device type, -1 for all.
+TVM_REGISTER_GLOBAL("runtime.workspace_pool_stats")
+.set_body([](TVMArgs args, TVMRetValue* rv) {
+    int device_type = args.num_args > 0 ? args[0].operator int() : -1;
+    WorkspacePool::Stats total;
+    int num_pool = 0;
+    WorkspacePoolRegistry::Global()->ForEach(device_type, [&](WorkspacePool* pool) {
+        WorkspacePool::Stats s = pool->GetStats();
+        total.num_hit += s.num_hit;
+        total.num_miss += s.num_miss;
+        total.num_trim += s.num_trim;
+        total.bytes_in_use += s.bytes_in_use;
+        total.bytes_cached += s.bytes_cached;
+        total.peak_bytes_held += s.peak_bytes_held;
+        ++num_pool;
+      });
+    std::ostringstream os;
+    os << "{\"num_pool\": " << num_pool
+       << ", \"num_hit\": " << total.num_hit
+       << ", \"num_miss\": " << total.num_miss
+       << ", \"num_trim\": " << total.num_trim
+       << ", \"bytes_in_use\": " << total.bytes_in_use
+       << ", \"bytes_cached\": " << total.bytes_cached
+       << ", \"peak_bytes_held\": " << total.peak_bytes_held
+       << "}";
+    *rv = os.str();
+  });
+
+TVM_REGISTER_GLOBAL("runtime.workspace_pool_reset_stats")
+.set_body([](TVMArgs args, TVMRetValue* rv) {
+    int device_type = args.num_args > 0 ? args[0].operator int() : -1;
+    WorkspacePoolRegistry::Global()->ForEach(device_type, [](WorkspacePool* pool) {
+        pool->ResetStats();
+      });
+  });
+
+// Release the cached blocks of the pools of a device type, -1 for all.
+TVM_REGISTER_GLOBAL("runtime.workspace_pool_trim")
+.set_body([](TVMArgs args, TVMRetValue* rv) {
+    int device_type = args.num_args > 0 ? args[0].operator int() : -1;
+    int64_t max_cached_bytes = args.num_args > 1 ? args[1].operator int64_t() : 0;
+    WorkspacePoolRegistry::Global()->ForEach(device_type, [&](WorkspacePool* pool) {
+        pool->Trim(static_cast<size_t>(max_cached_bytes));
+      });
+  });
+
+// Set the high-water mark of the cached bytes of the pools of a device type.
+TVM_REGISTER_GLOBAL("runtime.workspace_pool_set_max_cached_bytes")
+.set_body_typed([](int device_type, int64_t max_cached_bytes) {
+    CHECK_GE(max_cached_bytes, 0);
+    WorkspacePoolRegistry::Global()->SetMaxCachedBytes(
+        device_type, static_cast<size_t>(max_cached_bytes));
+  });
+
 }  // namespace runtime
 }  // namespace tvm
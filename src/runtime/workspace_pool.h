@@ -25,6 +25,8 @@
 #define TVM_RUNTIME_WORKSPACE_POOL_H_
 
 #include <tvm/runtime/device_api.h>
+#include <cstdint>
+#include <mutex>
 #include <vector>
 #include <memory>
 
@@ -40,9 +42,33 @@ namespace runtime {
  *  - Only a few allocation will happen, and space will be released after use.
  *  - The release order is usually in reverse order of allocate
  *  - Repeative pattern of same allocations over different runs.
+ *
+ *  Requests are rounded up to a size class, and freed blocks are cached in
+ *  the free list of their class, so both allocation and free take constant
+ *  time. The classes are whole pages up to four pages, then four classes
+ *  per power of two, which bounds the waste to a quarter of the request.
+ *
+ *  When the bytes cached in the free lists exceed the high-water mark,
+ *  the largest cached blocks are released to the device. The pool is
+ *  thread-safe, so it can also be shared by several threads.
  */
 class TVM_DLL WorkspacePool {
  public:
+  /*! \brief The statistics of a pool. */
+  struct Stats {
+    /*! \brief The number of allocations served from the free lists. */
+    uint64_t num_hit{0};
+    /*! \brief The number of allocations made on the device. */
+    uint64_t num_miss{0};
+    /*! \brief The number of cached blocks released to the device. */
+    uint64_t num_trim{0};
+    /*! \brief The bytes of the blocks in use. */
+    size_t bytes_in_use{0};
+    /*! \brief The bytes of the blocks cached in the free lists. */
+    size_t bytes_cached{0};
+    /*! \brief The maximum bytes held from the device. */
+    size_t peak_bytes_held{0};
+  };
   /*!
    * \brief Create pool with specific device type and device.
    * \param device_type The device type.
@@ -64,9 +90,31 @@ class TVM_DLL WorkspacePool {
    * \param ptr The pointer to be freed.
    */
   void FreeWorkspace(TVMContext ctx, void* ptr);
+  /*!
+   * \brief Set the high-water mark of the cached bytes of each device.
+   * \param max_cached_bytes The maximum bytes kept in the free lists.
+   */
+  void SetMaxCachedBytes(size_t max_cached_bytes);
+  /*!
+   * \brief Release cached blocks to the device.
+   * \param max_cached_bytes The maximum bytes kept cached on each device.
+   */
+  void Trim(size_t max_cached_bytes);
+  /*! \return The statistics summed over all devices. */
+  Stats GetStats();
+  /*! \brief Reset the counters of the statistics. */
+  void ResetStats();
+  /*! \return The device type this pool supports. */
+  DLDeviceType device_type() const {
+    return device_type_;
+  }
 
  private:
   class Pool;
+  /*! \brief protects the pools of all devices */
+  std::mutex mutex_;
+  /*! \brief The high-water mark of the cached bytes */
+  size_t max_cached_bytes_;
   /*! \brief pool of device local array */
   std::vector<Pool*> array_;
   /*! \brief device type this pool support */
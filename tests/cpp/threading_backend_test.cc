@@ -17,12 +17,17 @@
  * under the License.
  */
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <memory>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 #include <tvm/runtime/c_backend_api.h>
+#include <tvm/runtime/registry.h>
 
 constexpr size_t N = 128;
 
@@ -64,6 +69,176 @@ TEST(ThreadingBackend, TVMBackendParallelLaunchMultipleThreads) {
   }
 }
 
+TEST(ThreadingBackend, TVMBackendParallelLaunchSharedPool) {
+  const tvm::runtime::PackedFunc* config =
+      tvm::runtime::Registry::Get("runtime.config_threadpool");
+  const tvm::runtime::PackedFunc* reset =
+      tvm::runtime::Registry::Get("runtime.threadpool_reset_stats");
+  const tvm::runtime::PackedFunc* stats =
+      tvm::runtime::Registry::Get("runtime.threadpool_stats");
+  ASSERT_TRUE(config != nullptr && reset != nullptr && stats != nullptr);
+  // switch every frontend thread to the process-wide pool
+  (*config)(1, 0, 1);
+  (*reset)();
+  size_t num_threads = 4;
+  size_t num_jobs_per_thread = 8;
+  std::vector<std::unique_ptr<std::thread>> ts;
+  for (size_t i = 0; i < num_threads; ++i) {
+    ts.emplace_back(new std::thread([&]() {
+      for (size_t j = 0; j < num_jobs_per_thread; ++j) {
+        std::atomic<size_t> acc(0);
+        EXPECT_EQ(TVMBackendParallelLaunch(atomic_add_task_id, &acc, 0), 0);
+        EXPECT_EQ(acc.load(std::memory_order_relaxed), N * (N - 1) / 2);
+      }
+    }));
+  }
+  for (auto& t : ts) {
+    t->join();
+  }
+  std::string report = (*stats)();
+  std::string expected = "\"num_launch\": " + std::to_string(num_threads * num_jobs_per_thread);
+  EXPECT_NE(report.find("\"shared\": true"), std::string::npos);
+  EXPECT_NE(report.find(expected), std::string::npos) << report;
+  (*config)(1, 0, 0);
+}
+
+TEST(ThreadingBackend, TVMBackendParallelLaunchChunked) {
+  for (int num_chunk : {0, 1, 7, 64, 300}) {
+    std::atomic<size_t> acc(0);
+    EXPECT_EQ(TVMBackendParallelLaunchChunked(atomic_add_task_id, &acc, num_chunk), 0);
+    EXPECT_EQ(acc.load(std::memory_order_relaxed), N * (N - 1) / 2);
+  }
+}
+
+TEST(ThreadingBackend, TVMBackendParallelLaunchChunkedError) {
+  FTVMParallelLambda fail_odd_chunk = [](int task_id, TVMParallelGroupEnv* penv,
+                                         void* cdata) -> int {
+    EXPECT_EQ(penv->sync_handle, nullptr);
+    return task_id % 2 == 1 ? -1 : 0;
+  };
+  EXPECT_EQ(TVMBackendParallelLaunchChunked(fail_odd_chunk, nullptr, 16), -1);
+  // the pool stays usable after a failed launch
+  std::atomic<size_t> acc(0);
+  EXPECT_EQ(TVMBackendParallelLaunchChunked(atomic_add_task_id, &acc, 16), 0);
+  EXPECT_EQ(acc.load(std::memory_order_relaxed), N * (N - 1) / 2);
+}
+
+TEST(ThreadingBackend, TVMBackendParallelLaunchNested) {
+  // every task of the outer job runs a full parallel job of its own.
+  FTVMParallelLambda nested_add = [](int task_id, TVMParallelGroupEnv* penv,
+                                     void* cdata) -> int {
+    auto* data = reinterpret_cast<std::atomic<size_t>*>(cdata);
+    std::atomic<size_t> acc(0);
+    if (TVMBackendParallelLaunch(atomic_add_task_id, &acc, 0) != 0) return -1;
+    if (TVMBackendParallelLaunchChunked(atomic_add_task_id, &acc, 0) != 0) return -1;
+    data->fetch_add(acc.load(), std::memory_order_relaxed);
+    return 0;
+  };
+  std::atomic<size_t> total(0);
+  std::atomic<size_t> num_task(0);
+  FTVMParallelLambda count_task = [](int task_id, TVMParallelGroupEnv* penv,
+                                     void* cdata) -> int {
+    reinterpret_cast<std::atomic<size_t>*>(cdata)->store(penv->num_task);
+    return 0;
+  };
+  TVMBackendParallelLaunch(count_task, &num_task, 0);
+  EXPECT_EQ(TVMBackendParallelLaunch(nested_add, &total, 0), 0);
+  EXPECT_EQ(total.load(), num_task.load() * N * (N - 1));
+}
+
+TEST(ThreadingBackend, TVMBackendParallelLaunchNestedMultipleTasks) {
+  // a nested job of several tasks that do not synchronize runs them serially.
+  FTVMParallelLambda nested_add = [](int task_id, TVMParallelGroupEnv* penv,
+                                     void* cdata) -> int {
+    auto* data = reinterpret_cast<std::atomic<size_t>*>(cdata);
+    std::atomic<size_t> acc(0);
+    if (TVMBackendParallelLaunch(atomic_add_task_id, &acc, 2) != 0) return -1;
+    data->fetch_add(acc.load(), std::memory_order_relaxed);
+    return 0;
+  };
+  std::atomic<size_t> total(0);
+  EXPECT_EQ(TVMBackendParallelLaunch(nested_add, &total, 1), 0);
+  EXPECT_EQ(total.load(), N * (N - 1) / 2);
+}
+
+TEST(ThreadingBackend, TVMBackendParallelLaunchSpinProfile) {
+  const tvm::runtime::PackedFunc* config_spin =
+      tvm::runtime::Registry::Get("runtime.config_threadpool_spin");
+  const tvm::runtime::PackedFunc* reset =
+      tvm::runtime::Registry::Get("runtime.threadpool_reset_stats");
+  const tvm::runtime::PackedFunc* stats =
+      tvm::runtime::Registry::Get("runtime.threadpool_stats");
+  ASSERT_TRUE(config_spin != nullptr && reset != nullptr && stats != nullptr);
+  EXPECT_ANY_THROW((*config_spin)("unknown"));
+  for (std::string profile : {"power", "throughput", "latency"}) {
+    (*config_spin)(profile);
+    (*reset)();
+    for (int i = 0; i < 4; ++i) {
+      std::atomic<size_t> acc(0);
+      EXPECT_EQ(TVMBackendParallelLaunch(atomic_add_task_id, &acc, 0), 0);
+      EXPECT_EQ(acc.load(std::memory_order_relaxed), N * (N - 1) / 2);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::string report = (*stats)();
+    EXPECT_NE(report.find("\"spin_profile\": \"" + profile + "\""), std::string::npos)
+        << report;
+  }
+}
+
+TEST(ThreadingBackend, TVMBackendParallelLaunchCores) {
+  const tvm::runtime::PackedFunc* config_cores =
+      tvm::runtime::Registry::Get("runtime.config_threadpool_cores");
+  ASSERT_TRUE(config_cores != nullptr);
+  // the pool of a new thread is bound to the given cores only.
+  std::thread t([config_cores]() {
+    (*config_cores)(0);
+    std::atomic<size_t> acc(0);
+    EXPECT_EQ(TVMBackendParallelLaunch(atomic_add_task_id, &acc, 0), 0);
+    EXPECT_EQ(acc.load(std::memory_order_relaxed), N * (N - 1) / 2);
+  });
+  t.join();
+}
+
+TEST(ThreadingBackend, TVMBackendParallelLaunchCoresSharedPool) {
+  const tvm::runtime::PackedFunc* config =
+      tvm::runtime::Registry::Get("runtime.config_threadpool");
+  const tvm::runtime::PackedFunc* config_cores =
+      tvm::runtime::Registry::Get("runtime.config_threadpool_cores");
+  const tvm::runtime::PackedFunc* reset =
+      tvm::runtime::Registry::Get("runtime.threadpool_reset_stats");
+  const tvm::runtime::PackedFunc* stats =
+      tvm::runtime::Registry::Get("runtime.threadpool_stats");
+  ASSERT_TRUE(config != nullptr && config_cores != nullptr && reset != nullptr &&
+              stats != nullptr);
+  (*config)(1, 0, 1);
+  (*reset)();
+  // two stages bound to disjoint cores each get a pool of their own and leave
+  // the shared one alone.
+  int num_cores = std::max(static_cast<int>(std::thread::hardware_concurrency()), 2);
+  std::vector<std::unique_ptr<std::thread>> ts;
+  for (int core : {0, num_cores - 1}) {
+    ts.emplace_back(new std::thread([=]() {
+      (*config_cores)(core);
+      std::atomic<size_t> acc(0);
+      EXPECT_EQ(TVMBackendParallelLaunch(atomic_add_task_id, &acc, 0), 0);
+      EXPECT_EQ(acc.load(std::memory_order_relaxed), N * (N - 1) / 2);
+      std::string report = (*stats)();
+      EXPECT_NE(report.find("\"shared\": false"), std::string::npos) << report;
+      EXPECT_NE(report.find("\"cores\": [" + std::to_string(core) + "]"),
+                std::string::npos) << report;
+      EXPECT_NE(report.find("\"num_launch\": 1,"), std::string::npos) << report;
+    }));
+  }
+  for (auto& t : ts) {
+    t->join();
+  }
+  std::string report = (*stats)();
+  EXPECT_NE(report.find("\"shared\": true"), std::string::npos) << report;
+  EXPECT_NE(report.find("\"cores\": []"), std::string::npos) << report;
+  EXPECT_NE(report.find("\"num_launch\": 0,"), std::string::npos) << report;
+  (*config)(1, 0, 0);
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
   testing::FLAGS_gtest_death_test_style = "threadsafe";
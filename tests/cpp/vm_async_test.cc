@@ -0,0 +1,274 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file vm_async_test.cc
+ * \brief Tests of the asynchronous invocation of the VM, and of the
+ *  ordering of the kernels it runs on worker threads.
+ */
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dmlc/logging.h>
+#include <gtest/gtest.h>
+#include <tvm/runtime/container.h>
+#include <tvm/runtime/vm.h>
+
+#include "../../src/runtime/vm/kernel_scheduler.h"
+
+using namespace tvm::runtime;
+using namespace tvm::runtime::vm;
+
+namespace {
+
+const DLDataType kFloat32 = {kDLFloat, 32, 1};
+const int kSleepMs = 100;
+
+// The VM with its packed functions set directly, without a compiled library.
+class TestVM : public VirtualMachine {
+ public:
+  using VirtualMachine::Init;
+
+  void SetPackedFunc(PackedFunc f) {
+    packed_funcs_.assign(1, f);
+  }
+
+  // Invoke main synchronously, as the packed "invoke" does.
+  ObjectRef InvokeMain(const std::vector<ObjectRef>& args) {
+    std::lock_guard<std::mutex> lock(run_mutex_);
+    return Invoke("main", args);
+  }
+};
+
+// Count in arrived and wait until count threads have, so that the threads
+// which may run together do. Gives up after a deadline far above any run so
+// that a serialized run fails instead of hanging. Return whether they all did.
+bool Arrive(std::atomic<int>* arrived, int count) {
+  arrived->fetch_add(1);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (arrived->load() < count) {
+    if (std::chrono::steady_clock::now() > deadline) return false;
+    std::this_thread::yield();
+  }
+  return true;
+}
+
+// What the kernels of the VMs under test saw.
+struct KernelLog {
+  // the number of kernels to wait for in each kernel, zero not to wait.
+  int meet{0};
+  std::atomic<int> arrived{0};
+  std::atomic<int> running{0};
+  std::atomic<int> max_running{0};
+  std::mutex mutex;
+  std::vector<std::thread::id> threads;
+
+  void Reset(int num_meet) {
+    meet = num_meet;
+    arrived = 0;
+    running = 0;
+    max_running = 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    threads.clear();
+  }
+};
+
+KernelLog kernel_log;
+
+// Allocate a tensor of four floats in register dst, using dst - 3 to dst - 1.
+std::vector<Instruction> AllocVector(RegName dst) {
+  return {
+    Instruction::LoadConsti(16, dst - 3),
+    Instruction::LoadConsti(64, dst - 2),
+    Instruction::AllocStorage(dst - 3, dst - 2, kFloat32, dst - 1),
+    Instruction::AllocTensor(dst - 1, 0, {4}, kFloat32, dst),
+  };
+}
+
+// main(x) returns (f(x), f(x)) when chained is false, or (f(x), f(f(x))).
+ObjectPtr<TestVM> CreateVM(bool chained, ObjectPtr<Executable>* exec) {
+  std::vector<Instruction> code = AllocVector(4);
+  std::vector<Instruction> second = AllocVector(8);
+  code.insert(code.end(), second.begin(), second.end());
+  code.push_back(Instruction::InvokePacked(0, 2, 1, {0, 4}));
+  code.push_back(Instruction::InvokePacked(0, 2, 1, {static_cast<RegName>(chained ? 4 : 0), 8}));
+  code.push_back(Instruction::AllocADT(0, 2, {4, 8}, 9));
+  code.push_back(Instruction::Ret(9));
+  *exec = make_object<Executable>();
+  (*exec)->functions.emplace_back("main", std::vector<std::string>{"x"}, code, 10);
+  (*exec)->global_map["main"] = 0;
+
+  auto vm = make_object<TestVM>();
+  vm->LoadExecutable(exec->get());
+  vm->Init({{kDLCPU, 0}});
+  // out = x + 1, slowly, failing on a negative input.
+  vm->SetPackedFunc(PackedFunc([](TVMArgs args, TVMRetValue* rv) {
+    DLTensor* x = args[0];
+    DLTensor* out = args[1];
+    CHECK_GE(static_cast<float*>(x->data)[0], 0) << "negative input";
+    {
+      std::lock_guard<std::mutex> lock(kernel_log.mutex);
+      kernel_log.threads.push_back(std::this_thread::get_id());
+    }
+    int running = ++kernel_log.running;
+    int max_running = kernel_log.max_running.load();
+    while (running > max_running &&
+           !kernel_log.max_running.compare_exchange_weak(max_running, running)) {}
+    if (kernel_log.meet > 0) Arrive(&kernel_log.arrived, kernel_log.meet);
+    // leave the kernels which must not overlap time to do so.
+    std::this_thread::sleep_for(std::chrono::milliseconds(kSleepMs));
+    for (int i = 0; i < 4; ++i) {
+      static_cast<float*>(out->data)[i] = static_cast<float*>(x->data)[i] + 1;
+    }
+    --kernel_log.running;
+  }));
+  return vm;
+}
+
+NDArray Fill(float value) {
+  NDArray array = NDArray::Empty({4}, kFloat32, {kDLCPU, 0});
+  for (int i = 0; i < 4; ++i) {
+    static_cast<float*>(array->data)[i] = value;
+  }
+  return array;
+}
+
+float First(const ObjectRef& obj) {
+  return static_cast<float*>(Downcast<NDArray>(obj)->data)[0];
+}
+
+}  // namespace
+
+TEST(KernelScheduler, Ordering) {
+  KernelScheduler scheduler(std::vector<std::vector<unsigned> >(3));
+  std::vector<char> buf(64);
+  KernelScheduler::Range first{buf.data(), buf.data() + 32};
+  KernelScheduler::Range second{buf.data() + 32, buf.data() + 64};
+  KernelScheduler::Range whole{buf.data(), buf.data() + 64};
+  std::atomic<int> step{0};
+  int write_first = -1, write_second = -1, read_whole = -1;
+  // the two writers of disjoint ranges overlap, each waits for the other.
+  std::atomic<int> arrived{0};
+  bool met_first = false, met_second = false;
+  scheduler.Launch([&] {
+      met_first = Arrive(&arrived, 2);
+      write_first = step++;
+    }, {}, {first});
+  scheduler.Launch([&] {
+      met_second = Arrive(&arrived, 2);
+      write_second = step++;
+    }, {}, {second});
+  // reads what both wrote, so runs after them.
+  scheduler.Launch([&] { read_whole = step++; }, {whole}, {});
+  scheduler.WaitWriters(first);
+  EXPECT_GE(write_first, 0);
+  scheduler.WaitAll();
+  EXPECT_EQ(read_whole, 2);
+  EXPECT_LT(write_first + write_second, 2);
+  EXPECT_TRUE(met_first);
+  EXPECT_TRUE(met_second);
+}
+
+TEST(KernelScheduler, Error) {
+  KernelScheduler scheduler(std::vector<std::vector<unsigned> >(1));
+  std::vector<char> buf(16);
+  KernelScheduler::Range range{buf.data(), buf.data() + 16};
+  bool ran_after = false;
+  scheduler.Launch([] { LOG(FATAL) << "kernel failed"; }, {}, {range});
+  scheduler.Launch([&] { ran_after = true; }, {range}, {});
+  EXPECT_THROW(scheduler.WaitWriters(range), dmlc::Error);
+  EXPECT_NE(scheduler.Drain().find("kernel failed"), std::string::npos);
+  EXPECT_FALSE(ran_after);
+  scheduler.Launch([&] { ran_after = true; }, {range}, {});
+  scheduler.WaitAll();
+  EXPECT_TRUE(ran_after);
+}
+
+TEST(VMAsync, IndependentKernelsOverlap) {
+  ObjectPtr<Executable> exec;
+  auto vm = CreateVM(false, &exec);
+  kernel_log.Reset(2);
+  auto result = vm->InvokeAsync("main", {Fill(1)});
+  ADT out = Downcast<ADT>(result.get());
+  EXPECT_EQ(kernel_log.max_running.load(), 2);
+  EXPECT_EQ(First(out[0]), 2);
+  EXPECT_EQ(First(out[1]), 2);
+}
+
+TEST(VMAsync, DependentKernelsInOrder) {
+  ObjectPtr<Executable> exec;
+  auto vm = CreateVM(true, &exec);
+  kernel_log.Reset(0);
+  std::vector<std::shared_future<ObjectRef> > results;
+  for (int i = 0; i < 3; ++i) {
+    results.push_back(vm->InvokeAsync("main", {Fill(static_cast<float>(i))}));
+  }
+  for (int i = 0; i < 3; ++i) {
+    ADT out = Downcast<ADT>(results[i].get());
+    EXPECT_EQ(First(out[0]), i + 1);
+    EXPECT_EQ(First(out[1]), i + 2);
+  }
+  // each kernel reads what the one before it wrote.
+  EXPECT_EQ(kernel_log.max_running.load(), 1);
+}
+
+TEST(VMAsync, Error) {
+  ObjectPtr<Executable> exec;
+  auto vm = CreateVM(false, &exec);
+  kernel_log.Reset(0);
+  auto failed = vm->InvokeAsync("main", {Fill(-1)});
+  auto next = vm->InvokeAsync("main", {Fill(3)});
+  EXPECT_THROW(failed.get(), dmlc::Error);
+  // the VM carries on with the next invocation.
+  EXPECT_EQ(First(Downcast<ADT>(next.get())[1]), 4);
+}
+
+TEST(VMAsync, SyncInvokeInPlace) {
+  ObjectPtr<Executable> exec;
+  auto vm = CreateVM(false, &exec);
+  kernel_log.Reset(0);
+  vm->InvokeAsync("main", {Fill(1)}).get();
+  // the default workers of the asynchronous invocations are not used.
+  kernel_log.Reset(0);
+  ADT out = Downcast<ADT>(vm->InvokeMain({Fill(1)}));
+  EXPECT_EQ(First(out[1]), 2);
+  ASSERT_EQ(kernel_log.threads.size(), 2U);
+  for (const auto& id : kernel_log.threads) {
+    EXPECT_EQ(id, std::this_thread::get_id());
+  }
+  // until the workers are set.
+  vm->ConfigureAsync(2, "");
+  kernel_log.Reset(2);
+  out = Downcast<ADT>(vm->InvokeMain({Fill(1)}));
+  EXPECT_EQ(First(out[1]), 2);
+  EXPECT_EQ(kernel_log.max_running.load(), 2);
+  for (const auto& id : kernel_log.threads) {
+    EXPECT_NE(id, std::this_thread::get_id());
+  }
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  testing::FLAGS_gtest_death_test_style = "threadsafe";
+  return RUN_ALL_TESTS();
+}
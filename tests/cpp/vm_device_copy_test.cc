@@ -0,0 +1,152 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file vm_device_copy_test.cc
+ * \brief Tests of the VM running on several contexts, with copies between them.
+ */
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <tvm/runtime/container.h>
+#include <tvm/runtime/vm.h>
+
+using namespace tvm::runtime;
+using namespace tvm::runtime::vm;
+
+namespace {
+
+const DLDataType kFloat32 = {kDLFloat, 32, 1};
+const int64_t kSize = 1024;
+
+// The number of calls of add_one with a tensor outside of the second CPU.
+std::atomic<int> num_misplaced{0};
+
+// A library with the kernel add_one, which runs on the second CPU.
+class KernelLib : public ModuleNode {
+ public:
+  PackedFunc GetFunction(const std::string& name,
+                         const ObjectPtr<Object>& sptr_to_self) final {
+    if (name != "add_one") return PackedFunc();
+    return PackedFunc([](TVMArgs args, TVMRetValue* rv) {
+      DLTensor* x = args[0];
+      DLTensor* out = args[1];
+      if (x->ctx.device_id != 1 || out->ctx.device_id != 1) ++num_misplaced;
+      for (int64_t i = 0; i < kSize; ++i) {
+        static_cast<float*>(out->data)[i] = static_cast<float*>(x->data)[i] + 1;
+      }
+    });
+  }
+
+  const char* type_key() const final {
+    return "KernelLib";
+  }
+};
+
+// main(x) copies x to the second CPU, adds one there, and copies the result back.
+ObjectPtr<Executable> CreateExecutable() {
+  auto exec = make_object<Executable>();
+  exec->functions.emplace_back("main", std::vector<std::string>{"x"},
+                               std::vector<Instruction>{
+                                 Instruction::DeviceCopy(0, kDLCPU, 1, 1),
+                                 Instruction::LoadConsti(kSize * 4, 2),
+                                 Instruction::LoadConsti(64, 3),
+                                 Instruction::AllocStorage(2, 3, kFloat32, 4, kDLCPU, 1),
+                                 Instruction::AllocTensor(4, 0, {kSize}, kFloat32, 5),
+                                 Instruction::InvokePacked(0, 2, 1, {1, 5}),
+                                 Instruction::DeviceCopy(5, kDLCPU, 0, 6),
+                                 Instruction::Ret(6),
+                               }, 7);
+  exec->global_map["main"] = 0;
+  exec->primitive_map["add_one"] = 0;
+  exec->lib = Module(make_object<KernelLib>());
+  return exec;
+}
+
+ObjectPtr<VirtualMachine> CreateVM(const Executable* exec) {
+  auto vm = make_object<VirtualMachine>();
+  vm->LoadExecutable(exec);
+  Module(vm).GetFunction("init")(static_cast<int>(kDLCPU), 0, static_cast<int>(kDLCPU), 1);
+  return vm;
+}
+
+NDArray Fill(float value) {
+  NDArray array = NDArray::Empty({kSize}, kFloat32, {kDLCPU, 0});
+  for (int64_t i = 0; i < kSize; ++i) {
+    static_cast<float*>(array->data)[i] = value;
+  }
+  return array;
+}
+
+NDArray InvokeMain(Module vm_mod, float x) {
+  vm_mod.GetFunction("set_input")("main", Fill(x));
+  ObjectRef out = vm_mod.GetFunction("invoke")("main");
+  return Downcast<NDArray>(out);
+}
+
+void ExpectResult(const NDArray& out, float expected) {
+  EXPECT_EQ(out->ctx.device_type, kDLCPU);
+  EXPECT_EQ(out->ctx.device_id, 0);
+  int num_wrong = 0;
+  for (int64_t i = 0; i < kSize; ++i) {
+    if (static_cast<float*>(out->data)[i] != expected) ++num_wrong;
+  }
+  EXPECT_EQ(num_wrong, 0);
+}
+
+}  // namespace
+
+TEST(VMDeviceCopy, TwoContexts) {
+  auto exec = CreateExecutable();
+  auto vm = CreateVM(exec.get());
+  num_misplaced = 0;
+  for (int i = 0; i < 3; ++i) {
+    ExpectResult(InvokeMain(Module(vm), i), i + 1);
+  }
+  EXPECT_EQ(num_misplaced, 0);
+
+  vm->StartTrace(1024, 1);
+  InvokeMain(Module(vm), 0);
+  std::string trace = vm->ExportTrace();
+  size_t num_copies = 0;
+  for (size_t pos = trace.find("\"cat\": \"copy\""); pos != std::string::npos;
+       pos = trace.find("\"cat\": \"copy\"", pos + 1)) {
+    ++num_copies;
+  }
+  EXPECT_EQ(num_copies, 2U);
+}
+
+TEST(VMDeviceCopy, Async) {
+  auto exec = CreateExecutable();
+  auto vm = CreateVM(exec.get());
+  Module(vm).GetFunction("configure_async")(2, std::string());
+  num_misplaced = 0;
+  for (int i = 0; i < 20; ++i) {
+    ExpectResult(InvokeMain(Module(vm), i), i + 1);
+  }
+  EXPECT_EQ(num_misplaced, 0);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  testing::FLAGS_gtest_death_test_style = "threadsafe";
+  return RUN_ALL_TESTS();
+}
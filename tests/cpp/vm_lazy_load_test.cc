@@ -0,0 +1,176 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file vm_lazy_load_test.cc
+ * \brief Tests of loading the constants and functions of a saved VM
+ *  executable on first use.
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <tvm/runtime/container.h>
+#include <tvm/runtime/device_api.h>
+#include <tvm/runtime/vm.h>
+
+using namespace tvm::runtime;
+using namespace tvm::runtime::vm;
+
+namespace {
+
+const DLDataType kFloat32 = {kDLFloat, 32, 1};
+
+NDArray Fill(int64_t size, float value) {
+  NDArray array = NDArray::Empty({size}, kFloat32, {kDLCPU, 0});
+  for (int64_t i = 0; i < size; ++i) {
+    static_cast<float*>(array->data)[i] = value;
+  }
+  return array;
+}
+
+// An executable of functions returning one constant each.
+std::string SaveExecutable(int num_funcs) {
+  auto exec = make_object<Executable>();
+  for (int i = 0; i < num_funcs; ++i) {
+    std::string name = "f" + std::to_string(i);
+    exec->functions.emplace_back(name, std::vector<std::string>{"x"},
+                                 std::vector<Instruction>{Instruction::LoadConst(i, 1),
+                                                          Instruction::Ret(1)}, 2);
+    exec->global_map[name] = i;
+    exec->constants.push_back(Fill(1024, static_cast<float>(i)));
+  }
+  TVMByteArray code = exec->Save();
+  return std::string(code.data, code.size);
+}
+
+NDArray InvokeArray(const Module& exec_mod, const std::string& name) {
+  auto vm = make_object<VirtualMachine>();
+  vm->LoadExecutable(static_cast<const Executable*>(exec_mod.operator->()));
+  Module vm_mod(vm);
+  vm_mod.GetFunction("init")(static_cast<int>(kDLCPU), 0);
+  vm_mod.GetFunction("set_input")(name, Fill(1, 0));
+  ObjectRef result = vm_mod.GetFunction("invoke")(name);
+  return Downcast<NDArray>(result);
+}
+
+float Invoke(const Module& exec_mod, const std::string& name) {
+  return static_cast<float*>(InvokeArray(exec_mod, name)->data)[0];
+}
+
+std::string WriteFile(const std::string& code) {
+  std::string file_name = "vm_lazy_load_test.ro";
+  std::ofstream fs(file_name, std::ios::out | std::ios::binary);
+  fs.write(code.data(), code.size());
+  return file_name;
+}
+
+void CheckLoadedOnUse(const Module& exec_mod) {
+  const auto* exec = static_cast<const Executable*>(exec_mod.operator->());
+  ASSERT_EQ(exec->functions.size(), 4U);
+  ASSERT_EQ(exec->constants.size(), 4U);
+  // the headers of the functions are loaded up front.
+  EXPECT_EQ(exec->functions[2].params.size(), 1U);
+  EXPECT_EQ(exec->functions[2].register_file_size, 2);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(exec->functions[i].instructions.empty());
+    EXPECT_FALSE(exec->constants[i].defined());
+  }
+  EXPECT_EQ(Invoke(exec_mod, "f2"), 2);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(exec->functions[i].instructions.empty(), i != 2);
+    EXPECT_EQ(exec->constants[i].defined(), i == 2);
+  }
+  EXPECT_EQ(Invoke(exec_mod, "f3"), 3);
+  EXPECT_TRUE(exec->constants[3].defined());
+  EXPECT_FALSE(exec->constants[0].defined());
+}
+
+}  // namespace
+
+TEST(VMLazyLoad, FromString) {
+  std::string code = SaveExecutable(4);
+  Module exec_mod = Executable::Load(code, Module());
+  CheckLoadedOnUse(exec_mod);
+  // saving loads the rest, and saves the same executable.
+  auto* exec = const_cast<Executable*>(static_cast<const Executable*>(exec_mod.operator->()));
+  TVMByteArray saved = exec->Save();
+  EXPECT_EQ(std::string(saved.data, saved.size), code);
+  EXPECT_TRUE(exec->constants[0].defined());
+  EXPECT_EQ(Invoke(exec_mod, "f1"), 1);
+}
+
+TEST(VMLazyLoad, FromFile) {
+  std::string code = SaveExecutable(4);
+  std::string file_name = WriteFile(code);
+  Module exec_mod = Executable::LoadFromFile(file_name, Module());
+  std::remove(file_name.c_str());
+  CheckLoadedOnUse(exec_mod);
+}
+
+TEST(VMLazyLoad, WithoutIndex) {
+  std::string code = SaveExecutable(3);
+  // drop the section index, whose offset is followed by the magic number.
+  uint64_t index_offset;
+  std::copy(code.end() - 2 * sizeof(uint64_t), code.end() - sizeof(uint64_t),
+            reinterpret_cast<char*>(&index_offset));
+  // an executable of this format version always has it.
+  EXPECT_THROW(Executable::Load(code.substr(0, index_offset), Module()), dmlc::Error);
+}
+
+TEST(VMLazyLoad, FromFileMatchesInMemory) {
+  auto exec = make_object<Executable>();
+  for (int i = 0; i < 3; ++i) {
+    std::string name = "f" + std::to_string(i);
+    exec->functions.emplace_back(name, std::vector<std::string>{"x"},
+                                 std::vector<Instruction>{Instruction::LoadConst(i, 1),
+                                                          Instruction::Ret(1)}, 2);
+    exec->global_map[name] = i;
+    NDArray constant = Fill(1000 + i, 0);
+    for (int k = 0; k < 1000 + i; ++k) {
+      static_cast<float*>(constant->data)[k] = static_cast<float>(i * 10000 + k);
+    }
+    exec->constants.push_back(constant);
+  }
+  Module in_memory(exec);
+  TVMByteArray saved = exec->Save();
+  std::string file_name = WriteFile(std::string(saved.data, saved.size));
+  Module exec_mod = Executable::LoadFromFile(file_name, Module());
+  std::remove(file_name.c_str());
+  for (int i = 0; i < 3; ++i) {
+    std::string name = "f" + std::to_string(i);
+    NDArray expected = InvokeArray(in_memory, name);
+    NDArray result = InvokeArray(exec_mod, name);
+    ASSERT_EQ(result->shape[0], expected->shape[0]);
+    // the constants are views of the file, aligned as the arrays allocated.
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(result->data) % kAllocAlignment, 0U);
+    EXPECT_EQ(std::memcmp(result->data, expected->data, expected->shape[0] * sizeof(float)), 0)
+        << name;
+  }
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  testing::FLAGS_gtest_death_test_style = "threadsafe";
+  return RUN_ALL_TESTS();
+}
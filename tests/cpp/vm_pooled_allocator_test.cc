@@ -0,0 +1,132 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "../src/runtime/vm/pooled_allocator.h"
+
+using tvm::runtime::vm::AllocatorStats;
+using tvm::runtime::vm::Buffer;
+using tvm::runtime::vm::PooledAllocator;
+
+static const TVMContext kCPU = {kDLCPU, 0};
+static const TVMType kFloat32 = {kDLFloat, 32, 1};
+
+TEST(PooledAllocator, ReuseSizeClass) {
+  PooledAllocator alloc(kCPU);
+  Buffer a = alloc.Alloc(70000, 64, kFloat32);
+  EXPECT_GE(a.size, 70000U);
+  // a quarter of a power of two at most is wasted.
+  EXPECT_LE(a.size, 70000U * 5 / 4);
+  alloc.Free(a);
+  // a request rounded to the same class takes the block cached by this thread.
+  Buffer b = alloc.Alloc(69000, 64, kFloat32);
+  EXPECT_EQ(a.data, b.data);
+  alloc.Free(b);
+
+  AllocatorStats stats = alloc.GetStats();
+  EXPECT_EQ(stats.num_miss, 1U);
+  EXPECT_EQ(stats.num_thread_hit, 1U);
+  EXPECT_EQ(stats.bytes_in_use, 0U);
+  EXPECT_EQ(stats.bytes_cached, a.size);
+  EXPECT_EQ(alloc.UsedMemory(), a.size);
+}
+
+TEST(PooledAllocator, SharedAcrossThreads) {
+  PooledAllocator alloc(kCPU);
+  Buffer a = alloc.Alloc(1 << 20, 64, kFloat32);
+  // the cache of a thread goes to the shared pool when the thread exits.
+  std::thread t([&alloc, &a]() { alloc.Free(a); });
+  t.join();
+  Buffer b = alloc.Alloc(1 << 20, 64, kFloat32);
+  EXPECT_EQ(a.data, b.data);
+  alloc.Free(b);
+
+  AllocatorStats stats = alloc.GetStats();
+  EXPECT_EQ(stats.num_miss, 1U);
+  EXPECT_EQ(stats.num_shared_hit, 1U);
+}
+
+TEST(PooledAllocator, ReleaseOverBudget) {
+  PooledAllocator alloc(kCPU);
+  const size_t limit = 64 << 10;
+  alloc.SetMaxCachedBytes(limit);
+  std::vector<Buffer> bufs;
+  for (int i = 0; i < 8; ++i) {
+    bufs.push_back(alloc.Alloc(32 << 10, 64, kFloat32));
+  }
+  for (const Buffer& buf : bufs) {
+    alloc.Free(buf);
+  }
+  AllocatorStats stats = alloc.GetStats();
+  EXPECT_LE(stats.bytes_cached, limit);
+  EXPECT_GT(stats.num_release, 0U);
+  EXPECT_EQ(stats.peak_bytes_held, 8U * (32 << 10));
+  EXPECT_EQ(alloc.UsedMemory(), stats.bytes_cached);
+
+  alloc.Release(0);
+  EXPECT_EQ(alloc.GetStats().bytes_cached, 0U);
+  EXPECT_EQ(alloc.UsedMemory(), 0U);
+}
+
+TEST(PooledAllocator, TotalBudget) {
+  const size_t default_budget = PooledAllocator::TotalMaxCachedBytes();
+  EXPECT_LT(default_budget, std::numeric_limits<size_t>::max());
+  const size_t limit = 96 << 10;
+  PooledAllocator a(kCPU), b(kCPU);
+  std::vector<Buffer> bufs_a, bufs_b;
+  for (int i = 0; i < 4; ++i) {
+    bufs_a.push_back(a.Alloc(32 << 10, 64, kFloat32));
+    bufs_b.push_back(b.Alloc(32 << 10, 64, kFloat32));
+  }
+  for (int i = 0; i < 4; ++i) {
+    a.Free(bufs_a[i]);
+    b.Free(bufs_b[i]);
+  }
+  // each allocator is within its own budget, not both within the total.
+  EXPECT_EQ(a.GetStats().bytes_cached + b.GetStats().bytes_cached, 8U * (32 << 10));
+  PooledAllocator::SetTotalMaxCachedBytes(limit);
+  EXPECT_LE(PooledAllocator::TotalCachedBytes(), limit);
+  EXPECT_LE(a.GetStats().bytes_cached + b.GetStats().bytes_cached, limit);
+  EXPECT_GT(a.GetStats().num_release + b.GetStats().num_release, 0U);
+
+  for (int i = 0; i < 4; ++i) {
+    bufs_a[i] = a.Alloc(32 << 10, 64, kFloat32);
+    bufs_b[i] = b.Alloc(32 << 10, 64, kFloat32);
+  }
+  for (int i = 0; i < 4; ++i) {
+    a.Free(bufs_a[i]);
+    b.Free(bufs_b[i]);
+  }
+  // the frees after it are trimmed again within an interval of frees.
+  for (int i = 0; i < 512; ++i) {
+    a.Free(a.Alloc(4 << 10, 64, kFloat32));
+  }
+  EXPECT_LE(a.GetStats().bytes_cached + b.GetStats().bytes_cached, limit);
+  PooledAllocator::SetTotalMaxCachedBytes(default_budget);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  testing::FLAGS_gtest_death_test_style = "threadsafe";
+  return RUN_ALL_TESTS();
+}
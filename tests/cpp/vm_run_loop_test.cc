@@ -0,0 +1,251 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file vm_run_loop_test.cc
+ * \brief Tests of the superinstructions of the VM, and a microbenchmark of
+ *  its dispatch loop in ns per step for each opcode and fused sequence.
+ */
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <tvm/runtime/container.h>
+#include <tvm/runtime/vm.h>
+
+using namespace tvm::runtime;
+using namespace tvm::runtime::vm;
+
+namespace {
+
+// The VM with its packed functions set directly, without a compiled library.
+class TestVM : public VirtualMachine {
+ public:
+  using VirtualMachine::Init;
+  using VirtualMachine::Invoke;
+
+  void SetPackedFunc(PackedFunc f) {
+    packed_funcs_.assign(1, f);
+  }
+
+  Opcode GetOpcode(Index func_index, Index pc) const {
+    return loaded_->GetCode(func_index)[pc].op;
+  }
+};
+
+const DLDataType kFloat32 = {kDLFloat, 32, 1};
+const int kRepeat = 1000;
+const int kNumRun = 100;
+
+NDArray ScalarInt(int64_t value) {
+  NDArray array = NDArray::Empty({}, {kDLInt, 64, 1}, {kDLCPU, 0});
+  reinterpret_cast<int64_t*>(array->data)[0] = value;
+  return array;
+}
+
+ObjectPtr<TestVM> CreateVM(const std::vector<Instruction>& code, Index register_file_size,
+                           bool superinstructions, ObjectPtr<Executable>* exec) {
+  *exec = make_object<Executable>();
+  (*exec)->functions.emplace_back("main", std::vector<std::string>{"x"}, code,
+                                  register_file_size);
+  (*exec)->functions.emplace_back("id", std::vector<std::string>{"x"},
+                                  std::vector<Instruction>{Instruction::Ret(0)}, 1);
+  (*exec)->global_map["main"] = 0;
+  (*exec)->global_map["id"] = 1;
+  (*exec)->constants.push_back(NDArray::Empty({4}, kFloat32, {kDLCPU, 0}));
+  (*exec)->constants.push_back(ScalarInt(256));
+
+  setenv("TVM_VM_SUPERINSTRUCTIONS", superinstructions ? "1" : "0", 1);
+  auto vm = make_object<TestVM>();
+  vm->LoadExecutable(exec->get());
+  unsetenv("TVM_VM_SUPERINSTRUCTIONS");
+  vm->Init({{kDLCPU, 0}});
+  vm->SetPackedFunc(PackedFunc([](TVMArgs args, TVMRetValue* rv) {}));
+  return vm;
+}
+
+// A program taking both branches of an if and a match, and allocating a
+// tensor of a storage of a constant size.
+std::vector<Instruction> BranchProgram(int64_t cond) {
+  return {
+    Instruction::LoadConsti(cond, 1),
+    Instruction::LoadConsti(1, 2),
+    Instruction::If(1, 2, 1, 3),
+    Instruction::LoadConsti(10, 3),
+    Instruction::Goto(2),
+    Instruction::LoadConsti(20, 3),
+    Instruction::AllocADT(cond, 1, {3}, 4),
+    Instruction::GetTag(4, 5),
+    Instruction::LoadConsti(1, 6),
+    Instruction::If(5, 6, 1, 3),
+    Instruction::GetField(4, 0, 7),
+    Instruction::Goto(2),
+    Instruction::LoadConsti(30, 7),
+    Instruction::LoadConst(1, 8),
+    Instruction::LoadConsti(64, 9),
+    Instruction::AllocStorage(8, 9, kFloat32, 10),
+    Instruction::AllocTensor(10, 0, {4}, kFloat32, 11),
+    Instruction::AllocADT(0, 2, {7, 11}, 12),
+    Instruction::Ret(12),
+  };
+}
+
+/*!
+ * \brief Time a program of setup followed by kRepeat copies of a step.
+ * \param step The instructions of a step given four registers of its own.
+ * \param first_op Set to the opcode the first step runs as.
+ * \return The ns per step.
+ */
+double TimeStep(const std::vector<Instruction>& setup,
+                const std::function<std::vector<Instruction>(RegName)>& step,
+                bool superinstructions, Opcode* first_op) {
+  const RegName num_setup_regs = 6;
+  const RegName num_step_regs = 4;
+  std::vector<Instruction> code = setup;
+  for (int i = 0; i < kRepeat; ++i) {
+    std::vector<Instruction> instrs = step(num_setup_regs + num_step_regs * i);
+    code.insert(code.end(), instrs.begin(), instrs.end());
+  }
+  code.push_back(Instruction::Ret(0));
+  ObjectPtr<Executable> exec;
+  auto vm = CreateVM(code, num_setup_regs + num_step_regs * kRepeat, superinstructions, &exec);
+  std::vector<ObjectRef> args{ScalarInt(1)};
+  // warm up the register stack, allocators and constant pool.
+  EXPECT_TRUE(vm->Invoke("main", args).defined());
+  *first_op = vm->GetOpcode(0, static_cast<Index>(setup.size()));
+
+  auto begin = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < kNumRun; ++i) {
+    vm->Invoke("main", args);
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  double ns = std::chrono::duration<double, std::nano>(end - begin).count();
+  return ns / (static_cast<double>(kNumRun) * kRepeat);
+}
+
+}  // namespace
+
+TEST(VMRunLoop, Superinstructions) {
+  for (int64_t cond : {0, 1}) {
+    ObjectPtr<Executable> exec;
+    auto vm = CreateVM(BranchProgram(cond), 13, true, &exec);
+
+    ObjectPtr<Executable> ref_exec;
+    auto ref_vm = CreateVM(BranchProgram(cond), 13, false, &ref_exec);
+    for (auto* m : {vm.get(), ref_vm.get()}) {
+      ADT result = Downcast<ADT>(m->Invoke("main", {ScalarInt(0)}));
+      ASSERT_EQ(result.size(), 2U);
+      NDArray field = Downcast<NDArray>(result[0]);
+      // the tag of the adt is cond, taking get_field only when it is 1.
+      int64_t expected = cond == 1 ? 10 : 30;
+      EXPECT_EQ(reinterpret_cast<int64_t*>(field->data)[0], expected);
+      NDArray tensor = Downcast<NDArray>(result[1]);
+      EXPECT_EQ(tensor->shape[0], 4);
+    }
+    // the code of a function is formed on its first call.
+    EXPECT_EQ(vm->GetOpcode(0, 1), Opcode::IfConst);
+    EXPECT_EQ(vm->GetOpcode(0, 7), Opcode::IfTag);
+    EXPECT_EQ(vm->GetOpcode(0, 13), Opcode::AllocStorageTensor);
+    // the first load_consti is read by the if, but it is not a constant operand.
+    EXPECT_EQ(vm->GetOpcode(0, 0), Opcode::LoadConsti);
+  }
+}
+
+TEST(VMRunLoop, NanosPerStep) {
+  // registers: 0 the input, 1 an int scalar, 2 an ADT, 3 a storage, 4 a tensor.
+  std::vector<Instruction> setup{
+    Instruction::LoadConsti(256, 1),
+    Instruction::AllocADT(0, 2, {1, 1}, 2),
+    Instruction::AllocStorage(1, 1, kFloat32, 3),
+    Instruction::AllocTensor(3, 0, {16}, kFloat32, 4),
+  };
+  using Step = std::function<std::vector<Instruction>(RegName)>;
+  std::vector<std::pair<std::string, Step> > benches{
+    {"Move", [](RegName r) { return std::vector<Instruction>{Instruction::Move(1, r)}; }},
+    {"LoadConst", [](RegName r) {
+        return std::vector<Instruction>{Instruction::LoadConst(0, r)}; }},
+    {"LoadConsti", [](RegName r) {
+        return std::vector<Instruction>{Instruction::LoadConsti(1, r)}; }},
+    {"Goto", [](RegName r) { return std::vector<Instruction>{Instruction::Goto(1)}; }},
+    {"If", [](RegName r) { return std::vector<Instruction>{Instruction::If(1, 1, 1, 1)}; }},
+    {"AllocADT", [](RegName r) {
+        return std::vector<Instruction>{Instruction::AllocADT(0, 2, {1, 1}, r)}; }},
+    {"GetField", [](RegName r) {
+        return std::vector<Instruction>{Instruction::GetField(2, 0, r)}; }},
+    {"GetTag", [](RegName r) { return std::vector<Instruction>{Instruction::GetTag(2, r)}; }},
+    {"AllocClosure", [](RegName r) {
+        return std::vector<Instruction>{Instruction::AllocClosure(1, 1, {1}, r)}; }},
+    {"AllocStorage", [](RegName r) {
+        return std::vector<Instruction>{Instruction::AllocStorage(1, 1, kFloat32, r)}; }},
+    {"AllocTensor", [](RegName r) {
+        return std::vector<Instruction>{Instruction::AllocTensor(3, 0, {16}, kFloat32, r)}; }},
+    {"InvokePacked", [](RegName r) {
+        return std::vector<Instruction>{Instruction::InvokePacked(0, 2, 1, {4, 4})}; }},
+    {"Invoke+Ret", [](RegName r) {
+        return std::vector<Instruction>{Instruction::Invoke(1, {1}, r)}; }},
+    // the sequences fused into superinstructions.
+    {"LoadConsti+If", [](RegName r) {
+        return std::vector<Instruction>{Instruction::LoadConsti(256, r),
+                                        Instruction::If(1, r, 1, 1)}; }},
+    {"GetTag+LoadConsti+If", [](RegName r) {
+        return std::vector<Instruction>{Instruction::GetTag(2, r),
+                                        Instruction::LoadConsti(0, r + 1),
+                                        Instruction::If(r, r + 1, 1, 1)}; }},
+    {"AllocStorage+AllocTensor", [](RegName r) {
+        return std::vector<Instruction>{Instruction::LoadConst(1, r),
+                                        Instruction::LoadConsti(64, r + 1),
+                                        Instruction::AllocStorage(r, r + 1, kFloat32, r + 2),
+                                        Instruction::AllocTensor(r + 2, 0, {16}, kFloat32, r + 3)};
+      }},
+  };
+  std::map<std::string, Opcode> fused_ops{
+    {"LoadConsti+If", Opcode::IfConst},
+    {"GetTag+LoadConsti+If", Opcode::IfTag},
+    {"AllocStorage+AllocTensor", Opcode::AllocStorageTensor},
+  };
+  std::cout << std::setw(26) << "step" << std::setw(12) << "ns" << std::setw(12) << "fused ns"
+            << std::endl;
+  for (const auto& bench : benches) {
+    Opcode op, fused_op;
+    double ns = TimeStep(setup, bench.second, false, &op);
+    double fused_ns = TimeStep(setup, bench.second, true, &fused_op);
+    Opcode plain_op = bench.second(0)[0].op;
+    ASSERT_EQ(op, plain_op) << bench.first;
+    // the numbers of a sequence are only those of its superinstruction if it was formed.
+    auto it = fused_ops.find(bench.first);
+    ASSERT_EQ(fused_op, it != fused_ops.end() ? it->second : plain_op) << bench.first;
+    std::cout << std::setw(26) << bench.first << std::fixed << std::setprecision(1)
+              << std::setw(12) << ns << std::setw(12) << fused_ns << std::endl;
+    EXPECT_GT(ns, 0);
+    EXPECT_GT(fused_ns, 0);
+  }
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  testing::FLAGS_gtest_death_test_style = "threadsafe";
+  return RUN_ALL_TESTS();
+}
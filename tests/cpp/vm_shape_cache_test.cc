@@ -0,0 +1,203 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file vm_shape_cache_test.cc
+ * \brief Tests of the reuse of the outputs of the shape functions by the VM,
+ *  and of the kernels specialized for the shapes seen often.
+ */
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <tvm/runtime/container.h>
+#include <tvm/runtime/vm.h>
+
+using namespace tvm::runtime;
+using namespace tvm::runtime::vm;
+
+namespace {
+
+const DLDataType kInt64 = {kDLInt, 64, 1};
+const DLDataType kFloat32 = {kDLFloat, 32, 1};
+
+// A library of the kernels, by name.
+class KernelLib : public ModuleNode {
+ public:
+  explicit KernelLib(std::unordered_map<std::string, PackedFunc> funcs)
+      : funcs_(std::move(funcs)) {}
+
+  PackedFunc GetFunction(const std::string& name,
+                         const ObjectPtr<Object>& sptr_to_self) final {
+    auto it = funcs_.find(name);
+    return it == funcs_.end() ? PackedFunc() : it->second;
+  }
+
+  const char* type_key() const final {
+    return "KernelLib";
+  }
+
+ private:
+  std::unordered_map<std::string, PackedFunc> funcs_;
+};
+
+// Each function f<i>(x) returns kernel i of x, an output of two elements of the type.
+ObjectPtr<Executable> CreateExecutable(const std::vector<DLDataType>& out_types,
+                                       std::unordered_map<std::string, PackedFunc> kernels,
+                                       std::vector<Index> shape_funcs) {
+  auto exec = make_object<Executable>();
+  int i = 0;
+  for (const auto& it : kernels) {
+    DLDataType dtype = out_types[i];
+    std::vector<Instruction> code = {
+      Instruction::LoadConsti(16, 1),
+      Instruction::LoadConsti(64, 2),
+      Instruction::AllocStorage(1, 2, dtype, 3),
+      Instruction::AllocTensor(3, 0, {2}, dtype, 4),
+      Instruction::InvokePacked(i, 2, 1, {0, 4}),
+      Instruction::Ret(4),
+    };
+    std::string name = "f" + std::to_string(i);
+    exec->functions.emplace_back(name, std::vector<std::string>{"x"}, code, 5);
+    exec->global_map[name] = i;
+    exec->primitive_map[it.first] = i;
+    ++i;
+  }
+  exec->shape_funcs = std::move(shape_funcs);
+  exec->lib = Module(make_object<KernelLib>(std::move(kernels)));
+  return exec;
+}
+
+ObjectPtr<VirtualMachine> CreateVM(const Executable* exec) {
+  auto vm = make_object<VirtualMachine>();
+  vm->LoadExecutable(exec);
+  Module(vm).GetFunction("init")(static_cast<int>(kDLCPU), 0);
+  return vm;
+}
+
+template <typename T>
+NDArray Vector(const std::vector<T>& values, DLDataType dtype) {
+  NDArray array = NDArray::Empty({static_cast<int64_t>(values.size())}, dtype, {kDLCPU, 0});
+  for (size_t i = 0; i < values.size(); ++i) {
+    static_cast<T*>(array->data)[i] = values[i];
+  }
+  return array;
+}
+
+template <typename T>
+T Invoke(ObjectPtr<VirtualMachine> vm, const std::string& name, NDArray x, int i) {
+  Module vm_mod(vm);
+  vm_mod.GetFunction("set_input")(name, x);
+  ObjectRef out = vm_mod.GetFunction("invoke")(name);
+  return static_cast<T*>(Downcast<NDArray>(out)->data)[i];
+}
+
+std::string Stats(ObjectPtr<VirtualMachine> vm) {
+  return Module(vm).GetFunction("get_shape_cache_stats")();
+}
+
+}  // namespace
+
+TEST(VMShapeCache, Reuse) {
+  int num_calls = 0;
+  // the shape doubled, and the size of the storage of a float tensor of it.
+  auto shape_func = PackedFunc([&num_calls](TVMArgs args, TVMRetValue* rv) {
+    DLTensor* x = args[0];
+    DLTensor* out = args[1];
+    const int64_t* shape = static_cast<int64_t*>(x->data);
+    static_cast<int64_t*>(out->data)[0] = shape[0] * 2;
+    static_cast<int64_t*>(out->data)[1] = shape[0] * shape[1] * 4;
+    ++num_calls;
+  });
+  auto exec = CreateExecutable({kInt64}, {{"shape_func", shape_func}}, {0});
+  auto vm = CreateVM(exec.get());
+  EXPECT_EQ(Invoke<int64_t>(vm, "f0", Vector<int64_t>({3, 4}, kInt64), 1), 48);
+  EXPECT_EQ(Invoke<int64_t>(vm, "f0", Vector<int64_t>({3, 4}, kInt64), 1), 48);
+  EXPECT_EQ(num_calls, 1);
+  EXPECT_EQ(Invoke<int64_t>(vm, "f0", Vector<int64_t>({5, 4}, kInt64), 0), 10);
+  EXPECT_EQ(Invoke<int64_t>(vm, "f0", Vector<int64_t>({3, 4}, kInt64), 0), 6);
+  EXPECT_EQ(num_calls, 2);
+  std::string stats = Stats(vm);
+  EXPECT_NE(stats.find("{\"shape_cache\": {\"hits\": 2, \"misses\": 2, \"bypassed\": 0, "
+                       "\"evictions\": 0, \"entries\": 2"), std::string::npos) << stats;
+  EXPECT_NE(stats.find("\"name\": \"shape_func\""), std::string::npos) << stats;
+
+  // with a single entry, the other shape is dropped.
+  vm->ConfigureShapeCache(1);
+  Invoke<int64_t>(vm, "f0", Vector<int64_t>({3, 4}, kInt64), 0);
+  Invoke<int64_t>(vm, "f0", Vector<int64_t>({5, 4}, kInt64), 0);
+  EXPECT_EQ(Invoke<int64_t>(vm, "f0", Vector<int64_t>({5, 4}, kInt64), 0), 10);
+  EXPECT_EQ(num_calls, 4);
+  stats = Stats(vm);
+  EXPECT_NE(stats.find("\"hits\": 1, \"misses\": 2, \"bypassed\": 0, \"evictions\": 1"),
+            std::string::npos) << stats;
+
+  vm->ConfigureShapeCache(0);
+  Invoke<int64_t>(vm, "f0", Vector<int64_t>({5, 4}, kInt64), 0);
+  EXPECT_EQ(num_calls, 5);
+  EXPECT_NE(Stats(vm).find("\"shape_cache\": null"), std::string::npos);
+}
+
+TEST(VMShapeCache, Specialize) {
+  // out[0] is the sum of x, which is not a shape function.
+  auto sum = PackedFunc([](TVMArgs args, TVMRetValue* rv) {
+    DLTensor* x = args[0];
+    DLTensor* out = args[1];
+    float total = 0;
+    for (int64_t i = 0; i < x->shape[0]; ++i) {
+      total += static_cast<float*>(x->data)[i];
+    }
+    static_cast<float*>(out->data)[0] = total;
+  });
+  auto exec = CreateExecutable({kFloat32}, {{"sum", sum}}, {});
+  auto vm = CreateVM(exec.get());
+  std::vector<std::string> requests;
+  std::vector<int64_t> shape;
+  vm->SetSpecializeHook(PackedFunc([&](TVMArgs args, TVMRetValue* rv) {
+      requests.push_back(args[0]);
+      ADT shapes = args[1];
+      ASSERT_EQ(shapes.size(), 2U);
+      NDArray x_shape = Downcast<NDArray>(shapes[0]);
+      shape.assign(static_cast<int64_t*>(x_shape->data),
+                   static_cast<int64_t*>(x_shape->data) + x_shape->shape[0]);
+      *rv = PackedFunc([](TVMArgs args, TVMRetValue* rv) {
+        DLTensor* out = args[1];
+        static_cast<float*>(out->data)[0] = -1;
+      });
+    }), 2);
+  NDArray x = Vector<float>({1, 2, 3}, kFloat32);
+  EXPECT_EQ(Invoke<float>(vm, "f0", x, 0), 6);
+  EXPECT_TRUE(requests.empty());
+  EXPECT_EQ(Invoke<float>(vm, "f0", x, 0), 6);
+  ASSERT_EQ(requests.size(), 1U);
+  EXPECT_EQ(requests[0], "sum");
+  EXPECT_EQ(shape, std::vector<int64_t>({3}));
+  EXPECT_EQ(Invoke<float>(vm, "f0", x, 0), -1);
+  // the kernel is called for the other shapes.
+  EXPECT_EQ(Invoke<float>(vm, "f0", Vector<float>({1, 2, 3, 4}, kFloat32), 0), 10);
+  EXPECT_NE(Stats(vm).find("\"specialized\": {\"requests\": 1, \"kernels\": 1, \"calls\": 1}"),
+            std::string::npos) << Stats(vm);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  testing::FLAGS_gtest_death_test_style = "threadsafe";
+  return RUN_ALL_TESTS();
+}
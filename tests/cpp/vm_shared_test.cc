@@ -0,0 +1,153 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file vm_shared_test.cc
+ * \brief Tests of the VMs sharing one loaded executable across threads.
+ */
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <tvm/runtime/container.h>
+#include <tvm/runtime/vm.h>
+
+using namespace tvm::runtime;
+using namespace tvm::runtime::vm;
+
+namespace {
+
+const DLDataType kFloat32 = {kDLFloat, 32, 1};
+const int64_t kSize = 1024;
+
+// A library with the kernel add.
+class KernelLib : public ModuleNode {
+ public:
+  PackedFunc GetFunction(const std::string& name,
+                         const ObjectPtr<Object>& sptr_to_self) final {
+    if (name != "add") return PackedFunc();
+    return PackedFunc([](TVMArgs args, TVMRetValue* rv) {
+      DLTensor* a = args[0];
+      DLTensor* b = args[1];
+      DLTensor* out = args[2];
+      for (int64_t i = 0; i < kSize; ++i) {
+        static_cast<float*>(out->data)[i] =
+            static_cast<float*>(a->data)[i] + static_cast<float*>(b->data)[i];
+      }
+    });
+  }
+
+  const char* type_key() const final {
+    return "KernelLib";
+  }
+};
+
+NDArray Fill(float value) {
+  NDArray array = NDArray::Empty({kSize}, kFloat32, {kDLCPU, 0});
+  for (int64_t i = 0; i < kSize; ++i) {
+    static_cast<float*>(array->data)[i] = value;
+  }
+  return array;
+}
+
+// main(x) returns w + x, and weights() returns w, for a constant w.
+ObjectPtr<Executable> CreateExecutable() {
+  auto exec = make_object<Executable>();
+  exec->functions.emplace_back("main", std::vector<std::string>{"x"},
+                               std::vector<Instruction>{
+                                 Instruction::LoadConst(0, 1),
+                                 Instruction::LoadConsti(kSize * 4, 2),
+                                 Instruction::LoadConsti(64, 3),
+                                 Instruction::AllocStorage(2, 3, kFloat32, 4),
+                                 Instruction::AllocTensor(4, 0, {kSize}, kFloat32, 5),
+                                 Instruction::InvokePacked(0, 3, 1, {1, 0, 5}),
+                                 Instruction::Ret(5),
+                               }, 6);
+  exec->functions.emplace_back("weights", std::vector<std::string>{},
+                               std::vector<Instruction>{Instruction::LoadConst(0, 0),
+                                                        Instruction::Ret(0)}, 1);
+  exec->global_map["main"] = 0;
+  exec->global_map["weights"] = 1;
+  exec->primitive_map["add"] = 0;
+  exec->constants.push_back(Fill(1));
+  exec->lib = Module(make_object<KernelLib>());
+  return exec;
+}
+
+ObjectRef Invoke(Module vm_mod, const std::string& name, std::vector<NDArray> args) {
+  if (!args.empty()) vm_mod.GetFunction("set_input")(name, args[0]);
+  return vm_mod.GetFunction("invoke")(name);
+}
+
+}  // namespace
+
+TEST(VMShared, ConcurrentContexts) {
+  auto exec = CreateExecutable();
+  auto vm = make_object<VirtualMachine>();
+  vm->LoadExecutable(exec.get());
+  Module vm_mod(vm);
+  vm_mod.GetFunction("init")(static_cast<int>(kDLCPU), 0);
+  NDArray weights = Downcast<NDArray>(Invoke(vm_mod, "weights", {}));
+
+  const int num_threads = 8;
+  std::vector<Module> contexts;
+  for (int i = 0; i < num_threads; ++i) {
+    contexts.push_back(vm_mod.GetFunction("create_context")());
+  }
+  std::vector<int> num_wrong(num_threads, 0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < 50; ++i) {
+        float x = static_cast<float>(t * 100 + i);
+        NDArray out = Downcast<NDArray>(Invoke(contexts[t], "main", {Fill(x)}));
+        for (int64_t j = 0; j < kSize; ++j) {
+          if (static_cast<float*>(out->data)[j] != x + 1) ++num_wrong[t];
+        }
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  for (int t = 0; t < num_threads; ++t) {
+    EXPECT_EQ(num_wrong[t], 0) << "thread " << t;
+    // the constants are uploaded once, for all the contexts.
+    NDArray shared = Downcast<NDArray>(Invoke(contexts[t], "weights", {}));
+    EXPECT_EQ(shared->data, weights->data);
+  }
+}
+
+TEST(VMShared, OutlivesCreator) {
+  Module context;
+  {
+    auto exec = CreateExecutable();
+    auto vm = make_object<VirtualMachine>();
+    vm->LoadExecutable(exec.get());
+    Module(vm).GetFunction("init")(static_cast<int>(kDLCPU), 0);
+    context = Module(vm).GetFunction("create_context")();
+  }
+  NDArray out = Downcast<NDArray>(Invoke(context, "main", {Fill(2)}));
+  EXPECT_EQ(static_cast<float*>(out->data)[kSize - 1], 3);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  testing::FLAGS_gtest_death_test_style = "threadsafe";
+  return RUN_ALL_TESTS();
+}
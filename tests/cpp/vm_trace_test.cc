@@ -0,0 +1,156 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * \file vm_trace_test.cc
+ * \brief Tests of the timeline of the runs of the VM.
+ */
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <tvm/runtime/container.h>
+#include <tvm/runtime/vm.h>
+
+using namespace tvm::runtime;
+using namespace tvm::runtime::vm;
+
+namespace {
+
+const DLDataType kFloat32 = {kDLFloat, 32, 1};
+
+// A library with the kernel add_one.
+class KernelLib : public ModuleNode {
+ public:
+  PackedFunc GetFunction(const std::string& name,
+                         const ObjectPtr<Object>& sptr_to_self) final {
+    if (name != "add_one") return PackedFunc();
+    return PackedFunc([](TVMArgs args, TVMRetValue* rv) {
+      DLTensor* x = args[0];
+      DLTensor* out = args[1];
+      for (int i = 0; i < 4; ++i) {
+        static_cast<float*>(out->data)[i] = static_cast<float*>(x->data)[i] + 1;
+      }
+    });
+  }
+
+  const char* type_key() const final {
+    return "KernelLib";
+  }
+};
+
+// main(x) calls f(x), which returns add_one(x).
+ObjectPtr<Executable> CreateExecutable() {
+  auto exec = make_object<Executable>();
+  exec->functions.emplace_back("main", std::vector<std::string>{"x"},
+                               std::vector<Instruction>{Instruction::Invoke(1, {0}, 1),
+                                                        Instruction::Ret(1)}, 2);
+  exec->functions.emplace_back("f", std::vector<std::string>{"x"},
+                               std::vector<Instruction>{
+                                 Instruction::LoadConsti(16, 1),
+                                 Instruction::LoadConsti(64, 2),
+                                 Instruction::AllocStorage(1, 2, kFloat32, 3),
+                                 Instruction::AllocTensor(3, 0, {4}, kFloat32, 4),
+                                 Instruction::InvokePacked(0, 2, 1, {0, 4}),
+                                 Instruction::Ret(4),
+                               }, 5);
+  exec->global_map["main"] = 0;
+  exec->global_map["f"] = 1;
+  exec->primitive_map["add_one"] = 0;
+  exec->lib = Module(make_object<KernelLib>());
+  return exec;
+}
+
+ObjectPtr<VirtualMachine> CreateVM(const Executable* exec) {
+  auto vm = make_object<VirtualMachine>();
+  vm->LoadExecutable(exec);
+  Module(vm).GetFunction("init")(static_cast<int>(kDLCPU), 0);
+  NDArray x = NDArray::Empty({4}, kFloat32, {kDLCPU, 0});
+  Module(vm).GetFunction("set_input")("main", x);
+  return vm;
+}
+
+void InvokeMain(ObjectPtr<VirtualMachine> vm, int times) {
+  for (int i = 0; i < times; ++i) {
+    Module(vm).GetFunction("invoke")("main");
+  }
+}
+
+size_t Count(const std::string& s, const std::string& pattern) {
+  size_t n = 0;
+  for (size_t pos = s.find(pattern); pos != std::string::npos; pos = s.find(pattern, pos + 1)) {
+    ++n;
+  }
+  return n;
+}
+
+int64_t OtherData(const std::string& trace, const std::string& key) {
+  size_t pos = trace.find("\"" + key + "\": ");
+  EXPECT_NE(pos, std::string::npos);
+  return std::stoll(trace.substr(pos + key.size() + 4));
+}
+
+}  // namespace
+
+TEST(VMTrace, Timeline) {
+  auto exec = CreateExecutable();
+  auto vm = CreateVM(exec.get());
+  vm->StartTrace(1024, 1);
+  InvokeMain(vm, 1);
+  std::string trace = vm->ExportTrace();
+  EXPECT_EQ(OtherData(trace, "num_dropped"), 0);
+  EXPECT_EQ(Count(trace, "\"ph\": \"B\", \"cat\": \"frame\", \"name\": \"main\""), 1U);
+  EXPECT_EQ(Count(trace, "\"ph\": \"B\", \"cat\": \"frame\", \"name\": \"f\""), 1U);
+  EXPECT_EQ(Count(trace, "\"ph\": \"E\""), 2U);
+  EXPECT_EQ(Count(trace, "\"name\": \"AllocStorage\", \"args\": {\"bytes\": 16, "
+                         "\"device_type\": 1, \"device_id\": 0}"), 1U);
+  EXPECT_EQ(Count(trace, "\"cat\": \"kernel\", \"name\": \"add_one\""), 1U);
+  EXPECT_EQ(Count(trace, "\"name\": \"InvokePacked\", \"args\": {\"func\": \"f\""), 1U);
+  EXPECT_EQ(Count(trace, "\"name\": \"Invoke\", \"args\": {\"func\": \"main\", \"pc\": 0}"), 1U);
+}
+
+TEST(VMTrace, SampledRingBuffer) {
+  auto exec = CreateExecutable();
+  auto vm = CreateVM(exec.get());
+  vm->StartTrace(1024, 1);
+  InvokeMain(vm, 1);
+  int64_t events_per_run = OtherData(vm->ExportTrace(), "num_events");
+  ASSERT_GT(events_per_run, 8);
+
+  // the first and third runs are recorded, keeping the last 8 events.
+  vm->StartTrace(8, 2);
+  InvokeMain(vm, 3);
+  std::string trace = vm->ExportTrace();
+  EXPECT_EQ(OtherData(trace, "num_events"), 2 * events_per_run);
+  EXPECT_EQ(OtherData(trace, "num_dropped"), 2 * events_per_run - 8);
+  EXPECT_EQ(Count(trace, "\"pid\""), 8U);
+  // the last event is the pop of main.
+  EXPECT_NE(trace.find("\"ph\": \"E\", \"cat\": \"frame\", \"name\": \"main\"}]"),
+            std::string::npos) << trace;
+
+  vm->StopTrace();
+  InvokeMain(vm, 2);
+  EXPECT_EQ(OtherData(vm->ExportTrace(), "num_events"), 2 * events_per_run);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  testing::FLAGS_gtest_death_test_style = "threadsafe";
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,115 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <tvm/runtime/c_backend_api.h>
+#include <tvm/runtime/registry.h>
+
+// Read an integer field of the statistics in json.
+static int64_t GetStat(const std::string& stats, const std::string& key) {
+  size_t pos = stats.find("\"" + key + "\": ");
+  CHECK_NE(pos, std::string::npos) << key;
+  return std::stoll(stats.substr(pos + key.length() + 4));
+}
+
+static std::string GetCPUStats() {
+  const tvm::runtime::PackedFunc* f = tvm::runtime::Registry::Get("runtime.workspace_pool_stats");
+  CHECK(f != nullptr);
+  std::string stats = (*f)(static_cast<int>(kDLCPU));
+  return stats;
+}
+
+static void ResetCPUPool() {
+  (*tvm::runtime::Registry::Get("runtime.workspace_pool_trim"))(static_cast<int>(kDLCPU), 0);
+  (*tvm::runtime::Registry::Get("runtime.workspace_pool_reset_stats"))(static_cast<int>(kDLCPU));
+}
+
+TEST(WorkspacePool, ReuseSizeClass) {
+  ResetCPUPool();
+  std::vector<void*> ptrs;
+  for (int run = 0; run < 3; ++run) {
+    for (size_t nbytes : {100, 5000, 70000, 1 << 20}) {
+      void* ptr = TVMBackendAllocWorkspace(kDLCPU, 0, nbytes, kDLFloat, 32);
+      ASSERT_NE(ptr, nullptr);
+      ptrs.push_back(ptr);
+    }
+    for (auto it = ptrs.rbegin(); it != ptrs.rend(); ++it) {
+      EXPECT_EQ(TVMBackendFreeWorkspace(kDLCPU, 0, *it), 0);
+    }
+    ptrs.clear();
+  }
+  // requests rounded to the same class share the cached block.
+  void* a = TVMBackendAllocWorkspace(kDLCPU, 0, 69000, kDLFloat, 32);
+  EXPECT_EQ(TVMBackendFreeWorkspace(kDLCPU, 0, a), 0);
+
+  std::string stats = GetCPUStats();
+  EXPECT_EQ(GetStat(stats, "num_miss"), 4);
+  EXPECT_EQ(GetStat(stats, "num_hit"), 9);
+  EXPECT_EQ(GetStat(stats, "bytes_in_use"), 0);
+  EXPECT_GE(GetStat(stats, "bytes_cached"), 100 + 5000 + 70000 + (1 << 20));
+}
+
+TEST(WorkspacePool, TrimHighWaterMark) {
+  ResetCPUPool();
+  const size_t limit = 64 << 10;
+  (*tvm::runtime::Registry::Get("runtime.workspace_pool_set_max_cached_bytes"))(
+      static_cast<int>(kDLCPU), static_cast<int64_t>(limit));
+  std::vector<void*> ptrs;
+  for (int i = 0; i < 8; ++i) {
+    ptrs.push_back(TVMBackendAllocWorkspace(kDLCPU, 0, 32 << 10, kDLFloat, 32));
+  }
+  for (void* ptr : ptrs) {
+    EXPECT_EQ(TVMBackendFreeWorkspace(kDLCPU, 0, ptr), 0);
+  }
+  std::string stats = GetCPUStats();
+  EXPECT_LE(GetStat(stats, "bytes_cached"), static_cast<int64_t>(limit));
+  EXPECT_EQ(GetStat(stats, "num_trim"), 6);
+  (*tvm::runtime::Registry::Get("runtime.workspace_pool_set_max_cached_bytes"))(
+      static_cast<int>(kDLCPU), static_cast<int64_t>(1) << 62);
+  ResetCPUPool();
+  EXPECT_EQ(GetStat(GetCPUStats(), "bytes_cached"), 0);
+}
+
+TEST(WorkspacePool, ThreadLocalPools) {
+  ResetCPUPool();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([]() {
+      for (int i = 0; i < 100; ++i) {
+        void* ptr = TVMBackendAllocWorkspace(kDLCPU, 0, 4096 * (1 + i % 3), kDLFloat, 32);
+        EXPECT_EQ(TVMBackendFreeWorkspace(kDLCPU, 0, ptr), 0);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  // the pools of the exited threads are gone, with their statistics.
+  EXPECT_EQ(GetStat(GetCPUStats(), "bytes_in_use"), 0);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  testing::FLAGS_gtest_death_test_style = "threadsafe";
+  return RUN_ALL_TESTS();
+}
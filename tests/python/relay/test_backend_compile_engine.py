@@ -108,6 +108,72 @@ def test_compile_nhwc_pack():
     relay.build(mod, target="llvm")
 
 
+def test_compile_parallel():
+    engine = relay.backend.compile_engine.get()
+    engine.clear()
+    def get_func(shape):
+        x = relay.var("x", shape=shape)
+        f = relay.Function([x], relay.exp(relay.add(x, x)))
+        mod = relay.Module.from_expr(f)
+        mod = relay.transform.InferType()(mod)
+        return mod["main"]
+    funcs = [get_func((i + 1,)) for i in range(8)]
+    # duplicates are lowered once, and the order of the keys is kept.
+    res = engine.lower_parallel(funcs + [get_func((1,))], "llvm")
+    assert len(res) == 9
+    assert res[8].same_as(res[0])
+    assert len(set(r.func_name for r in res[:8])) == 8
+    for func, cached in zip(funcs, res):
+        assert engine.lower(func, "llvm").same_as(cached)
+    # only the lowering of each function counts as a use.
+    assert [v.use_count for _, v in engine.items()] == [1] * 8
+
+
+def test_compile_disk_cache():
+    import os
+    import shutil
+    import subprocess
+    import sys
+    import tempfile
+    script = """
+import numpy as np
+import tvm
+from tvm import relay
+x = relay.var("x", shape=(7,))
+f = relay.Function([x], relay.sigmoid(relay.add(x, x)))
+func = relay.transform.InferType()(relay.Module.from_expr(f))["main"]
+engine = relay.backend.compile_engine.get()
+jitted = engine.jit(func, "llvm")
+x = tvm.nd.array(np.ones(7).astype("float32"))
+y = tvm.nd.empty((7,))
+jitted(x, y)
+np.testing.assert_allclose(y.asnumpy(), 1 / (1 + np.exp(-2)), rtol=1e-5)
+stats = engine.disk_cache_stats()
+print(stats["hits"], stats["writes"])
+"""
+    path = tempfile.mkdtemp()
+    try:
+        env = dict(os.environ, TVM_COMPILE_CACHE_DIR=path)
+        def run_process():
+            return subprocess.check_output([sys.executable, "-c", script], env=env).split()
+        assert run_process() == [b"0", b"1"]
+        # another process uses the function lowered by the first one.
+        assert run_process() == [b"1", b"0"]
+
+        # the least recently used entries are evicted past the budget.
+        engine = relay.backend.compile_engine.get()
+        engine.set_disk_cache(path, max_bytes=1)
+        x = relay.var("x", shape=(8,))
+        f = relay.Function([x], relay.sigmoid(relay.add(x, x)))
+        engine.lower(relay.transform.InferType()(relay.Module.from_expr(f))["main"], "llvm")
+        stats = engine.disk_cache_stats()
+        assert stats["writes"] == 1
+        assert stats["evictions"] == 2
+        assert not os.listdir(path)
+    finally:
+        relay.backend.compile_engine.get().set_disk_cache(None)
+        shutil.rmtree(path)
+
 if __name__ == "__main__":
     test_compile_engine()
     test_compile_placeholder_bypass()
@@ -115,3 +181,5 @@ if __name__ == "__main__":
     test_compile_tuple_dup()
     test_compile_full()
     test_compile_nhwc_pack()
+    test_compile_parallel()
+    test_compile_disk_cache()
@@ -72,7 +72,47 @@ def test_add_sub():
     func = relay.Function([x, y], z)
     check_vm_alloc(func, check_add_sub)
 
+def test_coalesce_storage():
+    x = relay.var('x', shape=(16, 16))
+    y = relay.exp(x)
+    for _ in range(4):
+        # keep the ops from being fused.
+        y = relay.nn.relu(relay.nn.dense(y, x))
+    func = relay.Function([x], y)
+    mod = relay.Module.from_expr(func)
+    compiler = relay.vm.VMCompiler()
+    compiler.lower(mod, "llvm")
+    compiler.codegen()
+    stats = compiler.get_memory_plan_stats()
+    assert stats["num_storage_after"] < stats["num_storage_before"]
+    assert stats["bytes_after"] < stats["bytes_before"]
+
+    vm = relay.vm.VirtualMachine(compiler.get_exec())
+    vm.init(tvm.cpu())
+    x_np = np.random.uniform(size=(16, 16)).astype("float32")
+    ref = relay.create_executor("debug", mod=mod).evaluate()(x_np)
+    res = vm.run(x_np)
+    tvm.testing.assert_allclose(res.asnumpy(), ref.asnumpy(), rtol=1e-5)
+
+def test_coalesce_device_copy():
+    # a copy within one device aliases its source, which must stay alive as
+    # long as the copy.
+    x = relay.var('x', shape=(16, 16))
+    a = relay.exp(x)
+    b = relay.device_copy(a, tvm.cpu(), tvm.cpu())
+    y = x
+    for _ in range(3):
+        y = relay.nn.relu(relay.nn.dense(y, x))
+    func = relay.Function([x], relay.add(b, y))
+    mod = relay.Module.from_expr(func)
+    x_np = np.random.uniform(size=(16, 16)).astype("float32")
+    ref = relay.create_executor("debug", mod=mod).evaluate()(x_np)
+    res = relay.create_executor("vm", mod=mod).evaluate()(x_np)
+    tvm.testing.assert_allclose(res.asnumpy(), ref.asnumpy(), rtol=1e-5)
+
 if __name__ == "__main__":
     test_tyck_alloc_tensor()
     test_add()
     test_add_sub()
+    test_coalesce_storage()
+    test_coalesce_device_copy()
@@ -15,6 +15,8 @@
 # specific language governing permissions and limitations
 # under the License.
 """Unit tests for relay pass manager."""
+import json
+
 import numpy as np
 import pytest
 
@@ -530,5 +532,131 @@ def test_print_ir(capfd):
     assert "multiply" in out
 
 
+def test_pass_profiler():
+    shape = (1, 2, 3)
+    tp = relay.TensorType(shape, "float32")
+    x = relay.var("x", tp)
+    c = relay.const(np.ones(shape, "float32"))
+    y = relay.add(x, relay.add(c, c))
+    func = relay.Function([x], y)
+
+    seq = _transform.Sequential([
+        relay.transform.InferType(),
+        relay.transform.FoldConstant(),
+        relay.transform.DeadCodeElimination()
+    ], name="seq")
+
+    profiler = _transform.PassProfiler()
+    mod = relay.Module({"main": func})
+    with relay.build_config(opt_level=3, profiler=profiler):
+        mod = seq(mod)
+        mod = seq(mod)
+
+    events = json.loads(profiler.trace_json())["traceEvents"]
+    names = [e["name"] for e in events]
+    assert names.count("seq") == 2
+    assert names.count("FoldConstant") == 2
+    assert all(e["dur"] >= 0 and e["ph"] == "X" for e in events)
+    fold = [e for e in events if e["name"] == "FoldConstant"][0]
+    assert fold["args"]["nodes_before"] > fold["args"]["nodes_after"] > 0
+
+    # FoldConstant runs passes of its own, which are nested deeper.
+    report = profiler.report().splitlines()
+    outer = [line for line in report[1:] if not line.startswith("    ")]
+    rows = [line.split() for line in outer]
+    assert [r[0] for r in rows] == ["seq", "InferType", "FoldConstant",
+                                    "DeadCodeElimination"]
+    assert outer[0].startswith("seq ")
+    assert outer[2].startswith("  FoldConstant ")
+    # seq was called twice, as were the passes in it.
+    assert rows[0][2] == "2" and rows[2][1] == "2"
+
+    profiler.reset()
+    assert json.loads(profiler.trace_json())["traceEvents"] == []
+    # passes out of the context are not recorded.
+    seq(mod)
+    assert json.loads(profiler.trace_json())["traceEvents"] == []
+
+
+def test_parallel_function_pass():
+    shape = (1, 4, 8, 8)
+    tp = relay.TensorType(shape, "float32")
+    ctp = relay.TensorType((4,), "float32")
+
+    def subgraph(n):
+        x = relay.var("x", tp)
+        y = x
+        for _ in range(n):
+            gamma, beta, mean, var = [relay.var(v, ctp) for v in "gbmv"]
+            y = relay.nn.batch_norm(y, gamma, beta, mean, var)[0]
+            y = relay.nn.relu(y)
+            y = relay.add(y, relay.add(y, relay.const(1.0)))
+        return relay.Function(relay.analysis.free_vars(y), y)
+
+    # type inference looks up main.
+    names = ["main"] + ["f%d" % i for i in range(1, 16)]
+
+    def build(num_threads):
+        mod = relay.Module()
+        for i, name in enumerate(names):
+            mod[name] = subgraph(i % 4 + 1)
+        seq = _transform.Sequential([
+            relay.transform.SimplifyInference(),
+            relay.transform.EliminateCommonSubexpr(),
+            relay.transform.FuseOps(),
+            relay.transform.DeadCodeElimination(),
+            relay.transform.InferType()
+        ])
+        with relay.build_config(opt_level=3,
+                                function_pass_threads=num_threads):
+            return seq(mod)
+
+    assert relay.transform.FuseOps().thread_safe
+    assert not relay.transform.FoldConstant().thread_safe
+    expected = build(1)
+    actual = build(4)
+    for name in names:
+        assert analysis.graph_equal(actual[name], expected[name])
+        assert actual[name].checked_type == expected[name].checked_type
+
+
+
+def test_parallel_function_pass_shared_subexpr():
+    tp = relay.TensorType((4,), "float32")
+    x = relay.var("x", tp)
+    c = relay.const(1.0)
+    # functions built from the typed body of another share its nodes, the
+    # parameter and the constant included.
+    seed = run_infer_type(relay.Function([x], relay.add(relay.nn.relu(x), c)))
+    param, shared = seed.params[0], seed.body
+    names = ["main"] + ["f%d" % i for i in range(1, 16)]
+
+    def build(num_threads):
+        mod = relay.Module()
+        for i, name in enumerate(names):
+            y = shared
+            for _ in range(i % 4):
+                y = relay.add(y, relay.multiply(shared, c))
+            mod[name] = relay.Function([param], relay.nn.relu(y))
+        seq = _transform.Sequential([
+            relay.transform.EliminateCommonSubexpr(),
+            relay.transform.FuseOps(),
+            relay.transform.InferType()
+        ])
+        with relay.build_config(opt_level=3,
+                                function_pass_threads=num_threads):
+            return seq(mod)
+
+    expected = build(1)
+    actual = build(4)
+    for name in names:
+        assert analysis.graph_equal(actual[name], expected[name])
+        assert actual[name].checked_type == expected[name].checked_type
+    # the shared nodes are left as they were.
+    assert shared.checked_type == tp
+    assert analysis.graph_equal(seed, run_infer_type(
+        relay.Function([x], relay.add(relay.nn.relu(x), c))))
+
+
 if __name__ == "__main__":
     pytest.main()
@@ -15,6 +15,7 @@
 # specific language governing permissions and limitations
 # under the License.
 import os
+import threading
 
 import tvm
 import numpy as np
@@ -570,6 +571,123 @@ def test_add_op_broadcast():
     mod["main"] = func
     check_result([x_data, y_data], x_data + y_data, mod=mod)
 
+def test_invoke_async():
+    mod = relay.Module()
+    x = relay.var('x', shape=(10, 5))
+    y = relay.var('y', shape=(10, 5))
+    a = relay.op.add(x, y)
+    b = relay.op.multiply(x, y)
+    mod["main"] = relay.Function([x, y], relay.Tuple([a, relay.op.subtract(a, b)]))
+    exe = relay.vm.compile(mod, "llvm")
+    vm = relay.vm.VirtualMachine(exe)
+    vm.init(tvm.cpu())
+    vm.configure_async(2)
+    inputs = [[np.random.rand(10, 5).astype('float32') for _ in range(2)]
+              for _ in range(3)]
+    futures = [vm.invoke_async("main", x_data, y_data) for x_data, y_data in inputs]
+    for (x_data, y_data), future in zip(inputs, futures):
+        res = future.result()
+        assert future.done()
+        tvm.testing.assert_allclose(res[0].asnumpy(), x_data + y_data, rtol=1e-5)
+        tvm.testing.assert_allclose(res[1].asnumpy(), x_data + y_data - x_data * y_data,
+                                    rtol=1e-5)
+
+
+def test_shape_cache():
+    mod = relay.Module()
+    x = relay.var('x', shape=(relay.Any(), 4))
+    mod["main"] = relay.Function([x], relay.op.add(relay.op.multiply(x, x), x))
+    exe = relay.vm.compile(mod, "llvm")
+    vm = relay.vm.VirtualMachine(exe)
+    vm.init(tvm.cpu())
+
+    def run(n):
+        x_data = np.random.rand(n, 4).astype('float32')
+        res = vm.run(x_data)
+        tvm.testing.assert_allclose(res.asnumpy(), x_data * x_data + x_data, rtol=1e-5)
+        return vm.shape_cache_stats()["shape_cache"]
+
+    first = run(3)
+    assert first["misses"] > 0
+    again = run(3)
+    assert again["misses"] == first["misses"]
+    assert again["hits"] >= first["hits"] + first["misses"]
+    other = run(5)
+    assert other["misses"] > again["misses"]
+
+    specialized = []
+    def hook(name, shapes):
+        specialized.append((name, [shapes[i].asnumpy().tolist() for i in range(len(shapes))]))
+    vm.set_specialize_hook(hook, 2)
+    run(3)
+    run(3)
+    assert specialized and all([3, 4] in shapes for _, shapes in specialized)
+    assert vm.shape_cache_stats()["specialized"]["requests"] == len(specialized)
+
+    vm.configure_shape_cache(0)
+    assert vm.shape_cache_stats()["shape_cache"] is None
+    run(3)
+
+
+def test_shared_contexts():
+    mod = relay.Module()
+    x = relay.var('x', shape=(10, 10))
+    w = relay.const(np.random.rand(10, 10).astype('float32'))
+    mod["main"] = relay.Function([x], relay.op.add(x, w))
+    exe = relay.vm.compile(mod, "llvm")
+    vm = relay.vm.VirtualMachine(exe)
+    vm.init(tvm.cpu())
+    contexts = [vm.create_context() for _ in range(4)]
+    results = [None] * len(contexts)
+
+    def run(i):
+        x_data = np.random.rand(10, 10).astype('float32')
+        for _ in range(10):
+            out = contexts[i].run(x_data).asnumpy()
+        results[i] = (x_data, out)
+
+    threads = [threading.Thread(target=run, args=(i,)) for i in range(len(contexts))]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    for x_data, out in results:
+        tvm.testing.assert_allclose(out, x_data + w.data.asnumpy(), rtol=1e-5)
+
+
+def test_device_copy():
+    x = relay.var('x', shape=(4, 4))
+    y = relay.device_copy(x, tvm.cpu(0), tvm.cpu(0))
+    mod = relay.Module()
+    mod["main"] = relay.Function([x], relay.op.add(y, relay.const(1.0)))
+    exe = relay.vm.compile(mod, "llvm")
+    assert "device_copy" in exe.bytecode
+    vm = relay.vm.VirtualMachine(exe)
+    vm.init(tvm.cpu())
+    x_data = np.random.rand(4, 4).astype('float32')
+    tvm.testing.assert_allclose(vm.run(x_data).asnumpy(), x_data + 1, rtol=1e-5)
+
+
+def test_heterogeneous():
+    if not tvm.module.enabled("cuda") or not tvm.gpu(0).exist:
+        print("skip because cuda is not enabled.")
+        return
+    x = relay.var('x', shape=(4, 4))
+    y = relay.var('y', shape=(4, 4))
+    add = relay.annotation.on_device(relay.op.add(x, y), tvm.gpu(0))
+    mod = relay.Module()
+    mod["main"] = relay.Function([x, y], relay.op.multiply(add, relay.const(2.0)))
+    with relay.build_config(opt_level=1, fallback_device=tvm.cpu(0)):
+        exe = relay.vm.compile(mod, {"cpu": "llvm", "cuda": "cuda"})
+    assert "device_copy" in exe.bytecode
+    vm = relay.vm.VirtualMachine(exe)
+    vm.init([tvm.cpu(0), tvm.gpu(0)])
+    x_data = np.random.rand(4, 4).astype('float32')
+    y_data = np.random.rand(4, 4).astype('float32')
+    out = vm.run(x_data, y_data)
+    assert out.ctx == tvm.cpu(0)
+    tvm.testing.assert_allclose(out.asnumpy(), (x_data + y_data) * 2, rtol=1e-5)
+
 
 if __name__ == "__main__":
     pytest.main([__file__])
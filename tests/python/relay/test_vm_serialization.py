@@ -145,6 +145,32 @@ def test_save_load():
     tvm.testing.assert_allclose(res.asnumpy(), x_data + x_data)
 
 
+def test_load_exec_from_file():
+    x = relay.var('x', shape=(10, 10))
+    w = relay.var('w', shape=(10, 10))
+    f = relay.Function([x, w], relay.nn.relu(relay.nn.dense(x, w) - x))
+    x_data = np.random.rand(10, 10).astype('float32')
+    params = {"w": np.random.rand(10, 10).astype('float32')}
+
+    exe = create_exec(f, params=params)
+    code, lib = exe.save()
+    tmp = util.tempdir()
+    path_code = tmp.relpath("code.ro")
+    with open(path_code, "wb") as fo:
+        fo.write(code)
+
+    # the weight is a constant of the executable, a view of the mapped file.
+    des_exec = _vm.Executable.load_exec_from_file(path_code, lib)
+    des_vm = _vm.VirtualMachine(des_exec)
+    des_vm.init(tvm.cpu())
+    ref_vm = _vm.VirtualMachine(exe)
+    ref_vm.init(tvm.cpu())
+    for _ in range(2):
+        res = veval(des_vm, x_data)
+        ref = veval(ref_vm, x_data)
+        tvm.testing.assert_allclose(res.asnumpy(), ref.asnumpy())
+
+
 def test_const():
     c = relay.const(1.0, "float32")
     x = relay.var('x', shape=(10, 10), dtype='float32')
@@ -333,6 +359,7 @@ def test_mobilenet():
 if __name__ == "__main__":
     test_serializer()
     test_save_load()
+    test_load_exec_from_file()
     test_const()
     test_if()
     test_loop()
@@ -164,6 +164,33 @@ def test_llvm_persist_parallel():
     check_llvm()
 
 
+def test_llvm_chunked_parallel():
+    n = 1000
+    A = tvm.placeholder((n,), name='A')
+    C = tvm.compute(A.shape, lambda *i: A(*i) * 2 + 1, name='C')
+    s = tvm.create_schedule(C.op)
+    xo, xi = s[C].split(C.op.axis[0], factor=4)
+    s[C].parallel(xo)
+
+    def check_llvm(num_chunk_per_worker):
+        if not tvm.module.enabled("llvm"):
+            return
+        with tvm.build_config(chunked_parallel_launch=True):
+            f = tvm.build(s, [A, C], "llvm")
+        assert "TVMBackendParallelLaunchChunked" in f.get_source()
+        tvm.get_global_func("runtime.config_threadpool_chunking")(num_chunk_per_worker)
+        ctx = tvm.cpu(0)
+        a = tvm.nd.array(np.random.uniform(size=n).astype(A.dtype), ctx)
+        c = tvm.nd.array(np.zeros(n, dtype=C.dtype), ctx)
+        f(a, c)
+        tvm.testing.assert_allclose(c.asnumpy(), a.asnumpy() * 2 + 1)
+
+    check_llvm(1)
+    check_llvm(16)
+    check_llvm(1000)
+    tvm.get_global_func("runtime.config_threadpool_chunking")(4)
+
+
 def test_llvm_flip_pipeline():
     def check_llvm(nn, base):
         if not tvm.module.enabled("llvm"):
@@ -304,6 +331,36 @@ def test_multiple_func():
     check_llvm()
 
 
+def test_llvm_codegen_partitions():
+    n = 64
+    A = tvm.placeholder((n,), name='A')
+    funcs = []
+    for i in range(5):
+        B = tvm.compute(A.shape, lambda *j: A(*j) + i, name='B')
+        s = tvm.create_schedule(B.op)
+        funcs.append(tvm.lower(s, [A, B], name="fadd%d" % i))
+
+    def check(m):
+        a = tvm.nd.array(np.random.uniform(size=n).astype(A.dtype))
+        b = tvm.nd.array(np.zeros(n, dtype=A.dtype))
+        for i in range(5):
+            m["fadd%d" % i](a, b)
+            tvm.testing.assert_allclose(b.asnumpy(), a.asnumpy() + i)
+
+    if not tvm.module.enabled("llvm"):
+        return
+    with tvm.build_config(llvm_codegen_partitions=3):
+        m = tvm.build(funcs, "llvm")
+    assert m.get_function("_get_num_objects")() == 3
+    # the library links the objects of the partitions.
+    temp = util.tempdir()
+    path = temp.relpath("lib.so")
+    m.export_library(path)
+    check(tvm.module.load(path))
+    # the JIT runs the partitions linked into one module.
+    check(m)
+    assert all("fadd%d" % i in m.get_source() for i in range(5))
+
 
 def test_llvm_condition():
     def check_llvm(n, offset):
@@ -651,11 +708,13 @@ if __name__ == "__main__":
     test_rank_zero_bound_checkers()
     test_llvm_bool()
     test_llvm_persist_parallel()
+    test_llvm_chunked_parallel()
     test_llvm_condition()
     test_llvm_vadd_pipeline()
     test_llvm_add_pipeline()
     test_llvm_intrin()
     test_multiple_func()
+    test_llvm_codegen_partitions()
     test_llvm_flip_pipeline()
     test_llvm_madd_pipeline()
     test_llvm_temp_space()
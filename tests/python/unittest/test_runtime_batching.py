@@ -0,0 +1,105 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+import threading
+import numpy as np
+import tvm
+from tvm import relay
+from tvm.relay import vm as relay_vm
+from tvm.contrib import batching, graph_runtime
+
+
+def test_batching_graph_runtime():
+    if not tvm.module.enabled("llvm"):
+        print("Skip because llvm is not enabled")
+        return
+    n, m = 4, 3
+    x = relay.var("x", shape=(n, m))
+    func = relay.Function([x], x * relay.const(2.0) + relay.const(1.0))
+    graph, lib, params = relay.build(relay.Module.from_expr(func), "llvm")
+    mod = graph_runtime.create(graph, lib, tvm.cpu(0))
+    exe = batching.create(mod, ["x"], max_batch_size=8, timeout_us=20000)
+
+    num_thread = 6
+    results = [None] * num_thread
+    data = [np.random.uniform(size=(1 + i % 2, m)).astype("float32")
+            for i in range(num_thread)]
+
+    def run(i):
+        results[i] = exe.infer(data[i])[0].asnumpy()
+
+    threads = [threading.Thread(target=run, args=(i,)) for i in range(num_thread)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    for i in range(num_thread):
+        tvm.testing.assert_allclose(results[i], data[i] * 2.0 + 1.0)
+
+    stats = exe.get_stats()
+    assert stats["max_batch_size"] == n
+    assert stats["num_request"] == num_thread
+    assert stats["num_batch"] <= num_thread
+    exe.reset_stats()
+    assert exe.get_stats()["num_request"] == 0
+
+
+def test_batching_vm():
+    if not tvm.module.enabled("llvm"):
+        print("Skip because llvm is not enabled")
+        return
+    m = 3
+    x = relay.var("x", shape=(relay.Any(), m))
+    y = relay.var("y", shape=(relay.Any(), m))
+    func = relay.Function([x, y], relay.Tuple([x * relay.const(2.0) + y, x - y]))
+    mod = relay.Module()
+    mod["main"] = func
+    exe = relay_vm.compile(mod, "llvm")
+    vm = relay_vm.VirtualMachine(exe)
+    vm.init(tvm.cpu(0))
+    batch_exe = batching.create(vm, max_batch_size=8, timeout_us=20000)
+
+    # requests of 1 to 3 rows, batched in any order, each gets back its own rows.
+    num_thread = 6
+    results = [None] * num_thread
+    data = [(np.random.uniform(size=(1 + i % 3, m)).astype("float32"),
+             np.random.uniform(size=(1 + i % 3, m)).astype("float32"))
+            for i in range(num_thread)]
+
+    def run(i):
+        results[i] = [out.asnumpy() for out in batch_exe.infer(*data[i])]
+
+    threads = [threading.Thread(target=run, args=(i,)) for i in range(num_thread)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    for i in range(num_thread):
+        x_data, y_data = data[i]
+        assert len(results[i]) == 2
+        assert results[i][0].shape == x_data.shape
+        tvm.testing.assert_allclose(results[i][0], x_data * 2.0 + y_data, rtol=1e-5)
+        tvm.testing.assert_allclose(results[i][1], x_data - y_data, rtol=1e-5)
+
+    stats = batch_exe.get_stats()
+    assert stats["num_request"] == num_thread
+    assert 1 <= stats["num_batch"] <= num_thread
+    assert stats["max_batch_size"] == 8
+
+
+if __name__ == "__main__":
+    test_batching_graph_runtime()
+    test_batching_vm()
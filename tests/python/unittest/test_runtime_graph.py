@@ -118,9 +118,79 @@ def test_graph_simple():
             np.testing.assert_equal(out.asnumpy(), x_in + a)
             del mod
 
+    def check_context():
+        import threading
+        from tvm import relay
+        x = relay.var('x', shape=(1, 10))
+        y = relay.var('y', shape=(1, 10))
+        z = relay.add(relay.exp(x), y)
+        func = relay.Function([x, y], z)
+
+        x_in = np.random.uniform(size=(1, 10)).astype("float32")
+        params = {'x': x_in}
+        graph, lib, params = relay.build(func, target="llvm", params=params)
+
+        if not tvm.module.enabled("llvm"):
+            print("Skip because llvm is not enabled")
+            return
+        mod = graph_runtime.create(graph, lib, tvm.cpu(0))
+        mod.load_params(relay.save_param_dict(params))
+        num_contexts = 4
+        contexts = [mod.create_context() for _ in range(num_contexts)]
+        # parameters are shared, not copied.
+        for context in contexts:
+            assert context.get_input('x').handle.contents.data == \
+                mod.get_input('x').handle.contents.data
+        results = [None] * num_contexts
+        inputs = [np.random.uniform(size=(1, 10)).astype("float32")
+                  for _ in range(num_contexts)]
+
+        def run(i):
+            for _ in range(10):
+                contexts[i].run(y=inputs[i])
+                results[i] = contexts[i].get_output(0).asnumpy()
+
+        threads = [threading.Thread(target=run, args=(i,)) for i in range(num_contexts)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        for i in range(num_contexts):
+            tvm.testing.assert_allclose(results[i], np.exp(x_in) + inputs[i], rtol=1e-5)
+
+    def check_mapped_params():
+        from tvm import relay
+        x = relay.var('x', shape=(64, 64))
+        y = relay.var('y', shape=(64, 64))
+        z = relay.add(x, y)
+        func = relay.Function([x, y], z)
+
+        x_in = np.random.uniform(size=(64, 64)).astype("float32")
+        params = {'x': x_in}
+        graph, lib, params = relay.build(func, target="llvm", params=params)
+
+        if not tvm.module.enabled("llvm"):
+            print("Skip because llvm is not enabled")
+            return
+        temp = util.tempdir()
+        path = temp.relpath("params.bin")
+        with open(path, "wb") as fo:
+            fo.write(relay.save_param_dict(params, aligned=True))
+        # the aligned format is also readable by the copying loader.
+        assert relay.load_param_dict(bytearray(open(path, "rb").read())).keys() == params.keys()
+
+        mod = graph_runtime.create(graph, lib, tvm.cpu(0))
+        mod.load_params_from_file(path)
+        a = np.random.uniform(size=(64, 64)).astype("float32")
+        mod.run(y=a)
+        out = mod.get_output(0, tvm.nd.empty((64, 64)))
+        tvm.testing.assert_allclose(out.asnumpy(), x_in + a)
+
     check_verify()
     check_remote()
     check_sharing()
+    check_context()
+    check_mapped_params()
 
 if __name__ == "__main__":
     test_graph_simple()
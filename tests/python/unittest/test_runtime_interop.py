@@ -0,0 +1,105 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+import json
+import multiprocessing
+import numpy as np
+import tvm
+from tvm import relay
+from tvm.contrib import graph_runtime, interop_runtime
+
+
+def test_interop_runtime():
+    if not tvm.module.enabled("llvm"):
+        print("Skip because llvm is not enabled")
+        return
+    shape = (16, 16)
+    x = relay.var("x", shape=shape)
+    # independent branches joined at the end, with reused storage in each.
+    branches = []
+    for i in range(4):
+        y = relay.exp(x * relay.const(0.1 * (i + 1)))
+        y = relay.nn.relu(y - relay.const(1.0))
+        branches.append(relay.sqrt(y))
+    out = branches[0]
+    for y in branches[1:]:
+        out = out + y
+    func = relay.Function([x], out)
+    with relay.build_config(opt_level=0):
+        graph, lib, _ = relay.build(relay.Module.from_expr(func), "llvm")
+
+    ref = graph_runtime.create(graph, lib, tvm.cpu(0))
+    mod = interop_runtime.create(graph, lib, tvm.cpu(0), num_workers=3)
+    for _ in range(5):
+        data = np.random.uniform(size=shape).astype("float32")
+        ref.run(x=data)
+        mod.run(x=data)
+        tvm.testing.assert_allclose(mod.get_output(0).asnumpy(),
+                                    ref.get_output(0).asnumpy(), rtol=1e-5)
+
+    stats = mod.get_node_stats()
+    assert stats["num_workers"] == 3
+    assert stats["num_runs"] == 5
+    for node in stats["nodes"]:
+        assert 0 <= node["worker"] < 3
+        assert node["begin_ns"] <= node["end_ns"] <= stats["run_ns"]
+
+
+def test_interop_runtime_shared_pool():
+    if not tvm.module.enabled("llvm"):
+        print("Skip because llvm is not enabled")
+        return
+    if multiprocessing.cpu_count() < 2:
+        print("Skip because the workers need disjoint cores")
+        return
+    shape = (64, 64)
+    x = relay.var("x", shape=shape)
+    left = relay.nn.relu(relay.exp(x * relay.const(0.1)) - relay.const(1.0))
+    right = relay.sqrt(relay.exp(x * relay.const(0.2)))
+    func = relay.Function([x], left + right)
+    with relay.build_config(opt_level=0):
+        graph, lib, _ = relay.build(relay.Module.from_expr(func), "llvm")
+
+    config = tvm.get_global_func("runtime.config_threadpool")
+    reset = tvm.get_global_func("runtime.threadpool_reset_stats")
+    stats = tvm.get_global_func("runtime.threadpool_stats")
+    # the workers bound to their cores must not rebind the shared pool.
+    config(1, 0, 1)
+    try:
+        reset()
+        ref = graph_runtime.create(graph, lib, tvm.cpu(0))
+        mod = interop_runtime.create(graph, lib, tvm.cpu(0), num_workers=2,
+                                     worker_cores=[[0], [1]])
+        for _ in range(3):
+            data = np.random.uniform(size=shape).astype("float32")
+            mod.run(x=data)
+            ref.run(x=data)
+            tvm.testing.assert_allclose(mod.get_output(0).asnumpy(),
+                                        ref.get_output(0).asnumpy(), rtol=1e-5)
+        shared = json.loads(stats())
+        assert shared["shared"]
+        assert shared["cores"] == []
+        # the reference ran on the shared pool, the workers on their own.
+        ref_launch = shared["num_launch"]
+        mod.run(x=data)
+        assert json.loads(stats())["num_launch"] == ref_launch
+    finally:
+        config(1, 0, 0)
+
+
+if __name__ == "__main__":
+    test_interop_runtime()
+    test_interop_runtime_shared_pool()
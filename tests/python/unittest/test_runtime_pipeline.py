@@ -0,0 +1,130 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+import json
+import multiprocessing
+import numpy as np
+import tvm
+from tvm import relay
+from tvm.contrib import graph_runtime, pipeline_runtime
+
+
+def test_pipeline_runtime():
+    if not tvm.module.enabled("llvm"):
+        print("Skip because llvm is not enabled")
+        return
+    shape = (8, 16)
+    x = relay.var("x", shape=shape)
+    w = relay.var("w", shape=shape)
+    y = x
+    for _ in range(4):
+        y = relay.nn.relu(relay.exp(y * w) - relay.const(1.0))
+    func = relay.Function([x, w], y)
+    w_data = np.random.uniform(size=shape).astype("float32")
+    with relay.build_config(opt_level=0):
+        graph, lib, params = relay.build(
+            relay.Module.from_expr(func), "llvm", params={"w": w_data})
+
+    ref = graph_runtime.create(graph, lib, tvm.cpu(0))
+    ref.set_input(**params)
+
+    def run_frames(mod):
+        num_frame = 8
+        frames = [np.random.uniform(size=shape).astype("float32") for _ in range(num_frame)]
+        outputs = []
+        # keep two frames in flight.
+        for i, frame in enumerate(frames):
+            mod.push(x=frame)
+            if i >= 2:
+                outputs.append(mod.pop()[0].asnumpy())
+        while len(outputs) < num_frame:
+            outputs.append(mod.pop()[0].asnumpy())
+        for frame, out in zip(frames, outputs):
+            ref.run(x=frame)
+            tvm.testing.assert_allclose(out, ref.get_output(0).asnumpy(), rtol=1e-5)
+        return num_frame
+
+    # the frames see the parameters whether set as inputs or loaded.
+    mod = pipeline_runtime.create(graph, lib, tvm.cpu(0), num_stages=3)
+    mod.set_input(**params)
+    num_frame = run_frames(mod)
+    loaded = pipeline_runtime.create(graph, lib, tvm.cpu(0), num_stages=3)
+    loaded.load_params(relay.save_param_dict(params))
+    run_frames(loaded)
+    # the frames would not see parameters updated once they run.
+    try:
+        loaded.load_params(relay.save_param_dict(params))
+        assert False, "load_params after the first frame must fail"
+    except tvm.TVMError:
+        pass
+
+    stats = mod.get_pipeline_stats()
+    assert 1 <= stats["num_stages"] <= 3
+    assert stats["stages"][0]["begin"] == 0
+    for stage in stats["stages"]:
+        assert stage["num_frame"] == num_frame
+        assert 0 <= stage["occupancy"] <= 1
+
+
+def test_pipeline_runtime_shared_pool():
+    if not tvm.module.enabled("llvm"):
+        print("Skip because llvm is not enabled")
+        return
+    if multiprocessing.cpu_count() < 2:
+        print("Skip because the stages need disjoint cores")
+        return
+    shape = (64, 64)
+    x = relay.var("x", shape=shape)
+    y = x
+    for _ in range(4):
+        y = relay.nn.relu(relay.exp(y * relay.const(0.5)) - relay.const(1.0))
+    func = relay.Function([x], y)
+    with relay.build_config(opt_level=0):
+        graph, lib, _ = relay.build(relay.Module.from_expr(func), "llvm")
+
+    config = tvm.get_global_func("runtime.config_threadpool")
+    reset = tvm.get_global_func("runtime.threadpool_reset_stats")
+    stats = tvm.get_global_func("runtime.threadpool_stats")
+    # the stages bound to their cores must not rebind the shared pool.
+    config(1, 0, 1)
+    try:
+        ref = graph_runtime.create(graph, lib, tvm.cpu(0))
+        mod = pipeline_runtime.create(graph, lib, tvm.cpu(0), num_stages=2,
+                                      stage_cores=[[0], [1]])
+        reset()
+        frames = [np.random.uniform(size=shape).astype("float32") for _ in range(6)]
+        outputs = []
+        # at most num_stages + 1 frames in flight, a push blocks past them.
+        for i, frame in enumerate(frames):
+            mod.push(x=frame)
+            if i >= 2:
+                outputs.append(mod.pop()[0].asnumpy())
+        while len(outputs) < len(frames):
+            outputs.append(mod.pop()[0].asnumpy())
+        shared = json.loads(stats())
+        assert shared["shared"]
+        assert shared["cores"] == []
+        assert shared["num_launch"] == 0
+        assert mod.get_pipeline_stats()["num_stages"] == 2
+        for frame, out in zip(frames, outputs):
+            ref.run(x=frame)
+            tvm.testing.assert_allclose(out, ref.get_output(0).asnumpy(), rtol=1e-5)
+    finally:
+        config(1, 0, 0)
+
+if __name__ == "__main__":
+    test_pipeline_runtime()
+    test_pipeline_runtime_shared_pool()
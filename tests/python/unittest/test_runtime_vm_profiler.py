@@ -37,5 +37,48 @@ def test_basic():
     print("\n{}".format(vm.get_stat()))
     print("\n{}".format(vm.get_stat(False)))
 
+def test_trace():
+    if not relay.profiler_vm.enabled():
+        return
+    x = relay.var('x', shape=(relay.Any(), 4))
+    mod = relay.Module()
+    mod["main"] = relay.Function([x], relay.op.add(x, x))
+    exe = relay.vm.compile(mod, 'llvm')
+    vm = relay.profiler_vm.VirtualMachineProfiler(exe)
+    vm.init(tvm.cpu())
+    vm.start_trace(sample_every=2)
+    for n in range(1, 4):
+        vm.invoke("main", [np.random.rand(n, 4).astype('float32')])
+    vm.stop_trace()
+    vm.invoke("main", [np.random.rand(1, 4).astype('float32')])
+
+    events = vm.export_trace()["traceEvents"]
+    # the first and third runs are recorded.
+    assert len([e for e in events if e["ph"] == "B" and e["name"] == "main"]) == 2
+    allocs = [e for e in events if e["cat"] == "alloc"]
+    assert allocs and all(e["args"]["bytes"] > 0 for e in allocs)
+    assert any(e["cat"] == "kernel" for e in events)
+    assert any(e["cat"] == "dispatch" and e["name"] == "InvokePacked" for e in events)
+
+
+def test_async_kernels_timed():
+    if not relay.profiler_vm.enabled():
+        return
+    x = relay.var('x', shape=(4,))
+    mod = relay.Module()
+    mod["main"] = relay.Function([x], relay.op.add(x, x))
+    exe = relay.vm.compile(mod, 'llvm')
+    vm = relay.profiler_vm.VirtualMachineProfiler(exe)
+    vm.init(tvm.cpu())
+    # the kernels run on the workers, yet are timed until they are done.
+    vm.configure_async(1)
+    data = np.random.rand(4).astype('float32')
+    res = vm.invoke("main", [data])
+    np.testing.assert_allclose(res.asnumpy(), data + data)
+    assert "fused_add" in vm.get_stat()
+
+
 if __name__ == "__main__":
     test_basic()
+    test_trace()
+    test_async_kernels_timed()
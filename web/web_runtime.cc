@@ -83,6 +83,14 @@ int TVMBackendParallelLaunch(
   return -1;
 }
 
+int TVMBackendParallelLaunchChunked(
+    FTVMParallelLambda flambda,
+    void* cdata,
+    int num_chunk) {
+  TVMAPISetLastError("Parallel is not supported in Web runtime");
+  return -1;
+}
+
 int TVMBackendParallelBarrier(int task_id, TVMParallelGroupEnv* penv) {
   return 0;
 }